@@ -0,0 +1,28 @@
+// Filename: bench.h
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+// INCLUDES
+#include <chrono>
+
+// Standalone benchmarks of the CPU side systems, they only use the portable classes so they build on Linux too.
+// Every benchmark takes its own arguments (argv[0] is the benchmark name) and returns the process exit code.
+int RunBoundsTreeBench(int argc, char* argv[]);
+int RunEntityBench(int argc, char* argv[]);
+int RunFrameClockBench(int argc, char* argv[]);
+int RunJobSystemBench(int argc, char* argv[]);
+int RunLightBinningBench(int argc, char* argv[]);
+int RunOcclusionBench(int argc, char* argv[]);
+int RunPipelineBench(int argc, char* argv[]);
+int RunRenderQueueBench(int argc, char* argv[]);
+int RunSceneGraphBench(int argc, char* argv[]);
+int RunShaderCacheBench(int argc, char* argv[]);
+int RunTextureStreamerBench(int argc, char* argv[]);
+
+// Milliseconds elapsed since 'start'.
+inline double BenchElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+#endif
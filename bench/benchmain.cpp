@@ -0,0 +1,53 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: benchmain.cpp : Entry point of the standalone benchmarks.
+////////////////////////////////////////////////////////////////////////////////
+// Usage: RasterTekBench <benchmark> [arguments]
+//   boundstree [object count] [frames]    BVH build, refit, culling and ray queries against flat lists (BoundsTreeClass)
+//   entities [object count] [frames]      Entity-component systems against one object per instance (EntityWorldClass)
+//   frameclock [fps] [frames] [work ms]   Frame rate limiter and fixed simulation steps (FrameClockClass)
+//   jobs [item count] [threads]           Work-stealing job system scaling and contention (JobSystemClass)
+//   lightbinning [light count] [frames]   Clustered light binning (LightBinningClass)
+//   occlusion [object count] [frames]     Software occlusion culling behind rows of walls (OcclusionBufferClass)
+//   pipeline [object count] [frames]      Simulation of the next frame overlapped with the render (FramePipelineClass)
+//   renderqueue [packet count] [frames]   Draw packet sort (RenderQueueClass)
+//   scenegraph [node count] [frames]      World matrix update of a transform hierarchy (SceneGraphClass)
+//   shadercache [shaders] [compile ms]    Shader bytecode cache against a stub compiler, hits, misses and keys (ShaderCacheClass)
+//   texturestreamer [frames per phase]    Mip streaming within a budget as the textures seen change (TextureStreamerClass)
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+struct BenchEntry
+{
+    const char* name;
+    int (*run)(int argc, char* argv[]);
+};
+
+static const BenchEntry s_benchmarks[] = {
+    { "boundstree", RunBoundsTreeBench },
+    { "entities", RunEntityBench },
+    { "frameclock", RunFrameClockBench },
+    { "jobs", RunJobSystemBench },
+    { "lightbinning", RunLightBinningBench },
+    { "occlusion", RunOcclusionBench },
+    { "pipeline", RunPipelineBench },
+    { "renderqueue", RunRenderQueueBench },
+    { "scenegraph", RunSceneGraphBench },
+    { "shadercache", RunShaderCacheBench },
+    { "texturestreamer", RunTextureStreamerBench },
+};
+
+int main(int argc, char* argv[])
+{
+    if (argc >= 2) {
+        for (auto& bench : s_benchmarks) {
+            if (strcmp(argv[1], bench.name) == 0) { return bench.run(argc - 1, argv + 1); }
+        }
+    }
+
+    printf("Usage: RasterTekBench <benchmark> [arguments]\n");
+    for (auto& bench : s_benchmarks) { printf("  %s\n", bench.name); }
+
+    return 1;
+}
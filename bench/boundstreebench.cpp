@@ -0,0 +1,254 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: boundstreebench.cpp : Bounds tree (BVH) benchmark.
+////////////////////////////////////////////////////////////////////////////////
+// Object boxes scattered over a square that grows with their count (the same density at every size) behind rows of
+// walls, seen by the camera of the entities benchmark. For every object count:
+//   - the SAH build of the tree, and its refit with a tenth of the objects moving every frame;
+//   - frustum culling, plain and with the occlusion buffer, through the tree and over the flat list of boxes;
+//   - ray queries (picking) from the camera, through the tree and over the flat list.
+// Prints the average times and checks that the tree and the flat list find the same objects.
+//
+// Usage: RasterTekBench boundstree [object count (default 10000, 100000 and 1000000)] [frames (default 20)]
+#include "bench.h"
+#include "boundstreeclass.h"
+#include "entitysystems.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#define BENCH_RAY_COUNT 1000
+
+static float RandomRange(float low, float high)
+{
+    return low + (high - low) * ((float)rand() / (float)RAND_MAX);
+}
+
+static bool BoxOutside(const float planes[6][4], const float* box)
+{
+    for (int i = 0; i < 6; i++) {
+        const float* plane = planes[i];
+        float farthest = plane[0] * ((plane[0] >= 0.0f) ? box[3] : box[0]) + plane[1] * ((plane[1] >= 0.0f) ? box[4] : box[1]) +
+                         plane[2] * ((plane[2] >= 0.0f) ? box[5] : box[2]) + plane[3];
+        if (farthest < 0.0f) { return true; }
+    }
+
+    return false;
+}
+
+static float BoxRayEnter(const float* box, const float origin[3], const float direction[3], float maxDistance)
+{
+    float enter = 0.0f, leave = maxDistance;
+
+    for (int i = 0; i < 3; i++) {
+        float inverse = 1.0f / direction[i];
+        float t0 = (box[i] - origin[i]) * inverse, t1 = (box[3 + i] - origin[i]) * inverse;
+        enter = fmaxf(enter, fminf(t0, t1));
+        leave = fminf(leave, fmaxf(t0, t1));
+    }
+
+    return (enter <= leave) ? enter : -1.0f;
+}
+
+// The camera of the entities benchmark, (0, 20, -150) looking down +Z with a 60 degree field of view.
+static void BuildViewProjection(SceneMatrixType& viewProjection)
+{
+    float yScale = 1.0f / tanf(0.5f * 1.0471976f), xScale = yScale / (16.0f / 9.0f);
+    float nearZ = 0.3f, farZ = 1000.0f;
+    SceneMatrixType projection = { { xScale, 0.0f, 0.0f, 0.0f,  0.0f, yScale, 0.0f, 0.0f,  0.0f, 0.0f, farZ / (farZ - nearZ), 1.0f,
+                                     0.0f, 0.0f, -nearZ * farZ / (farZ - nearZ), 0.0f } };
+    SceneMatrixType view = { { 1.0f, 0.0f, 0.0f, 0.0f,  0.0f, 1.0f, 0.0f, 0.0f,  0.0f, 0.0f, 1.0f, 0.0f,  0.0f, -20.0f, 150.0f, 1.0f } };
+
+    for (int row = 0; row < 4; row++) {
+        for (int column = 0; column < 4; column++) {
+            viewProjection.m[4 * row + column] = view.m[4 * row] * projection.m[column] + view.m[4 * row + 1] * projection.m[4 + column] +
+                                                 view.m[4 * row + 2] * projection.m[8 + column] + view.m[4 * row + 3] * projection.m[12 + column];
+        }
+    }
+
+    return;
+}
+
+// Three rows of walls (boxes 30 wide, 40 high) across the view, as in the occlusion benchmark.
+static void BuildWalls(OcclusionBufferClass& occlusion, const SceneMatrixType& viewProjection)
+{
+    static const int faces[6][4] = { { 0, 1, 3, 2 }, { 4, 6, 7, 5 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 2, 6, 4 }, { 1, 5, 7, 3 } };
+    static const int corners[6] = { 0, 1, 2, 0, 2, 3 };
+    std::vector<float> box;
+
+    for (auto& face : faces) {
+        for (int corner : corners) {
+            box.push_back((face[corner] & 1) ? 1.0f : -1.0f);
+            box.push_back((face[corner] & 2) ? 1.0f : -1.0f);
+            box.push_back((face[corner] & 4) ? 1.0f : -1.0f);
+        }
+    }
+    int mesh = occlusion.AddMesh(box.data(), (int)box.size() / 3);
+
+    occlusion.Begin(viewProjection.m);
+    for (int wallRow = 0; wallRow < 3; wallRow++) {
+        for (int wall = 0; wall < 8; wall++) {
+            float world[16] = { 15.0f, 0.0f, 0.0f, 0.0f,  0.0f, 20.0f, 0.0f, 0.0f,  0.0f, 0.0f, 1.0f, 0.0f,
+                                -160.0f + 40.0f * (float)wall + 10.0f * (float)wallRow, 20.0f, -180.0f + 60.0f * (float)wallRow, 1.0f };
+            occlusion.AddOccluder(mesh, world);
+        }
+    }
+    occlusion.Rasterize(false);
+
+    return;
+}
+
+static bool RunSize(int objectCount, int frameCount, const float planes[6][4], const OcclusionBufferClass& occlusion)
+{
+    BoundsTreeClass tree;
+    std::vector<float> boxes(objectCount * 6);
+    std::vector<unsigned int> treeResult, flatResult;
+    double buildMs, refitMs = 0.0, treeMs = 0.0, flatMs = 0.0, treeOccludedMs = 0.0, flatOccludedMs = 0.0, treeRayMs = 0.0, flatRayMs = 0.0;
+    int rebuildCount = 0, rayHits = 0, i;
+    bool match = true;
+
+    // The square grows with the object count, 100000 objects fill 400 x 400.
+    float halfSize = 200.0f * sqrtf((float)objectCount / 100000.0f);
+    srand(1);
+    tree.Initialize(objectCount);
+    for (i = 0; i < objectCount; i++) {
+        float* box = &boxes[i * 6];
+        float x = RandomRange(-halfSize, halfSize), y = RandomRange(0.0f, 10.0f), z = RandomRange(-halfSize, halfSize), radius = RandomRange(0.5f, 1.5f);
+        box[0] = x - radius;
+        box[1] = y - radius;
+        box[2] = z - radius;
+        box[3] = x + radius;
+        box[4] = y + radius;
+        box[5] = z + radius;
+        tree.AddObject(box, box + 3, (unsigned int)i);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    tree.Update();
+    buildMs = BenchElapsedMs(start);
+
+    for (int frame = 0; frame < frameCount; frame++) {
+        // A tenth of the objects move by up to a unit.
+        for (i = frame % 10; i < objectCount; i += 10) {
+            float* box = &boxes[i * 6];
+            float dx = RandomRange(-1.0f, 1.0f), dz = RandomRange(-1.0f, 1.0f);
+            box[0] += dx;
+            box[3] += dx;
+            box[2] += dz;
+            box[5] += dz;
+            tree.SetBox(i, box, box + 3);
+        }
+        start = std::chrono::steady_clock::now();
+        if (tree.Update()) { rebuildCount++; }
+        refitMs += BenchElapsedMs(start);
+
+        // Frustum culling.
+        treeResult.clear();
+        start = std::chrono::steady_clock::now();
+        tree.QueryFrustum(planes, nullptr, treeResult);
+        treeMs += BenchElapsedMs(start);
+
+        flatResult.clear();
+        start = std::chrono::steady_clock::now();
+        for (i = 0; i < objectCount; i++) {
+            if (!BoxOutside(planes, &boxes[i * 6])) { flatResult.push_back(i); }
+        }
+        flatMs += BenchElapsedMs(start);
+
+        std::sort(treeResult.begin(), treeResult.end());
+        if (treeResult != flatResult) { match = false; }
+        int inFrustum = (int)flatResult.size();
+
+        // Frustum and occlusion culling. The tree skips whole branches behind the walls, the flat list tests every
+        // box in the frustum.
+        treeResult.clear();
+        start = std::chrono::steady_clock::now();
+        tree.QueryFrustum(planes, &occlusion, treeResult);
+        treeOccludedMs += BenchElapsedMs(start);
+
+        flatResult.clear();
+        start = std::chrono::steady_clock::now();
+        for (i = 0; i < objectCount; i++) {
+            const float* box = &boxes[i * 6];
+            if (!BoxOutside(planes, box) && occlusion.TestBox(box, box + 3)) { flatResult.push_back(i); }
+        }
+        flatOccludedMs += BenchElapsedMs(start);
+
+        // Both are conservative, the tree may keep a few more (a branch box is tested before the boxes in it).
+        if (frame == frameCount - 1) {
+            printf("  %d objects: %d in the frustum, %d through the tree and %d through the flat list with occlusion\n", objectCount, inFrustum,
+                   (int)treeResult.size(), (int)flatResult.size());
+        }
+    }
+
+    // Rays from the camera through random points of the view.
+    srand(2);
+    for (int ray = 0; ray < BENCH_RAY_COUNT; ray++) {
+        float origin[3] = { 0.0f, 20.0f, -150.0f };
+        float direction[3] = { RandomRange(-0.5f, 0.5f), RandomRange(-0.3f, 0.0f), 1.0f };
+        unsigned int treeHit = 0, flatHit = 0;
+        float treeDistance, flatDistance = 2000.0f;
+
+        start = std::chrono::steady_clock::now();
+        bool hit = tree.Raycast(origin, direction, 2000.0f, treeHit, treeDistance);
+        treeRayMs += BenchElapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        bool flat = false;
+        for (i = 0; i < objectCount; i++) {
+            float enter = BoxRayEnter(&boxes[i * 6], origin, direction, flatDistance);
+            if ((enter >= 0.0f) && (!flat || (enter < flatDistance))) {
+                flat = true;
+                flatDistance = enter;
+                flatHit = i;
+            }
+        }
+        flatRayMs += BenchElapsedMs(start);
+
+        if (hit != flat) { match = false; }
+        if (hit && flat && (fabsf(treeDistance - flatDistance) > 1.0e-3f)) { match = false; }
+        if (hit) { rayHits++; }
+        (void)treeHit;
+        (void)flatHit;
+    }
+
+    printf("    build        %10.3f ms, %d nodes, SAH cost %.1f\n", buildMs, tree.GetNodeCount(), tree.GetCost());
+    printf("    refit        %10.3f ms per frame, %d rebuilds in %d frames\n", refitMs / frameCount, rebuildCount, frameCount);
+    printf("    frustum      %10.3f ms tree  %10.3f ms flat\n", treeMs / frameCount, flatMs / frameCount);
+    printf("    + occlusion  %10.3f ms tree  %10.3f ms flat\n", treeOccludedMs / frameCount, flatOccludedMs / frameCount);
+    printf("    ray          %10.4f ms tree  %10.4f ms flat, %d of %d rays hit\n", treeRayMs / BENCH_RAY_COUNT, flatRayMs / BENCH_RAY_COUNT, rayHits,
+           BENCH_RAY_COUNT);
+    if (!match) { printf("    The tree and the flat list found different objects\n"); }
+
+    tree.Shutdown();
+
+    return match;
+}
+
+int RunBoundsTreeBench(int argc, char* argv[])
+{
+    OcclusionBufferClass occlusion;
+    SceneMatrixType viewProjection;
+    std::vector<int> objectCounts = { 10000, 100000, 1000000 };
+    float planes[6][4];
+    int frameCount = 20;
+    bool match = true;
+
+    if (argc > 1) { objectCounts = { atoi(argv[1]) }; }
+    if (argc > 2) { frameCount = atoi(argv[2]); }
+    if ((objectCounts[0] < 1) || (frameCount < 1)) { printf("Invalid arguments\n"); return 1; }
+
+    BuildViewProjection(viewProjection);
+    ComputeFrustumPlanes(viewProjection, planes);
+    if (!occlusion.Initialize(256, 144)) { printf("Could not initialize the occlusion buffer\n"); return 1; }
+    BuildWalls(occlusion, viewProjection);
+
+    printf("Bounds tree: %d frames\n", frameCount);
+    for (int objectCount : objectCounts) { match = RunSize(objectCount, frameCount, planes, occlusion) && match; }
+
+    occlusion.Shutdown();
+
+    return match ? 0 : 1;
+}
@@ -0,0 +1,245 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: entitybench.cpp : Entity-component systems against one heap object per instance.
+////////////////////////////////////////////////////////////////////////////////
+// The same frame is run on both layouts: spin every object, compute its world matrix, cull its bounding sphere
+// against the view frustum and submit the visible ones to a render queue.
+//   - objects: one heap allocated object per instance (allocated between other allocations, as objects created over
+//     the life of an application are), reached through a pointer array and copying getters, the way ModelClass /
+//     LightClass are used.
+//   - entities: EntityWorldClass archetypes and the systems of entitysystems.h, on one thread and on the workers.
+// Prints the average time per frame of every step and the number of visible objects (the same for both).
+//
+// Usage: RasterTekBench entities [object count (default 100000)] [frames (default 50)]
+#include "bench.h"
+#include "entitysystems.h"
+#include "rtparallel.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+struct BenchFloat4
+{
+    float x, y, z, w;
+};
+
+// The object-per-instance layout: private state behind getters and setters, one allocation per object.
+class BenchObjectClass
+{
+public:
+    BenchObjectClass(float x, float y, float z, float speed, float phase)
+    {
+        m_transform = { { 0.0f, 0.0f, 0.0f, 1.0f }, { x, y, z, 0.0f }, { 1.0f, 1.0f, 1.0f, 0.0f } };
+        m_speed = speed;
+        m_phase = phase;
+        m_radius = 1.0f;
+        m_visible = false;
+    }
+
+    void SetRotation(BenchFloat4 quaternion)
+    {
+        m_transform.rotation[0] = quaternion.x;
+        m_transform.rotation[1] = quaternion.y;
+        m_transform.rotation[2] = quaternion.z;
+        m_transform.rotation[3] = quaternion.w;
+    }
+
+    void Update() { SceneGraphClass::ComputeLocalMatrix(m_transform, m_world); }
+
+    float GetSpeed() { return m_speed; }
+    float GetPhase() { return m_phase; }
+    SceneMatrixType GetWorldMatrix() { return m_world; }
+    BenchFloat4 GetBoundingSphere() { return { m_world.m[12], m_world.m[13], m_world.m[14], m_radius }; }
+    void SetVisible(bool visible) { m_visible = visible; }
+    bool IsVisible() { return m_visible; }
+
+private:
+    SceneTransformType m_transform;
+    SceneMatrixType m_world;
+    float m_speed, m_phase, m_radius;
+    bool m_visible;
+};
+
+static BenchFloat4 YawQuaternion(float yaw)
+{
+    return { 0.0f, sinf(yaw * 0.5f), 0.0f, cosf(yaw * 0.5f) };
+}
+
+// A camera at (0, 20, -150) looking down +Z, 60 degree field of view: a bit more than half of the field is in view.
+static void BuildFrustum(float planes[6][4], SceneMatrixType& view)
+{
+    float yScale = 1.0f / tanf(0.5f * 1.0471976f), xScale = yScale / (16.0f / 9.0f);
+    float nearZ = 0.3f, farZ = 1000.0f;
+    SceneMatrixType projection = { { xScale, 0.0f, 0.0f, 0.0f,  0.0f, yScale, 0.0f, 0.0f,  0.0f, 0.0f, farZ / (farZ - nearZ), 1.0f,
+                                     0.0f, 0.0f, -nearZ * farZ / (farZ - nearZ), 0.0f } };
+    SceneMatrixType viewProjection;
+    int row, column;
+
+    view = { { 1.0f, 0.0f, 0.0f, 0.0f,  0.0f, 1.0f, 0.0f, 0.0f,  0.0f, 0.0f, 1.0f, 0.0f,  0.0f, -20.0f, 150.0f, 1.0f } };
+    for (row = 0; row < 4; row++) {
+        for (column = 0; column < 4; column++) {
+            viewProjection.m[4 * row + column] = view.m[4 * row] * projection.m[column] + view.m[4 * row + 1] * projection.m[4 + column] +
+                                                 view.m[4 * row + 2] * projection.m[8 + column] + view.m[4 * row + 3] * projection.m[12 + column];
+        }
+    }
+
+    ComputeFrustumPlanes(viewProjection, planes);
+
+    return;
+}
+
+static void PrintStep(const char* name, double totalMs, int frameCount)
+{
+    printf("    %-12s %8.3f ms\n", name, totalMs / (double)frameCount);
+}
+
+static int RunObjects(std::vector<BenchObjectClass*>& objects, const float planes[6][4], const SceneMatrixType& view, RenderQueueClass& queue,
+                      int frameCount)
+{
+    double spinMs = 0.0, transformMs = 0.0, cullMs = 0.0, submitMs = 0.0;
+    int visibleCount = 0;
+
+    for (int frame = 0; frame < frameCount; frame++) {
+        float rotation = 0.01f * (float)frame;
+
+        auto start = std::chrono::steady_clock::now();
+        for (auto object : objects) { object->SetRotation(YawQuaternion(object->GetSpeed() * rotation + object->GetPhase())); }
+        spinMs += BenchElapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        for (auto object : objects) { object->Update(); }
+        transformMs += BenchElapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        visibleCount = 0;
+        for (auto object : objects) {
+            BenchFloat4 sphere = object->GetBoundingSphere();
+            bool visible = true;
+            for (int plane = 0; plane < 6; plane++) {
+                float distance = (planes[plane][0] * sphere.x + planes[plane][1] * sphere.y) + (planes[plane][2] * sphere.z + planes[plane][3]);
+                if (distance < -sphere.w) { visible = false; }
+            }
+            object->SetVisible(visible);
+            if (visible) { visibleCount++; }
+        }
+        cullMs += BenchElapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        queue.Begin();
+        unsigned int payload = 0;
+        for (auto object : objects) {
+            if (!object->IsVisible()) { continue; }
+            SceneMatrixType world = object->GetWorldMatrix();
+            float depth = world.m[12] * view.m[2] + world.m[13] * view.m[6] + world.m[14] * view.m[10] + view.m[14];
+            queue.Submit(queue.MakeKey(RENDER_PASS_OPAQUE, 0, 0, 0, depth), payload++);
+        }
+        submitMs += BenchElapsedMs(start);
+    }
+
+    printf("  objects, one thread: %d visible\n", visibleCount);
+    PrintStep("spin", spinMs, frameCount);
+    PrintStep("transform", transformMs, frameCount);
+    PrintStep("culling", cullMs, frameCount);
+    PrintStep("submission", submitMs, frameCount);
+    PrintStep("frame", spinMs + transformMs + cullMs + submitMs, frameCount);
+
+    return visibleCount;
+}
+
+static int RunEntities(EntityWorldClass& world, const float planes[6][4], const SceneMatrixType& view, RenderQueueClass& queue, int frameCount,
+                       bool useThreads)
+{
+    std::vector<SceneMatrixType> visibleWorlds;
+    double spinMs = 0.0, transformMs = 0.0, cullMs = 0.0, submitMs = 0.0;
+    int visibleCount = 0;
+
+    visibleWorlds.reserve(world.GetEntityCount());
+    for (int frame = 0; frame < frameCount; frame++) {
+        float rotation = 0.01f * (float)frame;
+
+        auto start = std::chrono::steady_clock::now();
+        UpdateSpinSystem(world, rotation, useThreads);
+        spinMs += BenchElapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        UpdateTransformSystem(world, useThreads);
+        transformMs += BenchElapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        visibleCount = UpdateCullingSystem(world, planes, useThreads);
+        cullMs += BenchElapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        queue.Begin();
+        visibleWorlds.clear();
+        SubmitRenderSystem(world, view, 1000.0f, &queue, 0, visibleWorlds);
+        submitMs += BenchElapsedMs(start);
+    }
+
+    printf("  entities, %s: %d visible\n", useThreads ? "worker threads" : "one thread", visibleCount);
+    PrintStep("spin", spinMs, frameCount);
+    PrintStep("transform", transformMs, frameCount);
+    PrintStep("culling", cullMs, frameCount);
+    PrintStep("submission", submitMs, frameCount);
+    PrintStep("frame", spinMs + transformMs + cullMs + submitMs, frameCount);
+
+    return visibleCount;
+}
+
+int RunEntityBench(int argc, char* argv[])
+{
+    EntityWorldClass world;
+    RenderQueueClass queue;
+    std::vector<BenchObjectClass*> objects;
+    std::vector<void*> otherAllocations;
+    SceneMatrixType view;
+    float planes[6][4];
+    int objectCount = 100000;
+    int frameCount = 50;
+    int i;
+
+    if (argc > 1) { objectCount = atoi(argv[1]); }
+    if (argc > 2) { frameCount = atoi(argv[2]); }
+    if ((objectCount < 1) || (frameCount < 1)) { printf("Invalid arguments\n"); return 1; }
+
+    if (!world.Initialize(objectCount) || !queue.Initialize(objectCount)) { printf("Could not initialize the entity world\n"); return 1; }
+    queue.SetDepthRange(0.3f, 1000.0f);
+    BuildFrustum(planes, view);
+
+    // The same objects in both layouts, spread over a 400 x 400 square around the camera target.
+    srand(1);
+    unsigned int mask = COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_WORLD) | COMPONENT_BIT(COMPONENT_BOUNDS) |
+                        COMPONENT_BIT(COMPONENT_SPIN) | COMPONENT_BIT(COMPONENT_RENDERABLE);
+    for (i = 0; i < objectCount; i++) {
+        float x = (float)(rand() % 4000) * 0.1f - 200.0f;
+        float z = (float)(rand() % 4000) * 0.1f - 200.0f;
+        float speed = 0.5f + (float)(rand() % 100) * 0.01f;
+        float phase = (float)(rand() % 628) * 0.01f;
+
+        objects.push_back(new BenchObjectClass(x, 0.0f, z, speed, phase));
+        otherAllocations.push_back(malloc(16 + rand() % 256));
+
+        EntityId entity = world.CreateEntity(mask);
+        SceneTransformType* transform = world.Get<SceneTransformType>(entity, COMPONENT_TRANSFORM);
+        transform->translation[0] = x;
+        transform->translation[2] = z;
+        world.Get<BoundsComponent>(entity, COMPONENT_BOUNDS)->radius = 1.0f;
+        SpinComponent* spin = world.Get<SpinComponent>(entity, COMPONENT_SPIN);
+        spin->speed = speed;
+        spin->phase = phase;
+    }
+
+    printf("Entities: %d objects, %d frames, %u threads\n", objectCount, frameCount, RTGetWorkerCount());
+    int objectsVisible = RunObjects(objects, planes, view, queue, frameCount);
+    int entitiesVisible = RunEntities(world, planes, view, queue, frameCount, false);
+    RunEntities(world, planes, view, queue, frameCount, true);
+    if (objectsVisible != entitiesVisible) { printf("Visible counts differ\n"); }
+
+    for (auto object : objects) { delete object; }
+    for (auto allocation : otherAllocations) { free(allocation); }
+    queue.Shutdown();
+    world.Shutdown();
+
+    return (objectsVisible == entitiesVisible) ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: frameclockbench.cpp : Frame rate limiter and fixed-timestep clock benchmark.
+////////////////////////////////////////////////////////////////////////////////
+// A main loop of frames doing a few milliseconds of work each, held at a frame rate limit in two ways: spinning on the
+// clock until the frame is due (the old loop never waited at all, this is the best it could pace) and the sleeping
+// limiter of FrameClockClass. Prints the frame intervals and the CPU time the loop used per frame, the point of the
+// limiter being a CPU time close to the work itself: the limiter must not use more than a tenth of the wait.
+//
+// Then the simulation clock: frames of random lengths must simulate the same time as the real time they took, in
+// whole steps, and a long stall must not be caught up.
+//
+// Usage: RasterTekBench frameclock [frame rate (default 120)] [frames (default 240)] [work ms (default 2)]
+#include "bench.h"
+#include "frameclockclass.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+#define BENCH_STEP_TIME (1.0f / 60.0f)
+
+// Busy work for 'ms' milliseconds, standing in for the simulation and the draw calls of a frame.
+static void Work(double ms)
+{
+    auto start = std::chrono::steady_clock::now();
+    volatile float sink = 0.0f;
+
+    while (BenchElapsedMs(start) < ms) {
+        for (int i = 0; i < 1000; i++) { sink = sink + 1.0f; }
+    }
+
+    return;
+}
+
+static void PrintIntervals(const char* name, std::vector<double>& intervals, double cpuMs, int frameCount, double targetMs)
+{
+    double sum = 0.0, squares = 0.0, worst = 0.0;
+
+    for (double interval : intervals) {
+        sum += interval;
+        squares += interval * interval;
+        worst = fmax(worst, fabs(interval - targetMs));
+    }
+    double mean = sum / (double)intervals.size();
+    double deviation = sqrt(fmax(0.0, squares / (double)intervals.size() - mean * mean));
+
+    printf("  %-10s %8.3f ms per frame (deviation %.3f, worst %.3f off)  CPU %7.3f ms per frame\n", name, mean, deviation, worst,
+           cpuMs / frameCount);
+
+    return;
+}
+
+int RunFrameClockBench(int argc, char* argv[])
+{
+    FrameClockClass clock;
+    std::vector<double> intervals;
+    float frameRate = 120.0f;
+    int frameCount = 240;
+    double workMs = 2.0;
+    int frame;
+    bool match = true;
+
+    if (argc > 1) { frameRate = (float)atof(argv[1]); }
+    if (argc > 2) { frameCount = atoi(argv[2]); }
+    if (argc > 3) { workMs = atof(argv[3]); }
+    if ((frameRate <= 0.0f) || (frameCount < 2) || (workMs < 0.0)) { printf("Invalid arguments\n"); return 1; }
+
+    double targetMs = 1000.0 / frameRate;
+    printf("Frame clock: %.0f fps limit (%.3f ms), %d frames of %.1f ms work\n", frameRate, targetMs, frameCount, workMs);
+
+    // Step 1: Spinning until the frame is due. ---------------------------------------------------------------------
+    auto previous = std::chrono::steady_clock::now(), deadline = previous;
+    clock_t cpuStart = ::clock();
+    for (frame = 0; frame < frameCount; frame++) {
+        Work(workMs);
+        deadline += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(targetMs));
+        while (std::chrono::steady_clock::now() < deadline) {}
+
+        auto now = std::chrono::steady_clock::now();
+        intervals.push_back(std::chrono::duration<double, std::milli>(now - previous).count());
+        previous = now;
+    }
+    PrintIntervals("spin", intervals, 1000.0 * (double)(::clock() - cpuStart) / CLOCKS_PER_SEC, frameCount, targetMs);
+
+    // Step 2: The limiter of the frame clock. ----------------------------------------------------------------------
+    clock.Initialize(BENCH_STEP_TIME);
+    clock.SetFrameRateLimit(frameRate);
+    intervals.clear();
+    previous = std::chrono::steady_clock::now();
+    cpuStart = ::clock();
+    for (frame = 0; frame < frameCount; frame++) {
+        Work(workMs);
+        clock.WaitForNextFrame();
+
+        auto now = std::chrono::steady_clock::now();
+        intervals.push_back(std::chrono::duration<double, std::milli>(now - previous).count());
+        previous = now;
+    }
+    double limiterCpuMs = 1000.0 * (double)(::clock() - cpuStart) / CLOCKS_PER_SEC;
+    PrintIntervals("limiter", intervals, limiterCpuMs, frameCount, targetMs);
+    if ((targetMs > workMs) && ((limiterCpuMs / frameCount) > workMs + 0.1 * (targetMs - workMs))) { match = false; }
+    printf("  oversleep %.3f ms\n", clock.GetOversleep() * 1000.0);
+
+    // Step 3: Fixed steps. Frames of 1 to 40 ms simulate what they last, whatever the frame rate. -----------------
+    clock.Initialize(BENCH_STEP_TIME);
+    srand(1);
+    double realTime = 0.0, simulatedTime = 0.0;
+    int steps = 0;
+    for (frame = 0; frame < 50; frame++) {
+        std::this_thread::sleep_for(std::chrono::microseconds(1000 + rand() % 39000));
+        int frameSteps = clock.BeginFrame();
+        steps += frameSteps;
+        realTime += clock.GetFrameTime();
+        simulatedTime = steps * (double)clock.GetStepTime();
+
+        float interpolation = clock.GetInterpolation();
+        if ((interpolation < 0.0f) || (interpolation >= 1.0f)) { match = false; }
+    }
+    // What is left over is less than a step.
+    double behind = realTime - simulatedTime;
+    if ((behind < -1.0e-4) || (behind >= clock.GetStepTime())) { match = false; }
+    printf("  fixed steps: %.4f s real, %d steps simulated %.4f s, %.4f s in the next step\n", realTime, steps, simulatedTime, behind);
+
+    // A stall of a second runs at most FRAME_CLOCK_MAX_FRAME_TIME of steps.
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    int stallSteps = clock.BeginFrame();
+    if (stallSteps > (int)(FRAME_CLOCK_MAX_FRAME_TIME / clock.GetStepTime()) + 1) { match = false; }
+    printf("  a 1 s stall runs %d steps\n", stallSteps);
+
+    clock.Shutdown();
+    if (!match) { printf("The limiter spun or the simulation clock lost time\n"); }
+
+    return match ? 0 : 1;
+}
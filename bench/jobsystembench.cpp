@@ -0,0 +1,201 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: jobsystembench.cpp : Work-stealing job system benchmark and stress test.
+////////////////////////////////////////////////////////////////////////////////
+// Scaling: a parallel loop over 'item count' items of a few hundred nanoseconds each, on job systems of 1 thread up
+// to 'threads', against the loop before the job system (a std::thread started per helper and per loop). Then the
+// cost of a small loop (64 chunks of almost nothing), where starting threads per loop is what the frame pays.
+//
+// Contention: threads that are not workers (as the window and the simulation thread are) start loops at the same
+// time, loops nested in loops, fans of thousands of tiny jobs started from inside jobs (more than a deque holds),
+// all against the same workers. Every item must be counted exactly once.
+//
+// Waiting: a thread waits on a job that sleeps for a while on a worker. The waiter must sleep too, not use up a core.
+//
+// Usage: RasterTekBench jobs [item count (default 1000000)] [threads (default the core count, at least 4)]
+#include "bench.h"
+#include "jobsystemclass.h"
+
+#include <algorithm>
+#include <atomic>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+#define BENCH_SMALL_LOOPS 2000
+#define BENCH_STRESS_CALLERS 4
+#define BENCH_STRESS_ROUNDS 200
+#define BENCH_FAN_JOBS (2 * JOB_SYSTEM_DEQUE_SIZE)
+#define BENCH_LONG_JOB_MS 100
+
+// The loop of RTParallelFor before the job system, for comparison.
+static void SpawnParallelFor(int threadCount, int count, int grain, const std::function<void(int begin, int end)>& func)
+{
+    int chunkCount = (count + grain - 1) / grain;
+    std::atomic<int> nextChunk(0);
+    std::vector<std::thread> threads;
+
+    threadCount = std::min(threadCount, chunkCount);
+    auto worker = [&]() {
+        for (int chunk = nextChunk.fetch_add(1); chunk < chunkCount; chunk = nextChunk.fetch_add(1)) {
+            int begin = chunk * grain;
+            func(begin, std::min(begin + grain, count));
+        }
+    };
+    for (int i = 1; i < threadCount; i++) { threads.emplace_back(worker); }
+    worker();
+    for (auto& thread : threads) { thread.join(); }
+
+    return;
+}
+
+// A few hundred nanoseconds of arithmetic per item.
+static void Work(std::vector<float>& values, int begin, int end)
+{
+    for (int i = begin; i < end; i++) {
+        float value = (float)i;
+        for (int k = 0; k < 32; k++) { value = sqrtf(value * 1.0001f + 1.0f); }
+        values[i] = value;
+    }
+
+    return;
+}
+
+struct FanType
+{
+    JobSystemClass* jobs;
+    std::atomic<long long>* total;
+};
+
+static void CountJob(void* data)
+{
+    ((FanType*)data)->total->fetch_add(1, std::memory_order_relaxed);
+    return;
+}
+
+static void LongJob(void*)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(BENCH_LONG_JOB_MS));
+    return;
+}
+
+// Runs on a worker: more jobs than its deque holds, so the last ones run inline.
+static void FanJob(void* data)
+{
+    FanType* fan = (FanType*)data;
+    std::vector<JobType> jobs(BENCH_FAN_JOBS, JobType{ CountJob, fan, nullptr });
+    JobCounterType counter;
+
+    fan->jobs->Run(jobs.data(), (int)jobs.size(), counter);
+    fan->jobs->Wait(counter);
+
+    return;
+}
+
+int RunJobSystemBench(int argc, char* argv[])
+{
+    std::vector<float> values;
+    int itemCount = 1000000;
+    int maxThreads = std::max(4, (int)std::thread::hardware_concurrency());
+    std::vector<int> threadCounts;
+    int threadCount, loop;
+    bool match = true;
+
+    if (argc > 1) { itemCount = atoi(argv[1]); }
+    if (argc > 2) { maxThreads = atoi(argv[2]); }
+    if ((itemCount < 1) || (maxThreads < 1) || (maxThreads > JOB_SYSTEM_MAX_WORKERS + 1)) { printf("Invalid arguments\n"); return 1; }
+
+    values.resize(itemCount);
+    auto work = [&](int begin, int end) { Work(values, begin, end); };
+    auto nothing = [&](int begin, int) { values[begin] += 1.0f; };
+
+    printf("Job system: %d items, up to %d threads, %u cores\n", itemCount, maxThreads, std::thread::hardware_concurrency());
+
+    // Step 1: Scaling, the job system against threads started per loop. ------------------------------------------
+    double serialMs = 0.0;
+    for (threadCount = 1; threadCount < maxThreads; threadCount *= 2) { threadCounts.push_back(threadCount); }
+    threadCounts.push_back(maxThreads);
+    for (int threads : threadCounts) {
+        JobSystemClass jobs;
+        if (!jobs.Initialize(threads - 1, true)) { printf("Could not start the job system\n"); return 1; }
+
+        auto start = std::chrono::steady_clock::now();
+        jobs.ParallelFor(itemCount, 1024, work);
+        double jobMs = BenchElapsedMs(start);
+        if (threads == 1) { serialMs = jobMs; }
+
+        start = std::chrono::steady_clock::now();
+        SpawnParallelFor(threads, itemCount, 1024, work);
+        double spawnMs = BenchElapsedMs(start);
+
+        // The small loops.
+        start = std::chrono::steady_clock::now();
+        for (loop = 0; loop < BENCH_SMALL_LOOPS; loop++) { jobs.ParallelFor(64, 1, nothing); }
+        double smallJobUs = 1000.0 * BenchElapsedMs(start) / BENCH_SMALL_LOOPS;
+
+        start = std::chrono::steady_clock::now();
+        for (loop = 0; loop < BENCH_SMALL_LOOPS; loop++) { SpawnParallelFor(threads, 64, 1, nothing); }
+        double smallSpawnUs = 1000.0 * BenchElapsedMs(start) / BENCH_SMALL_LOOPS;
+
+        printf("  %2d threads: loop %8.3f ms (%.2fx), threads per loop %8.3f ms;  small loop %7.2f us, threads per loop %7.2f us\n",
+               threads, jobMs, serialMs / jobMs, spawnMs, smallJobUs, smallSpawnUs);
+        jobs.Shutdown();
+    }
+
+    // Step 2: Contention. ---------------------------------------------------------------------------------------
+    JobSystemClass jobs;
+    std::atomic<long long> total(0);
+    if (!jobs.Initialize(maxThreads - 1, false)) { printf("Could not start the job system\n"); return 1; }
+
+    int outer = 64, inner = 256;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> callers;
+    for (int caller = 0; caller < BENCH_STRESS_CALLERS; caller++) {
+        callers.emplace_back([&]() {
+            FanType fan = { &jobs, &total };
+            for (int round = 0; round < BENCH_STRESS_ROUNDS; round++) {
+                // A loop of loops, counted item by item.
+                jobs.ParallelFor(outer, 1, [&](int begin, int end) {
+                    for (int i = begin; i < end; i++) {
+                        jobs.ParallelFor(inner, 16, [&](int innerBegin, int innerEnd) { total.fetch_add(innerEnd - innerBegin, std::memory_order_relaxed); });
+                    }
+                });
+
+                // A job fanning out, every few rounds.
+                if ((round % 20) == 0) {
+                    JobType job = { FanJob, &fan, nullptr };
+                    JobCounterType counter;
+                    jobs.Run(&job, 1, counter);
+                    jobs.Wait(counter);
+                }
+            }
+        });
+    }
+    for (auto& caller : callers) { caller.join(); }
+    double stressMs = BenchElapsedMs(start);
+
+    long long expected = (long long)BENCH_STRESS_CALLERS * BENCH_STRESS_ROUNDS * outer * inner +
+                         (long long)BENCH_STRESS_CALLERS * ((BENCH_STRESS_ROUNDS + 19) / 20) * BENCH_FAN_JOBS;
+    if (total.load() != expected) { match = false; }
+    printf("  contention: %d callers, %d workers, %.3f ms, %lld of %lld items counted, %llu jobs stolen\n", BENCH_STRESS_CALLERS,
+           maxThreads - 1, stressMs, total.load(), expected, jobs.GetStealCount());
+
+    // Step 3: Waiting on a long job, the CPU time of the process is the waiter's. ---------------------------------
+    JobType longJob = { LongJob, nullptr, nullptr };
+    JobCounterType longCounter;
+    start = std::chrono::steady_clock::now();
+    clock_t cpuStart = clock();
+    jobs.Run(&longJob, 1, longCounter);
+    jobs.Wait(longCounter);
+    double waitCpuMs = 1000.0 * (double)(clock() - cpuStart) / CLOCKS_PER_SEC;
+    double waitMs = BenchElapsedMs(start);
+    if (waitCpuMs > 0.25 * waitMs) { match = false; }
+    printf("  waiting on a %d ms job: %.3f ms, %.3f ms of CPU\n", BENCH_LONG_JOB_MS, waitMs, waitCpuMs);
+    jobs.Shutdown();
+
+    if (!match) { printf("The job system lost or repeated items, or spun while waiting\n"); }
+
+    return match ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: lightbinningbench.cpp : Clustered light binning benchmark.
+////////////////////////////////////////////////////////////////////////////////
+// Bins a set of point lights scattered in front of the camera into the default cluster grid every frame, the lights
+// drift a little between frames like the animated lights of test 15. Prints the average time per frame and the
+// light count statistics of the clusters.
+//
+// Usage: RasterTekBench lightbinning [light count (default 1024)] [frames (default 200)]
+#include "bench.h"
+#include "lightbinningclass.h"
+#include "rtparallel.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Same projection as the application (D3DClass).
+#define BENCH_FOV_Y (3.14159265f / 4.0f)
+#define BENCH_ASPECT (16.0f / 9.0f)
+#define BENCH_NEAR 0.3f
+#define BENCH_FAR 1000.0f
+
+static float RandomRange(float low, float high)
+{
+    return low + (high - low) * ((float)rand() / (float)RAND_MAX);
+}
+
+int RunLightBinningBench(int argc, char* argv[])
+{
+    LightBinningClass binning;
+    LightBinningConfig config;
+    std::vector<ClusterLightType> lights;
+    float view[16] = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 };   // Camera at the origin looking down +z.
+    int lightCount = 1024;
+    int frameCount = 200;
+    int frame, i, cluster, maxCount, usedClusters, indexCount = 0;
+    double totalMs, bestMs, ms;
+
+    if (argc > 1) { lightCount = atoi(argv[1]); }
+    if (argc > 2) { frameCount = atoi(argv[2]); }
+    if ((lightCount < 0) || (frameCount < 1)) { printf("Invalid arguments\n"); return 1; }
+
+    if (!binning.Initialize(config)) { printf("Could not initialize the light binning\n"); return 1; }
+    binning.SetFrustum(BENCH_FOV_Y, BENCH_ASPECT, BENCH_NEAR, BENCH_FAR);
+
+    // The lights fill the first 100 units of the frustum, with radii of a few units like local point lights.
+    srand(1);
+    lights.resize(lightCount);
+    for (auto& light : lights) {
+        light.position[2] = RandomRange(1.0f, 100.0f);
+        light.position[0] = RandomRange(-0.7f, 0.7f) * light.position[2];
+        light.position[1] = RandomRange(-0.4f, 0.4f) * light.position[2];
+        light.radius = RandomRange(1.0f, 6.0f);
+        light.color[0] = light.color[1] = light.color[2] = light.color[3] = 1.0f;
+    }
+
+    // Warm up (allocation of the per slice lists), then time every frame.
+    binning.Bin(view, lights.data(), lightCount);
+
+    totalMs = 0.0;
+    bestMs = 1.0e30;
+    for (frame = 0; frame < frameCount; frame++) {
+        for (i = 0; i < lightCount; i++) { lights[i].position[0] += 0.05f * sinf((float)(frame + i)); }
+
+        auto start = std::chrono::steady_clock::now();
+        indexCount = binning.Bin(view, lights.data(), lightCount);
+        ms = BenchElapsedMs(start);
+
+        totalMs += ms;
+        bestMs = std::min(bestMs, ms);
+    }
+
+    // Statistics of the last frame.
+    const ClusterRangeType* ranges = binning.GetClusterRanges();
+    maxCount = 0;
+    usedClusters = 0;
+    for (cluster = 0; cluster < binning.GetClusterCount(); cluster++) {
+        maxCount = std::max(maxCount, (int)ranges[cluster].count);
+        if (ranges[cluster].count > 0) { usedClusters++; }
+    }
+
+    printf("Light binning: %d lights, %d x %d x %d clusters, %u threads\n", lightCount, config.clustersX, config.clustersY, config.clustersZ,
+           RTGetWorkerCount());
+    printf("  time per frame: %.3f ms average, %.3f ms best (%d frames)\n", totalMs / (double)frameCount, bestMs, frameCount);
+    printf("  light indices: %d (overflow %d), clusters with lights: %d, max lights in a cluster: %d, average: %.1f\n",
+           indexCount, binning.GetOverflowCount(), usedClusters, maxCount, (usedClusters > 0) ? (double)indexCount / (double)usedClusters : 0.0);
+
+    binning.Shutdown();
+
+    return 0;
+}
@@ -0,0 +1,151 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: occlusionbench.cpp : Software occlusion culling benchmark.
+////////////////////////////////////////////////////////////////////////////////
+// The objects of the entities benchmark (spheres scattered over a 400 x 400 square) behind rows of walls, the
+// occluders. Every frame the objects are culled against the frustum, the walls are rasterized into the occlusion
+// buffer and the objects left are tested against it, on one thread and on the workers. Prints the average time per
+// frame of the rasterization and of the tests, and how many of the objects in the frustum the walls hide.
+//
+// Usage: RasterTekBench occlusion [object count (default 100000)] [frames (default 50)]
+#include "bench.h"
+#include "entitysystems.h"
+#include "rtparallel.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#define BENCH_BUFFER_WIDTH 256
+#define BENCH_BUFFER_HEIGHT 144
+
+// The 12 triangles of the box -1..1.
+static void BuildBoxMesh(std::vector<float>& positions)
+{
+    static const int faces[6][4] = { { 0, 1, 3, 2 }, { 4, 6, 7, 5 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 2, 6, 4 }, { 1, 5, 7, 3 } };
+    static const int corners[6] = { 0, 1, 2, 0, 2, 3 };
+
+    for (auto& face : faces) {
+        for (int corner : corners) {
+            int vertex = face[corner];
+            positions.push_back((vertex & 1) ? 1.0f : -1.0f);
+            positions.push_back((vertex & 2) ? 1.0f : -1.0f);
+            positions.push_back((vertex & 4) ? 1.0f : -1.0f);
+        }
+    }
+
+    return;
+}
+
+// Same camera as the entities benchmark: (0, 20, -150) looking down +Z, 60 degree field of view.
+static void BuildViewProjection(SceneMatrixType& viewProjection)
+{
+    float yScale = 1.0f / tanf(0.5f * 1.0471976f), xScale = yScale / (16.0f / 9.0f);
+    float nearZ = 0.3f, farZ = 1000.0f;
+    SceneMatrixType projection = { { xScale, 0.0f, 0.0f, 0.0f,  0.0f, yScale, 0.0f, 0.0f,  0.0f, 0.0f, farZ / (farZ - nearZ), 1.0f,
+                                     0.0f, 0.0f, -nearZ * farZ / (farZ - nearZ), 0.0f } };
+    SceneMatrixType view = { { 1.0f, 0.0f, 0.0f, 0.0f,  0.0f, 1.0f, 0.0f, 0.0f,  0.0f, 0.0f, 1.0f, 0.0f,  0.0f, -20.0f, 150.0f, 1.0f } };
+    int row, column;
+
+    for (row = 0; row < 4; row++) {
+        for (column = 0; column < 4; column++) {
+            viewProjection.m[4 * row + column] = view.m[4 * row] * projection.m[column] + view.m[4 * row + 1] * projection.m[4 + column] +
+                                                 view.m[4 * row + 2] * projection.m[8 + column] + view.m[4 * row + 3] * projection.m[12 + column];
+        }
+    }
+
+    return;
+}
+
+static int RunFrames(EntityWorldClass& world, OcclusionBufferClass& buffer, const SceneMatrixType& viewProjection, int frameCount, bool useThreads)
+{
+    double cullMs = 0.0, rasterizeMs = 0.0, testMs = 0.0;
+    float planes[6][4];
+    int inFrustum = 0, hidden = 0;
+
+    ComputeFrustumPlanes(viewProjection, planes);
+    for (int frame = 0; frame < frameCount; frame++) {
+        auto start = std::chrono::steady_clock::now();
+        inFrustum = UpdateCullingSystem(world, planes, useThreads);
+        cullMs += BenchElapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        buffer.Begin(viewProjection.m);
+        RasterizeOccluderSystem(world, buffer, useThreads);
+        rasterizeMs += BenchElapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        hidden = UpdateOcclusionSystem(world, buffer, useThreads);
+        testMs += BenchElapsedMs(start);
+    }
+
+    printf("  %s: %d in the frustum, %d hidden by %d occluder triangles\n", useThreads ? "worker threads" : "one thread", inFrustum, hidden,
+           buffer.GetTriangleCount());
+    printf("    frustum      %8.3f ms\n", cullMs / frameCount);
+    printf("    rasterize    %8.3f ms\n", rasterizeMs / frameCount);
+    printf("    occlusion    %8.3f ms\n", testMs / frameCount);
+
+    return hidden;
+}
+
+int RunOcclusionBench(int argc, char* argv[])
+{
+    EntityWorldClass world;
+    OcclusionBufferClass buffer;
+    SceneMatrixType viewProjection;
+    std::vector<float> box;
+    int objectCount = 100000;
+    int frameCount = 50;
+    int i;
+
+    if (argc > 1) { objectCount = atoi(argv[1]); }
+    if (argc > 2) { frameCount = atoi(argv[2]); }
+    if ((objectCount < 1) || (frameCount < 1)) { printf("Invalid arguments\n"); return 1; }
+
+    if (!world.Initialize(objectCount) || !buffer.Initialize(BENCH_BUFFER_WIDTH, BENCH_BUFFER_HEIGHT)) {
+        printf("Could not initialize the occlusion buffer\n");
+        return 1;
+    }
+    BuildBoxMesh(box);
+    int mesh = buffer.AddMesh(box.data(), (int)box.size() / 3);
+    BuildViewProjection(viewProjection);
+
+    // Three rows of walls 30 wide and 40 high with gaps between them, the first rows in front of most objects.
+    unsigned int wallMask = COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_WORLD) | COMPONENT_BIT(COMPONENT_OCCLUDER);
+    for (int wallRow = 0; wallRow < 3; wallRow++) {
+        for (int wall = 0; wall < 8; wall++) {
+            EntityId entity = world.CreateEntity(wallMask);
+            SceneTransformType* transform = world.Get<SceneTransformType>(entity, COMPONENT_TRANSFORM);
+            transform->translation[0] = -160.0f + 40.0f * (float)wall + 10.0f * (float)wallRow;
+            transform->translation[1] = 20.0f;
+            transform->translation[2] = -180.0f + 60.0f * (float)wallRow;
+            transform->scale[0] = 15.0f;
+            transform->scale[1] = 20.0f;
+            transform->scale[2] = 1.0f;
+            world.Get<OccluderComponent>(entity, COMPONENT_OCCLUDER)->mesh = mesh;
+        }
+    }
+
+    srand(1);
+    unsigned int mask = COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_WORLD) | COMPONENT_BIT(COMPONENT_BOUNDS) |
+                        COMPONENT_BIT(COMPONENT_RENDERABLE);
+    for (i = 0; i < objectCount; i++) {
+        EntityId entity = world.CreateEntity(mask);
+        SceneTransformType* transform = world.Get<SceneTransformType>(entity, COMPONENT_TRANSFORM);
+        transform->translation[0] = (float)(rand() % 4000) * 0.1f - 200.0f;
+        transform->translation[2] = (float)(rand() % 4000) * 0.1f - 200.0f;
+        world.Get<BoundsComponent>(entity, COMPONENT_BOUNDS)->radius = 1.0f;
+    }
+    UpdateTransformSystem(world, false);
+
+    printf("Occlusion: %d objects, %d x %d buffer, %d frames, %u threads\n", objectCount, BENCH_BUFFER_WIDTH, BENCH_BUFFER_HEIGHT, frameCount,
+           RTGetWorkerCount());
+    int hidden = RunFrames(world, buffer, viewProjection, frameCount, false);
+    int hiddenThreads = RunFrames(world, buffer, viewProjection, frameCount, true);
+    if (hidden != hiddenThreads) { printf("Hidden counts differ\n"); }
+
+    buffer.Shutdown();
+    world.Shutdown();
+
+    return (hidden == hiddenThreads) ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: pipelinebench.cpp : Pipelined simulation and render benchmark.
+////////////////////////////////////////////////////////////////////////////////
+// The frame of ApplicationClass cut the same way: the simulation (spin, transform, cull and submit the objects of
+// the entities benchmark, one thread) writes a frame state, the render (sort the render queue and fill the constant
+// buffer data of every draw) reads it.
+//   - serial: simulation then render, on one thread.
+//   - pipelined: FramePipelineClass simulates frame N + 1 while the calling thread renders frame N.
+// Prints the average time per frame of both and of the simulation and the render alone; the pipelined frame should
+// come close to the longer of the two on a machine with two cores or more. Every frame is checked to render the same
+// draws in both modes, in order and complete.
+//
+// Usage: RasterTekBench pipeline [object count (default 100000)] [frames (default 50)]
+#include "bench.h"
+#include "entitysystems.h"
+#include "framepipelineclass.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// The frame state of the benchmark.
+struct BenchFrameState
+{
+    int frame;
+    std::vector<SceneMatrixType> visibleWorlds;
+    RenderQueueClass queue;
+};
+
+struct BenchContext
+{
+    EntityWorldClass world;
+    SceneMatrixType view, viewProjection;
+    float planes[6][4];
+    std::vector<SceneMatrixType> constants;     // The constant buffer data of the draws.
+};
+
+// result = a * b, row vectors as XMMatrixMultiply.
+static void MultiplyMatrices(const SceneMatrixType& a, const SceneMatrixType& b, SceneMatrixType& result)
+{
+    for (int row = 0; row < 4; row++) {
+        for (int column = 0; column < 4; column++) {
+            result.m[4 * row + column] = a.m[4 * row] * b.m[column] + a.m[4 * row + 1] * b.m[4 + column] +
+                                         a.m[4 * row + 2] * b.m[8 + column] + a.m[4 * row + 3] * b.m[12 + column];
+        }
+    }
+
+    return;
+}
+
+static void BuildCamera(BenchContext& context)
+{
+    float yScale = 1.0f / tanf(0.5f * 1.0471976f), xScale = yScale / (16.0f / 9.0f);
+    float nearZ = 0.3f, farZ = 1000.0f;
+    SceneMatrixType projection = { { xScale, 0.0f, 0.0f, 0.0f,  0.0f, yScale, 0.0f, 0.0f,  0.0f, 0.0f, farZ / (farZ - nearZ), 1.0f,
+                                     0.0f, 0.0f, -nearZ * farZ / (farZ - nearZ), 0.0f } };
+
+    context.view = { { 1.0f, 0.0f, 0.0f, 0.0f,  0.0f, 1.0f, 0.0f, 0.0f,  0.0f, 0.0f, 1.0f, 0.0f,  0.0f, -20.0f, 150.0f, 1.0f } };
+    MultiplyMatrices(context.view, projection, context.viewProjection);
+    ComputeFrustumPlanes(context.viewProjection, context.planes);
+
+    return;
+}
+
+static void Simulate(BenchContext& context, BenchFrameState& state, int frame)
+{
+    state.frame = frame;
+    UpdateSpinSystem(context.world, 0.01f * (float)frame, false);
+    UpdateTransformSystem(context.world, false);
+    UpdateCullingSystem(context.world, context.planes, false);
+
+    state.queue.Begin();
+    state.visibleWorlds.clear();
+    SubmitRenderSystem(context.world, context.view, 1000.0f, &state.queue, 0, state.visibleWorlds);
+
+    return;
+}
+
+// Returns a checksum of the draws, in their order.
+static double Render(BenchContext& context, BenchFrameState& state)
+{
+    double checksum = 0.0;
+
+    const RenderPacketType* packets = state.queue.Sort();
+    int packetCount = state.queue.GetPacketCount();
+    context.constants.resize(packetCount);
+    for (int packet = 0; packet < packetCount; packet++) {
+        SceneMatrixType& constants = context.constants[packet];
+        MultiplyMatrices(state.visibleWorlds[packets[packet].payload], context.viewProjection, constants);
+        checksum += (double)constants.m[12] * (double)(packet + 1) + (double)constants.m[14];
+    }
+
+    return checksum + (double)state.frame;
+}
+
+int RunPipelineBench(int argc, char* argv[])
+{
+    BenchContext context;
+    BenchFrameState states[FRAME_PIPELINE_SLOTS];
+    FramePipelineClass pipeline;
+    std::vector<double> serialChecksums, pipelinedChecksums;
+    double simulateMs = 0.0, renderMs = 0.0, serialMs, pipelinedMs;
+    int objectCount = 100000;
+    int frameCount = 50;
+    int frame, i;
+
+    if (argc > 1) { objectCount = atoi(argv[1]); }
+    if (argc > 2) { frameCount = atoi(argv[2]); }
+    if ((objectCount < 1) || (frameCount < 1)) { printf("Invalid arguments\n"); return 1; }
+
+    if (!context.world.Initialize(objectCount)) { printf("Could not initialize the entity world\n"); return 1; }
+    for (auto& state : states) {
+        if (!state.queue.Initialize(objectCount)) { printf("Could not initialize the render queue\n"); return 1; }
+        state.queue.SetDepthRange(0.3f, 1000.0f);
+    }
+    BuildCamera(context);
+
+    // The objects of the entities benchmark.
+    srand(1);
+    unsigned int mask = COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_WORLD) | COMPONENT_BIT(COMPONENT_BOUNDS) |
+                        COMPONENT_BIT(COMPONENT_SPIN) | COMPONENT_BIT(COMPONENT_RENDERABLE);
+    for (i = 0; i < objectCount; i++) {
+        EntityId entity = context.world.CreateEntity(mask);
+        SceneTransformType* transform = context.world.Get<SceneTransformType>(entity, COMPONENT_TRANSFORM);
+        transform->translation[0] = (float)(rand() % 4000) * 0.1f - 200.0f;
+        transform->translation[2] = (float)(rand() % 4000) * 0.1f - 200.0f;
+        context.world.Get<BoundsComponent>(entity, COMPONENT_BOUNDS)->radius = 1.0f;
+        SpinComponent* spin = context.world.Get<SpinComponent>(entity, COMPONENT_SPIN);
+        spin->speed = 0.5f + (float)(rand() % 100) * 0.01f;
+        spin->phase = (float)(rand() % 628) * 0.01f;
+    }
+
+    printf("Pipeline: %d objects, %d frames\n", objectCount, frameCount);
+
+    // Step 1: Serial, the simulation and the render timed apart. ----------------------------------------------------
+    auto start = std::chrono::steady_clock::now();
+    for (frame = 0; frame < frameCount; frame++) {
+        auto step = std::chrono::steady_clock::now();
+        Simulate(context, states[0], frame);
+        simulateMs += BenchElapsedMs(step);
+
+        step = std::chrono::steady_clock::now();
+        serialChecksums.push_back(Render(context, states[0]));
+        renderMs += BenchElapsedMs(step);
+    }
+    serialMs = BenchElapsedMs(start);
+
+    // Step 2: Pipelined. The first frame is simulated on this thread, as ApplicationClass::Frame does. ---------------
+    int nextFrame = 0;
+    if (!pipeline.Initialize([&](int slot) { Simulate(context, states[slot], nextFrame); })) { printf("Could not start the pipeline\n"); return 1; }
+
+    start = std::chrono::steady_clock::now();
+    Simulate(context, states[0], nextFrame++);
+    int slot = 0;
+    for (frame = 0; frame < frameCount; frame++) {
+        if (frame > 0) { slot = pipeline.WaitForFrame(); nextFrame++; }
+        if (frame + 1 < frameCount) { pipeline.StartFrame(1 - slot); }
+        pipelinedChecksums.push_back(Render(context, states[slot]));
+    }
+    pipeline.WaitForFrame();
+    pipelinedMs = BenchElapsedMs(start);
+    pipeline.Shutdown();
+
+    bool match = (serialChecksums == pipelinedChecksums);
+    printf("  simulation   %8.3f ms\n", simulateMs / frameCount);
+    printf("  render       %8.3f ms\n", renderMs / frameCount);
+    printf("  serial       %8.3f ms per frame\n", serialMs / frameCount);
+    printf("  pipelined    %8.3f ms per frame (%.2fx, the longer step is %.3f ms)\n", pipelinedMs / frameCount, serialMs / pipelinedMs,
+           fmax(simulateMs, renderMs) / frameCount);
+    if (!match) { printf("The pipelined frames differ from the serial ones\n"); }
+
+    for (auto& state : states) { state.queue.Shutdown(); }
+    context.world.Shutdown();
+
+    return match ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: renderqueuebench.cpp : Render queue sort benchmark.
+////////////////////////////////////////////////////////////////////////////////
+// Submits a frame of draw packets with random state (a few shader variants, many textures and materials) spread
+// over the view depth, mostly opaque with some transparent and overlay draws, and sorts them every frame. Prints the
+// average time of the radix sort against std::sort of the same keys, and the shader / texture changes of the draws
+// in submission order and in sorted order.
+//
+// Usage: RasterTekBench renderqueue [packet count (default 100000)] [frames (default 200)]
+#include "bench.h"
+#include "renderqueueclass.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#define BENCH_NEAR 0.3f
+#define BENCH_FAR 1000.0f
+#define BENCH_VARIANTS 32
+#define BENCH_TEXTURES 512
+#define BENCH_MATERIALS 64
+
+struct BenchDraw
+{
+    RenderPass pass;
+    unsigned int variant, texture, material;
+    float depth;
+};
+
+static float RandomRange(float low, float high)
+{
+    return low + (high - low) * ((float)rand() / (float)RAND_MAX);
+}
+
+// Shader and texture changes when the draws are issued in the given order.
+static int CountStateChanges(const std::vector<BenchDraw>& draws, const std::vector<unsigned int>& order)
+{
+    int changes = 0;
+    size_t i;
+
+    for (i = 1; i < order.size(); i++) {
+        const BenchDraw& previous = draws[order[i - 1]];
+        const BenchDraw& current = draws[order[i]];
+        if (previous.variant != current.variant) { changes++; }
+        if (previous.texture != current.texture) { changes++; }
+    }
+
+    return changes;
+}
+
+int RunRenderQueueBench(int argc, char* argv[])
+{
+    RenderQueueClass queue;
+    std::vector<BenchDraw> draws;
+    std::vector<unsigned long long> keys;
+    std::vector<unsigned int> order;
+    const RenderPacketType* sorted = nullptr;
+    int packetCount = 100000;
+    int frameCount = 200;
+    int frame, i;
+    double radixMs, radixBestMs, stdMs, ms;
+
+    if (argc > 1) { packetCount = atoi(argv[1]); }
+    if (argc > 2) { frameCount = atoi(argv[2]); }
+    if ((packetCount < 1) || (frameCount < 1)) { printf("Invalid arguments\n"); return 1; }
+
+    if (!queue.Initialize(packetCount)) { printf("Could not initialize the render queue\n"); return 1; }
+    queue.SetDepthRange(BENCH_NEAR, BENCH_FAR);
+
+    // 90% opaque, 8% transparent, 2% overlay.
+    srand(1);
+    draws.resize(packetCount);
+    for (auto& draw : draws) {
+        int pass = rand() % 100;
+        draw.pass = (pass < 90) ? RENDER_PASS_OPAQUE : ((pass < 98) ? RENDER_PASS_TRANSPARENT : RENDER_PASS_OVERLAY);
+        draw.variant = rand() % BENCH_VARIANTS;
+        draw.texture = rand() % BENCH_TEXTURES;
+        draw.material = rand() % BENCH_MATERIALS;
+        draw.depth = RandomRange(1.0f, 500.0f);
+    }
+
+    // Warm up, then time the building of the keys and the sort of every frame, the draws move a little between frames.
+    radixMs = 0.0;
+    radixBestMs = 1.0e30;
+    for (frame = -1; frame < frameCount; frame++) {
+        for (i = 0; i < packetCount; i++) { draws[i].depth = std::max(draws[i].depth + ((i + frame) & 1 ? 0.1f : -0.1f), 1.0f); }
+
+        auto start = std::chrono::steady_clock::now();
+        queue.Begin();
+        for (i = 0; i < packetCount; i++) {
+            const BenchDraw& draw = draws[i];
+            queue.Submit(queue.MakeKey(draw.pass, draw.variant, draw.texture, draw.material, draw.depth), (unsigned int)i);
+        }
+        sorted = queue.Sort();
+        ms = BenchElapsedMs(start);
+
+        if (frame >= 0) {
+            radixMs += ms;
+            radixBestMs = std::min(radixBestMs, ms);
+        }
+    }
+
+    // Check the order and compare with std::sort of the same keys.
+    for (i = 1; i < packetCount; i++) {
+        if (sorted[i - 1].key > sorted[i].key) { printf("Render queue: packets out of order at %d\n", i); return 1; }
+    }
+
+    stdMs = 0.0;
+    for (frame = 0; frame < frameCount; frame++) {
+        keys.clear();
+        auto start = std::chrono::steady_clock::now();
+        for (i = 0; i < packetCount; i++) {
+            const BenchDraw& draw = draws[i];
+            keys.push_back(queue.MakeKey(draw.pass, draw.variant, draw.texture, draw.material, draw.depth));
+        }
+        std::sort(keys.begin(), keys.end());
+        stdMs += BenchElapsedMs(start);
+    }
+
+    printf("Render queue: %d packets\n", packetCount);
+    printf("  keys + radix sort: %.3f ms average, %.3f ms best (%d frames)\n", radixMs / (double)frameCount, radixBestMs, frameCount);
+    printf("  keys + std::sort:  %.3f ms average\n", stdMs / (double)frameCount);
+
+    order.resize(packetCount);
+    for (i = 0; i < packetCount; i++) { order[i] = (unsigned int)i; }
+    printf("  shader + texture changes: %d in submission order, ", CountStateChanges(draws, order));
+    for (i = 0; i < packetCount; i++) { order[i] = sorted[i].payload; }
+    printf("%d sorted\n", CountStateChanges(draws, order));
+
+    queue.Shutdown();
+
+    return 0;
+}
@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: scenegraphbench.cpp : Scene graph world matrix update benchmark.
+////////////////////////////////////////////////////////////////////////////////
+// Builds a random tree (every node under a random earlier node, so the nodes are added out of depth order and the
+// first update sorts them) and updates its world matrices every frame: once with every node spinning, once with 1%
+// of the nodes spinning (the update reaches their subtrees only), each on one thread and on the worker threads.
+// Prints the average time per frame and the number of world matrices recomputed.
+//
+// Usage: RasterTekBench scenegraph [node count (default 1000000)] [frames (default 50)]
+#include "bench.h"
+#include "rtparallel.h"
+#include "scenegraphclass.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static void SpinNodes(SceneGraphClass& sceneGraph, const std::vector<int>& nodes, int frame)
+{
+    for (int node : nodes) {
+        float angle = 0.01f * (float)(frame + node);
+        sceneGraph.SetRotation(node, 0.0f, sinf(angle * 0.5f), 0.0f, cosf(angle * 0.5f));
+    }
+}
+
+static void RunCase(SceneGraphClass& sceneGraph, const std::vector<int>& nodes, int frameCount, bool useThreads, const char* name)
+{
+    double totalMs = 0.0, bestMs = 1.0e30, ms;
+    int updated = 0;
+
+    for (int frame = 0; frame < frameCount; frame++) {
+        SpinNodes(sceneGraph, nodes, frame);
+
+        auto start = std::chrono::steady_clock::now();
+        updated = sceneGraph.Update(useThreads);
+        ms = BenchElapsedMs(start);
+
+        totalMs += ms;
+        bestMs = std::min(bestMs, ms);
+    }
+
+    printf("  %-28s %8.3f ms average, %8.3f ms best, %d matrices\n", name, totalMs / (double)frameCount, bestMs, updated);
+}
+
+int RunSceneGraphBench(int argc, char* argv[])
+{
+    SceneGraphClass sceneGraph;
+    std::vector<int> allNodes, someNodes;
+    int nodeCount = 1000000;
+    int frameCount = 50;
+    int i;
+
+    if (argc > 1) { nodeCount = atoi(argv[1]); }
+    if (argc > 2) { frameCount = atoi(argv[2]); }
+    if ((nodeCount < 1) || (frameCount < 1)) { printf("Invalid arguments\n"); return 1; }
+
+    if (!sceneGraph.Initialize(nodeCount)) { printf("Could not initialize the scene graph\n"); return 1; }
+
+    srand(1);
+    for (i = 0; i < nodeCount; i++) {
+        int node = sceneGraph.AddNode((i == 0) ? -1 : rand() % i);
+        sceneGraph.SetTranslation(node, (float)(rand() % 11 - 5), 0.0f, (float)(rand() % 11 - 5));
+        sceneGraph.SetScale(node, 0.99f, 0.99f, 0.99f);
+        allNodes.push_back(node);
+        if ((rand() % 100) == 0) { someNodes.push_back(node); }
+    }
+
+    // The first update sorts the nodes by depth and computes everything.
+    auto start = std::chrono::steady_clock::now();
+    sceneGraph.Update(true);
+    printf("Scene graph: %d nodes, %u threads, first update (depth sort) %.3f ms\n", nodeCount, RTGetWorkerCount(), BenchElapsedMs(start));
+
+    RunCase(sceneGraph, allNodes, frameCount, false, "all nodes, one thread:");
+    RunCase(sceneGraph, allNodes, frameCount, true, "all nodes, worker threads:");
+    RunCase(sceneGraph, someNodes, frameCount, false, "1% of nodes, one thread:");
+    RunCase(sceneGraph, someNodes, frameCount, true, "1% of nodes, worker threads:");
+
+    sceneGraph.Shutdown();
+
+    return 0;
+}
@@ -0,0 +1,167 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: shadercachebench.cpp : Shader bytecode cache check and benchmark.
+////////////////////////////////////////////////////////////////////////////////
+// ShaderCacheClass against a stub compiler, in a scratch directory of the temporary directory. The stub "compiles"
+// a shader into bytes made of its inputs, taking a fixed time per compile like a real one would.
+//   - a first lookup is a miss and compiles, the second one is a hit and returns the same bytecode and metadata;
+//   - the key changes with the defines, the contents of an included file and the compile flags, not otherwise;
+//   - a corrupted or truncated entry is a miss, compiled again and rewritten, so the next lookup is a hit.
+// Then 'shader count' variants looked up cold and warm, the time of a launch without and with the cache.
+//
+// Usage: RasterTekBench shadercache [shader count (default 200)] [compile ms (default 1)]
+#include "bench.h"
+#include "shadercacheclass.h"
+
+#include <filesystem>
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct BenchCompiler
+{
+    int compileCount;
+    double compileMs;
+};
+
+static void WriteTextFile(const std::filesystem::path& path, const char* text)
+{
+    std::ofstream fout(path, std::ios::binary | std::ios::trunc);
+    fout << text;
+
+    return;
+}
+
+// The stub compiler: bytecode made of the variant name, metadata of its length.
+static ShaderCacheClass::CompileFunction MakeCompile(BenchCompiler& compiler, const std::string& variant)
+{
+    return [&compiler, variant](std::vector<unsigned char>& bytecode, std::vector<unsigned char>& metadata) {
+        compiler.compileCount++;
+        if (compiler.compileMs > 0.0) { std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(compiler.compileMs)); }
+        bytecode.assign(variant.begin(), variant.end());
+        bytecode.push_back(0);
+        metadata.assign(1, (unsigned char)variant.size());
+        return true;
+    };
+}
+
+// A lookup of which the compiles and the result are checked.
+static bool Lookup(ShaderCacheClass& cache, BenchCompiler& compiler, const std::string& source, const std::vector<ShaderDefine>& defines,
+                   unsigned int flags, const std::string& variant, int expectedCompiles)
+{
+    std::vector<unsigned char> bytecode, metadata;
+    int compileCount = compiler.compileCount;
+
+    if (!cache.GetBytecode(source.c_str(), defines, "main", "ps_5_0", flags, MakeCompile(compiler, variant), bytecode, metadata)) { return false; }
+    if ((compiler.compileCount - compileCount) != expectedCompiles) { return false; }
+
+    std::string result(bytecode.begin(), bytecode.end());
+    return (result == variant + '\0') && (metadata.size() == 1) && (metadata[0] == (unsigned char)variant.size());
+}
+
+static bool Check(const char* name, bool passed)
+{
+    printf("  %-52s %s\n", name, passed ? "ok" : "FAILED");
+    return passed;
+}
+
+int RunShaderCacheBench(int argc, char* argv[])
+{
+    ShaderCacheClass cache;
+    BenchCompiler compiler = { 0, 0.0 };
+    std::vector<ShaderDefine> defines = { { "USE_SPECULAR", "1" } };
+    unsigned long long key, otherKey;
+    int shaderCount = 200;
+    double compileMs = 1.0;
+    bool match = true;
+    std::error_code error;
+
+    if (argc > 1) { shaderCount = atoi(argv[1]); }
+    if (argc > 2) { compileMs = atof(argv[2]); }
+    if ((shaderCount < 1) || (compileMs < 0.0)) { printf("Invalid arguments\n"); return 1; }
+
+    // Step 1: A shader including a file, in a scratch directory. ---------------------------------------------------
+    std::filesystem::path directory = std::filesystem::temp_directory_path(error) / "rtshadercachebench";
+    std::filesystem::path cacheDirectory = directory / "cache";
+    std::filesystem::remove_all(directory, error);
+    std::filesystem::create_directories(directory, error);
+    WriteTextFile(directory / "common.hlsl", "float4 Tint() { return float4(1, 1, 1, 1); }\n");
+    WriteTextFile(directory / "light.ps", "#include \"common.hlsl\"\nfloat4 main() : SV_TARGET { return Tint(); }\n");
+    std::string source = (directory / "light.ps").string();
+
+    if (!cache.Initialize(cacheDirectory.string().c_str(), 1)) { printf("Could not create the cache directory\n"); return 1; }
+    printf("Shader cache: %s\n", cacheDirectory.string().c_str());
+
+    // Step 2: Hit and miss. -------------------------------------------------------------------------------------
+    match &= Check("first lookup misses and compiles", Lookup(cache, compiler, source, defines, 0, "light", 1));
+    match &= Check("second lookup hits, same bytecode and metadata", Lookup(cache, compiler, source, defines, 0, "light", 0));
+    match &= Check("hit and miss counters", (cache.GetHitCount() == 1) && (cache.GetMissCount() == 1));
+
+    // Step 3: What the key depends on. --------------------------------------------------------------------------
+    cache.ComputeKey(source.c_str(), defines, "main", "ps_5_0", 0, key);
+    cache.ComputeKey(source.c_str(), defines, "main", "ps_5_0", 0, otherKey);
+    match &= Check("same inputs, same key", key == otherKey);
+
+    std::vector<ShaderDefine> otherDefines = { { "USE_SPECULAR", "0" } };
+    cache.ComputeKey(source.c_str(), otherDefines, "main", "ps_5_0", 0, otherKey);
+    match &= Check("define value changes the key", key != otherKey);
+    otherDefines.push_back({ "USE_FOG", "1" });
+    cache.ComputeKey(source.c_str(), otherDefines, "main", "ps_5_0", 0, otherKey);
+    match &= Check("extra define changes the key", key != otherKey);
+
+    cache.ComputeKey(source.c_str(), defines, "main", "ps_5_0", 1, otherKey);
+    match &= Check("compile flags change the key", key != otherKey);
+
+    WriteTextFile(directory / "common.hlsl", "float4 Tint() { return float4(1, 0, 0, 1); }\n");
+    cache.ComputeKey(source.c_str(), defines, "main", "ps_5_0", 0, otherKey);
+    match &= Check("included file contents change the key", key != otherKey);
+    match &= Check("changed include misses", Lookup(cache, compiler, source, defines, 0, "light", 1));
+    WriteTextFile(directory / "common.hlsl", "float4 Tint() { return float4(1, 1, 1, 1); }\n");
+    match &= Check("include restored, the old entry hits again", Lookup(cache, compiler, source, defines, 0, "light", 0));
+
+    // Step 4: Damaged entries. ----------------------------------------------------------------------------------
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.cso", key);
+    std::filesystem::path entry = cacheDirectory / name;
+    uintmax_t entrySize = std::filesystem::file_size(entry, error);
+
+    {
+        std::fstream file(entry, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp((std::streamoff)entrySize - 1);
+        file.put('\x7f');
+    }
+    match &= Check("corrupted entry misses and compiles", Lookup(cache, compiler, source, defines, 0, "light", 1));
+    match &= Check("corrupted entry rewritten, next lookup hits", Lookup(cache, compiler, source, defines, 0, "light", 0));
+
+    std::filesystem::resize_file(entry, entrySize - 3, error);
+    match &= Check("truncated entry misses and compiles", Lookup(cache, compiler, source, defines, 0, "light", 1));
+    match &= Check("truncated entry rewritten, next lookup hits", Lookup(cache, compiler, source, defines, 0, "light", 0) &&
+                                                                   (std::filesystem::file_size(entry, error) == entrySize));
+
+    std::filesystem::resize_file(entry, 8, error);
+    match &= Check("entry cut inside its header misses and compiles", Lookup(cache, compiler, source, defines, 0, "light", 1));
+
+    // Step 5: A launch of 'shader count' variants, cold then warm. -------------------------------------------------
+    compiler.compileMs = compileMs;
+    double launchMs[2];
+    for (int launch = 0; launch < 2; launch++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int variant = 0; variant < shaderCount; variant++) {
+            std::vector<ShaderDefine> variantDefines = { { "VARIANT", std::to_string(variant) } };
+            if (!Lookup(cache, compiler, source, variantDefines, 0, "variant" + std::to_string(variant), (launch == 0) ? 1 : 0)) {
+                match = false;
+            }
+        }
+        launchMs[launch] = BenchElapsedMs(start);
+    }
+    printf("  %d variants at %.1f ms per compile: cold %.3f ms, warm %.3f ms (%.1fx)\n", shaderCount, compileMs, launchMs[0], launchMs[1],
+           launchMs[0] / launchMs[1]);
+
+    cache.Shutdown();
+    std::filesystem::remove_all(directory, error);
+    if (!match) { printf("The shader cache returned stale or damaged bytecode\n"); }
+
+    return match ? 0 : 1;
+}
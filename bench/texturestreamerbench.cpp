@@ -0,0 +1,176 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: texturestreamerbench.cpp : Texture mip streaming benchmark.
+////////////////////////////////////////////////////////////////////////////////
+// Textures of 1024 x 1024 (5.3 MB with their mips) streamed against a budget that holds 11 of them, with stand-in
+// textures that only count bytes. The requested set changes in three phases:
+//   1. textures 0 to 9 are seen up close, they all fit;
+//   2. the camera moves on to textures 10 to 19 before the first ones time out: the budget is full of mips nobody
+//      wants any more, the new ones must still reach their finest mip;
+//   3. textures 20 to 31 are all seen at once, more than the budget holds: they must not evict each other.
+// Prints, per phase, the frames the textures took to get their mips and the bytes streamed in and evicted, then the
+// average time of Update. The resident total must never go over the budget, no phase may stream in more than the
+// budget holds (mips streamed in only to be evicted again), and an Update may change a texture once at most (a
+// TextureClass reads its levels from disk on every change).
+//
+// Usage: RasterTekBench texturestreamer [frames per phase (default 40)]
+#include "bench.h"
+#include "texturestreamerclass.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#define BENCH_TEXTURE_SIZE 1024
+#define BENCH_TEXTURE_COUNT 32
+#define BENCH_BUDGET_TEXTURES 11
+
+// A texture of which only the byte count of its mips exists.
+class BenchTextureClass : public StreamedTextureClass
+{
+public:
+    BenchTextureClass(int size, int minimumMip)
+    {
+        m_size = size;
+        m_mipCount = 1;
+        while ((size >> m_mipCount) > 0) { m_mipCount++; }
+        m_residentMip = minimumMip;
+        m_uploadedBytes = 0;
+        m_evictedBytes = 0;
+        m_evictions = 0;
+        m_changes = 0;
+    }
+
+    int GetWidth() { return m_size; }
+    int GetHeight() { return m_size; }
+    int GetResidentMip() { return m_residentMip; }
+
+    unsigned long long GetMipBytes(int mip)
+    {
+        unsigned long long size = (unsigned long long)std::max(1, m_size >> mip);
+        return ((mip >= 0) && (mip < m_mipCount)) ? size * size * 4 : 0;
+    }
+
+    unsigned long long GetResidentBytes()
+    {
+        unsigned long long bytes = 0;
+        for (int mip = m_residentMip; mip < m_mipCount; mip++) { bytes += GetMipBytes(mip); }
+        return bytes;
+    }
+
+    bool SetResidentMip(int mip)
+    {
+        if ((mip < 0) || (mip >= m_mipCount)) { return false; }
+        for (int level = mip; level < m_residentMip; level++) { m_uploadedBytes += GetMipBytes(level); }
+        for (int level = m_residentMip; level < mip; level++) { m_evictedBytes += GetMipBytes(level); m_evictions++; }
+        m_residentMip = mip;
+        m_changes++;
+        return true;
+    }
+
+public:
+    int m_size, m_mipCount, m_residentMip;
+    unsigned long long m_uploadedBytes, m_evictedBytes;
+    int m_evictions;
+    int m_changes;
+};
+
+struct BenchPhase
+{
+    const char* name;
+    int first, last;                // The textures requested at mip 0.
+    int expectedAtMip0;             // How many of them must reach it.
+};
+
+int RunTextureStreamerBench(int argc, char* argv[])
+{
+    TextureStreamerClass streamer;
+    TextureStreamerConfig config;
+    std::vector<BenchTextureClass*> textures;
+    double updateMs = 0.0;
+    int framesPerPhase = 40;
+    int updates = 0, maxChanges = 0, i, frame;
+    bool match = true;
+
+    if (argc > 1) { framesPerPhase = atoi(argv[1]); }
+
+    config.initialResidentSize = 64;
+    config.uploadBytesPerFrame = 16ull * 1024 * 1024;
+    config.requestTimeoutFrames = 60;
+    if ((framesPerPhase < 10) || (framesPerPhase >= (int)config.requestTimeoutFrames)) { printf("Invalid arguments\n"); return 1; }
+
+    int minimumMip = 0;
+    while ((BENCH_TEXTURE_SIZE >> minimumMip) > config.initialResidentSize) { minimumMip++; }
+    BenchTextureClass probe(BENCH_TEXTURE_SIZE, 0);
+    config.budgetBytes = BENCH_BUDGET_TEXTURES * probe.GetResidentBytes();
+
+    streamer.Initialize(config);
+    for (i = 0; i < BENCH_TEXTURE_COUNT; i++) {
+        textures.push_back(new BenchTextureClass(BENCH_TEXTURE_SIZE, minimumMip));
+        streamer.Register(textures.back(), minimumMip);
+    }
+
+    printf("Texture streamer: %d textures of %d x %d, budget %.1f MB (%d full chains), %d frames per phase\n", BENCH_TEXTURE_COUNT,
+           BENCH_TEXTURE_SIZE, BENCH_TEXTURE_SIZE, config.budgetBytes / (1024.0 * 1024.0), BENCH_BUDGET_TEXTURES, framesPerPhase);
+
+    BenchPhase phases[] = {
+        { "first set", 0, 9, 10 },
+        { "new set", 10, 19, 10 },
+        { "over budget", 20, 31, BENCH_BUDGET_TEXTURES - 1 },
+    };
+
+    for (auto& phase : phases) {
+        unsigned long long uploaded = 0, evicted = 0;
+        int evictions = 0, doneFrame = -1;
+
+        for (auto texture : textures) {
+            uploaded -= texture->m_uploadedBytes;
+            evicted -= texture->m_evictedBytes;
+        }
+
+        for (frame = 0; frame < framesPerPhase; frame++) {
+            for (i = phase.first; i <= phase.last; i++) { streamer.RequestMip(textures[i], 0); }
+
+            std::vector<int> before;
+            for (i = phase.first; i <= phase.last; i++) { before.push_back(textures[i]->m_evictions); }
+            for (auto texture : textures) { texture->m_changes = 0; }
+
+            auto start = std::chrono::steady_clock::now();
+            if (!streamer.Update()) { printf("Update failed\n"); return 1; }
+            updateMs += BenchElapsedMs(start);
+            updates++;
+
+            for (i = phase.first; i <= phase.last; i++) { evictions += textures[i]->m_evictions - before[i - phase.first]; }
+            if (streamer.GetResidentBytes() > config.budgetBytes) { match = false; }
+            for (auto texture : textures) { maxChanges = std::max(maxChanges, texture->m_changes); }
+
+            int atMip0 = 0;
+            for (i = phase.first; i <= phase.last; i++) { atMip0 += (textures[i]->GetResidentMip() == 0) ? 1 : 0; }
+            if ((doneFrame < 0) && (atMip0 >= phase.expectedAtMip0)) { doneFrame = frame + 1; }
+        }
+
+        int atMip0 = 0;
+        for (i = phase.first; i <= phase.last; i++) { atMip0 += (textures[i]->GetResidentMip() == 0) ? 1 : 0; }
+        for (auto texture : textures) {
+            uploaded += texture->m_uploadedBytes;
+            evicted += texture->m_evictedBytes;
+        }
+
+        if (atMip0 < phase.expectedAtMip0) { match = false; }
+        if (evictions > 0) { match = false; }
+        if (uploaded > config.budgetBytes) { match = false; }
+        printf("  %-12s textures %2d-%2d: %2d at mip 0 (%d expected) after %2d frames, %6.1f MB in, %6.1f MB evicted, %d levels evicted "
+               "from the requested textures\n", phase.name, phase.first, phase.last, atMip0, phase.expectedAtMip0, doneFrame,
+               uploaded / (1024.0 * 1024.0), evicted / (1024.0 * 1024.0), evictions);
+    }
+
+    if (maxChanges > 1) { match = false; }
+    printf("  update %.4f ms, resident %.1f MB, %d changes of a texture per update at most\n", updateMs / updates,
+           streamer.GetResidentBytes() / (1024.0 * 1024.0), maxChanges);
+    if (!match) { printf("The streamer went over its budget or did not stream the wanted mips in, or changed a texture twice in a frame\n"); }
+
+    streamer.Shutdown();
+    for (auto texture : textures) { delete texture; }
+
+    return match ? 0 : 1;
+}
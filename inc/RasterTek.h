@@ -22,6 +22,12 @@ struct RTUserArgs {
     uchar test = 5;
     uchar end = 5;
     uchar mod = 1;
+    int texBudget = 256;    // Texture streaming memory budget in MB
+    uchar hud = 0;          // Draw the statistics text on top of the scene
+    uchar hotReload = 0;    // Recompile the shaders when their source files change
+    int fps = 0;            // Frame rate limit of the active window, 0 for none (vsync only)
+    uchar pipelined = 0;    // Simulate the next frame on a thread of its own while the current one is drawn
+    char scene[MAX_PATH] = "";  // Scene file to load instead of the one of the test number
 };
 
 extern RTUserArgs RTArgs;
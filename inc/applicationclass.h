@@ -5,20 +5,97 @@
 #include "cameraclass.h"
 #include "modelclass.h"
 #include "shaderclass.h"
-#include "lightclass.h"
+#include "shadercacheclass.h"
+#include "shaderwatcherclass.h"
 #include "bitmapclass.h"
-#include "timerclass.h"
+#include "texturestreamerclass.h"
+#include "spritebatchclass.h"
+#include "spriteanimationclass.h"
+#include "instancebufferclass.h"
+#include "dynamicringbufferclass.h"
+#include "fontclass.h"
+#include "textclass.h"
+#include "clusteredlightingclass.h"
+#include "renderqueueclass.h"
+#include "commandrecorderclass.h"
+#include "scenefileclass.h"
+#include "entitysystems.h"
+#include "framepipelineclass.h"
+
+#include <vector>
 
 // GLOBALS
 const bool FULL_SCREEN = false;
 const bool VSYNC_ENABLED = true;
 const float SCREEN_DEPTH = 1000.0f;
 const float SCREEN_NEAR = 0.3f;
+const float SIMULATION_STEP_TIME = 1.0f / 60.0f;   // Seconds of one fixed simulation step (ApplicationClass::Update).
+const float ROTATION_SPEED = 0.0174532925f * 6.0f; // Radians per second the scene turns by, 0.1 degree per step.
+const float BACKGROUND_FRAME_RATE = 10.0f;   // Frame rate limit while the window is not the active one.
+const int MAX_MODEL_INSTANCES = 16;         // Copies of the model one instanced draw can render.
+const unsigned int VERTEX_RING_SIZE = 8 * 1024 * 1024;   // Bytes of the dynamic ring buffer shared by the 2D geometry.
+const int SPRITE_STRESS_COUNT = 50000;       // Number of sprites drawn by the sprite batch stress test (test 14).
+const int CLUSTERED_LIGHT_COUNT = 512;       // Point lights of the clustered lighting test (test 15).
+const int MAX_RECORD_CONTEXTS = 8;           // Deferred contexts (and recording threads) of a deferred scene (test 16) at most.
+const char SHADER_CACHE_DIRECTORY[] = "shadercache";   // Compiled shaders kept between launches, relative to the run directory.
+const char TEXTURE_MIP_DIRECTORY[] = "mipcache";    // Finer mips of the streamed textures, written again on every launch.
+const char SHADER_SOURCE_DIRECTORY[] = "../shaders";   // Watched for edits with --hotreload, as the shader files are opened.
+const char SCENE_FILE_FORMAT[] = "../data/scenes/test%02d.json";   // Scene file of a test number, --scene loads another one.
+const int HUD_MAX_CHARACTERS = 1024;         // Visible characters of all the HUD strings together.
+const float HUD_UPDATE_TIME = 0.5f;          // Seconds the frame statistics are averaged over before the HUD text changes.
+const int OCCLUSION_BUFFER_WIDTH = 256;      // Pixels of the software occlusion buffer, multiples of OCCLUSION_TILE_SIZE.
+const int OCCLUSION_BUFFER_HEIGHT = 144;
+
+// The draws of a frame, the payload of their packets in the render queue. An object of the scene drawn on its own has
+// the payload SCENE_DRAW_OBJECT + its index in the visible objects of the frame.
+enum SceneDraw { SCENE_DRAW_INSTANCES, SCENE_DRAW_GRID, SCENE_DRAW_SPRITES, SCENE_DRAW_BITMAP, SCENE_DRAW_HUD, SCENE_DRAW_OBJECT };
 
 typedef struct ApplicationConfig {
     bool useTimer = false;
 } ApplicationConfig;
 
+// A sprite of the sprite batch stress test, bouncing around the screen. Its texture is the current frame of its animation.
+struct SpriteParticle {
+    float x, y;
+    float velocityX, velocityY;
+    int animation;
+};
+
+// A point light of the clustered lighting test, circling the center of the scene. The light itself is recomputed from
+// this every frame.
+struct OrbitingLight {
+    float orbitRadius, height;
+    float phase, speed;
+};
+
+// A sprite of the sprite batch stress test as it is drawn this frame.
+struct SpriteDrawType {
+    float x, y;
+    int image;
+    XMFLOAT4 uvRect;
+};
+
+// Everything a frame is drawn from. The simulation writes it and the render only reads it, the render never touches the
+// entities, the camera or the animations. With --pipelined there are FRAME_PIPELINE_SLOTS of them: the simulation
+// thread writes one while the render thread draws the other (see FramePipelineClass).
+struct FrameStateType {
+    // The simulation steps due, the real time of the frame and how far the frame is between the last two steps.
+    int steps;
+    float stepTime, frameTime, interpolation;
+
+    XMFLOAT4X4 viewMatrix, viewMatrixDefault;
+    XMFLOAT3 cameraPosition;
+    std::vector<SceneMatrixType> visibleWorlds;     // World matrices of the objects in view.
+    float modelDepth;                               // View depth of the nearest of them.
+    RenderQueueClass* renderQueue;                  // Has the objects drawn one by one, the render queues the other draws.
+    XMFLOAT4 diffuseColor[MAX_DIFFUSE_LIGHTS];      // The light entities.
+    XMFLOAT3 lightPosDir[MAX_DIFFUSE_LIGHTS];
+    std::vector<ClusterLightType> clusterLights;
+    std::vector<SpriteDrawType> sprites;
+    unsigned int bitmapFrame;
+    int occluderTriangles, treeNodes;               // For the HUD.
+};
+
 class ApplicationClass {
 public:
     ApplicationClass();
@@ -29,19 +106,68 @@ public:
     bool Initialize(int screenWidth, int screenHeight, HWND hwnd, ApplicationConfig &config);
     void Shutdown();
 
-    bool Frame();
+    void Update(float stepTime);
+    bool Frame(float frameTime, float interpolation);
 
 private:
-    bool Render(float rotation);
+    void StepSimulation(float stepTime);
+    void Simulate(FrameStateType& state);
+    void StartFrameState(FrameStateType& state, float frameTime, float interpolation);
+    bool Render(FrameStateType& state);
+    bool RenderDeferredGrid(const FrameStateType& state, XMMATRIX viewMatrix, XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture,
+                            bool useAmbientLight, XMFLOAT4 ambientColor,
+                            bool useDiffuseLight, XMFLOAT4 diffuseColor[], XMFLOAT3 lightPosDir[],
+                            bool useSpecularLight, XMFLOAT4 specularColor, float specularPower);
+    void RequestModelTextureDetail(XMMATRIX worldMatrix, XMMATRIX projectionMatrix, XMFLOAT3 cameraPosition);
+    bool InitializeSpriteStress(int screenWidth, int screenHeight);
+    void UpdateSpriteStress(float frameTime);
+    bool InitializeClusteredLights(int screenWidth, int screenHeight);
+    void UpdateClusteredLights(float rotation, std::vector<ClusterLightType>& lights);
+    bool InitializeEntities();
+    void UpdateEntities(float rotation, XMMATRIX viewMatrix, XMMATRIX projectionMatrix, FrameStateType& state);
+    bool InitializeDeferredScene(HWND hwnd, bool useTexture, bool useAmbient, bool useDiffuse, bool useSpecular);
+    bool InitializeHud(HWND hwnd, int screenWidth, int screenHeight);
+    void UpdateHud(float frameTime, const FrameStateType& state);
+    void UpdateShaderReload();
 
     ApplicationConfig m_Config;
     D3DClass* m_Direct3D;
     CameraClass* m_Camera;
     ModelClass* m_Model;
     ShaderClass* m_Shader;
+    ShaderCacheClass* m_ShaderCache;
+    ShaderWatcherClass* m_ShaderWatcher;
     BitmapClass* m_Bitmap;
-    LightClass* m_Lights;
-    TimerClass* m_Timer;
+    TextureStreamerClass* m_TextureStreamer;
+    SpriteBatchClass* m_SpriteBatch;
+    SpriteAnimationClass* m_SpriteAnimation;
+    InstanceBufferClass* m_InstanceBuffer;
+    DynamicRingBufferClass* m_VertexRing;
+    ShaderClass* m_TextShader;
+    FontClass* m_Font;
+    TextClass* m_Text;
+    ClusteredLightingClass* m_ClusteredLighting;
+    CommandRecorderClass* m_CommandRecorder;
+    std::vector<ShaderClass*> m_PartitionShaders;      // One per deferred context, the cbuffers of a shader object belong to one context.
+    SceneFileClass* m_SceneFile;
+    EntityWorldClass* m_Entities;                      // The objects and the diffuse lights of the scene.
+    OcclusionBufferClass* m_Occlusion;                 // Only for the scenes with occluders.
+    BoundsTreeClass* m_BoundsTree;                     // The world boxes of the objects, for the culling.
+    std::vector<unsigned int> m_TreeResults;           // Entities returned by the culling query of the frame.
+    std::vector<OrbitingLight> m_OrbitingLights;
+    std::vector<ClusterLightType> m_ClusterLights;     // Colors and radii, the frame states get the positions of the frame.
+    FrameStateType m_FrameStates[FRAME_PIPELINE_SLOTS];
+    FramePipelineClass* m_Pipeline;                    // Simulates the next frame while a frame is drawn, --pipelined only.
+    int m_hudFpsString, m_hudStatsString, m_hudShaderString;
+    int m_hudFrameCount, m_hudMapCount, m_hudBindCount, m_hudSkippedBindCount;
+    float m_hudTime;
+    float m_rotation, m_previousRotation;             // Of the last two simulation steps, the frame draws in between.
+    int m_pendingSteps;                                // Simulation steps due since the last frame was started.
+    float m_stepTime;
+    TextureClass* m_SpriteTextures;
+    int m_spriteTextureCount;
+    std::vector<SpriteParticle> m_SpriteParticles;
+    int m_screenWidth, m_screenHeight;
     int m_numDiffuseLights;
     bool m_isDiffuseLightPosGiven;   // Position of diffuse lights is specified, if true; otherise direction will be given. 
                                      // (May need to use position to calculate direction, may be wrt each vertex vor wrt world
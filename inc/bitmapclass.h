@@ -9,6 +9,8 @@
 using namespace DirectX;
 
 #include "textureclass.h"
+#include "dynamicringbufferclass.h"
+#include "renderstatecacheclass.h"
 
 // BitmapClass will be used to represent an individual 2D image that needs to be rendered to the screen.
 // For every 2D image you have you will need a new BitmapClass for each.
@@ -30,13 +32,16 @@ public:
     BitmapClass(const BitmapClass&);
     ~BitmapClass();
 
-    bool Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext, int screenWidth, int screenHeight, bool sprite_mode, char* textureFilename, int renderX, int renderY);
+    bool Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext, int screenWidth, int screenHeight, bool sprite_mode, char* textureFilename, int renderX, int renderY,
+                    DynamicRingBufferClass* vertexRing);
     void Shutdown();
+    void SetStateCache(RenderStateCacheClass* stateCache);
     bool Render(ID3D11DeviceContext* deviceContext);
     void Update(float speed);
 
     int GetIndexCount();
     ID3D11ShaderResourceView* GetTexture();
+    unsigned int GetFrameIndex();
 
     void SetRenderLocation(int x, int y);
 
@@ -50,13 +55,16 @@ private:
     void ReleaseTextures();
 
 private:
-    ID3D11Buffer *m_vertexBuffer, *m_indexBuffer;
+    DynamicRingBufferClass* m_VertexRing;
+    RenderStateCacheClass* m_StateCache;
+    ID3D11Buffer* m_indexBuffer;
+    unsigned int m_vertexOffset, m_vertexRingWrap;      // Where the vertices are in the ring, valid until it wraps.
     // The BitmapClass will need to maintain some extra information that a 3D model wouldn't such as the screen size,
     // the bitmap size, and the last place it was rendered. We have added extra private variables here to track that extra information.
     int m_vertexCount, m_indexCount, m_screenWidth, m_screenHeight, m_bitmapWidth, m_bitmapHeight, m_renderX, m_renderY, m_prevPosX, m_prevPosY;
     TextureClass* m_Textures;
 
-    int m_currentTexture, m_textureCount;
+    int m_currentTexture, m_textureCount, m_frameCount;
     bool m_animate;
     float m_frameTime, m_cycleTime;
 };
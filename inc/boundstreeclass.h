@@ -0,0 +1,96 @@
+// Filename: boundstreeclass.h
+#ifndef _BOUNDSTREECLASS_H_
+#define _BOUNDSTREECLASS_H_
+
+// INCLUDES
+#include "occlusionbufferclass.h"
+
+#include <vector>
+
+#define BOUNDS_TREE_LEAF_SIZE 4         // Objects of a leaf at most.
+#define BOUNDS_TREE_BINS 12             // Candidate split planes per axis of the SAH build are the bin borders.
+#define BOUNDS_TREE_REBUILD_RATIO 1.5f  // Refitting lets the tree get this much worse than its build before it is rebuilt.
+
+// Class name: BoundsTreeClass
+// Bounding volume hierarchy over the world boxes of the scene objects, so culling and picking visit the branches
+// that matter instead of every object.
+//
+// The tree is built top-down with the surface area heuristic (SAH), the split candidates of every axis being the
+// borders of BOUNDS_TREE_BINS bins of the object centers. Moving objects only change their box (SetBox) and Update
+// refits the tree bottom-up; refitting keeps the topology, so when the SAH cost of the refitted tree grows past
+// BOUNDS_TREE_REBUILD_RATIO times its cost at build time, or objects were added or removed, Update builds it again.
+//
+// Queries: the frustum query keeps, per branch, the planes its box is not yet fully inside of (a branch inside all of
+// them is taken whole), and tests the branches against an occlusion buffer when given one. The ray query walks the
+// nearer child first and skips what is past the nearest hit.
+//
+// The nodes are stored with both children of a node next to each other after their parent, the refit is one reverse
+// pass over the array. SetBox may be called from several threads for different objects, everything else is single
+// threaded.
+class BoundsTreeClass
+{
+private:
+    // A leaf has 'count' objects, from 'first' in the object order; an inner node has count 0 and its children at
+    // 'first' and 'first' + 1.
+    struct NodeType
+    {
+        float boxMin[3];
+        int first;
+        float boxMax[3];
+        int count;
+    };
+
+    // An object while the tree is built: its box and center copied next to each other, so the binning and the
+    // partitioning read memory in order instead of jumping through the proxies.
+    struct BuildItemType
+    {
+        float boxMin[3], boxMax[3], center[3];
+        int proxy;
+    };
+
+public:
+    BoundsTreeClass();
+    BoundsTreeClass(const BoundsTreeClass&);
+    ~BoundsTreeClass();
+
+    bool Initialize(int initialCapacity);
+    void Shutdown();
+
+    // A new object, in the tree from the next Update. Returns its proxy, the handle of the other calls.
+    int AddObject(const float boxMin[3], const float boxMax[3], unsigned int userData);
+    void RemoveObject(int proxy);
+    void SetBox(int proxy, const float boxMin[3], const float boxMax[3]);
+
+    // Refit or rebuild the tree for the boxes set since the last Update. Returns true when it was rebuilt.
+    bool Update();
+    void Rebuild();
+
+    // Append the user data of the objects whose box touches the frustum (planes a, b, c, d with ax + by + cz + d >= 0
+    // inside, see ComputeFrustumPlanes) and, with an occlusion buffer, is not hidden behind its occluders.
+    void QueryFrustum(const float planes[6][4], const OcclusionBufferClass* occlusion, std::vector<unsigned int>& userData) const;
+
+    // The nearest object box the ray (origin + t direction, 0 <= t <= maxDistance) enters. False when there is none.
+    bool Raycast(const float origin[3], const float direction[3], float maxDistance, unsigned int& userData, float& distance) const;
+
+    int GetObjectCount();
+    int GetNodeCount();
+    float GetCost();            // SAH cost of the tree relative to its root box, see Update.
+
+private:
+    void BuildNode(int node, int first, int count, std::vector<BuildItemType>& items);
+    void SetNodeBox(NodeType& node, int first, int count);
+    void AppendSubtree(int node, std::vector<unsigned int>& userData) const;
+
+private:
+    std::vector<NodeType> m_nodes;
+    std::vector<float> m_boxes;                 // Box of every proxy: min x, y, z, max x, y, z.
+    std::vector<unsigned int> m_userData;       // Of every proxy.
+    std::vector<bool> m_alive;
+    std::vector<int> m_freeProxies;
+    std::vector<int> m_order;                   // The proxies of the tree, leaf after leaf.
+    int m_objectCount;
+    bool m_needsRebuild;
+    float m_buildCost, m_cost;
+};
+
+#endif
@@ -0,0 +1,72 @@
+// Filename: clusteredlightingclass.h
+#ifndef _CLUSTEREDLIGHTINGCLASS_H_
+#define _CLUSTEREDLIGHTINGCLASS_H_
+
+// INCLUDES
+#include "RasterTek.h"
+#include <d3d11.h>
+#include <directxmath.h>
+using namespace DirectX;
+
+#include "lightbinningclass.h"
+
+// Shader registers of the clustered lighting resources in light.ps (USE_CLUSTERED_LIGHTS).
+#define CLUSTER_LIGHT_SLOT 1            // t1: StructuredBuffer<ClusterLight>, the lights.
+#define CLUSTER_RANGE_SLOT 2            // t2: StructuredBuffer<uint2>, offset and count of the lights of every cluster.
+#define CLUSTER_INDEX_SLOT 3            // t3: StructuredBuffer<uint>, the light index list.
+#define CLUSTER_CBUFFER_SLOT 4          // b4: ClusterBuffer, the grid dimensions.
+
+// Class name: ClusteredLightingClass
+// GPU side of clustered forward shading: runs the LightBinningClass binning of the point lights every frame and
+// uploads the lights, the cluster ranges and the light index list into dynamic structured buffers read by the light
+// pixel shader. Any number of point lights (up to maxLights) can light a scene this way, each pixel only loops over
+// the lights of its own cluster.
+class ClusteredLightingClass
+{
+private:
+    // Must match ClusterBuffer in light.ps.
+    struct ClusterBufferType
+    {
+        unsigned int clustersX, clustersY, clustersZ;
+        unsigned int lightCount;
+        float tileScaleX, tileScaleY;   // Clusters per pixel, the tile of a pixel is its position times this.
+        float sliceScale, sliceBias;
+    };
+
+public:
+    ClusteredLightingClass();
+    ClusteredLightingClass(const ClusteredLightingClass&);
+    ~ClusteredLightingClass();
+
+    bool Initialize(ID3D11Device* device, const LightBinningConfig& config, int maxLights, int screenWidth, int screenHeight,
+                    float fovY, float nearZ, float farZ);
+    void Shutdown();
+
+    // Bin the lights (world space) for this view and upload the result, then Render binds it to the pixel shader.
+    bool Update(ID3D11DeviceContext* deviceContext, XMMATRIX viewMatrix, const ClusterLightType* lights, int lightCount);
+    void Render(ID3D11DeviceContext* deviceContext);
+
+    int GetLightCount();
+    int GetLightIndexCount();
+
+private:
+    bool CreateStructuredBuffer(ID3D11Device* device, unsigned int elementSize, unsigned int elementCount, ID3D11Buffer** buffer,
+                                ID3D11ShaderResourceView** view);
+    bool UploadBuffer(ID3D11DeviceContext* deviceContext, ID3D11Buffer* buffer, const void* data, unsigned int size);
+
+private:
+    LightBinningClass* m_LightBinning;
+    LightBinningConfig m_config;
+    int m_maxLights, m_lightCount;
+    int m_screenWidth, m_screenHeight;
+
+    ID3D11Buffer* m_lightBuffer;
+    ID3D11Buffer* m_clusterRangeBuffer;
+    ID3D11Buffer* m_lightIndexBuffer;
+    ID3D11Buffer* m_clusterBuffer;
+    ID3D11ShaderResourceView* m_lightView;
+    ID3D11ShaderResourceView* m_clusterRangeView;
+    ID3D11ShaderResourceView* m_lightIndexView;
+};
+
+#endif
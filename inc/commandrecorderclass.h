@@ -0,0 +1,55 @@
+// Filename: commandrecorderclass.h
+#ifndef _COMMANDRECORDERCLASS_H_
+#define _COMMANDRECORDERCLASS_H_
+
+// INCLUDES
+#include "RasterTek.h"
+#include <d3d11.h>
+#include <functional>
+#include <vector>
+
+// Class name: CommandRecorderClass
+// Records the draws of a frame on several threads. The scene is cut into partitions, every partition is recorded on
+// a deferred context of its own by a worker thread (RTParallelFor) and closed into a command list, then Execute
+// plays the command lists on the immediate context, in partition order, from the render thread. The cost of
+// building the draws (constant buffer updates, binds, draw calls) is spread over the cores; only the execution of
+// the lists stays on one thread.
+//
+// A deferred context starts every command list with the default pipeline state, so a partition binds everything it
+// uses (render targets and viewport included, see D3DClass::SetDefaultState). The command lists are executed without
+// restoring the immediate context state either: after Execute the immediate context is in the default state and its
+// state cache must be invalidated.
+class CommandRecorderClass
+{
+public:
+    // Records partition 'partition' on 'deviceContext', called on a worker thread. Returns false on an error.
+    typedef std::function<bool(ID3D11DeviceContext* deviceContext, int partition)> RecordFunction;
+
+public:
+    CommandRecorderClass();
+    CommandRecorderClass(const CommandRecorderClass&);
+    ~CommandRecorderClass();
+
+    bool Initialize(ID3D11Device* device, int contextCount);
+    void Shutdown();
+
+    // Record partitionCount partitions (at most the context count) in parallel. On an error nothing is kept to execute.
+    bool Record(int partitionCount, const RecordFunction& record);
+    void Execute(ID3D11DeviceContext* deviceContext);
+
+    int GetContextCount();
+
+    // False when the driver has no native command lists and the runtime emulates them (recording still runs in
+    // parallel, but the execution costs more).
+    bool HasDriverCommandLists();
+
+private:
+    void ReleaseCommandLists();
+
+private:
+    std::vector<ID3D11DeviceContext*> m_contexts;
+    std::vector<ID3D11CommandList*> m_commandLists;
+    bool m_driverCommandLists;
+};
+
+#endif
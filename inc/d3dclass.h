@@ -5,12 +5,15 @@
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "dxgi.lib")
 #pragma comment(lib, "d3dcompiler.lib")
+#pragma comment(lib, "dxguid.lib")
 
 // INCLUDES
 #include <d3d11.h>
 #include <directxmath.h>
 using namespace DirectX;
 
+#include "renderstatecacheclass.h"
+
 class D3DClass {
 public:
     D3DClass();
@@ -25,6 +28,7 @@ public:
 
     ID3D11Device* GetDevice();
     ID3D11DeviceContext* GetDeviceContext();
+    RenderStateCacheClass* GetStateCache();
 
     void GetProjectionMatrix(XMMATRIX&);
     void GetWorldMatrix(XMMATRIX&);
@@ -35,10 +39,18 @@ public:
     void D3DClass::SetBackBufferRenderTarget();
     void D3DClass::ResetViewport();
 
+    // Bind the back buffer, the depth buffer, the Z buffer on / no blending states, the rasterizer state and the
+    // viewport on a context that lost them (a deferred context, the immediate context after a command list).
+    void SetDefaultState(ID3D11DeviceContext* deviceContext);
+
     // Functions for turning the Z buffer on and off when rendering 2D images.
     void TurnZBufferOn();
     void TurnZBufferOff();
 
+    // Functions for turning alpha blending on and off when rendering text.
+    void TurnOnAlphaBlending();
+    void TurnOffAlphaBlending();
+
 private:
     bool m_vsync_enabled;
     int m_videoCardMemory;
@@ -54,6 +66,10 @@ private:
     ID3D11DepthStencilView* m_depthStencilView;
     ID3D11RasterizerState* m_rasterState;
     ID3D11DepthStencilState* m_depthDisabledStencilState;
+    ID3D11BlendState* m_alphaEnableBlendingState;
+    ID3D11BlendState* m_alphaDisableBlendingState;
+
+    RenderStateCacheClass* m_StateCache;
 
     D3D11_VIEWPORT m_viewport;
     XMMATRIX m_projectionMatrix;
@@ -0,0 +1,45 @@
+// Filename: dynamicringbufferclass.h
+#ifndef _DYNAMICRINGBUFFERCLASS_H_
+#define _DYNAMICRINGBUFFERCLASS_H_
+
+// INCLUDES
+#include "RasterTek.h"
+#include <d3d11.h>
+
+// Class name: DynamicRingBufferClass
+// One large dynamic buffer shared by all the geometry that is rewritten from the CPU (bitmaps, sprite batches, ...).
+// Each upload takes the next free range of the buffer and maps it with D3D11_MAP_WRITE_NO_OVERWRITE: the GPU may still
+// be reading the ranges written before, but never the new one, so the driver neither waits nor renames the buffer.
+// Only when the end of the buffer is reached does the ring start over at offset 0 with D3D11_MAP_WRITE_DISCARD,
+// which hands over a fresh copy of the buffer. The caller writes its vertices straight into the mapped memory.
+class DynamicRingBufferClass
+{
+public:
+    DynamicRingBufferClass();
+    DynamicRingBufferClass(const DynamicRingBufferClass&);
+    ~DynamicRingBufferClass();
+
+    bool Initialize(ID3D11Device* device, unsigned int sizeBytes, unsigned int bindFlags);
+    void Shutdown();
+
+    // Map returns a pointer to write 'size' bytes to, and the offset of that range in the buffer (a multiple of
+    // 'alignment', e.g. the vertex stride). Unmap must be called before the range is drawn and before the next Map.
+    void* Map(ID3D11DeviceContext* deviceContext, unsigned int size, unsigned int alignment, unsigned int& offset);
+    void Unmap(ID3D11DeviceContext* deviceContext);
+
+    ID3D11Buffer* GetBuffer();
+    unsigned int GetSize();
+
+    // The ranges written before a wrap are gone, a caller can keep drawing a range it wrote earlier (without writing it
+    // again) only as long as the wrap count did not change.
+    unsigned int GetWrapCount();
+    unsigned int GetMapCount();
+
+private:
+    ID3D11Buffer* m_buffer;
+    unsigned int m_size, m_position;
+    unsigned int m_wrapCount, m_mapCount;
+    bool m_mapped;
+};
+
+#endif
@@ -0,0 +1,57 @@
+// Filename: entitysystems.h
+#ifndef _ENTITYSYSTEMS_H_
+#define _ENTITYSYSTEMS_H_
+
+// INCLUDES
+#include "entityworldclass.h"
+#include "renderqueueclass.h"
+#include "occlusionbufferclass.h"
+#include "boundstreeclass.h"
+
+#include <vector>
+
+// The per frame systems over the entities of an EntityWorldClass, run in this order: spin (animation), transform,
+// bounds tree, culling, occlusion, render submission. Each one walks the component arrays it needs from start to end; all but the
+// submission cut them into chunks of ENTITY_SYSTEM_GRAIN entities for the worker threads when useThreads is set. Like
+// the storage, they have no Windows or Direct3D dependency.
+#define ENTITY_SYSTEM_GRAIN 4096
+
+// Spin + Transform: write the rotation of the spinning entities for the frame rotation (radians).
+void UpdateSpinSystem(EntityWorldClass& world, float rotation, bool useThreads);
+
+// Transform + World: the world matrix of every entity from its local transform.
+void UpdateTransformSystem(EntityWorldClass& world, bool useThreads);
+
+// The six planes (a, b, c, d with ax + by + cz + d >= 0 inside) of the view frustum of a view * projection matrix, in
+// the row vector convention and the 0..1 depth range of Direct3D.
+void ComputeFrustumPlanes(const SceneMatrixType& viewProjection, float planes[6][4]);
+
+// World + Bounds + Renderable: set the visible flag of the renderables whose bounding sphere touches the frustum.
+// Returns the number of visible entities.
+int UpdateCullingSystem(EntityWorldClass& world, const float planes[6][4], bool useThreads);
+
+// Occluder + World: place the occluders in the occlusion buffer and rasterize them. The buffer is started (Begin)
+// with the view * projection matrix of the frame by the caller.
+void RasterizeOccluderSystem(EntityWorldClass& world, OcclusionBufferClass& buffer, bool useThreads);
+
+// World + Bounds + Renderable: clear the visible flag of the visible renderables hidden behind the occluders, tested
+// with the world box of their bounding sphere. The occluders are not tested. Returns the number of entities hidden.
+int UpdateOcclusionSystem(EntityWorldClass& world, const OcclusionBufferClass& buffer, bool useThreads);
+
+// World + Bounds: write the world box of the bounding sphere of every entity in the bounds tree into its proxy, then
+// refit the tree (or rebuild it, see BoundsTreeClass::Update).
+void UpdateBoundsTreeSystem(EntityWorldClass& world, BoundsTreeClass& tree, bool useThreads);
+
+// Renderable: frustum culling and occlusion through the bounds tree, whose user data are the entities. Sets the
+// visible flag of the renderables the tree query returns (into 'visibleEntities') and clears it for the others. The
+// occluders are rasterized before. Returns the number of visible entities.
+int UpdateTreeCullingSystem(EntityWorldClass& world, const BoundsTreeClass& tree, const float planes[6][4], const OcclusionBufferClass* occlusion,
+                            std::vector<unsigned int>& visibleEntities);
+
+// World + Renderable: append the world matrix of every visible renderable to visibleWorlds and, with a queue, submit
+// one opaque packet per renderable, its payload payloadBase + its index in visibleWorlds. Returns the view depth of
+// the nearest visible renderable (farZ when there is none).
+float SubmitRenderSystem(EntityWorldClass& world, const SceneMatrixType& view, float farZ, RenderQueueClass* queue, unsigned int payloadBase,
+                         std::vector<SceneMatrixType>& visibleWorlds);
+
+#endif
@@ -0,0 +1,157 @@
+// Filename: entityworldclass.h
+#ifndef _ENTITYWORLDCLASS_H_
+#define _ENTITYWORLDCLASS_H_
+
+// INCLUDES
+#include "scenegraphclass.h"
+
+#include <functional>
+#include <vector>
+
+// The component types. An entity has any set of them, its archetype is the mask of the types it has.
+enum ComponentType
+{
+    COMPONENT_TRANSFORM,        // SceneTransformType, the local transform.
+    COMPONENT_WORLD,            // SceneMatrixType, the world matrix computed from the transform.
+    COMPONENT_BOUNDS,           // BoundsComponent
+    COMPONENT_SPIN,             // SpinComponent
+    COMPONENT_RENDERABLE,       // RenderableComponent
+    COMPONENT_LIGHT,            // LightComponent
+    COMPONENT_OCCLUDER,         // OccluderComponent
+    COMPONENT_COUNT
+};
+
+#define COMPONENT_BIT(type) (1u << (type))
+
+// Bounding sphere in object space, and the object of the entity in a bounds tree (BoundsTreeClass proxy, -1 when it
+// is in none).
+struct BoundsComponent
+{
+    float center[3];
+    float radius;
+    int proxy;
+};
+
+// Turns the entity around Y every frame: yaw + speed * the frame rotation + phase, on top of its pitch and roll.
+// Angles in radians.
+struct SpinComponent
+{
+    float speed;
+    float phase;
+    float pitch, yaw, roll;
+};
+
+// What the entity is drawn with, the ids go in the render queue sort key. 'visible' is written by the culling system.
+struct RenderableComponent
+{
+    unsigned int variant;
+    unsigned int texture;
+    unsigned int material;
+    unsigned int visible;
+};
+
+// A diffuse light, lighting along its direction or, when 'positional' is set, from its position.
+struct LightComponent
+{
+    float color[4];
+    float direction[3];
+    float position[3];
+    unsigned int positional;
+};
+
+// The entity hides what is behind it: its mesh is drawn in the occlusion buffer (OcclusionBufferClass::AddMesh index).
+struct OccluderComponent
+{
+    int mesh;
+};
+
+// Entity handle: the index of its record and the generation of the record, a destroyed entity's handle goes stale.
+typedef unsigned int EntityId;
+
+#define ENTITY_INDEX_BITS 22
+#define ENTITY_INVALID 0xffffffffu
+
+// A run of entities of one archetype. components[type] points at the first entity's component of every type of the
+// archetype (null for the other types), the components of the run follow each other.
+struct EntityChunkType
+{
+    int count;
+    const EntityId* entities;
+    void* components[COMPONENT_COUNT];
+};
+
+// Class name: EntityWorldClass
+// Entity-component storage by archetype. All the entities with the same set of components live in one archetype,
+// which keeps every component type in its own contiguous array (structure of arrays), so a system reading two
+// components of a hundred thousand entities walks two linear arrays instead of chasing a pointer per object.
+//
+// The systems go through ForEachChunk: every archetype having the requested components is handed over as chunks of
+// consecutive entities, in parallel on the worker threads (RTParallelFor) when asked. Entities can not be created,
+// destroyed or change components while a ForEachChunk is running.
+//
+// Adding or removing components moves the entity to another archetype; destroying it moves the last entity of its
+// archetype in its place.
+class EntityWorldClass
+{
+public:
+    typedef std::function<void(const EntityChunkType& chunk)> ChunkFunction;
+
+public:
+    EntityWorldClass();
+    EntityWorldClass(const EntityWorldClass&);
+    ~EntityWorldClass();
+
+    bool Initialize(int initialCapacity);
+    void Shutdown();
+
+    // A new entity with the components of 'componentMask': identity transform and world matrix, no bounds tree proxy,
+    // everything else zero.
+    EntityId CreateEntity(unsigned int componentMask);
+    void DestroyEntity(EntityId entity);
+    bool IsAlive(EntityId entity);
+    int GetEntityCount();
+
+    bool AddComponents(EntityId entity, unsigned int componentMask);
+    bool RemoveComponents(EntityId entity, unsigned int componentMask);
+    unsigned int GetComponentMask(EntityId entity);
+
+    // The component of an entity, null when it does not have it. Valid until the next structural change.
+    void* GetComponent(EntityId entity, ComponentType type);
+
+    template <class T> T* Get(EntityId entity, ComponentType type) { return (T*)GetComponent(entity, type); }
+
+    // Call 'function' on every entity having all the components of 'componentMask'. With useThreads the archetypes are
+    // cut into chunks of 'grain' entities processed on the worker threads, the chunks must not write the same data.
+    void ForEachChunk(unsigned int componentMask, int grain, bool useThreads, const ChunkFunction& function);
+
+private:
+    struct ArchetypeType
+    {
+        unsigned int mask;
+        int count;
+        std::vector<EntityId> entities;
+        std::vector<unsigned char> columns[COMPONENT_COUNT];
+    };
+
+    struct EntityRecordType
+    {
+        int archetype;
+        int row;
+        unsigned int generation;
+    };
+
+    int FindArchetype(unsigned int mask);
+    int AppendRow(int archetype, EntityId entity);
+    void RemoveRow(int archetype, int row);
+    bool MoveEntity(EntityId entity, unsigned int newMask);
+    EntityRecordType* GetRecord(EntityId entity);
+
+private:
+    std::vector<ArchetypeType> m_archetypes;
+    std::vector<EntityRecordType> m_records;
+    std::vector<unsigned int> m_freeRecords;
+    int m_entityCount;
+    int m_initialCapacity;
+};
+
+#endif
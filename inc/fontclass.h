@@ -0,0 +1,52 @@
+// Filename: fontclass.h
+#ifndef _FONTCLASS_H_
+#define _FONTCLASS_H_
+
+// INCLUDES
+#include "RasterTek.h"
+#include <d3d11.h>
+#include <directxmath.h>
+using namespace DirectX;
+
+#include "textureclass.h"
+
+#define FONT_FIRST_CHAR 32
+#define FONT_LAST_CHAR 126
+#define FONT_CHAR_COUNT (FONT_LAST_CHAR - FONT_FIRST_CHAR + 1)
+
+// Class name: FontClass
+// A bitmap font: the atlas texture made by the RasterTekFontAtlas tool (tools/fontatlas) and the placement of every
+// printable ASCII character in it. The glyph metrics are in pixels, TextClass uses them to lay out the strings.
+class FontClass
+{
+public:
+    struct GlyphType
+    {
+        XMFLOAT4 uvRect;        // left, top, right, bottom texture coordinates in the atlas.
+        float width, height;    // Size of the glyph bitmap.
+        float xOffset, yOffset; // Position of the bitmap relative to the pen position (top of the line).
+        float xAdvance;         // How far the pen moves after this character.
+    };
+
+public:
+    FontClass();
+    FontClass(const FontClass&);
+    ~FontClass();
+
+    bool Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext, char* fontFilename);
+    void Shutdown();
+
+    ID3D11ShaderResourceView* GetTexture();
+    const GlyphType* GetGlyph(char character);
+    int GetLineHeight();
+
+private:
+    bool LoadFontData(char* filename, char* atlasFilename);
+
+private:
+    TextureClass* m_Texture;
+    GlyphType m_glyphs[FONT_CHAR_COUNT];
+    int m_atlasWidth, m_atlasHeight, m_lineHeight;
+};
+
+#endif
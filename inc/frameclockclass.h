@@ -0,0 +1,55 @@
+// Filename: frameclockclass.h
+#ifndef _FRAMECLOCKCLASS_H_
+#define _FRAMECLOCKCLASS_H_
+
+// INCLUDES
+#include <chrono>
+
+#define FRAME_CLOCK_MAX_FRAME_TIME 0.25       // Seconds of one frame the simulation catches up at most, after a stall.
+
+// Class name: FrameClockClass
+// The clock of the main loop: a fixed-timestep simulation clock and a frame rate limiter.
+//
+// BeginFrame measures the real time since the previous frame and returns how many simulation steps of GetStepTime
+// seconds fit in it, the time left over carried to the next frame. The simulation advances by whole steps only, so it
+// runs at the same speed at any frame rate. The frame draws the state GetInterpolation of the way from the state before
+// the last step to the last one, which keeps the motion smooth when steps and frames do not line up.
+//
+// WaitForNextFrame holds the frame rate at the limit: it sleeps until the frame is due and never spins, an idle instance
+// uses no CPU. On Windows the sleep is a high resolution waitable timer (Windows 10 1803 and later), a plain waitable
+// timer of the 1 ms timeBeginPeriod granularity before that. The frames are due at regular times rather than one
+// period after the previous frame ended, so an oversleep is taken off the next frame and the rate does not drift.
+// After the loop blocked for a while (idle), Reset forgets that time.
+class FrameClockClass
+{
+public:
+    FrameClockClass();
+    FrameClockClass(const FrameClockClass&);
+    ~FrameClockClass();
+
+    bool Initialize(float stepTime);
+    void Shutdown();
+
+    void SetFrameRateLimit(float framesPerSecond);  // 0 for no limit.
+    void Reset();
+
+    int BeginFrame();
+    void WaitForNextFrame();
+
+    float GetStepTime();
+    float GetFrameTime();       // Real seconds since the previous frame.
+    float GetInterpolation();   // Between 0 and 1, the part of a step simulated ahead of the drawn state.
+    double GetOversleep();      // Seconds the waits woke up late, on average.
+
+private:
+    typedef std::chrono::steady_clock ClockType;
+
+    ClockType::time_point m_frameStart;
+    ClockType::time_point m_deadline;
+    double m_stepTime, m_frameTime, m_accumulator;
+    double m_framePeriod;
+    double m_oversleep;
+    void* m_timer;              // The waitable timer on Windows.
+};
+
+#endif
@@ -0,0 +1,55 @@
+// Filename: framepipelineclass.h
+#ifndef _FRAMEPIPELINECLASS_H_
+#define _FRAMEPIPELINECLASS_H_
+
+// INCLUDES
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#define FRAME_PIPELINE_SLOTS 2          // Frame states: one drawn while the next one is produced.
+#define FRAME_PIPELINE_SPIN_COUNT 2000  // Checks of a waiting thread before it goes to sleep.
+
+// Class name: FramePipelineClass
+// Runs the simulation of frame N + 1 on a thread of its own while the calling (render) thread draws frame N.
+//
+// The frames are written to FRAME_PIPELINE_SLOTS frame states owned by the caller, in turn. StartFrame hands a slot
+// to the simulation thread, which calls the produce function with it; WaitForFrame returns once the frame started
+// last is done. The caller draws that slot and starts the next frame in the other one, so the simulation thread only
+// ever writes a slot the render thread is not reading, and a frame costs the longer of the two instead of their sum.
+//
+// The handoff is two frame counters, stored with release and loaded with acquire order: everything written to a slot
+// before its counter moved is visible to the other thread after it saw the counter. The frame states themselves are
+// never locked. A thread that has to wait checks the counter for a while and then sleeps on a condition variable,
+// the mutex of which only guards the sleep.
+class FramePipelineClass
+{
+public:
+    FramePipelineClass();
+    FramePipelineClass(const FramePipelineClass&);
+    ~FramePipelineClass();
+
+    bool Initialize(const std::function<void(int slot)>& produce);
+    void Shutdown();
+
+    void StartFrame(int slot);
+    int WaitForFrame();     // The slot of the frame started last, -1 when none was started.
+
+private:
+    void Run();
+    void Wait(const std::atomic<int>& counter, int value);
+    void Wake(std::atomic<int>& counter, int value);
+
+private:
+    std::function<void(int slot)> m_produce;
+    std::thread m_thread;
+    std::atomic<int> m_started, m_finished;     // Frames handed to the simulation thread, frames it produced.
+    std::atomic<bool> m_quit;
+    int m_slot;                                 // Of the frame started last, published by m_started.
+    std::mutex m_sleepMutex;
+    std::condition_variable m_sleep;
+};
+
+#endif
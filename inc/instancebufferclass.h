@@ -0,0 +1,49 @@
+// Filename: instancebufferclass.h
+#ifndef _INSTANCEBUFFERCLASS_H_
+#define _INSTANCEBUFFERCLASS_H_
+
+// INCLUDES
+#include "RasterTek.h"
+#include <d3d11.h>
+#include <directxmath.h>
+#include "renderstatecacheclass.h"
+using namespace DirectX;
+
+// Input slot the per-instance stream is bound to, slot 0 is the vertex buffer of the model.
+#define INSTANCE_INPUT_SLOT 1
+
+// Class name: InstanceBufferClass
+// Per-instance vertex stream for hardware instancing. Each instance is a world matrix, read by the instanced vertex
+// shaders as four float4 rows (WORLD0..WORLD3, D3D11_INPUT_PER_INSTANCE_DATA). Drawing N copies of a model is then
+// a single DrawIndexedInstanced call instead of N cbuffer updates and DrawIndexed calls.
+class InstanceBufferClass
+{
+private:
+    // The rows of the matrix are stored as is (not transposed like the cbuffer matrices), the shader rebuilds the
+    // matrix from the rows so mul(position, world) gives the same result as the cbuffer path.
+    struct InstanceType
+    {
+        XMFLOAT4X4 world;
+    };
+
+public:
+    InstanceBufferClass();
+    InstanceBufferClass(const InstanceBufferClass&);
+    ~InstanceBufferClass();
+
+    bool Initialize(ID3D11Device* device, int maxInstances);
+    void Shutdown();
+    void SetStateCache(RenderStateCacheClass* stateCache);
+
+    bool Update(ID3D11DeviceContext* deviceContext, const XMMATRIX* worldMatrices, int instanceCount);
+    void Render(ID3D11DeviceContext* deviceContext);
+
+    int GetInstanceCount();
+
+private:
+    ID3D11Buffer* m_instanceBuffer;
+    RenderStateCacheClass* m_StateCache;
+    int m_maxInstances, m_instanceCount;
+};
+
+#endif
@@ -0,0 +1,114 @@
+// Filename: jobsystemclass.h
+#ifndef _JOBSYSTEMCLASS_H_
+#define _JOBSYSTEMCLASS_H_
+
+// INCLUDES
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define JOB_SYSTEM_MAX_WORKERS 64       // Worker threads at most, the jobs of a parallel loop are on the caller's stack.
+#define JOB_SYSTEM_DEQUE_SIZE 4096      // Jobs a worker can have queued, a power of two. Jobs over that run inline.
+#define JOB_SYSTEM_SPIN_COUNT 64        // Rounds of stealing an idle or waiting thread tries before it goes to sleep.
+
+// A job runs function(data) once. The job and its data belong to the caller and must stay valid until the counter
+// the job was started with is back to zero.
+struct JobCounterType
+{
+    std::atomic<int> pending{ 0 };
+};
+
+struct JobType
+{
+    void (*function)(void* data);
+    void* data;
+    JobCounterType* counter;
+};
+
+// Class name: JobSystemClass
+// Work-stealing job scheduler: the one pool of threads the CPU side systems share (culling, animation, light binning,
+// the occlusion rasterizer, mip generation, command recording) instead of starting threads of their own.
+//
+// Every worker has a Chase-Lev deque of jobs. The worker pushes and pops its own jobs at the bottom, last in first
+// out, which keeps the data of a job it just started in its cache; the other threads steal from the top, oldest jobs
+// first, so they take the larger pieces of work. Threads that are not workers (the window thread, the simulation
+// thread of the frame pipeline) queue their jobs on a shared queue that every worker also takes from.
+//
+// Dependencies are counters: Run adds the jobs it starts to a counter, each finished job takes one off, and Wait
+// returns once the counter is zero. A waiting thread runs other jobs in the meantime (its own first, then stolen
+// ones), so waiting for jobs from inside a job neither blocks a worker nor deadlocks, as long as a job only waits for
+// jobs it started itself. ParallelFor is Run and Wait over the chunks of a range; a loop started inside another one
+// is spread over the workers too.
+//
+// Idle workers steal for a while and then sleep until new jobs are queued. A thread waiting on a counter with nothing
+// left to run sleeps as well, until the counter is zero or new jobs are queued, so a long job on a worker does not
+// keep the window or the simulation thread spinning. The workers can be pinned one per core, starting with the second
+// one, the first being left to the thread that created the job system.
+class JobSystemClass
+{
+private:
+    // Chase-Lev work-stealing deque (the C11 version of Le, Pop, Cohen and Zappa Nardelli), of fixed size.
+    class JobDequeType
+    {
+    public:
+        JobDequeType();
+
+        bool Push(JobType* job);    // Owner only, false when full.
+        JobType* Pop();             // Owner only.
+        JobType* Steal();           // Any thread.
+
+    private:
+        alignas(64) std::atomic<long long> m_top;
+        alignas(64) std::atomic<long long> m_bottom;
+        alignas(64) std::atomic<JobType*> m_jobs[JOB_SYSTEM_DEQUE_SIZE];
+    };
+
+public:
+    JobSystemClass();
+    JobSystemClass(const JobSystemClass&);
+    ~JobSystemClass();
+
+    bool Initialize(int workerCount, bool pinThreads);
+    void Shutdown();
+
+    void Run(JobType* jobs, int count, JobCounterType& counter);
+    void Wait(JobCounterType& counter);
+
+    // Calls func(begin, end) for the chunks of 'grain' items of [0, count) and returns once they are all done.
+    void ParallelFor(int count, int grain, const std::function<void(int begin, int end)>& func);
+
+    int GetThreadCount();   // The workers and the calling thread.
+    unsigned long long GetStealCount();
+
+private:
+    void WorkerThread(int worker);
+    JobType* FindJob();
+    void Execute(JobType* job);
+    void WakeWorkers();
+    void WakeSleepers();
+    static void PinThread(std::thread& thread, int core);
+
+private:
+    std::vector<std::thread> m_workers;
+    std::vector<JobDequeType*> m_deques;
+    std::atomic<bool> m_quit;
+
+    // Jobs queued by the threads that are not workers.
+    std::mutex m_queueMutex;
+    std::deque<JobType*> m_queue;
+    std::atomic<int> m_queueSize;
+
+    // Idle workers sleep until m_signal changes, waiting threads until that or their counter is zero.
+    std::mutex m_sleepMutex;
+    std::condition_variable m_sleep;
+    std::atomic<unsigned int> m_signal;
+    std::atomic<int> m_sleeping;
+
+    std::atomic<unsigned long long> m_steals;
+};
+
+#endif
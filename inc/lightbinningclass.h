@@ -0,0 +1,96 @@
+// Filename: lightbinningclass.h
+#ifndef _LIGHTBINNINGCLASS_H_
+#define _LIGHTBINNINGCLASS_H_
+
+// INCLUDES
+#include <vector>
+
+// A point light as uploaded to the light structured buffer of light.ps (32 bytes, the same layout as ClusterLight).
+struct ClusterLightType
+{
+    float position[3];          // World space.
+    float radius;               // The light has no effect past this distance.
+    float color[4];
+};
+
+// The lights of one cluster are the 'count' entries of the light index list starting at 'offset'.
+struct ClusterRangeType
+{
+    unsigned int offset;
+    unsigned int count;
+};
+
+typedef struct LightBinningConfig {
+    int clustersX = 16;         // Screen tiles across.
+    int clustersY = 9;          // Screen tiles down.
+    int clustersZ = 24;         // Depth slices, exponentially spaced between the near and far planes.
+    int maxLightIndices = 256 * 1024;  // Size of the light index list, the lights past it are dropped (overflow).
+} LightBinningConfig;
+
+// Class name: LightBinningClass
+// CPU side of clustered forward shading. The view frustum is cut into a grid of clusters (froxels): screen tiles by
+// exponential depth slices. Every frame each point light is binned into the clusters its sphere touches, so the pixel
+// shader only loops over the lights of its own cluster instead of every light in the scene.
+//
+// The bounding box of every cluster in view space is computed once by SetFrustum. Bin transforms the lights to view
+// space, gathers for every depth slice the lights overlapping its depth range, and then tests those lights against
+// the clusters of the slice four at a time with SSE (sphere against box). The slices are binned in parallel and the
+// result is a compact light index list with one (offset, count) range per cluster, ready to upload.
+class LightBinningClass
+{
+public:
+    LightBinningClass();
+    LightBinningClass(const LightBinningClass&);
+    ~LightBinningClass();
+
+    bool Initialize(const LightBinningConfig& config);
+    void Shutdown();
+
+    // Perspective projection of the view (left handed, like XMMatrixPerspectiveFovLH).
+    void SetFrustum(float fovY, float aspect, float nearZ, float farZ);
+
+    // viewMatrix is row major with row vectors (the XMFLOAT4X4 layout of a DirectXMath view matrix). Returns the
+    // number of light indices written.
+    int Bin(const float* viewMatrix, const ClusterLightType* lights, int lightCount);
+
+    int GetClusterCount();
+    const ClusterRangeType* GetClusterRanges();
+    const unsigned int* GetLightIndices();
+    int GetLightIndexCount();
+    int GetOverflowCount();
+
+    // The depth slice of a view space depth z is floor(log(z) * scale + bias), the pixel shader needs both.
+    float GetSliceScale();
+    float GetSliceBias();
+
+private:
+    void BinSlice(int slice);
+
+private:
+    // Lights overlapping the depth range of a slice, in view space, as structure of arrays padded to a multiple of four.
+    struct SliceType
+    {
+        std::vector<float> x, y, z, radiusSq;
+        std::vector<int> light;
+        std::vector<unsigned int> indices;      // Light indices of the clusters of the slice, cluster after cluster.
+        std::vector<unsigned int> counts;       // Light count of every cluster of the slice.
+    };
+
+    LightBinningConfig m_config;
+    int m_clusterCount, m_tileCount;
+    float m_nearZ, m_farZ, m_sliceScale, m_sliceBias;
+
+    // View space bounds, x / y of every cluster and the depth range of every slice.
+    std::vector<float> m_minX, m_maxX, m_minY, m_maxY;
+    std::vector<float> m_sliceNear, m_sliceFar;
+
+    // Lights of the current frame in view space.
+    std::vector<float> m_lightX, m_lightY, m_lightZ, m_lightRadius;
+    std::vector<SliceType> m_slices;
+
+    std::vector<ClusterRangeType> m_ranges;
+    std::vector<unsigned int> m_indices;
+    int m_indexCount, m_overflowCount;
+};
+
+#endif
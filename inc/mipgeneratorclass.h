@@ -0,0 +1,91 @@
+// Filename: mipgeneratorclass.h
+#ifndef _MIPGENERATORCLASS_H_
+#define _MIPGENERATORCLASS_H_
+
+// INCLUDES
+#include <vector>
+
+// Filters available to build each mip level from the previous one.
+// MIP_FILTER_BOX is the classic 2x2 average, MIP_FILTER_KAISER is a Kaiser windowed sinc which keeps the smaller
+// levels noticeably sharper without the ringing of a plain sinc.
+enum MipFilter { MIP_FILTER_BOX, MIP_FILTER_KAISER };
+
+typedef struct MipGeneratorConfig {
+    MipFilter filter = MIP_FILTER_KAISER;
+    bool srgb = true;                    // RGB channels are sRGB encoded, so they are filtered in linear space.
+    bool preserveAlphaCoverage = false;  // Rescale alpha of every level so alpha tested coverage matches level 0.
+    float alphaCutoff = 0.5f;            // Alpha test reference value used for the coverage computation.
+    float kaiserWidth = 3.0f;            // Radius of the Kaiser filter in destination texels.
+    float kaiserAlpha = 4.0f;            // Kaiser window shape parameter (higher = smoother, less ringing).
+    int maxLevels = 0;                   // Limit on the number of levels (0 = full chain down to 1x1).
+} MipGeneratorConfig;
+
+// One level of the chain, RGBA 8 bit per channel with tightly packed rows (rowPitch = width * 4).
+struct MipLevelData {
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;
+};
+
+struct MipChain {
+    std::vector<MipLevelData> levels;
+};
+
+// Class name: MipGeneratorClass
+// Builds complete mip chains on the CPU instead of relying on ID3D11DeviceContext::GenerateMips.
+// The color channels are converted sRGB -> linear before filtering and linear -> sRGB afterwards, which keeps the
+// brightness of the small levels correct (filtering the encoded values darkens them). Pixels are filtered as one
+// SSE register per RGBA texel and the work is split in row bands across threads; GenerateBatch additionally works
+// on several images at once. The class has no Direct3D dependency so the chains can be consumed by the texture
+// loader as well as any CPU side sampling or offline cooking.
+class MipGeneratorClass
+{
+private:
+    // Precomputed separable filter: for each destination texel the first source texel and the range of weights to use.
+    struct FilterContribution
+    {
+        int first;
+        int count;
+        int weightOffset;
+    };
+
+    struct FilterKernel
+    {
+        std::vector<FilterContribution> contributions;
+        std::vector<float> weights;
+    };
+
+public:
+    MipGeneratorClass();
+    MipGeneratorClass(const MipGeneratorClass&);
+    ~MipGeneratorClass();
+
+    bool Initialize(const MipGeneratorConfig& config);
+    void Shutdown();
+
+    bool Generate(const unsigned char* rgba, int width, int height, MipChain& chain);
+    bool GenerateBatch(const unsigned char* const* images, const int* widths, const int* heights, int imageCount, MipChain* chains);
+
+    static int GetMipLevelCount(int width, int height);
+
+private:
+    void BuildKernel(int srcSize, int dstSize, FilterKernel& kernel);
+    float EvaluateFilter(float t);
+
+    void DecodeToLinear(const unsigned char* rgba, int pixelCount, float* linear);
+    void EncodeFromLinear(const float* linear, int pixelCount, float alphaScale, unsigned char* rgba);
+    unsigned char LinearToSrgb(float value);
+
+    void Downsample(const float* src, int srcWidth, int srcHeight, float* dst, int dstWidth, int dstHeight);
+
+    float ComputeAlphaCoverage(const float* linear, int pixelCount, float alphaScale);
+    float FindAlphaScale(const float* linear, int pixelCount, float targetCoverage);
+
+private:
+    MipGeneratorConfig m_config;
+    float m_srgbToLinear[256];
+    float m_srgbThresholds[255];    // Linear value half way between two neighboring sRGB codes.
+    float m_kaiserNormalization;
+};
+
+#endif
@@ -8,7 +8,10 @@
 using namespace DirectX;
 
 #include "textureclass.h"
+#include "texturestreamerclass.h"
+#include "renderstatecacheclass.h"
 #include <fstream>
+#include <vector>
 using namespace std;
 
 // Class name: ModelClass
@@ -49,12 +52,17 @@ public:
     ModelClass(const ModelClass&);
     ~ModelClass();
 
-    bool Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext, CraftModel crafModel, char* modelFilename, char* textureFilename, bool useNormal);
+    bool Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext, CraftModel crafModel, char* modelFilename, char* textureFilename, bool useNormal,
+                    TextureStreamerClass* textureStreamer);
     void Shutdown();
+    void SetStateCache(RenderStateCacheClass* stateCache);
     void Render(ID3D11DeviceContext* deviceContext);
 
     int GetIndexCount();
     ID3D11ShaderResourceView* GetTexture();
+    float GetBoundingRadius();
+    void GetTrianglePositions(std::vector<float>& positions);
+    void RequestTextureDetail(float projectedSize);
 
     bool LoadModel(char*);
     void ReleaseModel();
@@ -73,8 +81,11 @@ private:
     ID3D11Buffer *m_vertexBuffer, *m_indexBuffer;
     int m_vertexCount, m_indexCount;
     TextureClass* m_Texture;
+    TextureStreamerClass* m_TextureStreamer;
+    RenderStateCacheClass* m_StateCache;
 
     ModelParamType* m_model;
+    float m_boundingRadius;
     unsigned int m_vertexBufferStride;
 };
 
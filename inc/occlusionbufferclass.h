@@ -0,0 +1,82 @@
+// Filename: occlusionbufferclass.h
+#ifndef _OCCLUSIONBUFFERCLASS_H_
+#define _OCCLUSIONBUFFERCLASS_H_
+
+// INCLUDES
+#include <vector>
+
+// The buffer is cut in square tiles of this many pixels. A row of tiles (a band) is the unit of work of the worker
+// threads, and every tile keeps the farthest depth of its pixels for the quick rejection of the tests.
+#define OCCLUSION_TILE_SIZE 8
+
+// Class name: OcclusionBufferClass
+// Software occlusion culling. The designated occluders (walls, floors, large props) are rasterized on the CPU into a
+// small depth buffer, then the bounding boxes of the objects are tested against it: an object whose box is behind the
+// occluders at every pixel it covers is not drawn.
+//
+// Both sides are conservative, an object is never culled while any part of it could be seen:
+//   - an occluder only writes the pixels its triangle covers completely, with the farthest depth of the triangle over
+//     the pixel;
+//   - a box is tested with the nearest depth of its corners over every pixel its projection touches, and a box
+//     crossing the near plane is always visible.
+//
+// Rasterization works on bands of tiles in parallel (RTParallelFor): the triangles are binned by band, each band walks
+// its triangles four pixels at a time with SSE, the edge functions giving a coverage mask per group of pixels. The
+// tests only read the buffer, they can run on any number of threads once Rasterize has returned.
+//
+// Matrices are row major with row vectors (the XMFLOAT4X4 layout of DirectXMath), depth is the 0..1 Direct3D range.
+class OcclusionBufferClass
+{
+private:
+    // A triangle of the frame in buffer space: pixels for x and y, z / w for the depth.
+    struct TriangleType
+    {
+        float x[3], y[3], z[3];
+    };
+
+public:
+    OcclusionBufferClass();
+    OcclusionBufferClass(const OcclusionBufferClass&);
+    ~OcclusionBufferClass();
+
+    // Width and height in pixels, multiples of OCCLUSION_TILE_SIZE.
+    bool Initialize(int width, int height);
+    void Shutdown();
+
+    // An occluder mesh: a triangle list of 'vertexCount' object space positions (x, y, z). Returns its index.
+    int AddMesh(const float* positions, int vertexCount);
+
+    // Clear the buffer and the occluders of the previous frame.
+    void Begin(const float* viewProjection);
+
+    // Place a copy of a mesh in the frame. The triangles are transformed and clipped to the near plane here, on the
+    // calling thread, nothing is drawn until Rasterize.
+    void AddOccluder(int mesh, const float* worldMatrix);
+
+    // Draw the occluders of the frame into the depth buffer.
+    void Rasterize(bool useThreads);
+
+    // World space box against the occluders: false when it is hidden, true when any of it may be seen.
+    bool TestBox(const float boxMin[3], const float boxMax[3]) const;
+
+    int GetWidth();
+    int GetHeight();
+    const float* GetDepth();
+    int GetTriangleCount();
+
+private:
+    void ClipAndAddTriangle(const float clip[3][4]);
+    void RasterizeBand(int band);
+
+private:
+    int m_width, m_height, m_tilesX, m_tilesY;
+    float m_viewProjection[16];
+
+    std::vector<float> m_depth;                     // Row after row.
+    std::vector<float> m_tileMaxDepth;              // Farthest depth of every tile, written by Rasterize.
+    std::vector<std::vector<float>> m_meshes;
+    std::vector<TriangleType> m_triangles;
+    std::vector<std::vector<int>> m_bandTriangles;  // The triangles overlapping every band.
+};
+
+#endif
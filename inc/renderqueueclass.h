@@ -0,0 +1,70 @@
+// Filename: renderqueueclass.h
+#ifndef _RENDERQUEUECLASS_H_
+#define _RENDERQUEUECLASS_H_
+
+// INCLUDES
+#include <vector>
+
+// Passes of a frame, in the order they are drawn (the two top bits of the sort key).
+enum RenderPass { RENDER_PASS_OPAQUE = 0, RENDER_PASS_TRANSPARENT = 1, RENDER_PASS_OVERLAY = 2 };
+
+// A draw submitted to the render queue. The payload is what the caller needs to issue the draw (an index in its own
+// table of draws), the queue only orders the packets by key.
+struct RenderPacketType
+{
+    unsigned long long key;
+    unsigned int payload;
+    unsigned int padding;
+};
+
+// Class name: RenderQueueClass
+// Collects the draw packets of a frame and sorts them by their 64 bit key with an LSD radix sort (eight passes of
+// eight bits, stable, linear in the packet count), so the caller submits them in key order. The layout of the key
+// depends on the pass:
+//
+//   opaque       [pass 2][depth bucket 4][shader variant 10][texture 16][material 12][depth 20]
+//   transparent  [pass 2][inverted depth 24][shader variant 10][texture 16][material 12]
+//   overlay      [pass 2][layer 12][shader variant 10][texture 16][unused 24]
+//
+// Opaque draws are grouped by a coarse depth bucket first and by state inside a bucket, so they go roughly front to
+// back (early-Z rejects the hidden pixels) while the draws sharing a shader and texture stay next to each other.
+// Transparent draws must be blended back to front, depth comes before the state. Overlay draws (2D, HUD) are drawn
+// by layer in the order the caller gives.
+class RenderQueueClass
+{
+public:
+    RenderQueueClass();
+    RenderQueueClass(const RenderQueueClass&);
+    ~RenderQueueClass();
+
+    bool Initialize(int initialCapacity);
+    void Shutdown();
+
+    // View depth range of the perspective projection, the depths are quantized logarithmically between the two.
+    void SetDepthRange(float nearZ, float farZ);
+
+    // Build a sort key. variant, texture and material are ids chosen by the caller (see GetResourceId), only their low
+    // bits are kept. For the overlay pass 'material' is the layer and viewDepth is ignored.
+    unsigned long long MakeKey(RenderPass pass, unsigned int variant, unsigned int texture, unsigned int material, float viewDepth);
+
+    // A 16 bit id for a resource pointer (texture, buffer). Two resources may share an id, that only costs a state change.
+    static unsigned int GetResourceId(const void* resource);
+
+    void Begin();
+    void Submit(unsigned long long key, unsigned int payload);
+
+    // Sort the packets of the frame, the result stays valid until the next Begin.
+    const RenderPacketType* Sort();
+    int GetPacketCount();
+
+private:
+    unsigned int QuantizeDepth(float viewDepth, int bits);
+
+private:
+    std::vector<RenderPacketType> m_packets;
+    std::vector<RenderPacketType> m_scratch;
+    const RenderPacketType* m_sorted;
+    float m_nearZ, m_logScale;
+};
+
+#endif
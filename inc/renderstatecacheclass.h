@@ -0,0 +1,77 @@
+// Filename: renderstatecacheclass.h
+#ifndef _RENDERSTATECACHECLASS_H_
+#define _RENDERSTATECACHECLASS_H_
+
+// INCLUDES
+#include "RasterTek.h"
+#include <d3d11.h>
+
+#define RENDER_STATE_MAX_VERTEX_BUFFERS 2       // Slot 0 (model vertices) and INSTANCE_INPUT_SLOT.
+#define RENDER_STATE_MAX_CONSTANT_BUFFERS 4     // b0..b3 of the shaders (frame, object, light, material).
+#define RENDER_STATE_MAX_SAMPLERS 1
+
+// Class name: RenderStateCacheClass
+// Shadow copy of the pipeline state bound on the immediate context. The shader, model and 2D classes bind their
+// input layout, shaders, sampler, vertex / index buffers, topology and constant buffers through it, and a bind that
+// matches what is already set is dropped instead of reaching the driver. Back to back draws sharing a model or a
+// shader (the two cubes of test 8, a batch of objects with the same material) then only bind what differs.
+//
+// Everything bound on the context must go through the cache, otherwise call Invalidate so the next binds are all
+// issued. A bind on another context than the one given to Initialize is passed through untracked and uncounted, so
+// the classes using the cache can also record on deferred contexts from worker threads.
+class RenderStateCacheClass
+{
+public:
+    RenderStateCacheClass();
+    RenderStateCacheClass(const RenderStateCacheClass&);
+    ~RenderStateCacheClass();
+
+    bool Initialize(ID3D11DeviceContext* deviceContext);
+    void Shutdown();
+    void Invalidate();
+
+    void SetInputLayout(ID3D11DeviceContext* deviceContext, ID3D11InputLayout* layout);
+    void SetPrimitiveTopology(ID3D11DeviceContext* deviceContext, D3D11_PRIMITIVE_TOPOLOGY topology);
+    void SetVertexBuffer(ID3D11DeviceContext* deviceContext, unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset);
+    void SetIndexBuffer(ID3D11DeviceContext* deviceContext, ID3D11Buffer* buffer, DXGI_FORMAT format, unsigned int offset);
+    void SetVertexShader(ID3D11DeviceContext* deviceContext, ID3D11VertexShader* shader);
+    void SetPixelShader(ID3D11DeviceContext* deviceContext, ID3D11PixelShader* shader);
+    void SetVSConstantBuffer(ID3D11DeviceContext* deviceContext, unsigned int slot, ID3D11Buffer* buffer);
+    void SetPSConstantBuffer(ID3D11DeviceContext* deviceContext, unsigned int slot, ID3D11Buffer* buffer);
+    void SetPSSampler(ID3D11DeviceContext* deviceContext, unsigned int slot, ID3D11SamplerState* sampler);
+
+    // Binds passed on to the context and binds dropped since the last reset.
+    int GetIssuedCount();
+    int GetSkippedCount();
+    void ResetCounters();
+
+private:
+    bool IsTracked(ID3D11DeviceContext* deviceContext);
+
+private:
+    struct VertexBufferType
+    {
+        ID3D11Buffer* buffer;
+        unsigned int stride;
+        unsigned int offset;
+    };
+
+    ID3D11DeviceContext* m_deviceContext;
+
+    // The shadow state. Invalidate sets it to values no bind can match, so every next bind is issued once.
+    ID3D11InputLayout* m_layout;
+    D3D11_PRIMITIVE_TOPOLOGY m_topology;
+    VertexBufferType m_vertexBuffers[RENDER_STATE_MAX_VERTEX_BUFFERS];
+    ID3D11Buffer* m_indexBuffer;
+    DXGI_FORMAT m_indexFormat;
+    unsigned int m_indexOffset;
+    ID3D11VertexShader* m_vertexShader;
+    ID3D11PixelShader* m_pixelShader;
+    ID3D11Buffer* m_vsConstantBuffers[RENDER_STATE_MAX_CONSTANT_BUFFERS];
+    ID3D11Buffer* m_psConstantBuffers[RENDER_STATE_MAX_CONSTANT_BUFFERS];
+    ID3D11SamplerState* m_psSamplers[RENDER_STATE_MAX_SAMPLERS];
+
+    int m_issuedCount, m_skippedCount;
+};
+
+#endif
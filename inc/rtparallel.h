@@ -0,0 +1,25 @@
+// Filename: rtparallel.h
+#ifndef _RTPARALLEL_H_
+#define _RTPARALLEL_H_
+
+// INCLUDES
+#include <functional>
+
+class JobSystemClass;
+
+// Small data-parallel helper shared by the CPU side systems (mip generation, etc).
+// It has no Windows or Direct3D dependency so the code using it can also be built and profiled on Linux.
+//
+// RTParallelFor splits the range [0, count) into chunks of 'grain' items and calls func(begin, end) for each chunk.
+// The chunks run on the job system of the process (JobSystemClass), which is started by the first call and stopped
+// at exit. The calling thread takes part in the work and the call only returns once every chunk has been processed.
+// Nested calls (a parallel loop started from inside another one) are spread over the same worker threads.
+void RTParallelFor(int count, int grain, const std::function<void(int begin, int end)>& func);
+
+// Number of threads (including the caller) a parallel loop may use.
+unsigned int RTGetWorkerCount();
+
+// The job system behind RTParallelFor, for the systems queuing jobs of their own.
+JobSystemClass* RTGetJobSystem();
+
+#endif
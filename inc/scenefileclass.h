@@ -0,0 +1,133 @@
+// Filename: scenefileclass.h
+#ifndef _SCENEFILECLASS_H_
+#define _SCENEFILECLASS_H_
+
+// INCLUDES
+#include <string>
+#include <vector>
+
+#define SCENE_MAX_LIGHTS 4                  // Diffuse lights of a scene at most (MAX_DIFFUSE_LIGHTS of the light shader).
+#define SCENE_MAX_PATH 128
+
+// Geometry built in code when the scene has no model file (ModelClass CraftModel).
+enum SceneCraft { SCENE_CRAFT_RED, SCENE_CRAFT_REDINC, SCENE_CRAFT_FULLCOL };
+
+// A copy of the scene model. The rotation is in radians (pitch, yaw, roll); a spinning object turns around Y by 'spin'
+// times the frame rotation, plus 'phase'. An occluder also hides the objects behind it from the occlusion culling.
+struct SceneObjectType
+{
+    float position[3];
+    float rotation[3];
+    float scale[3];
+    float spin;
+    float phase;
+    bool occluder;
+};
+
+// A diffuse light, lighting along its direction or, when 'positional' is set, from its position.
+struct SceneLightType
+{
+    float color[4];
+    float direction[3];
+    float position[3];
+    bool positional;
+};
+
+// Everything the application sets up for a test, as flat arrays and flags. The use* flags are derived from the
+// content of the file when it is loaded, so the frame loop only reads them.
+struct SceneDescType
+{
+    char name[SCENE_MAX_PATH];
+    float clearColor[4];
+    bool clearOnly;                         // Nothing is drawn, the back buffer is only cleared.
+
+    float cameraPosition[3];
+    float cameraRotation[3];                // Degrees, CameraClass::SetRotation.
+
+    SceneCraft craft;
+    char model[SCENE_MAX_PATH];             // Empty: the crafted geometry.
+    char texture[SCENE_MAX_PATH];
+    std::vector<SceneObjectType> objects;   // At least one.
+
+    float ambientColor[4];
+    std::vector<SceneLightType> lights;
+    float specularColor[4];
+    float specularPower;
+
+    char bitmap[SCENE_MAX_PATH];            // 2D bitmap drawn over the scene, or the sprite description with spriteAnimation.
+    bool spriteAnimation;
+    bool spriteStress;
+    bool instancing;
+    bool clusteredLights;
+    bool deferred;
+    bool hud;
+
+    bool useTexture;
+    bool useAmbient;
+    bool useDiffuse;
+    bool useSpecular;
+    bool use2D;
+    bool useTimer;
+    bool useOcclusion;                      // At least one object is an occluder.
+};
+
+// Class name: SceneFileClass
+// Loads a scene description from a JSON file (data/scenes/testNN.json) so a test is set up by data instead of code:
+// the camera, the model and its texture, the copies of the model placed in the scene, the lights and the features the
+// test turns on. A new scene, a benchmark with more objects for example, only needs a new file.
+//
+// The reader handles the JSON the scene files use (objects, arrays, numbers, strings, true / false), unknown keys are
+// ignored so a file can carry comments in a "description" string. An object with a "grid" entry is expanded here into
+// one object per grid cell. The class has no Windows or Direct3D dependency.
+class SceneFileClass
+{
+private:
+    enum JsonType { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+
+    struct JsonValue
+    {
+        JsonType type = JSON_NULL;
+        int line = 0;
+        double number = 0.0;
+        std::string text;
+        std::vector<JsonValue> items;           // Array items, or object member values.
+        std::vector<std::string> keys;          // Object member names.
+
+        const JsonValue* Find(const char* key) const;
+    };
+
+public:
+    SceneFileClass();
+    SceneFileClass(const SceneFileClass&);
+    ~SceneFileClass();
+
+    bool Initialize(const char* filename);
+    void Shutdown();
+
+    const SceneDescType& GetScene();
+
+    // Line of the parse error or of the bad value, 0 when the file could not be read.
+    int GetErrorLine();
+
+private:
+    bool ParseValue(JsonValue& value, int depth);
+    bool ParseString(std::string& text);
+    void SkipSpace();
+
+    bool ReadScene(const JsonValue& root);
+    bool ReadObjects(const JsonValue* objects);
+    bool ReadLights(const JsonValue* lights);
+    bool ReadFloats(const JsonValue* value, float* floats, int count);
+    bool ReadPath(const JsonValue* value, char* path);
+    bool ReadBool(const JsonValue* value, bool& flag);
+    void DeriveFlags();
+
+private:
+    SceneDescType m_scene;
+    std::string m_text;
+    size_t m_pos;
+    int m_line;
+    int m_errorLine;
+};
+
+#endif
@@ -0,0 +1,79 @@
+// Filename: scenegraphclass.h
+#ifndef _SCENEGRAPHCLASS_H_
+#define _SCENEGRAPHCLASS_H_
+
+// INCLUDES
+#include <vector>
+
+// A world matrix, row major with row vectors and the translation in the last row: the XMFLOAT4X4 layout of a
+// DirectXMath matrix, so XMLoadFloat4x4 reads it as is.
+struct alignas(16) SceneMatrixType
+{
+    float m[16];
+};
+
+// Local transform of a node: scale, then rotation (unit quaternion x, y, z, w), then translation, relative to the parent.
+struct alignas(16) SceneTransformType
+{
+    float rotation[4];
+    float translation[4];           // w unused.
+    float scale[4];                 // w unused.
+};
+
+// Class name: SceneGraphClass
+// Transform hierarchy. The nodes are kept in contiguous arrays sorted by depth (every parent before its children,
+// the nodes of one depth next to each other), so the world matrices are updated in one linear pass: a node is
+// recomputed when its local transform changed or its parent was recomputed in the same update, which reaches every
+// dirty subtree and skips the rest of the tree. The nodes of a depth level only read the level above, so big levels
+// are split across the worker threads (RTParallelFor).
+//
+// The node ids returned by AddNode stay valid, the arrays behind them are reordered by depth on the next Update when
+// a node was added out of depth order. The matrix products use SSE directly.
+class SceneGraphClass
+{
+public:
+    SceneGraphClass();
+    SceneGraphClass(const SceneGraphClass&);
+    ~SceneGraphClass();
+
+    bool Initialize(int initialCapacity);
+    void Shutdown();
+
+    // Add a node under 'parent' (-1 for a root) with an identity local transform. Returns its id.
+    int AddNode(int parent);
+    int GetNodeCount();
+
+    void SetTranslation(int node, float x, float y, float z);
+    void SetRotation(int node, float x, float y, float z, float w);
+    void SetScale(int node, float x, float y, float z);
+
+    // Recompute the world matrices of the dirty subtrees. Returns the number of world matrices recomputed.
+    int Update(bool useThreads);
+
+    // World matrix of a node as of the last Update.
+    const SceneMatrixType* GetWorldMatrix(int node);
+
+    // The matrix of a local transform alone, for the transforms kept outside a hierarchy.
+    static void ComputeLocalMatrix(const SceneTransformType& local, SceneMatrixType& matrix);
+
+private:
+    void SortByDepth();
+    int UpdateRange(int begin, int end);
+
+private:
+    // Indexed by slot (depth sorted order).
+    std::vector<SceneTransformType> m_local;
+    std::vector<SceneMatrixType> m_world;
+    std::vector<int> m_parent;                  // Slot of the parent, -1 for a root.
+    std::vector<int> m_depth;
+    std::vector<int> m_node;                    // Node id of the slot.
+    std::vector<unsigned char> m_dirty;         // Local transform changed since the last update.
+    std::vector<unsigned int> m_updateStamp;    // m_updateCount of the last update that recomputed the world matrix.
+
+    std::vector<int> m_slot;                    // Slot of a node id.
+    std::vector<int> m_levelStart;              // First slot of every depth level, and the slot count at the end.
+    bool m_sorted;
+    unsigned int m_updateCount;
+};
+
+#endif
@@ -0,0 +1,63 @@
+// Filename: shadercacheclass.h
+#ifndef _SHADERCACHECLASS_H_
+#define _SHADERCACHECLASS_H_
+
+// INCLUDES
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A define passed to the shader compiler, name and value.
+typedef std::pair<std::string, std::string> ShaderDefine;
+
+// Class name: ShaderCacheClass
+// On disk cache of compiled shader bytecode. Every entry is keyed by a 64 bit hash of everything the bytecode
+// depends on: the source text, the text of the files it includes, the defines, the entry point, the profile, the
+// compile flags and the compiler version. A launch with unchanged shaders loads the blobs back instead of compiling
+// them; any change to one of the inputs gives a new key, so stale entries are simply never read again.
+// Next to the bytecode an entry keeps a metadata blob produced by the same compile (ShaderClass stores the shader
+// reflection there), so a hit returns everything a miss would have computed.
+//
+// The class has no Windows or Direct3D dependency (the compiler is a callback), so the key and the file format can
+// be built and checked on Linux with a stub compiler. GetBytecode can be called from several threads, the entries and
+// counters are guarded and the compiles themselves run in parallel.
+class ShaderCacheClass
+{
+public:
+    // Called on a miss, compiles the shader and fills the bytecode and its metadata. Returns false on a compile error.
+    typedef std::function<bool(std::vector<unsigned char>& bytecode, std::vector<unsigned char>& metadata)> CompileFunction;
+
+public:
+    ShaderCacheClass();
+    ShaderCacheClass(const ShaderCacheClass&);
+    ~ShaderCacheClass();
+
+    bool Initialize(const char* cacheDirectory, unsigned int compilerVersion);
+    void Shutdown();
+
+    bool GetBytecode(const char* sourceFile, const std::vector<ShaderDefine>& defines, const char* entryPoint, const char* profile,
+                     unsigned int flags, const CompileFunction& compile, std::vector<unsigned char>& bytecode,
+                     std::vector<unsigned char>& metadata);
+
+    bool ComputeKey(const char* sourceFile, const std::vector<ShaderDefine>& defines, const char* entryPoint, const char* profile,
+                    unsigned int flags, unsigned long long& key);
+
+    int GetHitCount();
+    int GetMissCount();
+
+private:
+    bool HashSourceFile(const std::string& filename, unsigned long long& hash, int depth);
+    std::string GetEntryFilename(unsigned long long key);
+    bool ReadEntry(unsigned long long key, std::vector<unsigned char>& bytecode, std::vector<unsigned char>& metadata);
+    bool WriteEntry(unsigned long long key, const std::vector<unsigned char>& bytecode, const std::vector<unsigned char>& metadata);
+
+private:
+    std::string m_directory;
+    unsigned int m_compilerVersion;
+    int m_hitCount, m_missCount;
+    std::mutex m_mutex;
+};
+
+#endif
@@ -6,73 +6,107 @@
 #include <d3d11.h>
 #include <d3dcompiler.h>
 #include <directxmath.h>
+#include <filesystem>
 #include <fstream>
+#include <future>
+#include <map>
+#include <vector>
 using namespace DirectX;
 using namespace std;
 
+#include "shadercacheclass.h"
+#include "shaderreflection.h"
+#include "renderstatecacheclass.h"
+
 #define MAX_DIFFUSE_LIGHTS 4
 
+// Compile time features of a shader variant, each is a D3D_SHADER_MACRO define of the light shaders.
+enum ShaderFeature { SHADER_FEATURE_TEXTURE = 1, SHADER_FEATURE_AMBIENT = 2, SHADER_FEATURE_DIFFUSE = 4, SHADER_FEATURE_SPECULAR = 8,
+                     SHADER_FEATURE_CLUSTERED = 16 };
+
+// The constant buffers of the shaders, bound by name: the register of each one in each stage comes from the
+// reflection of the compiled variant (see CBUFFER_NAMES).
+enum ShaderConstantBuffer { CBUFFER_FRAME, CBUFFER_OBJECT, CBUFFER_LIGHT, CBUFFER_MATERIAL, CBUFFER_COUNT };
+
+// Result of ShaderClass::ApplyReload.
+enum ShaderReloadStatus { SHADER_RELOAD_NONE, SHADER_RELOAD_APPLIED, SHADER_RELOAD_FAILED };
+
 // Class name: ShaderClass
-enum ShaderType { SHADER_COLOR, SHADER_TEXURE, SHADER_LIGHT };
+enum ShaderType { SHADER_COLOR, SHADER_TEXURE, SHADER_TEXTURE_ARRAY, SHADER_LIGHT };
 typedef struct ShaderInfo {
     ShaderType type;
     WCHAR* vs_shader_file;
     char* vs_shader_name;
     WCHAR* ps_shader_file;
     char* ps_shader_name;
-    unsigned int param_cnt;
+    bool instanced;             // The world matrix comes from the per-instance stream (InstanceBufferClass).
+    unsigned int variant;       // Variant key (feature bits and light count) compiled at initialization, 0 = no defines.
 } ShaderInfo;
 
 class ShaderClass
 {
 private:
-    // Here is the definition of the cBuffer type that will be used with the vertex shader. This typedef must be exactly
-    // the same as the one in the vertex shader as the model data needs to match the typedefs in the shader for proper rendering.
-    struct MatrixBufferType
-    {
-        XMMATRIX world;
-        XMMATRIX view;
-        XMMATRIX projection;
-    };
-
-    struct TextureConfigBufferType
+    // Here is the definition of the cBuffer types that will be used with the shaders. These typedefs must be exactly
+    // the same as the ones in the shaders as the data needs to match the typedefs in the shader for proper rendering.
+    // The buffers are grouped by update frequency: per frame (view-projection and lights), per object (world) and
+    // per material (texture slice), each one is only written when its content changed.
+    struct FrameBufferType
     {
-        unsigned int useTexture;
-        XMFLOAT3 paddingTCB;           // Extra padding so structure is a multiple of 16 for CreateBuffer function requirements.
+        XMMATRIX viewProjection;
     };
 
-    struct LightConfigBufferType
+    struct ObjectBufferType
     {
-        unsigned int useAmbientLight;
-        unsigned int useDiffuseLight;
-        unsigned int useSpecularLight;
-        float paddingLCB;             // Extra padding so structure is a multiple of 16 for CreateBuffer function requirements.
+        XMMATRIX world;
     };
 
-    struct LightDiffuseParamBufferType
+    struct LightBufferType
     {
         XMFLOAT4 diffuseLightPosDir[MAX_DIFFUSE_LIGHTS];
         XMFLOAT4 diffuseColor[MAX_DIFFUSE_LIGHTS];
-        unsigned int numDiffuseLights;
-        unsigned int isDiffuseLightPos;
-        XMFLOAT2 paddingLDB;          // Extra padding so structure is a multiple of 16 for CreateBuffer function requirements.
-    };
 
-    struct LightAmbientSpecularParamBufferType
-    {
         // Paramaters for ambient light
         XMFLOAT4 ambientColor;
 
         // Paramaters for specular light
         XMFLOAT4 specularColor;
+        XMFLOAT3 cameraPosition;
         float specularPower;
-        XMFLOAT3 paddingLPB;          // Extra padding so structure is a multiple of 16 for CreateBuffer function requirements.
+
+        unsigned int numDiffuseLights;
+        unsigned int isDiffuseLightPos;
+        XMFLOAT2 paddingLB;           // Extra padding so structure is a multiple of 16 for CreateBuffer function requirements.
     };
 
-    struct CameraBufferType
+    struct MaterialBufferType
     {
-        XMFLOAT3 cameraPosition;
-        unsigned int calcViewDirection;
+        unsigned int textureSlice;
+        XMFLOAT3 paddingMB;           // Extra padding so structure is a multiple of 16 for CreateBuffer function requirements.
+    };
+
+    // The compiled vertex / pixel shader pair of one permutation of the shader files, with the register of every
+    // constant buffer in each stage (-1 when the stage does not read it).
+    struct ShaderVariantType
+    {
+        ID3D11VertexShader* vertexShader;
+        ID3D11PixelShader* pixelShader;
+        int vsSlots[CBUFFER_COUNT];
+        int psSlots[CBUFFER_COUNT];
+    };
+
+    // The shaders of a hot reload, built on the reload thread and swapped in by ApplyReload.
+    struct ReloadResultType
+    {
+        bool succeeded;
+        std::map<unsigned int, ShaderVariantType> variants;
+        ID3D11InputLayout* layout;
+    };
+
+    // A dynamic constant buffer and the hash of the data last written to it.
+    struct ConstantBufferType
+    {
+        ID3D11Buffer* buffer;
+        unsigned long long hash;
     };
 
 public:
@@ -80,8 +114,13 @@ public:
     ShaderClass(const ShaderClass&);
     ~ShaderClass();
 
-    bool Initialize(ID3D11Device* device, HWND hwnd, bool useTexture, bool useAmbient, bool useDiffuse, bool useSpecular);
+    bool Initialize(ID3D11Device* device, HWND hwnd, bool useTexture, bool useTextureArray, bool useInstancing, bool useAmbient, bool useDiffuse, bool useSpecular,
+                    unsigned int numDiffuseLights);
     void Shutdown();
+    void SetShaderCache(ShaderCacheClass* shaderCache);
+    void SetStateCache(RenderStateCacheClass* stateCache);
+    void SetClusteredLighting(bool useClusteredLights);
+    void SetTextureSlice(unsigned int slice);
     bool Render(ID3D11DeviceContext* deviceContext, int indexCount, XMMATRIX worldMatrix, XMMATRIX viewMatrix,
                 XMMATRIX projMatrix, ID3D11ShaderResourceView* texture,
                 XMFLOAT3 cameraPos,
@@ -89,13 +128,60 @@ public:
                 bool useDiffuse, unsigned int numDiffuseLights, XMFLOAT4 diffuseCol[],
                 bool isLightPos, XMFLOAT3 lightPosDir[],
                 bool useSpecular, XMFLOAT4 specularCol, float specularPow);
+    bool RenderInstanced(ID3D11DeviceContext* deviceContext, int indexCount, int instanceCount, XMMATRIX viewMatrix,
+                         XMMATRIX projMatrix, ID3D11ShaderResourceView* texture,
+                         XMFLOAT3 cameraPos,
+                         bool useAmbient, XMFLOAT4 ambientCol,
+                         bool useDiffuse, unsigned int numDiffuseLights, XMFLOAT4 diffuseCol[],
+                         bool isLightPos, XMFLOAT3 lightPosDir[],
+                         bool useSpecular, XMFLOAT4 specularCol, float specularPow);
+
+    // Batched drawing (texture shader): the matrices and pipeline state are set once by BeginBatch, then every
+    // DrawBatch only binds its texture (when it changed) and draws its range of the bound index buffer.
+    bool BeginBatch(ID3D11DeviceContext* deviceContext, XMMATRIX worldMatrix, XMMATRIX viewMatrix, XMMATRIX projMatrix);
+    void DrawBatch(ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView* texture, int indexCount, int startIndex);
+
+    // The bound texture is only tracked per shader object, call this when another shader object used slot 0 since.
+    void InvalidateBoundTexture();
+
+    // The context lost its state (a new command list on a deferred context): the next draw binds its texture and
+    // writes every constant buffer again.
+    void ResetContextState();
+
+    // Number of constant buffer Map calls since the last reset (writes skipped because the data did not change are
+    // not counted).
+    int GetMapCount();
+    void ResetMapCount();
+
+    // Key of the variant the last draw used, an id for the render queue.
+    unsigned int GetCurrentVariant();
+
+    // Hot reload: StartReload recompiles the variants on a worker thread when one of the source files changed
+    // (UsesShaderFile), ApplyReload swaps the result in at a frame boundary. A failed compile keeps the running shaders.
+    bool UsesShaderFile(const char* filename);
+    void StartReload();
+    ShaderReloadStatus ApplyReload();
 
 private:
     bool InitializeShader(ID3D11Device* device, HWND hwnd, bool useTexture, bool useAmbient, bool useDiffuse, bool useSpecular);
 
-    bool SetShaderUsed(bool useTexture, bool useLighting);
+    bool SetShaderUsed(bool useTexture, bool useTextureArray, bool useInstancing, bool useAmbient, bool useDiffuse, bool useSpecular,
+                       unsigned int numDiffuseLights);
     ShaderInfo GetShaderUsed();
 
+    static unsigned int GetVariantKey(bool useTexture, bool useAmbient, bool useDiffuse, bool useSpecular, unsigned int numDiffuseLights,
+                                      bool useClusteredLights);
+    bool SelectVariant(unsigned int variant);
+    bool CompileVariant(unsigned int variant, ShaderVariantType& shaders, std::vector<unsigned char>* vertexShaderCode,
+                        ShaderReflectionType* vertexReflection, HWND hwnd);
+    static void ReleaseVariants(std::map<unsigned int, ShaderVariantType>& variants);
+    ReloadResultType ReloadVariants(std::vector<unsigned int> variants);
+    bool CompileShader(WCHAR* filename, char* entryPoint, const char* profile, D3D_SHADER_MACRO* defines, UINT flags, HWND hwnd,
+                       std::vector<unsigned char>& bytecode, ShaderReflectionType& reflection);
+    static bool ReflectShader(const std::vector<unsigned char>& bytecode, ShaderReflectionType& reflection);
+    bool CreateInputLayout(ID3D11Device* device, const std::vector<unsigned char>& vertexShaderCode, const ShaderReflectionType& vertexReflection,
+                           ID3D11InputLayout** layout);
+
     void ShutdownShader();
     void OutputShaderErrorMessage(ID3D10Blob* errorMessage, HWND hwnd, WCHAR* shaderFilename);
 
@@ -106,22 +192,44 @@ private:
                              bool useDiffuse, unsigned int numDiffuseLights, XMFLOAT4 diffuseCol[],
                              bool isLightPos, XMFLOAT3 lightPosDir[],
                              bool useSpecular, XMFLOAT4 specularCol, float specularPow);
-    void RenderShader(ID3D11DeviceContext* deviceContext, int indexCount);
+    void RenderShader(ID3D11DeviceContext* deviceContext, int indexCount, int instanceCount);
+    void SetPipelineState(ID3D11DeviceContext* deviceContext);
+    void SetConstantBuffer(ID3D11DeviceContext* deviceContext, ShaderConstantBuffer cbuffer, ID3D11Buffer* buffer);
+
+    bool UpdateConstantBuffer(ID3D11DeviceContext* deviceContext, ConstantBufferType& cbuffer, const void* data, unsigned int size);
+    bool SetMatrixBuffers(ID3D11DeviceContext* deviceContext, XMMATRIX worldMatrix, XMMATRIX viewMatrix, XMMATRIX projMatrix);
 
 private:
     ShaderInfo m_shader_info;
-
+    ID3D11Device* m_device;
+    HWND m_hwnd;
+    ShaderCacheClass* m_ShaderCache;
+    RenderStateCacheClass* m_StateCache;
+    bool m_useClusteredLights;      // The light shader also loops over the lights of the cluster (ClusteredLightingClass).
+    std::future<ReloadResultType> m_reload;
+    bool m_reloadPending;           // A source changed again while m_reload was compiling.
+
+    // All the variants compiled so far by key, m_vertexShader / m_pixelShader and the slot tables are the ones of
+    // m_currentVariant.
+    std::map<unsigned int, ShaderVariantType> m_variants;
+    unsigned int m_currentVariant;
     ID3D11VertexShader* m_vertexShader;
     ID3D11PixelShader* m_pixelShader;
+    int m_vsSlots[CBUFFER_COUNT];
+    int m_psSlots[CBUFFER_COUNT];
     ID3D11InputLayout* m_layout;
     ID3D11SamplerState* m_sampleState;
 
-    ID3D11Buffer* m_matrixBuffer;
-    ID3D11Buffer* m_textureConfigBuffer;
-    ID3D11Buffer* m_lightConfigBuffer;
-    ID3D11Buffer* m_lightDiffuseParamBuffer;
-    ID3D11Buffer* m_lightAmbientSpecularParamBuffer;
-    ID3D11Buffer* m_cameraBuffer;
+    ConstantBufferType m_frameBuffer;         // FrameBuffer
+    ConstantBufferType m_objectBuffer;        // ObjectBuffer
+    ConstantBufferType m_lightBuffer;         // LightBuffer
+    ConstantBufferType m_materialBuffer;      // MaterialBuffer
+    int m_mapCount;
+
+    // The texture bound to the pixel shader by the previous draw, used to skip rebinding when it did not change
+    // (e.g. an animated sprite between two frame changes, the slice is then only a material buffer change).
+    ID3D11ShaderResourceView* m_boundTexture;
+    unsigned int m_textureSlice;
 };
 
 #endif
\ No newline at end of file
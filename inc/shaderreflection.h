@@ -0,0 +1,44 @@
+// Filename: shaderreflection.h
+#ifndef _SHADERREFLECTION_H_
+#define _SHADERREFLECTION_H_
+
+// INCLUDES
+#include <string>
+#include <vector>
+
+// What ShaderClass needs to know about a compiled shader stage, taken from the shader reflection (D3DReflect) when the
+// shader is compiled and stored next to its bytecode in the shader cache, so a cache hit does not reflect again.
+// The D3D enums are kept as plain numbers: these types have no Windows or Direct3D dependency, and the serialized
+// form can be built and checked on Linux like the shader cache itself.
+
+// An element of the input signature of a vertex shader.
+struct ShaderInputType
+{
+    std::string semanticName;
+    unsigned int semanticIndex;
+    unsigned int componentType;         // D3D_REGISTER_COMPONENT_TYPE (1 = uint, 2 = int, 3 = float).
+    unsigned int componentCount;        // Components of the declared type, 1 to 4.
+    unsigned int systemValue;           // D3D_NAME, 0 for a regular input (not filled by the input assembler otherwise).
+};
+
+// A resource bound by the shader: constant buffer, texture, sampler, structured buffer ...
+struct ShaderBindingType
+{
+    std::string name;
+    unsigned int type;                  // D3D_SHADER_INPUT_TYPE (0 = constant buffer).
+    unsigned int slot;                  // Register (bN, tN, sN) of the resource.
+};
+
+typedef struct ShaderReflectionType {
+    std::vector<ShaderInputType> inputs;
+    std::vector<ShaderBindingType> bindings;
+} ShaderReflectionType;
+
+// The register of the resource named 'name' of the given type, -1 when the shader does not use it.
+int FindShaderBinding(const ShaderReflectionType& reflection, const char* name, unsigned int type);
+
+// Flat little endian byte form of the reflection, the metadata of a shader cache entry.
+void WriteShaderReflection(const ShaderReflectionType& reflection, std::vector<unsigned char>& data);
+bool ReadShaderReflection(const std::vector<unsigned char>& data, ShaderReflectionType& reflection);
+
+#endif
@@ -0,0 +1,54 @@
+// Filename: shaderwatcherclass.h
+#ifndef _SHADERWATCHERCLASS_H_
+#define _SHADERWATCHERCLASS_H_
+
+// INCLUDES
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define SHADER_WATCH_SETTLE_MS 200          // A file is reported once it has not been written for this long.
+
+// Class name: ShaderWatcherClass
+// Watches a directory (the shader sources) for files being written, with ReadDirectoryChangesW on Windows and
+// inotify on Linux, on a thread of its own so the render loop never waits on the file system. Editors often write a
+// file in several steps (truncate, write, rename), so a change is only reported after the file has been quiet for
+// SHADER_WATCH_SETTLE_MS, and reported once however many notifications it took.
+class ShaderWatcherClass
+{
+public:
+    ShaderWatcherClass();
+    ShaderWatcherClass(const ShaderWatcherClass&);
+    ~ShaderWatcherClass();
+
+    bool Initialize(const char* directory);
+    void Shutdown();
+
+    // The names (without the directory) of the files changed since the previous call. Returns false when there are none.
+    bool GetChangedFiles(std::vector<std::string>& files);
+
+private:
+    void WatchThread();
+    void AddChange(const std::string& filename);
+
+private:
+    std::string m_directory;
+    std::thread m_thread;
+    std::atomic<bool> m_stop;
+
+    // Files changed and not reported yet, with the time of their last change.
+    std::mutex m_mutex;
+    std::map<std::string, std::chrono::steady_clock::time_point> m_changes;
+
+#ifdef _WIN32
+    void* m_directoryHandle;
+#else
+    int m_notifyFd;
+#endif
+};
+
+#endif
@@ -0,0 +1,77 @@
+// Filename: spriteanimationclass.h
+#ifndef _SPRITEANIMATIONCLASS_H_
+#define _SPRITEANIMATIONCLASS_H_
+
+// INCLUDES
+#include <directxmath.h>
+#include <vector>
+using namespace DirectX;
+
+// Class name: SpriteAnimationClass
+// Advances the frame animations of many sprites at once. A clip is a list of frames played in a loop at a fixed
+// frame time, every frame is a texture coordinate rectangle (a cell of a sprite sheet, or the whole texture when
+// the frames are separate textures) plus an image number the caller maps to its texture.
+//
+// The state of the animations is kept in structure of arrays form (one array per field) so Update works on four
+// animations per SSE register and the arrays are streamed linearly, instead of one BitmapClass::Update call per
+// object. An update longer than several frame times advances the animation by all the frames that elapsed.
+// After Update the current frame of every animation is available as an image number and a uv rectangle, ready to
+// be passed on to SpriteBatchClass::Draw.
+class SpriteAnimationClass
+{
+public:
+    SpriteAnimationClass();
+    SpriteAnimationClass(const SpriteAnimationClass&);
+    ~SpriteAnimationClass();
+
+    bool Initialize(int maxAnimations);
+    void Shutdown();
+
+    // Clips, a clip id is returned (-1 on error). A null images / uvRects array means image 0 / the whole texture.
+    int AddClip(int frameCount, float frameTime, const int* images, const XMFLOAT4* uvRects);
+    int AddSheetClip(int columns, int rows, int frameCount, float frameTime, int image);
+
+    // Animations, the animation id is returned (-1 when full). startTime offsets the animation into its clip.
+    int AddAnimation(int clip, float startTime, float speed);
+    void SetSpeed(int animation, float speed);
+
+    void Update(float frameTime);
+
+    int GetAnimationCount();
+    int GetFrame(int animation);
+    int GetImage(int animation);
+    XMFLOAT4 GetUVRect(int animation);
+
+private:
+    void UpdateRange(float frameTime, int begin, int end);
+
+private:
+    struct FrameType
+    {
+        int image;
+        XMFLOAT4 uvRect;
+    };
+
+    struct ClipType
+    {
+        int firstFrame;
+        int frameCount;
+        float frameTime;
+    };
+
+    std::vector<FrameType> m_frames;
+    std::vector<ClipType> m_clips;
+
+    // Animation state, one entry per animation. The arrays are allocated for a multiple of four animations so the
+    // SSE loop never needs a scalar tail, the padding entries are harmless one frame clips.
+    float* m_time;              // Time spent in the current frame.
+    float* m_frameTime;         // Duration of a frame of the clip.
+    float* m_invFrameTime;
+    float* m_speed;
+    float* m_frameCount;        // Frame count of the clip, as float for the SSE arithmetic.
+    int* m_frame;               // Current frame within the clip.
+    int* m_firstFrame;          // First frame of the clip in m_frames.
+    int m_animationCount, m_maxAnimations;
+};
+
+#endif
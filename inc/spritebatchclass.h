@@ -0,0 +1,80 @@
+// Filename: spritebatchclass.h
+#ifndef _SPRITEBATCHCLASS_H_
+#define _SPRITEBATCHCLASS_H_
+
+// INCLUDES
+#include "RasterTek.h"
+#include <d3d11.h>
+#include <directxmath.h>
+#include <vector>
+using namespace DirectX;
+
+#include "shaderclass.h"
+#include "dynamicringbufferclass.h"
+#include "renderstatecacheclass.h"
+
+// SPRITE_SORT_DEFERRED keeps the submission order (draws are only merged while consecutive sprites share a texture),
+// SPRITE_SORT_TEXTURE groups the sprites by texture first so there is one draw per texture, at the cost of the
+// overlap order between sprites using different textures.
+enum SpriteSortMode { SPRITE_SORT_DEFERRED, SPRITE_SORT_TEXTURE };
+
+// Class name: SpriteBatchClass
+// Draws a large number of 2D textured quads with a few draw calls. The sprites queued between Begin and End are
+// written into the shared dynamic ring buffer (4 vertices each) and drawn with a static index buffer shared by all
+// the quads. Every run of sprites using the same texture is a single DrawIndexed, so the cost of a sprite is the
+// 4 vertices it writes instead of the buffer updates, constant buffer maps and draw call of a BitmapClass.
+// Sprite positions are in screen pixels with (0, 0) at the top left corner, like BitmapClass.
+class SpriteBatchClass
+{
+private:
+    // Same vertex as BitmapClass, so the sprites are drawn with the regular texture shader.
+    struct VertexType
+    {
+        XMFLOAT3 position;
+        XMFLOAT2 texture;
+    };
+
+    struct SpriteInfo
+    {
+        ID3D11ShaderResourceView* texture;
+        XMFLOAT4 rect;              // left, top, width, height in pixels.
+        XMFLOAT4 uvRect;            // left, top, right, bottom texture coordinates.
+    };
+
+public:
+    SpriteBatchClass();
+    SpriteBatchClass(const SpriteBatchClass&);
+    ~SpriteBatchClass();
+
+    bool Initialize(ID3D11Device* device, DynamicRingBufferClass* vertexRing, int screenWidth, int screenHeight, int maxSpritesPerFlush);
+    void Shutdown();
+    void SetStateCache(RenderStateCacheClass* stateCache);
+
+    void Begin(SpriteSortMode sortMode);
+    void Draw(ID3D11ShaderResourceView* texture, float x, float y, float width, float height);
+    void Draw(ID3D11ShaderResourceView* texture, float x, float y, float width, float height, XMFLOAT4 uvRect);
+    bool End(ID3D11DeviceContext* deviceContext, ShaderClass* shader, XMMATRIX worldMatrix, XMMATRIX viewMatrix, XMMATRIX orthoMatrix);
+
+    int GetSpriteCount();
+    int GetDrawCount();
+
+private:
+    bool InitializeBuffers(ID3D11Device* device);
+    void ShutdownBuffers();
+
+    bool Flush(ID3D11DeviceContext* deviceContext, ShaderClass* shader, int first, int count);
+    void WriteVertices(VertexType* vertices, int first, int count);
+
+private:
+    DynamicRingBufferClass* m_VertexRing;
+    RenderStateCacheClass* m_StateCache;
+    ID3D11Buffer* m_indexBuffer;
+    int m_screenWidth, m_screenHeight, m_maxSprites;
+
+    std::vector<SpriteInfo> m_sprites;
+    SpriteSortMode m_sortMode;
+    bool m_inBatch;
+    int m_spriteCount, m_drawCount;     // Statistics of the last End call.
+};
+
+#endif
@@ -3,6 +3,7 @@
 #include "RasterTek.h"
 #include "inputclass.h"
 #include "applicationclass.h"
+#include "frameclockclass.h"
 
 // FUNCTION PROTOTYPES
 static LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
@@ -22,6 +23,7 @@ public:
 
 private:
 	bool Frame();
+	void UpdateFrameRateLimit();
 
 	bool InitializeWindows(int& screenWidth, int& screenHeight);
 	void ShutdownWindows();
@@ -33,6 +35,9 @@ private:
 
 	InputClass* m_Input;
 	ApplicationClass* m_Application;
+	FrameClockClass* m_Clock;
+	bool m_isActive;     // The window is the one of the active application.
+	bool m_isMinimized;  // Nothing to draw, the loop blocks on the messages.
 };
 
 // GLOBALS
@@ -0,0 +1,77 @@
+// Filename: textclass.h
+#ifndef _TEXTCLASS_H_
+#define _TEXTCLASS_H_
+
+// INCLUDES
+#include "RasterTek.h"
+#include <d3d11.h>
+#include <directxmath.h>
+#include <string>
+#include <vector>
+using namespace DirectX;
+
+#include "fontclass.h"
+#include "shaderclass.h"
+#include "dynamicringbufferclass.h"
+#include "renderstatecacheclass.h"
+
+// Class name: TextClass
+// Draws all the strings of a HUD with one font in a single draw call. Every string is laid out once into its own
+// cached array of glyph quads, SetString only lays it out again when its text or position changed. At render time
+// the quads of all the strings are copied back to back into the shared dynamic ring buffer, which is skipped too when
+// nothing changed and the ring still holds the previous copy, and drawn with one DrawIndexed over the font atlas.
+// Positions are in screen pixels with (0, 0) at the top left corner, like BitmapClass.
+class TextClass
+{
+private:
+    // Same vertex as BitmapClass, so the text is drawn with the regular texture shader.
+    struct VertexType
+    {
+        XMFLOAT3 position;
+        XMFLOAT2 texture;
+    };
+
+    struct StringType
+    {
+        std::string text;
+        int x, y;
+        std::vector<VertexType> vertices;   // 4 per visible character.
+    };
+
+public:
+    TextClass();
+    TextClass(const TextClass&);
+    ~TextClass();
+
+    bool Initialize(ID3D11Device* device, DynamicRingBufferClass* vertexRing, FontClass* font, int screenWidth, int screenHeight, int maxCharacters);
+    void Shutdown();
+    void SetStateCache(RenderStateCacheClass* stateCache);
+
+    int AddString();
+    void SetString(int id, const char* text, int x, int y);
+    bool Render(ID3D11DeviceContext* deviceContext, ShaderClass* shader, XMMATRIX worldMatrix, XMMATRIX viewMatrix, XMMATRIX orthoMatrix);
+
+    int GetCharacterCount();
+    int GetLayoutCount();
+
+private:
+    bool InitializeBuffers(ID3D11Device* device);
+    void ShutdownBuffers();
+
+    void BuildString(StringType& string);
+
+private:
+    DynamicRingBufferClass* m_VertexRing;
+    RenderStateCacheClass* m_StateCache;
+    FontClass* m_Font;
+    ID3D11Buffer* m_indexBuffer;
+    int m_screenWidth, m_screenHeight, m_maxCharacters;
+
+    std::vector<StringType> m_strings;
+    bool m_dirty;
+    unsigned int m_vertexOffset, m_vertexRingWrap;
+    int m_characterCount;
+    int m_layoutCount;                  // Strings laid out again since Initialize, for the statistics.
+};
+
+#endif
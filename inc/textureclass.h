@@ -5,9 +5,13 @@
 // INCLUDES
 #include <d3d11.h>
 #include <stdio.h>
+#include <string>
+
+#include "mipgeneratorclass.h"
+#include "texturestreamerclass.h"
 
 // Class name: TextureClass
-class TextureClass
+class TextureClass : public StreamedTextureClass
 {
 private:
     struct TargaHeader
@@ -25,21 +29,44 @@ public:
     ~TextureClass();
 
     bool Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext, char* filename);
+    bool InitializeArray(ID3D11Device* device, ID3D11DeviceContext* deviceContext, char** filenames, int count);
+    bool InitializeStreaming(ID3D11Device* device, ID3D11DeviceContext* deviceContext, char* filename, TextureStreamerClass* streamer);
     void Shutdown();
 
     ID3D11ShaderResourceView* GetTexture();
 
     int GetWidth();
     int GetHeight();
+    int GetArraySize();
+
+    // Mip residency, used by the TextureStreamerClass. Non streamed textures always have every mip resident.
+    int GetMipCount();
+    int GetResidentMip();
+    unsigned long long GetMipBytes(int mip);
+    unsigned long long GetResidentBytes();
+    bool SetResidentMip(int mip);
 
 private:
     bool LoadTarga32Bit(char*);
+    bool CreateTexture(ID3D11Device* device, const MipChain* chains, int arraySize, bool arrayView);
+    bool WriteStreamedMips(const MipChain& chain, int initialMip);
+    bool ReadStreamedMips(int first, int last, MipChain& chain);
+    bool CreateResidentTexture(int mip, const MipChain* chain);
+    static void GetMipGeneratorConfig(MipGeneratorConfig& config);
 
 private:
     unsigned char* m_targaData;
     ID3D11Texture2D* m_texture;
     ID3D11ShaderResourceView* m_textureView;
-    int m_width, m_height;
+    int m_width, m_height, m_arraySize;
+
+    // Streaming state: the finer mips are streamed in from a file of their own, written when the texture is loaded.
+    std::string m_mipFilename;
+    TextureStreamerClass* m_streamer;
+    ID3D11Device* m_device;
+    ID3D11DeviceContext* m_deviceContext;
+    int m_mipCount, m_residentMip;
+    unsigned long long m_residentBytes;
 };
 
 #endif
\ No newline at end of file
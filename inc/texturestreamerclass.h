@@ -0,0 +1,94 @@
+// Filename: texturestreamerclass.h
+#ifndef _TEXTURESTREAMERCLASS_H_
+#define _TEXTURESTREAMERCLASS_H_
+
+// INCLUDES
+#include <vector>
+
+#define TEXTURE_STREAMER_NO_MIP 15      // Required mip of a texture not seen on screen, past every chain (D3D11_REQ_MIP_LEVELS).
+
+typedef struct TextureStreamerConfig {
+    unsigned long long budgetBytes = 256ull * 1024 * 1024;        // Video memory all streamed textures may use together.
+    unsigned long long uploadBytesPerFrame = 4ull * 1024 * 1024;  // Limit on the data streamed in during one frame.
+    int initialResidentSize = 64;       // On load only the mips with width and height <= this size are resident.
+    unsigned int requestTimeoutFrames = 60;   // A texture not requested for this many frames falls back to its initial mips.
+    const char* mipDirectory = nullptr; // Where the textures keep their finer mips to stream in from, the run directory when null.
+} TextureStreamerConfig;
+
+// Class name: StreamedTextureClass
+// What the streamer needs of a texture: the size of its mips and a way to change its most detailed resident mip.
+// TextureClass implements it with Direct3D textures, the texture streaming benchmark (bench/) with byte counts only.
+class StreamedTextureClass
+{
+public:
+    virtual ~StreamedTextureClass() {}
+
+    virtual int GetWidth() = 0;
+    virtual int GetHeight() = 0;
+    virtual int GetResidentMip() = 0;
+    virtual unsigned long long GetMipBytes(int mip) = 0;
+    virtual unsigned long long GetResidentBytes() = 0;
+    virtual bool SetResidentMip(int mip) = 0;
+};
+
+// Class name: TextureStreamerClass
+// Manages the mip residency of the streamed TextureClass objects. A streamed texture first only has its low
+// resolution mips on the GPU. Each frame the renderer reports, from the projected on screen size of the objects
+// using the texture, the most detailed mip it actually needs (RequestMip). Update then plans finer mips one level at a
+// time and, when the resident total goes over the byte budget, evicts the finest mips of the textures that need them
+// the least. Textures are never dropped below their initial low resolution mips. The plan is applied at the end of
+// Update with one SetResidentMip per texture at most, so a texture streaming several levels in loads them together.
+//
+// Mips nobody wants any more stay resident while the budget allows it. When a wanted mip does not fit, StreamIn makes
+// room for it: first from the textures holding more than they want, then from the ones requested longer ago than the
+// texture streaming in. Textures requested as recently are never evicted for each other, so they cannot thrash.
+class TextureStreamerClass
+{
+private:
+    struct StreamEntry
+    {
+        StreamedTextureClass* texture;
+        int requestedMip;           // Most detailed mip requested during the current frame (-1 = no request).
+        int wantedMip;              // Most detailed mip the texture should have resident.
+        int minimumMip;             // The low resolution mips loaded at initialization, always resident.
+        int plannedMip;             // Most detailed mip resident once the current Update is applied.
+        unsigned int lastRequestFrame;
+    };
+
+public:
+    TextureStreamerClass();
+    TextureStreamerClass(const TextureStreamerClass&);
+    ~TextureStreamerClass();
+
+    bool Initialize(const TextureStreamerConfig& config);
+    void Shutdown();
+
+    void Register(StreamedTextureClass* texture, int minimumMip);
+    void Unregister(StreamedTextureClass* texture);
+
+    void RequestMip(StreamedTextureClass* texture, int mip);
+    void RequestProjectedSize(StreamedTextureClass* texture, float projectedWidth, float projectedHeight);
+    bool Update();
+
+    int GetInitialResidentSize();
+    const char* GetMipDirectory();
+    unsigned long long GetResidentBytes();
+    unsigned long long GetBudgetBytes();
+
+    static int ComputeRequiredMip(int textureWidth, int textureHeight, float projectedWidth, float projectedHeight);
+    static float ComputeProjectedSize(float radius, float distance, float projectionScaleY, int screenHeight);
+
+private:
+    StreamEntry* FindEntry(StreamedTextureClass* texture);
+    StreamEntry* FindVictim(const StreamEntry* candidate);
+    unsigned long long GetPlannedBytes(const StreamEntry& entry);
+    void EvictOverBudget(unsigned long long& residentBytes);
+    void StreamIn(unsigned long long& residentBytes);
+
+private:
+    TextureStreamerConfig m_config;
+    std::vector<StreamEntry> m_entries;
+    unsigned int m_frame;
+};
+
+#endif
@@ -5,11 +5,15 @@
 // GLOBALS - These globals in the shader can be modified externally from your C++ code.
 // Put most globals in buffer object types called "cbuffer" even if it is just a single global variable.
 // Logically organizing these buffers is important for efficient execution of shaders as well as how the graphics card will store the buffers.
-cbuffer MatrixBuffer
+// The buffers are split by how often they change: the view and projection once per frame, the world matrix per object.
+cbuffer FrameBuffer : register(b0)
+{
+    matrix viewProjectionMatrix;
+};
+
+cbuffer ObjectBuffer : register(b1)
 {
     matrix worldMatrix;
-    matrix viewMatrix;
-    matrix projectionMatrix;
 };
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -20,6 +24,17 @@ struct VertexInputType
     float4 color : COLOR;
 };
 
+// Instanced drawing: the world matrix comes from the per-instance stream (one row per WORLDn element).
+struct InstancedVertexInputType
+{
+    float4 position : POSITION;
+    float4 color : COLOR;
+    float4 world0 : WORLD0;
+    float4 world1 : WORLD1;
+    float4 world2 : WORLD2;
+    float4 world3 : WORLD3;
+};
+
 struct PixelInputType
 {
     float4 position : SV_POSITION;
@@ -39,14 +54,29 @@ PixelInputType ColorVertexShader(VertexInputType input)
     // Change the position vector to be 4 units for proper matrix calculations.
     input.position.w = 1.0f;
 
-    // Calculate the position of the vertex against the world, view, and projection matrices.
+    // Calculate the position of the vertex against the world and the combined view-projection matrices.
     output.position = mul(input.position, worldMatrix);
-    output.position = mul(output.position, viewMatrix);
-    output.position = mul(output.position, projectionMatrix);
+    output.position = mul(output.position, viewProjectionMatrix);
 
     // Store the input color for the pixel shader to use.
     output.color = input.color;
 
     return output;
 }
+
+PixelInputType ColorVertexShaderInstanced(InstancedVertexInputType input)
+{
+    PixelInputType output;
+    matrix world = float4x4(input.world0, input.world1, input.world2, input.world3);
+
+    input.position.w = 1.0f;
+
+    // Same as above, with the world matrix of the instance.
+    output.position = mul(input.position, world);
+    output.position = mul(output.position, viewProjectionMatrix);
+
+    output.color = input.color;
+
+    return output;
+}
 // --------------------------------------------------------------------------------------------------------------------
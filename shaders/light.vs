@@ -3,27 +3,53 @@
 // DEFINES
 #define MAX_DIFFUSE_LIGHTS 4
 
+// Shader permutation defines, the same as light.ps (ShaderClass compiles both with the same D3D_SHADER_MACRO list so
+// the interpolators of the variant match).
+#ifndef USE_TEXTURE
+#define USE_TEXTURE 1
+#endif
+#ifndef USE_AMBIENT_LIGHT
+#define USE_AMBIENT_LIGHT 1
+#endif
+#ifndef USE_DIFFUSE_LIGHT
+#define USE_DIFFUSE_LIGHT 1
+#endif
+#ifndef USE_SPECULAR_LIGHT
+#define USE_SPECULAR_LIGHT 1
+#endif
+#ifndef NUM_DIFFUSE_LIGHTS
+#define NUM_DIFFUSE_LIGHTS MAX_DIFFUSE_LIGHTS
+#endif
+#ifndef USE_CLUSTERED_LIGHTS
+#define USE_CLUSTERED_LIGHTS 0
+#endif
+
+#define USE_LIGHT_DIRECTIONS ((USE_DIFFUSE_LIGHT || USE_SPECULAR_LIGHT) && (NUM_DIFFUSE_LIGHTS > 0))
+
 // GLOBALS
-cbuffer MatrixBuffer
+// The registers are explicit since a variant may not use all the buffers and the unused ones must not shift the others.
+// The buffers are split by how often they change: per frame (view-projection, lights and camera) and per object (world).
+cbuffer FrameBuffer : register(b0)
+{
+    matrix viewProjectionMatrix;
+};
+
+cbuffer ObjectBuffer : register(b1)
 {
     matrix worldMatrix;
-    matrix viewMatrix;
-    matrix projectionMatrix;
 };
 
-cbuffer LightDiffuseParamBuffer
+cbuffer LightBuffer : register(b2)
 {
     float4 diffuseLightPosDir[MAX_DIFFUSE_LIGHTS];
     float4 diffuseColor[MAX_DIFFUSE_LIGHTS];
+    float4 ambientColor;
+    float4 specularColor;
+    float3 cameraPosition;
+    float specularPower;
     unsigned int numDiffuseLights;
     unsigned int isDiffuseLightPos;
-    float2 paddingLDB;
-};
-
-cbuffer CameraBuffer
-{
-    float3 cameraPosition;
-    unsigned int calcViewDirection;
+    float2 paddingLB;
 };
 
 // TYPEDEFS
@@ -36,18 +62,42 @@ struct VertexInputType
     float3 normal : NORMAL;
 };
 
+// Instanced drawing: the world matrix comes from the per-instance stream (one row per WORLDn element) instead of the
+// ObjectBuffer, so every copy of the model can have its own transform within a single draw call.
+struct InstancedVertexInputType
+{
+    float4 position : POSITION;
+    float4 color : COLOR;
+    float2 tex : TEXCOORD0;
+    float3 normal : NORMAL;
+    float4 world0 : WORLD0;
+    float4 world1 : WORLD1;
+    float4 world2 : WORLD2;
+    float4 world3 : WORLD3;
+};
+
 struct PixelInputType
 {
     float4 position : SV_POSITION;
+#if !USE_TEXTURE
     float4 color : COLOR;
+#endif
     float2 tex : TEXCOORD0;
     float3 normal : NORMAL;
+#if USE_SPECULAR_LIGHT
     float3 viewDirection : TEXCOORD1;
-    float3 diffuseLightDir[MAX_DIFFUSE_LIGHTS] : TEXCOORD2;
+#endif
+#if USE_LIGHT_DIRECTIONS
+    float3 diffuseLightDir[NUM_DIFFUSE_LIGHTS] : TEXCOORD2;
+#endif
+#if USE_CLUSTERED_LIGHTS
+    float4 worldPosition : TEXCOORD6;
+#endif
 };
 
 // Vertex Shader
-PixelInputType LightVertexShader(VertexInputType input)
+// The lighting setup is shared by the regular and the instanced entry points, only the source of the world matrix differs.
+PixelInputType LightVertex(VertexInputType input, matrix world)
 {
     unsigned int i;
     PixelInputType output;
@@ -56,13 +106,14 @@ PixelInputType LightVertexShader(VertexInputType input)
     // Change the position vector to be 4 units for proper matrix calculations.
     input.position.w = 1.0f;
 
-    // Calculate the position of the vertex against the world, view, and projection matrices.
-    output.position = mul(input.position, worldMatrix);
-    output.position = mul(output.position, viewMatrix);
-    output.position = mul(output.position, projectionMatrix);
+    // Calculate the position of the vertex against the world and the combined view-projection matrices.
+    output.position = mul(input.position, world);
+    output.position = mul(output.position, viewProjectionMatrix);
 
+#if !USE_TEXTURE
     // Store the input color for the pixel shader to use
     output.color = input.color;
+#endif
 
     // Store the texture coordinates for the pixel shader.
     output.tex = input.tex;
@@ -72,18 +123,26 @@ PixelInputType LightVertexShader(VertexInputType input)
     // being sent as input into the pixel shader.
     // We only calculate against the world matrix as we are just trying to find the lighting values in the 3D world space.
     // Note that sometimes these normals need to be re-normalized inside the pixel shader due to the interpolation that occurs
-    output.normal = mul(input.normal, (float3x3)worldMatrix);
+    output.normal = mul(input.normal, (float3x3)world);
     
     // Normalize the normal vector.
     output.normal = normalize(output.normal);
 
     // Calculate the position of the vertex in the world.
-    worldPosition = mul(input.position, worldMatrix);
+    worldPosition = mul(input.position, world);
+
+#if USE_CLUSTERED_LIGHTS
+    // The clustered lights are lit per pixel from the world position, w carries the view depth (the w of the
+    // perspective projection) the pixel shader needs to find its depth slice.
+    output.worldPosition = float4(worldPosition.xyz, output.position.w);
+#endif
 
     // The position of all the lights in the world in relation to the vertex must be calculated, normalized
     // final directions then sent into the pixel shader
     // The direction of lights is specified then it can be used directly and sent to pixel shader
-    for (i=0; i<numDiffuseLights; i++) {
+#if USE_LIGHT_DIRECTIONS
+    [unroll]
+    for (i=0; i<NUM_DIFFUSE_LIGHTS; i++) {
         if (isDiffuseLightPos) {
             // Determine the light positions based on the position of the lights and the position of the vertex in the world.
             output.diffuseLightDir[i] = diffuseLightPosDir[i].xyz - worldPosition.xyz;
@@ -95,18 +154,36 @@ PixelInputType LightVertexShader(VertexInputType input)
             output.diffuseLightDir[i] = -diffuseLightPosDir[i].xyz;
         }
     }
+#endif
 
     // VideDirection calculations are needed if Specular lighting is used
     // The viewing direction is calculated here in the vertex shader. We calculate the world position of the vertex and
     // subtract that from the camera position to determine where we are viewing the scene from.
     // The final value is normalized and sent into the pixel shader.
-    if (calcViewDirection) {
-        // Determine the viewing direction based on the position of the camera and the position of the vertex in the world.
-        output.viewDirection = cameraPosition.xyz - worldPosition.xyz;
+#if USE_SPECULAR_LIGHT
+    // Determine the viewing direction based on the position of the camera and the position of the vertex in the world.
+    output.viewDirection = cameraPosition.xyz - worldPosition.xyz;
 
-        // Normalize the viewing direction vector.
-        output.viewDirection = normalize(output.viewDirection);
-    }
+    // Normalize the viewing direction vector.
+    output.viewDirection = normalize(output.viewDirection);
+#endif
 
     return output;
-}
\ No newline at end of file
+}
+
+PixelInputType LightVertexShader(VertexInputType input)
+{
+    return LightVertex(input, worldMatrix);
+}
+
+PixelInputType LightVertexShaderInstanced(InstancedVertexInputType input)
+{
+    VertexInputType vertex;
+
+    vertex.position = input.position;
+    vertex.color = input.color;
+    vertex.tex = input.tex;
+    vertex.normal = input.normal;
+
+    return LightVertex(vertex, float4x4(input.world0, input.world1, input.world2, input.world3));
+}
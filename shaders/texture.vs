@@ -2,11 +2,15 @@
 // #pragma enable_d3d11_debug_symbols
 
 // GLOBALS
-cbuffer MatrixBuffer
+// The buffers are split by how often they change: the view and projection once per frame, the world matrix per object.
+cbuffer FrameBuffer : register(b0)
+{
+    matrix viewProjectionMatrix;
+};
+
+cbuffer ObjectBuffer : register(b1)
 {
     matrix worldMatrix;
-    matrix viewMatrix;
-    matrix projectionMatrix;
 };
 
 // TYPEDEFS
@@ -16,6 +20,17 @@ struct VertexInputType
     float2 tex : TEXCOORD0;
 };
 
+// Instanced drawing: the world matrix comes from the per-instance stream (one row per WORLDn element).
+struct InstancedVertexInputType
+{
+    float4 position : POSITION;
+    float2 tex : TEXCOORD0;
+    float4 world0 : WORLD0;
+    float4 world1 : WORLD1;
+    float4 world2 : WORLD2;
+    float4 world3 : WORLD3;
+};
+
 struct PixelInputType
 {
     float4 position : SV_POSITION;
@@ -30,13 +45,28 @@ PixelInputType TextureVertexShader(VertexInputType input)
     // Change the position vector to be 4 units for proper matrix calculations.
     input.position.w = 1.0f;
 
-    // Calculate the position of the vertex against the world, view, and projection matrices.
+    // Calculate the position of the vertex against the world and the combined view-projection matrices.
     output.position = mul(input.position, worldMatrix);
-    output.position = mul(output.position, viewMatrix);
-    output.position = mul(output.position, projectionMatrix);
+    output.position = mul(output.position, viewProjectionMatrix);
 
     // Store the texture coordinates for the pixel shader.
     output.tex = input.tex;
 
     return output;
-}
\ No newline at end of file
+}
+
+PixelInputType TextureVertexShaderInstanced(InstancedVertexInputType input)
+{
+    PixelInputType output;
+    matrix world = float4x4(input.world0, input.world1, input.world2, input.world3);
+
+    input.position.w = 1.0f;
+
+    // Same as above, with the world matrix of the instance.
+    output.position = mul(input.position, world);
+    output.position = mul(output.position, viewProjectionMatrix);
+
+    output.tex = input.tex;
+
+    return output;
+}
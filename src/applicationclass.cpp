@@ -1,4 +1,5 @@
 #include "applicationclass.h"
+#include "rtparallel.h"
 
 // --------------------------------------------------------------------------------------------------------------------
 ApplicationClass::ApplicationClass()
@@ -7,9 +8,48 @@ ApplicationClass::ApplicationClass()
     m_Camera = nullptr;
     m_Model = nullptr;
     m_Shader = nullptr;
+    m_ShaderCache = nullptr;
+    m_ShaderWatcher = nullptr;
     m_Bitmap = nullptr;
-    m_Lights = nullptr;
-    m_Timer = nullptr;
+    m_TextureStreamer = nullptr;
+    m_SpriteBatch = nullptr;
+    m_SpriteAnimation = nullptr;
+    m_InstanceBuffer = nullptr;
+    m_VertexRing = nullptr;
+    m_TextShader = nullptr;
+    m_Font = nullptr;
+    m_Text = nullptr;
+    m_ClusteredLighting = nullptr;
+    m_CommandRecorder = nullptr;
+    m_SceneFile = nullptr;
+    m_Entities = nullptr;
+    m_Occlusion = nullptr;
+    m_BoundsTree = nullptr;
+    m_Pipeline = nullptr;
+    for (auto& state : m_FrameStates) {
+        state.steps = 0;
+        state.stepTime = state.frameTime = state.interpolation = 0.0f;
+        state.modelDepth = 0.0f;
+        state.renderQueue = nullptr;
+        state.bitmapFrame = 0;
+        state.occluderTriangles = state.treeNodes = 0;
+    }
+    m_hudFpsString = 0;
+    m_hudStatsString = 0;
+    m_hudShaderString = 0;
+    m_hudFrameCount = 0;
+    m_hudMapCount = 0;
+    m_hudBindCount = 0;
+    m_hudSkippedBindCount = 0;
+    m_hudTime = 0.0f;
+    m_rotation = 0.0f;
+    m_previousRotation = 0.0f;
+    m_pendingSteps = 0;
+    m_stepTime = 0.0f;
+    m_SpriteTextures = nullptr;
+    m_spriteTextureCount = 0;
+    m_screenWidth = 0;
+    m_screenHeight = 0;
     m_numDiffuseLights = 0;
     m_isDiffuseLightPosGiven = false;
 }
@@ -31,194 +71,744 @@ ApplicationClass::~ApplicationClass()
 bool ApplicationClass::Initialize(int screenWidth, int screenHeight, HWND hwnd, ApplicationConfig& config)
 {
     bool result;
-    char modelFilename[128];
-    char textureFilename[128];
-    char bitmapFilename[128];
-    bool useTexture = false;
-    bool useAmbient = false;
-    bool useDiffuse = false;
-    bool useSpecular = false;
-    bool useLighting = false;
-    bool useGeoRendering = false;
-    bool use2DRendering = false;
-    bool useSpriteAnimation = false;
+    char sceneFilename[MAX_PATH];
+    char message[MAX_PATH + 64];
+    bool useHud;
 
     // Appliction configuaration paramaters
     m_Config = config;
+    m_screenWidth = screenWidth;
+    m_screenHeight = screenHeight;
+
+    // The test is described by its scene file, unless another scene file is given on the command line.
+    sprintf(sceneFilename, SCENE_FILE_FORMAT, (int)RTArgs.test);
+    if (RTArgs.scene[0] != 0) { strcpy(sceneFilename, RTArgs.scene); }
+
+    m_SceneFile = new SceneFileClass;
+    result = m_SceneFile->Initialize(sceneFilename);
+    if (!result) {
+        sprintf(message, "Could not load the scene file %s (line %d).", sceneFilename, m_SceneFile->GetErrorLine());
+        SHOW_MSG_AND_RETURN(message, "Error");
+    }
+    const SceneDescType& scene = m_SceneFile->GetScene();
 
-    // Initilize variable
-    strcpy(modelFilename, "");
-    strcpy(textureFilename, "");
+    // The HUD shows the frame statistics, a scene can also turn it on for itself.
+    useHud = scene.hud || (RTArgs.hud != 0);
+    if (scene.useTimer || useHud) { m_Config.useTimer = true; }
 
     // Step 1: Create the direct3d object. -------------------------------------------------------------------------------
     m_Direct3D = new D3DClass();
     result = m_Direct3D->Initialize(screenWidth, screenHeight, VSYNC_ENABLED, hwnd, FULL_SCREEN, SCREEN_DEPTH, SCREEN_NEAR);
     if (!result) { SHOW_MSG_AND_RETURN("Could not initialize Direct3D", "Error"); }
-    if (CHECK_RT_TEST_NUM(3)) { return true; }
+    if (scene.clearOnly) { return true; }
 
     // Step 2: Create the camera object. ---------------------------------------------------------------------------------
     m_Camera = new CameraClass;
+    m_Camera->SetPosition(scene.cameraPosition[0], scene.cameraPosition[1], scene.cameraPosition[2]);
+    m_Camera->SetRotation(scene.cameraRotation[0], scene.cameraRotation[1], scene.cameraRotation[2]);
 
-    // Set the initial position of the camera.
-    m_Camera->SetPosition(0.0f, 0.0f, -5.0f);
-    if (CHECK_RT_TEST_NUM(8) || CHECK_RT_TEST_NUM(9) || CHECK_RT_TEST_NUM(12)) {
-        // Move the camera back another 5 units so that we can see both cubes easily.
-        m_Camera->SetPosition(0.0f, 0.0f, -10.0f);
-    }
-    if (CHECK_RT_TEST_NUM(11)) {
-        m_Camera->SetPosition(0.0f, 2.0f, -12.0f);
-    }
+    // Step 2-b: Create the texture streamer, the model textures only keep the mips they need resident within the budget.
+    TextureStreamerConfig streamerConfig;
+    streamerConfig.budgetBytes = (unsigned long long)RTArgs.texBudget * 1024 * 1024;
+    streamerConfig.mipDirectory = TEXTURE_MIP_DIRECTORY;
+    m_TextureStreamer = new TextureStreamerClass;
+    result = m_TextureStreamer->Initialize(streamerConfig);
+    if (!result) { SHOW_MSG_AND_RETURN("Could not initialize the texture streamer.", "Error"); }
 
     // Step 3: Create and initialize the model object. -------------------------------------------------------------------
-    // Set the file name of the model.
+    // Without a model file the geometry is crafted in code. The model has normals when a diffuse light shades it.
     m_Model = new ModelClass;
+    m_Model->SetStateCache(m_Direct3D->GetStateCache());
 
-    // Set the name of the model and texture file that we will be loading.
-    if (CHECK_RT_TEST_NUM(7) || CHECK_RT_TEST_NUM(8) || CHECK_RT_TEST_NUM(9)) { strcpy(modelFilename, "../data/models/cube.txt"); }
-    if (CHECK_RT_TEST_NUM(10)) { strcpy(modelFilename, "../data/models/sphere.txt"); }
-    if (CHECK_RT_TEST_NUM(11)) { strcpy(modelFilename, "../data/models/plane.txt"); }
+    CraftModel craftModels[] = { TRI_RED, TRI_REDINC, TRI_FULLCOL };
+    result = m_Model->Initialize(m_Direct3D->GetDevice(), m_Direct3D->GetDeviceContext(), craftModels[scene.craft], (char*)scene.model,
+                                 (char*)scene.texture, scene.useDiffuse, m_TextureStreamer);
+    if (!result) { SHOW_MSG_AND_RETURN("Could not initialize the model object.", "Error"); }
+
+    // Step 3-b: Create the per-instance stream of the model world matrices.
+    if (scene.instancing) {
+        if ((int)scene.objects.size() > MAX_MODEL_INSTANCES) { SHOW_MSG_AND_RETURN("Too many objects to draw instanced.", "Error"); }
 
-    if (CHECK_RT_TEST_NUM(5) || CHECK_RT_TEST_NUM(6) || CHECK_RT_TEST_NUM(7) || CHECK_RT_TEST_NUM(8) || CHECK_RT_TEST_NUM(9) || CHECK_RT_TEST_NUM(10) || CHECK_RT_TEST_NUM(11) ||
-        CHECK_RT_TEST_NUM(12) || CHECK_RT_TEST_NUM(13)) {
-        useTexture = true;
-        if (CHECK_RT_TEST_NUM(12)) { strcpy(bitmapFilename, "../data/textures/stone01.tga"); }
-        else if (CHECK_RT_TEST_NUM(13)) { strcpy(bitmapFilename, "../data/textures/sprite_data_01.txt"); }
-        else { strcpy(textureFilename, "../data/textures/stone01.tga"); }
+        m_InstanceBuffer = new InstanceBufferClass;
+        m_InstanceBuffer->SetStateCache(m_Direct3D->GetStateCache());
+        result = m_InstanceBuffer->Initialize(m_Direct3D->GetDevice(), MAX_MODEL_INSTANCES);
+        if (!result) { SHOW_MSG_AND_RETURN("Could not initialize the instance buffer.", "Error"); }
     }
 
-    if (CHECK_RT_TEST_NUM(6) || CHECK_RT_TEST_NUM(7) || CHECK_RT_TEST_NUM(8) || CHECK_RT_TEST_NUM(9) || CHECK_RT_TEST_NUM(10) || CHECK_RT_TEST_NUM(11)) { useAmbient = true; useDiffuse = true; }
-    if (CHECK_RT_TEST_NUM(10)) { useAmbient = true;  useSpecular = true; }
+    // Step 4: Create and initialize the shader object.
+    // The compiled shaders are cached on disk, only the shaders that changed since the last launch get compiled.
+    m_ShaderCache = new ShaderCacheClass;
+    result = m_ShaderCache->Initialize(SHADER_CACHE_DIRECTORY, D3D_COMPILER_VERSION);
+    if (!result) { SHOW_MSG_AND_RETURN("Could not initialize the shader cache.", "Error"); }
 
-    if (CHECK_RT_TEST_NUM(12)  || CHECK_RT_TEST_NUM(13)) {
-        useGeoRendering = false; use2DRendering = true;
-        if (CHECK_RT_TEST_NUM(13)) { m_Config.useTimer = true; useSpriteAnimation = true; }
+    m_Shader = new ShaderClass;
+    m_Shader->SetShaderCache(m_ShaderCache);
+    m_Shader->SetStateCache(m_Direct3D->GetStateCache());
+
+    // The number of diffuse lights is compiled in the light shader, so it is decided before the shader is created.
+    // With clustered lighting all the lights are clustered point lights, there may be no classic diffuse light.
+    m_numDiffuseLights = (int)scene.lights.size();
+    if (scene.clusteredLights) { m_Shader->SetClusteredLighting(true); }
+
+    // The animated sprite keeps all its frames in one texture array and uses the texture array shader.
+    // The copies of the model of an instancing scene are drawn with instancing.
+    result = m_Shader->Initialize(m_Direct3D->GetDevice(), hwnd, scene.useTexture, scene.spriteAnimation, scene.instancing, scene.useAmbient,
+                                  scene.useDiffuse, scene.useSpecular, m_numDiffuseLights);
+    if (!result) { SHOW_MSG_AND_RETURN("Could not initialize the shader object.", "Error"); }
+
+    // Edited shader files are recompiled in the background and swapped in between two frames.
+    if (RTArgs.hotReload) {
+        m_ShaderWatcher = new ShaderWatcherClass;
+        result = m_ShaderWatcher->Initialize(SHADER_SOURCE_DIRECTORY);
+        if (!result) { SHOW_MSG_AND_RETURN("Could not watch the shader directory.", "Error"); }
     }
 
-    CraftModel craftModel = TRI_FULLCOL;
-    if (CHECK_RT_TEST_NUM(1)) { craftModel = TRI_RED; }
-    if (CHECK_RT_TEST_NUM(2)) { craftModel = TRI_REDINC; }
-    result = m_Model->Initialize(m_Direct3D->GetDevice(), m_Direct3D->GetDeviceContext(), craftModel, modelFilename, textureFilename, useDiffuse);
-    if (!result) { SHOW_MSG_AND_RETURN("Could not initialize the model object.", "Error"); }
+    // Step 5: Create the entities of the scene, its objects and its diffuse lights. -----------------------------------
+    m_isDiffuseLightPosGiven = !scene.lights.empty() && scene.lights[0].positional;
+    result = InitializeEntities();
+    if (!result) { SHOW_MSG_AND_RETURN("Could not initialize the entities of the scene.", "Error"); }
 
-    // Step 4: Create and initialize the shader object.
-    m_Shader = new ShaderClass;
+    // Step 5-b: Create the clustered point lights and their binning. ---------------------------------------------------
+    if (scene.clusteredLights) {
+        result = InitializeClusteredLights(screenWidth, screenHeight);
+        if (!result) { SHOW_MSG_AND_RETURN("Could not initialize the clustered lighting.", "Error"); }
+    }
 
-    result = m_Shader->Initialize(m_Direct3D->GetDevice(), hwnd, useTexture, useAmbient, useDiffuse, useSpecular);
-    if (!result) { SHOW_MSG_AND_RETURN("Could not initialize the shader object.", "Error"); }
+    // Step 5-c: Create the deferred contexts the copies of the model are recorded on. ---------------------------------
+    if (scene.deferred) {
+        result = InitializeDeferredScene(hwnd, scene.useTexture, scene.useAmbient, scene.useDiffuse, scene.useSpecular);
+        if (!result) { SHOW_MSG_AND_RETURN("Could not initialize the deferred contexts.", "Error"); }
+    }
 
-    // Step 5: Create and initialize the light object. -------------------------------------------------------------------
-    useLighting = useAmbient || useDiffuse || useSpecular;
-    m_numDiffuseLights = 0;
-    if (useLighting) {
-        // The color of the light is set to white and the light direction is set to point down the positive Z axis.
-        m_numDiffuseLights = 1; m_isDiffuseLightPosGiven = false;
-        if (CHECK_RT_TEST_NUM(11)) { m_numDiffuseLights = 4; }
-
-        // Create and initialize the light objects array.
-        m_Lights = new LightClass[m_numDiffuseLights];
-
-        // Set Ambient light properties - color
-        m_Lights[0].SetAmbientColor(0.0f, 0.0f, 0.0f, 1.0f);
-        if (useAmbient) {
-            m_Lights[0].SetAmbientColor(0.15f, 0.15f, 0.15f, 1.0f);
-        }
+    // Step 6: Create and initialize the bitmap object needed for 2D rendering. ------------------------------------------
+    // All the 2D geometry (bitmaps, sprites and the HUD text) is written every frame in one shared dynamic ring buffer.
+    if (scene.use2D || useHud) {
+        m_VertexRing = new DynamicRingBufferClass;
+        result = m_VertexRing->Initialize(m_Direct3D->GetDevice(), VERTEX_RING_SIZE, D3D11_BIND_VERTEX_BUFFER);
+        if (!result) { SHOW_MSG_AND_RETURN("Could not initialize the vertex ring buffer.", "Error"); }
+    }
 
-        // Set Diffuse light properties - color, direction and/or posotion (for all lights used in a test)
-        m_Lights[0].SetDiffuseColor(1.0f, 1.0f, 1.0f, 1.0f);
-        m_Lights[0].SetDirection(0.0f, 0.0f, 1.0f);
-        if (CHECK_RT_TEST_NUM(9)) {
-            m_Lights[0].SetDirection(1.0f, 0.0f, 0.0f);
-        }
-        if (CHECK_RT_TEST_NUM(10)) {
-            m_Lights[0].SetDirection(1.0f, 0.0f, 1.0f);
-        }
-        if (CHECK_RT_TEST_NUM(11)) {
-            m_isDiffuseLightPosGiven = true;
+    if (scene.spriteStress) {
+        result = InitializeSpriteStress(screenWidth, screenHeight);
+        if (!result) { SHOW_MSG_AND_RETURN("Could not initialize the sprite batch.", "Error"); }
+    }
+    else if (scene.use2D) {
+        m_Bitmap = new BitmapClass;
+        m_Bitmap->SetStateCache(m_Direct3D->GetStateCache());
 
-            // Manually set the color and position of each light.
-            m_Lights[0].SetDiffuseColor(1.0f, 0.0f, 0.0f, 1.0f);  // Red
-            m_Lights[0].SetPosition(-3.0f, 1.0f, 3.0f);
+        result = m_Bitmap->Initialize(m_Direct3D->GetDevice(), m_Direct3D->GetDeviceContext(), screenWidth, screenHeight, scene.spriteAnimation, (char*)scene.bitmap, 50, 50,
+                                     m_VertexRing);
+        if (!result) { SHOW_MSG_AND_RETURN("Could not initialize the bitmap object.", "Error"); }
+    }
 
-            m_Lights[1].SetDiffuseColor(0.0f, 1.0f, 0.0f, 1.0f);  // Green
-            m_Lights[1].SetPosition(3.0f, 1.0f, 3.0f);
+    // Step 7: Create the font and the text of the HUD. ------------------------------------------------------------------
+    if (useHud) {
+        result = InitializeHud(hwnd, screenWidth, screenHeight);
+        if (!result) { SHOW_MSG_AND_RETURN("Could not initialize the HUD text.", "Error"); }
+    }
 
-            m_Lights[2].SetDiffuseColor(0.0f, 0.0f, 1.0f, 1.0f);  // Blue
-            m_Lights[2].SetPosition(-3.0f, 1.0f, -3.0f);
+    // Step 8: Create the render queues the draws of a frame are sorted in, one per frame state. ----------------------
+    for (auto& state : m_FrameStates) {
+        state.renderQueue = new RenderQueueClass;
+        result = state.renderQueue->Initialize(SCENE_DRAW_OBJECT + (int)scene.objects.size());
+        if (!result) { SHOW_MSG_AND_RETURN("Could not initialize the render queue.", "Error"); }
+        state.renderQueue->SetDepthRange(SCREEN_NEAR, SCREEN_DEPTH);
+    }
 
-            m_Lights[3].SetDiffuseColor(1.0f, 1.0f, 1.0f, 1.0f);  // White
-            m_Lights[3].SetPosition(3.0f, 1.0f, -3.0f);
-        }
+    // Step 9: Start the simulation thread of the pipelined mode. ------------------------------------------------------
+    if (RTArgs.pipelined) {
+        m_Pipeline = new FramePipelineClass;
+        result = m_Pipeline->Initialize([this](int slot) { Simulate(m_FrameStates[slot]); });
+        if (!result) { SHOW_MSG_AND_RETURN("Could not start the simulation thread.", "Error"); }
+    }
+
+    return true;
+}
+
+// The sprite batch stress test draws SPRITE_STRESS_COUNT small sprites bouncing around the screen, cycling over a few
+// textures so the batch has to sort them into one draw per texture.
+bool ApplicationClass::InitializeSpriteStress(int screenWidth, int screenHeight)
+{
+    bool result;
+    int i;
+    char* textureFilenames[] = { "../data/textures/stone01.tga", "../data/textures/sprite01.tga", "../data/textures/sprite02.tga",
+                                 "../data/textures/sprite03.tga", "../data/textures/sprite04.tga" };
+
+    m_SpriteBatch = new SpriteBatchClass;
+    m_SpriteBatch->SetStateCache(m_Direct3D->GetStateCache());
+    result = m_SpriteBatch->Initialize(m_Direct3D->GetDevice(), m_VertexRing, screenWidth, screenHeight, SPRITE_STRESS_COUNT);
+    if (!result) { return false; }
+
+    m_spriteTextureCount = sizeof(textureFilenames) / sizeof(textureFilenames[0]);
+    m_SpriteTextures = new TextureClass[m_spriteTextureCount];
+    for (i = 0; i < m_spriteTextureCount; i++) {
+        result = m_SpriteTextures[i].Initialize(m_Direct3D->GetDevice(), m_Direct3D->GetDeviceContext(), textureFilenames[i]);
+        if (!result) { return false; }
+    }
+
+    // The sprites cycle through the four sprite textures (the frames of the test 13 sprite), each at its own speed and
+    // starting frame. The stone sprites are a single frame clip.
+    int spriteFrames[] = { 1, 2, 3, 4 };
+    int stoneClip, spriteClip;
+
+    m_SpriteAnimation = new SpriteAnimationClass;
+    result = m_SpriteAnimation->Initialize(SPRITE_STRESS_COUNT);
+    if (!result) { return false; }
+
+    stoneClip = m_SpriteAnimation->AddClip(1, 1.0f, nullptr, nullptr);
+    spriteClip = m_SpriteAnimation->AddClip(4, 0.25f, spriteFrames, nullptr);
+    if ((stoneClip < 0) || (spriteClip < 0)) { return false; }
+
+    // Scatter the sprites over the screen with a random direction and speed (in pixels per second).
+    srand(1234);
+    m_SpriteParticles.resize(SPRITE_STRESS_COUNT);
+    for (auto& particle : m_SpriteParticles) {
+        particle.x = (float)(rand() % screenWidth);
+        particle.y = (float)(rand() % screenHeight);
+        particle.velocityX = (float)((rand() % 401) - 200);
+        particle.velocityY = (float)((rand() % 401) - 200);
+        particle.animation = m_SpriteAnimation->AddAnimation(((rand() % m_spriteTextureCount) == 0) ? stoneClip : spriteClip,
+                                                             (float)(rand() % 1000) * 0.001f, 0.5f + (float)(rand() % 151) * 0.01f);
+    }
+
+    return true;
+}
+
+void ApplicationClass::UpdateSpriteStress(float frameTime)
+{
+    m_SpriteAnimation->Update(frameTime);
+
+    for (auto& particle : m_SpriteParticles) {
+        particle.x += particle.velocityX * frameTime;
+        particle.y += particle.velocityY * frameTime;
+
+        if ((particle.x < 0.0f) || (particle.x > (float)m_screenWidth)) { particle.velocityX = -particle.velocityX; }
+        if ((particle.y < 0.0f) || (particle.y > (float)m_screenHeight)) { particle.velocityY = -particle.velocityY; }
+    }
+
+    return;
+}
+
+// The clustered lighting test scatters CLUSTERED_LIGHT_COUNT small colored point lights over the floor, circling its
+// center at different distances and speeds. The clusters use the projection of D3DClass.
+bool ApplicationClass::InitializeClusteredLights(int screenWidth, int screenHeight)
+{
+    LightBinningConfig binningConfig;
+    bool result;
+    int i;
+
+    m_ClusteredLighting = new ClusteredLightingClass;
+    result = m_ClusteredLighting->Initialize(m_Direct3D->GetDevice(), binningConfig, CLUSTERED_LIGHT_COUNT, screenWidth, screenHeight,
+                                             XM_PIDIV4, SCREEN_NEAR, SCREEN_DEPTH);
+    if (!result) { return false; }
+
+    srand(4321);
+    m_OrbitingLights.resize(CLUSTERED_LIGHT_COUNT);
+    m_ClusterLights.resize(CLUSTERED_LIGHT_COUNT);
+    for (i = 0; i < CLUSTERED_LIGHT_COUNT; i++) {
+        m_OrbitingLights[i].orbitRadius = (float)(rand() % 2000) * 0.01f;
+        m_OrbitingLights[i].height = 0.3f + (float)(rand() % 100) * 0.01f;
+        m_OrbitingLights[i].phase = (float)(rand() % 628) * 0.01f;
+        m_OrbitingLights[i].speed = (float)((rand() % 401) - 200) * 0.01f;
+
+        m_ClusterLights[i].radius = 1.5f + (float)(rand() % 100) * 0.01f;
+        m_ClusterLights[i].color[0] = (float)(rand() % 101) * 0.01f;
+        m_ClusterLights[i].color[1] = (float)(rand() % 101) * 0.01f;
+        m_ClusterLights[i].color[2] = (float)(rand() % 101) * 0.01f;
+        m_ClusterLights[i].color[3] = 1.0f;
+    }
+
+    return true;
+}
+
+// The lights of m_ClusterLights at their place of this rotation.
+void ApplicationClass::UpdateClusteredLights(float rotation, std::vector<ClusterLightType>& lights)
+{
+    float angle;
+    int i;
+
+    lights = m_ClusterLights;
+    for (i = 0; i < CLUSTERED_LIGHT_COUNT; i++) {
+        angle = m_OrbitingLights[i].phase + rotation * m_OrbitingLights[i].speed;
+        lights[i].position[0] = m_OrbitingLights[i].orbitRadius * cosf(angle);
+        lights[i].position[1] = m_OrbitingLights[i].height;
+        lights[i].position[2] = m_OrbitingLights[i].orbitRadius * sinf(angle);
+    }
+
+    return;
+}
+
+// Every object of the scene is an entity: its transform, world matrix, bounding sphere and what it is drawn with, a
+// spin when it turns and the occluder mesh (the model) when it hides what is behind it. The diffuse lights are
+// entities with a light component, in the order of the scene file.
+bool ApplicationClass::InitializeEntities()
+{
+    const SceneDescType& scene = m_SceneFile->GetScene();
+    std::vector<float> positions;
+    unsigned int objectMask, variant, texture;
+    XMFLOAT4 quaternion;
+    EntityId entity;
+    int occluderMesh = -1;
+    bool result;
+
+    m_Entities = new EntityWorldClass;
+    result = m_Entities->Initialize((int)scene.objects.size());
+    if (!result) { return false; }
+
+    m_BoundsTree = new BoundsTreeClass;
+    result = m_BoundsTree->Initialize((int)scene.objects.size());
+    if (!result) { return false; }
+
+    if (scene.useOcclusion) {
+        m_Occlusion = new OcclusionBufferClass;
+        result = m_Occlusion->Initialize(OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT);
+        if (!result) { return false; }
 
-        // Set Ambient light properties - color, power
-        m_Lights[0].SetSpecularColor(0.0f, 0.0f, 0.0f, 1.0f);
-        m_Lights[0].SetSpecularPower(0.0f);
-        if (useSpecular) {
-            m_Lights[0].SetSpecularColor(1.0f, 1.0f, 1.0f, 1.0f);
-            m_Lights[0].SetSpecularPower(32.0f);
+        m_Model->GetTrianglePositions(positions);
+        occluderMesh = m_Occlusion->AddMesh(positions.data(), (int)positions.size() / 3);
+    }
+
+    objectMask = COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_WORLD) | COMPONENT_BIT(COMPONENT_BOUNDS) |
+                 COMPONENT_BIT(COMPONENT_RENDERABLE);
+    variant = m_Shader->GetCurrentVariant();
+    texture = RenderQueueClass::GetResourceId(m_Model->GetTexture());
+
+    for (auto& object : scene.objects) {
+        entity = m_Entities->CreateEntity(objectMask | ((object.spin != 0.0f) ? COMPONENT_BIT(COMPONENT_SPIN) : 0) |
+                                          ((object.occluder && m_Occlusion) ? COMPONENT_BIT(COMPONENT_OCCLUDER) : 0));
+        if (entity == ENTITY_INVALID) { return false; }
+
+        SceneTransformType* transform = m_Entities->Get<SceneTransformType>(entity, COMPONENT_TRANSFORM);
+        XMStoreFloat4(&quaternion, XMQuaternionRotationRollPitchYaw(object.rotation[0], object.rotation[1] + object.phase, object.rotation[2]));
+        memcpy(transform->rotation, &quaternion, sizeof(quaternion));
+        memcpy(transform->translation, object.position, sizeof(object.position));
+        memcpy(transform->scale, object.scale, sizeof(object.scale));
+
+        // The box of the object in the bounds tree is set with its world matrix, by the first update.
+        BoundsComponent* bounds = m_Entities->Get<BoundsComponent>(entity, COMPONENT_BOUNDS);
+        bounds->radius = m_Model->GetBoundingRadius();
+        bounds->proxy = m_BoundsTree->AddObject(object.position, object.position, entity);
+
+        RenderableComponent* renderable = m_Entities->Get<RenderableComponent>(entity, COMPONENT_RENDERABLE);
+        renderable->variant = variant;
+        renderable->texture = texture;
+
+        SpinComponent* spin = m_Entities->Get<SpinComponent>(entity, COMPONENT_SPIN);
+        if (spin) {
+            spin->speed = object.spin;
+            spin->phase = object.phase;
+            spin->pitch = object.rotation[0];
+            spin->yaw = object.rotation[1];
+            spin->roll = object.rotation[2];
         }
+
+        OccluderComponent* occluder = m_Entities->Get<OccluderComponent>(entity, COMPONENT_OCCLUDER);
+        if (occluder) { occluder->mesh = occluderMesh; }
     }
 
-    // Step 6: Create and initialize the bitmap object needed for 2D rendering. ------------------------------------------
-    if (use2DRendering) {
-        m_Bitmap = new BitmapClass;
+    for (auto& sceneLight : scene.lights) {
+        entity = m_Entities->CreateEntity(COMPONENT_BIT(COMPONENT_LIGHT));
+        if (entity == ENTITY_INVALID) { return false; }
 
-        result = m_Bitmap->Initialize(m_Direct3D->GetDevice(), m_Direct3D->GetDeviceContext(), screenWidth, screenHeight, useSpriteAnimation, bitmapFilename, 50, 50);
-        if (!result) { SHOW_MSG_AND_RETURN("Could not initialize the bitmap object.", "Error"); }
+        LightComponent* light = m_Entities->Get<LightComponent>(entity, COMPONENT_LIGHT);
+        memcpy(light->color, sceneLight.color, sizeof(sceneLight.color));
+        memcpy(light->direction, sceneLight.direction, sizeof(sceneLight.direction));
+        memcpy(light->position, sceneLight.position, sizeof(sceneLight.position));
+        light->positional = sceneLight.positional ? 1 : 0;
     }
 
-    // Create and initialize the timer object.
-    if (m_Config.useTimer == true) {
-        m_Timer = new TimerClass;
+    return true;
+}
+
+// Spin the objects that turn, compute their world matrices, refit the bounds tree, cull the objects against the view
+// frustum and the occluders through it and collect the visible ones in the frame state. The objects drawn one by one
+// are queued with their own packet, the instanced and deferred draws queue one packet for all of them in Render.
+void ApplicationClass::UpdateEntities(float rotation, XMMATRIX viewMatrix, XMMATRIX projectionMatrix, FrameStateType& state)
+{
+    SceneMatrixType view, viewProjection;
+    float planes[6][4];
+
+    UpdateSpinSystem(*m_Entities, rotation, true);
+    UpdateTransformSystem(*m_Entities, true);
+    UpdateBoundsTreeSystem(*m_Entities, *m_BoundsTree, true);
+
+    XMStoreFloat4x4((XMFLOAT4X4*)view.m, viewMatrix);
+    XMStoreFloat4x4((XMFLOAT4X4*)viewProjection.m, XMMatrixMultiply(viewMatrix, projectionMatrix));
+    ComputeFrustumPlanes(viewProjection, planes);
+
+    // The occluders are rasterized for this frame's view before the tree is walked, the branches behind them are skipped.
+    if (m_Occlusion) {
+        m_Occlusion->Begin(viewProjection.m);
+        RasterizeOccluderSystem(*m_Entities, *m_Occlusion, true);
+    }
+    UpdateTreeCullingSystem(*m_Entities, *m_BoundsTree, planes, m_Occlusion, m_TreeResults);
+
+    state.visibleWorlds.clear();
+    state.modelDepth = SubmitRenderSystem(*m_Entities, view, SCREEN_DEPTH, (m_InstanceBuffer || m_CommandRecorder) ? nullptr : state.renderQueue,
+                                          SCENE_DRAW_OBJECT, state.visibleWorlds);
+    state.occluderTriangles = m_Occlusion ? m_Occlusion->GetTriangleCount() : 0;
+    state.treeNodes = m_BoundsTree->GetNodeCount();
+
+    return;
+}
+
+// The draw-heavy scenes draw every object with a draw of its own, the objects are cut into one partition per deferred
+// context and the partitions are recorded in parallel. Every partition draws with its own shader object (the same
+// variant, loaded from the shader cache).
+bool ApplicationClass::InitializeDeferredScene(HWND hwnd, bool useTexture, bool useAmbient, bool useDiffuse, bool useSpecular)
+{
+    bool result;
+    int partitionCount;
+
+    partitionCount = (int)RTGetWorkerCount();
+    if (partitionCount > MAX_RECORD_CONTEXTS) { partitionCount = MAX_RECORD_CONTEXTS; }
 
-        result = m_Timer->Initialize();
+    m_CommandRecorder = new CommandRecorderClass;
+    result = m_CommandRecorder->Initialize(m_Direct3D->GetDevice(), partitionCount);
+    if (!result) { return false; }
+
+    m_PartitionShaders.assign(partitionCount, nullptr);
+    for (auto& shader : m_PartitionShaders) {
+        shader = new ShaderClass;
+        shader->SetShaderCache(m_ShaderCache);
+        result = shader->Initialize(m_Direct3D->GetDevice(), hwnd, useTexture, false, false, useAmbient, useDiffuse, useSpecular, m_numDiffuseLights);
         if (!result) { return false; }
     }
 
     return true;
 }
 
+// The HUD has its own texture shader since the scene shader of the test may be a lighting or texture array one.
+bool ApplicationClass::InitializeHud(HWND hwnd, int screenWidth, int screenHeight)
+{
+    bool result;
+    char fontFilename[128];
+
+    strcpy(fontFilename, "../data/fonts/dejavusansmono16.txt");
+
+    m_TextShader = new ShaderClass;
+    m_TextShader->SetShaderCache(m_ShaderCache);
+    m_TextShader->SetStateCache(m_Direct3D->GetStateCache());
+    result = m_TextShader->Initialize(m_Direct3D->GetDevice(), hwnd, true, false, false, false, false, false, 0);
+    if (!result) { return false; }
+
+    m_Font = new FontClass;
+    result = m_Font->Initialize(m_Direct3D->GetDevice(), m_Direct3D->GetDeviceContext(), fontFilename);
+    if (!result) { return false; }
+
+    m_Text = new TextClass;
+    m_Text->SetStateCache(m_Direct3D->GetStateCache());
+    result = m_Text->Initialize(m_Direct3D->GetDevice(), m_VertexRing, m_Font, screenWidth, screenHeight, HUD_MAX_CHARACTERS);
+    if (!result) { return false; }
+
+    m_hudFpsString = m_Text->AddString();
+    m_hudStatsString = m_Text->AddString();
+    m_hudShaderString = m_Text->AddString();
+    m_Text->SetString(m_hudFpsString, "Fps: -", 10, 10);
+
+    return true;
+}
+
+// The counters are averaged over HUD_UPDATE_TIME, so most frames do not change the text and reuse its layout.
+void ApplicationClass::UpdateHud(float frameTime, const FrameStateType& state)
+{
+    char text[128];
+
+    // Constant buffer writes of the previous frame, all the shader objects together.
+    m_hudMapCount += m_Shader->GetMapCount() + m_TextShader->GetMapCount();
+    m_Shader->ResetMapCount();
+    m_TextShader->ResetMapCount();
+    for (auto shader : m_PartitionShaders) {
+        m_hudMapCount += shader->GetMapCount();
+        shader->ResetMapCount();
+    }
+
+    // Binds of the previous frame passed on to the context / dropped by the state cache.
+    m_hudBindCount += m_Direct3D->GetStateCache()->GetIssuedCount();
+    m_hudSkippedBindCount += m_Direct3D->GetStateCache()->GetSkippedCount();
+    m_Direct3D->GetStateCache()->ResetCounters();
+
+    m_hudFrameCount++;
+    m_hudTime += frameTime;
+    if (m_hudTime < HUD_UPDATE_TIME) { return; }
+
+    sprintf(text, "Fps: %d  Frame: %.2f ms", (int)((float)m_hudFrameCount / m_hudTime + 0.5f), (m_hudTime * 1000.0f) / (float)m_hudFrameCount);
+    m_Text->SetString(m_hudFpsString, text, 10, 10);
+
+    if (m_SpriteBatch) {
+        sprintf(text, "Sprites: %d  Draws: %d", m_SpriteBatch->GetSpriteCount(), m_SpriteBatch->GetDrawCount());
+        m_Text->SetString(m_hudStatsString, text, 10, 10 + m_Font->GetLineHeight());
+    }
+    else if (m_ClusteredLighting) {
+        sprintf(text, "Lights: %d  Light indices: %d", m_ClusteredLighting->GetLightCount(), m_ClusteredLighting->GetLightIndexCount());
+        m_Text->SetString(m_hudStatsString, text, 10, 10 + m_Font->GetLineHeight());
+    }
+    else if (m_CommandRecorder) {
+        sprintf(text, "Draws: %d  Deferred contexts: %d (%s command lists)", (int)state.visibleWorlds.size(), m_CommandRecorder->GetContextCount(),
+                m_CommandRecorder->HasDriverCommandLists() ? "driver" : "emulated");
+        m_Text->SetString(m_hudStatsString, text, 10, 10 + m_Font->GetLineHeight());
+    }
+    else if (m_Occlusion) {
+        sprintf(text, "Draws: %d  Occluder triangles: %d  Tree nodes: %d", (int)state.visibleWorlds.size(), state.occluderTriangles,
+                state.treeNodes);
+        m_Text->SetString(m_hudStatsString, text, 10, 10 + m_Font->GetLineHeight());
+    }
+
+    sprintf(text, "Cbuffer maps: %.1f  Binds: %.1f  Skipped: %.1f / frame", (float)m_hudMapCount / (float)m_hudFrameCount,
+            (float)m_hudBindCount / (float)m_hudFrameCount, (float)m_hudSkippedBindCount / (float)m_hudFrameCount);
+    m_Text->SetString(m_hudShaderString, text, 10, 10 + 2 * m_Font->GetLineHeight());
+
+    m_hudFrameCount = 0;
+    m_hudMapCount = 0;
+    m_hudBindCount = 0;
+    m_hudSkippedBindCount = 0;
+    m_hudTime = 0.0f;
+
+    return;
+}
+
 void ApplicationClass::Shutdown()
 {
-    RT_RELEASE_OBJ_PTR(m_Timer);
-    RT_RELEASE_OBJ_PTR_ARR(m_Lights);
+    // The simulation thread goes first, it uses most of what follows.
+    RT_SHUTDOWN_OBJ_PTR(m_Pipeline);
+    RT_SHUTDOWN_OBJ_PTR(m_ShaderWatcher);
+    for (auto& state : m_FrameStates) { RT_SHUTDOWN_OBJ_PTR(state.renderQueue); }
+    for (auto& shader : m_PartitionShaders) { RT_SHUTDOWN_OBJ_PTR(shader); }
+    m_PartitionShaders.clear();
+    RT_SHUTDOWN_OBJ_PTR(m_CommandRecorder);
+    RT_SHUTDOWN_OBJ_PTR(m_Occlusion);
+    RT_SHUTDOWN_OBJ_PTR(m_BoundsTree);
+    RT_SHUTDOWN_OBJ_PTR(m_Entities);
+    RT_SHUTDOWN_OBJ_PTR(m_Text);
+    RT_SHUTDOWN_OBJ_PTR(m_Font);
+    RT_SHUTDOWN_OBJ_PTR(m_TextShader);
+    RT_SHUTDOWN_OBJ_PTR(m_ClusteredLighting);
+    RT_SHUTDOWN_OBJ_PTR_ARR(m_SpriteTextures, m_spriteTextureCount);
+    RT_SHUTDOWN_OBJ_PTR(m_SpriteAnimation);
+    RT_SHUTDOWN_OBJ_PTR(m_SpriteBatch);
     RT_SHUTDOWN_OBJ_PTR(m_Bitmap);
+    RT_SHUTDOWN_OBJ_PTR(m_VertexRing);
     RT_SHUTDOWN_OBJ_PTR(m_Shader);
+    RT_SHUTDOWN_OBJ_PTR(m_ShaderCache);
+    RT_SHUTDOWN_OBJ_PTR(m_InstanceBuffer);
     RT_SHUTDOWN_OBJ_PTR(m_Model);
+    RT_SHUTDOWN_OBJ_PTR(m_TextureStreamer);
     RT_RELEASE_OBJ_PTR(m_Camera);
     RT_SHUTDOWN_OBJ_PTR(m_Direct3D);
+    RT_SHUTDOWN_OBJ_PTR(m_SceneFile);
 
     return;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
-bool ApplicationClass::Frame()
+// One fixed step of the simulation is due, SystemClass calls this as many times per frame as the real time since the
+// last frame holds. The steps run with the simulation of the next frame started (on the simulation thread with
+// --pipelined).
+void ApplicationClass::Update(float stepTime)
 {
+    m_pendingSteps++;
+    m_stepTime = stepTime;
+
+    return;
+}
+
+// frameTime is the real time since the last frame, interpolation how far the frame is from the state before the last
+// simulation step to the last one (see FrameClockClass).
+//
+// A frame is simulated into a frame state, then drawn from it. Serially both happen here, one after the other. In the
+// pipelined mode this draws the frame state simulated during the previous frame, while the simulation thread works on
+// the next one, so the frame costs the longer of the two instead of their sum and is drawn one frame late.
+bool ApplicationClass::Frame(float frameTime, float interpolation)
+{
+    FrameStateType* state;
+    float hudFrameTime = frameTime;
     bool result;
-    static float rotation = 0.0f;
-    float frameTime;
+    int slot;
 
-    // Update the rotation variable each frame.
-    rotation -= 0.0174532925f * 0.1f;
-    if (rotation < 0.0f) { rotation += 360.0f; }
+    if (m_SceneFile->GetScene().clearOnly) {
+        const float* clearColor = m_SceneFile->GetScene().clearColor;
 
-    if (m_Config.useTimer) {
-        // Update the system stats.
-        m_Timer->Frame();
+        // Clear the buffers to begin the scene and present them to the screen.
+        m_Direct3D->BeginScene(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+        m_Direct3D->EndScene();
 
-        // Get the current frame time.
-        frameTime = m_Timer->GetTime();
+        return true;
+    }
+
+    // Swap in the shaders recompiled since the last frame, before anything is drawn with them.
+    if (m_ShaderWatcher) { UpdateShaderReload(); }
+
+    if (!m_Pipeline) {
+        state = &m_FrameStates[0];
+        StartFrameState(*state, frameTime, interpolation);
+        Simulate(*state);
+    } else {
+        // The first frame has no frame simulated ahead, it is simulated here and the next one starts with no time.
+        slot = m_Pipeline->WaitForFrame();
+        if (slot < 0) {
+            slot = 0;
+            StartFrameState(m_FrameStates[slot], frameTime, interpolation);
+            Simulate(m_FrameStates[slot]);
+            frameTime = 0.0f;
+        }
+        state = &m_FrameStates[slot];
 
-        // Update the sprite object using the frame time.
-        m_Bitmap->Update(frameTime);
+        StartFrameState(m_FrameStates[1 - slot], frameTime, interpolation);
+        m_Pipeline->StartFrame(1 - slot);
     }
 
+    if (m_Text) { UpdateHud(hudFrameTime, *state); }
+
     // Render the graphics scene.
-    result = Render(rotation);
+    result = Render(*state);
     if (!result) { return false; }
 
+    // Stream texture mips in / out based on the requests made while rendering this frame.
+    if (m_TextureStreamer) {
+        result = m_TextureStreamer->Update();
+        if (!result) { return false; }
+    }
+
     return true;
 }
 
+// The request of a frame state: the simulation steps due since the last one and the time of the frame.
+void ApplicationClass::StartFrameState(FrameStateType& state, float frameTime, float interpolation)
+{
+    state.steps = m_pendingSteps;
+    state.stepTime = m_stepTime;
+    state.frameTime = frameTime;
+    state.interpolation = interpolation;
+    m_pendingSteps = 0;
+
+    return;
+}
+
+// One fixed step of the simulation. Keeps the state of the step before, so the frame can be drawn between the two.
+void ApplicationClass::StepSimulation(float stepTime)
+{
+    // Update the rotation variable each step.
+    m_previousRotation = m_rotation;
+    m_rotation -= ROTATION_SPEED * stepTime;
+    if (m_rotation < 0.0f) {
+        m_rotation += 360.0f;
+        m_previousRotation += 360.0f;
+    }
+
+    return;
+}
+
+// Everything of a frame but the draws: the simulation steps, the camera, the entities and the culling, the lights and
+// the animations, written to the frame state. Touches nothing the render thread uses.
+void ApplicationClass::Simulate(FrameStateType& state)
+{
+    XMMATRIX viewMatrix, viewMatrixDefault, projectionMatrix;
+    float rotation;
+    int step;
+
+    for (step = 0; step < state.steps; step++) { StepSimulation(state.stepTime); }
+    rotation = m_previousRotation + (m_rotation - m_previousRotation) * state.interpolation;
+
+    // Generate the view matrix based on the camera's position. The projection matrix of D3DClass is fixed.
+    m_Camera->Render();
+    m_Camera->GetViewMatrix(viewMatrix);
+    m_Camera->GetViewMatrixDefault(viewMatrixDefault);
+    m_Direct3D->GetProjectionMatrix(projectionMatrix);
+    XMStoreFloat4x4(&state.viewMatrix, viewMatrix);
+    XMStoreFloat4x4(&state.viewMatrixDefault, viewMatrixDefault);
+    state.cameraPosition = m_Camera->GetPosition();
+
+    // The render queue is started before the entities are updated, the objects drawn one by one are queued by the
+    // render submission system.
+    state.renderQueue->Begin();
+    UpdateEntities(rotation, viewMatrix, projectionMatrix, state);
+
+    // The diffuse lights are the light entities.
+    int lightCount = 0;
+    m_Entities->ForEachChunk(COMPONENT_BIT(COMPONENT_LIGHT), ENTITY_SYSTEM_GRAIN, false, [&](const EntityChunkType& chunk) {
+        const LightComponent* lights = (const LightComponent*)chunk.components[COMPONENT_LIGHT];
+
+        for (int i = 0; (i < chunk.count) && (lightCount < m_numDiffuseLights); i++, lightCount++) {
+            state.diffuseColor[lightCount] = XMFLOAT4(lights[i].color);
+            state.lightPosDir[lightCount] = XMFLOAT3(m_isDiffuseLightPosGiven ? lights[i].position : lights[i].direction);
+        }
+    });
+
+    if (m_ClusteredLighting) { UpdateClusteredLights(rotation, state.clusterLights); }
+
+    // Update the sprite object using the frame time.
+    if (m_Bitmap) {
+        if (m_Config.useTimer) { m_Bitmap->Update(state.frameTime); }
+        state.bitmapFrame = m_Bitmap->GetFrameIndex();
+    }
+    if (m_Config.useTimer) {
+        if (m_SpriteBatch) {
+            UpdateSpriteStress(state.frameTime);
+
+            state.sprites.resize(m_SpriteParticles.size());
+            for (size_t sprite = 0; sprite < m_SpriteParticles.size(); sprite++) {
+                const SpriteParticle& particle = m_SpriteParticles[sprite];
+                state.sprites[sprite].x = particle.x;
+                state.sprites[sprite].y = particle.y;
+                state.sprites[sprite].image = m_SpriteAnimation->GetImage(particle.animation);
+                state.sprites[sprite].uvRect = m_SpriteAnimation->GetUVRect(particle.animation);
+            }
+        }
+    }
+
+    return;
+}
+
+// Start a background recompile of the shader objects reading a changed file, and swap in the ones done compiling. Never
+// waits for the compiler: a reload takes effect on the first frame after it finished. The partition shaders of a
+// deferred scene draw the objects in place of m_Shader, they reload with it.
+void ApplicationClass::UpdateShaderReload()
+{
+    std::vector<std::string> files;
+    std::vector<ShaderClass*> shaders = { m_Shader, m_TextShader };
+
+    shaders.insert(shaders.end(), m_PartitionShaders.begin(), m_PartitionShaders.end());
+
+    if (m_ShaderWatcher->GetChangedFiles(files)) {
+        for (ShaderClass* shader : shaders) {
+            if (!shader) { continue; }
+            for (auto& file : files) {
+                if (shader->UsesShaderFile(file.c_str())) {
+                    shader->StartReload();
+                    break;
+                }
+            }
+        }
+    }
+
+    for (ShaderClass* shader : shaders) {
+        if (shader && (shader->ApplyReload() == SHADER_RELOAD_FAILED)) {
+            OutputDebugStringA("Shader reload failed, keeping the previous shaders. Check shader-error.txt for message.\n");
+        }
+    }
+
+    return;
+}
+
+// Work out how big the model is on screen with this world matrix and pass it on as the texture detail it needs.
+void ApplicationClass::RequestModelTextureDetail(XMMATRIX worldMatrix, XMMATRIX projectionMatrix, XMFLOAT3 cameraPos)
+{
+    XMVECTOR objectPosition, cameraPosition;
+    float scale, distance, projectedSize;
+
+    // The translation of the world matrix is the object position, the length of its first row is the scale.
+    objectPosition = worldMatrix.r[3];
+    cameraPosition = XMLoadFloat3(&cameraPos);
+    distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(objectPosition, cameraPosition)));
+    scale = XMVectorGetX(XMVector3Length(worldMatrix.r[0]));
+
+    projectedSize = TextureStreamerClass::ComputeProjectedSize(m_Model->GetBoundingRadius() * scale, distance,
+                                                               XMVectorGetY(projectionMatrix.r[1]), m_screenHeight);
+    m_Model->RequestTextureDetail(projectedSize);
+
+    return;
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 // It still begins with clearing the scene except that it is cleared to black. After that it calls the Render function
 // for the camera object to create a view matrix based on the camera's location that was set in the Initialize function.
@@ -246,163 +836,231 @@ bool ApplicationClass::Frame()
 // Once it is scaled, we then rotate it so that it will be oriented in the direction we want it to face.
 // Now that it is both scaled and rotated, we can move it to the final location in the 3D world by using translation.
 
-bool ApplicationClass::Render(float rotation)
+bool ApplicationClass::Render(FrameStateType& state)
 {
     bool result;
-    XMMATRIX worldMatrix, viewMatrix, projectionMatrix, rotateMatrix, translateMatrix, scaleMatrix, srMatrix;
+    XMMATRIX worldMatrix, modelMatrix, viewMatrix, projectionMatrix;
     XMMATRIX viewMatrixDefault, orthoMatrix;
-    bool useGeoRendering = false;
-    bool use2DRendering = false;
-
-    if (CHECK_RT_TEST_NUM(12) || CHECK_RT_TEST_NUM(13)) { useGeoRendering = false; use2DRendering = true; }
-
-    if (CHECK_RT_TEST_NUM(3) == true) {
-        // Clear the buffers to begin the scene - gray
-        m_Direct3D->BeginScene(0.5f, 0.5f, 0.5f, 1.0f);
-
-        // Present the rendered scene to the screen.
-        m_Direct3D->EndScene();
-
-        return true;
-    }
+    XMMATRIX instanceMatrices[MAX_MODEL_INSTANCES];
+    int instanceCount = 1;
+    const SceneDescType& scene = m_SceneFile->GetScene();
+    RenderQueueClass* renderQueue = state.renderQueue;
 
     // Step 1: Clear the back buffer ----------------------------------------------------------------------------------
-    // Clear the buffers to begin the scene - black
-    m_Direct3D->BeginScene(0.0f, 0.0f, 0.0f, 1.0f);
+    m_Direct3D->BeginScene(scene.clearColor[0], scene.clearColor[1], scene.clearColor[2], scene.clearColor[3]);
 
     // Step 2: Reset the render frame ---------------------------------------------------------------------------------
 
-    // 2-a: Generate the view matrix based on the camera's position.
-    m_Camera->Render();
-    // m_Camera->SetPosition(0.0f, 0.0f, -15.0f);
-
     // Object #1 base object ==========================================================================================
-    // 2-b: Get the world, view, and projection matrices from the camera and d3d objects.
+    // 2-a: Get the world, view, and projection matrices. The view matrices come with the frame state, the simulation
+    // generated them from the camera's position.
     m_Direct3D->GetWorldMatrix(worldMatrix);
-    m_Camera->GetViewMatrix(viewMatrix);                   // use for Geometry rendering
-    m_Camera->GetViewMatrixDefault(viewMatrixDefault);     // use for 2D rendering will - view should not change with camera
+    viewMatrix = XMLoadFloat4x4(&state.viewMatrix);                 // use for Geometry rendering
+    viewMatrixDefault = XMLoadFloat4x4(&state.viewMatrixDefault);   // use for 2D rendering will - view should not change with camera
     m_Direct3D->GetProjectionMatrix(projectionMatrix);     // Used for Geometry rendering
     m_Direct3D->GetOrthoMatrix(orthoMatrix);               // Used for 2D Rendeirng 
 
-    // Here we rotate the world matrix by the rotation value so that when we render the triangle using this updated world matrix it will spin the triangle by the rotation amount.
-    if (CHECK_RT_TEST_NUM(6) || CHECK_RT_TEST_NUM(7) || CHECK_RT_TEST_NUM(9) || CHECK_RT_TEST_NUM(10)) {
-        // Rotate the world matrix by the rotation value so that the triangle will spin.
-        worldMatrix = XMMatrixRotationY(rotation);
+    // 2-b: The world matrices of the visible objects are in the frame state. The world matrix above stays the
+    // identity, the 2D elements are drawn with it.
+    if (m_InstanceBuffer) {
+        instanceCount = (int)state.visibleWorlds.size();
+        for (auto i = 0; i < instanceCount; i++) {
+            instanceMatrices[i] = XMLoadFloat4x4((const XMFLOAT4X4*)state.visibleWorlds[i].m);
+        }
     }
-    if (CHECK_RT_TEST_NUM(8)) {
-        // Key ont: Multiply in SRT order as described above
-        rotateMatrix = XMMatrixRotationY(rotation);  // Build the rotation matrix.
-        translateMatrix = XMMatrixTranslation(-2.0f, 0.0f, 0.0f);  // Build the translation matrix.
 
-        // Multiply them together to create the final world transformation matrix.
-        worldMatrix = XMMatrixMultiply(rotateMatrix, translateMatrix);
-    }
     // 2-c: Put the model vertex and index buffers on the graphics pipeline to prepare them for drawing.
+    // With instancing the world matrices of all the copies go in the instance stream, bound next to the model buffers.
     m_Model->Render(m_Direct3D->GetDeviceContext());
+    if (m_InstanceBuffer) {
+        result = m_InstanceBuffer->Update(m_Direct3D->GetDeviceContext(), instanceMatrices, instanceCount);
+        if (!result) { return false; }
+        m_InstanceBuffer->Render(m_Direct3D->GetDeviceContext());
+    }
 
-    // 2-d: Render the model using the color shader.
-    bool useAmbientLight = false;
-    bool useDiffuseLight = false;
-    bool useSpecularLight = false;
-    bool useLighting = false;
-    XMFLOAT4 ambientColor(0.0, 0.0, 0.0, 1.0);
-    XMFLOAT4 diffuseColor[MAX_DIFFUSE_LIGHTS];
-    XMFLOAT4 specularColor(0.0, 0.0, 0.0, 1.0);
-    float specularPower = 0.0;
-    XMFLOAT3 lightPosDir[MAX_DIFFUSE_LIGHTS];
-
-    if (CHECK_RT_TEST_NUM(9) || CHECK_RT_TEST_NUM(10) || CHECK_RT_TEST_NUM(11)) { useAmbientLight = true; }
-    if (CHECK_RT_TEST_NUM(6) || CHECK_RT_TEST_NUM(7) || CHECK_RT_TEST_NUM(8) || CHECK_RT_TEST_NUM(9) || CHECK_RT_TEST_NUM(10) || CHECK_RT_TEST_NUM(11)) { useDiffuseLight = true; }
-    if (CHECK_RT_TEST_NUM(10)) { useSpecularLight = true; }
-
-    useLighting = useAmbientLight || useDiffuseLight || useSpecularLight;
-    if (useLighting) {
-        // Get the ambient light paramaters.
-        ambientColor = m_Lights->GetAmbientColor();
-
-        // Get the diffuse light paramaters.
-        for (auto i = 0; i < m_numDiffuseLights; i++) {
-            // Create the diffuse color array from the four light colors.
-            diffuseColor[i] = m_Lights[i].GetDiffuseColor();
-
-            if (m_isDiffuseLightPosGiven) {
-                // Create the light position array from the four light positions.
-                auto position = m_Lights[i].GetPosition();
-                lightPosDir[i].x = position.x;
-                lightPosDir[i].y = position.y;
-                lightPosDir[i].z = position.z;
-            }
-            else {
-                lightPosDir[i] = m_Lights[i].GetDirection();
-            }
-        }
+    // Every visible object asks for the texture detail of its size on screen.
+    for (auto& world : state.visibleWorlds) {
+        RequestModelTextureDetail(XMLoadFloat4x4((const XMFLOAT4X4*)world.m), projectionMatrix, state.cameraPosition);
+    }
 
-        // Get the specular light paramaters.
-        specularColor = m_Lights->GetSpecularColor();
-        specularPower = m_Lights->GetSpecularPower();
+    // 2-d: Gather the lights of the scene for the light shader.
+    // The light types used come with the scene, the flags are only read here. The diffuse lights come with the frame state.
+    bool useAmbientLight = scene.useAmbient;
+    bool useDiffuseLight = scene.useDiffuse;
+    bool useSpecularLight = scene.useSpecular;
+    XMFLOAT4 ambientColor(scene.ambientColor);
+    XMFLOAT4* diffuseColor = state.diffuseColor;
+    XMFLOAT4 specularColor(scene.specularColor);
+    float specularPower = scene.specularPower;
+    XMFLOAT3* lightPosDir = state.lightPosDir;
+
+    // The clustered point lights are binned for this frame's view and bound next to the light shader buffers.
+    if (m_ClusteredLighting) {
+        result = m_ClusteredLighting->Update(m_Direct3D->GetDeviceContext(), viewMatrix, state.clusterLights.data(), (int)state.clusterLights.size());
+        if (!result) { return false; }
+        m_ClusteredLighting->Render(m_Direct3D->GetDeviceContext());
     }
 
+    // Step 3: Queue the draws of the frame ----------------------------------------------------------------------------
+    // Every draw goes in the render queue with its sort key: the opaque scene first, front to back with the draws of
+    // the same shader and texture grouped, then the 2D overlays and the HUD on top, in that order.
     ID3D11ShaderResourceView* texture = m_Model->GetTexture();
-    result = m_Shader->Render(m_Direct3D->GetDeviceContext(), m_Model->GetIndexCount(), worldMatrix, viewMatrix, projectionMatrix, texture,
-                              m_Camera->GetPosition(),
-                              useAmbientLight, ambientColor,
-                              useDiffuseLight, m_numDiffuseLights, diffuseColor,
-                              m_isDiffuseLightPosGiven, lightPosDir,
-                              useSpecularLight, specularColor, specularPower);
-    if (!result) { return false; }
 
-    if (CHECK_RT_TEST_NUM(8)) {
-        // Object #2 Additonal object ========================================================================================
-        scaleMatrix = XMMatrixScaling(0.5f, 0.5f, 0.5f);          // Build the scaling matrix.
-        rotateMatrix = XMMatrixRotationY(rotation);               // Build the rotation matrix.
-        translateMatrix = XMMatrixTranslation(2.0f, 0.0f, 0.0f);  // Build the translation matrix.
-
-        // Multiply the scale, rotation, and translation matrices together to create the final world transformation matrix.
-        srMatrix = XMMatrixMultiply(scaleMatrix, rotateMatrix);
-        worldMatrix = XMMatrixMultiply(srMatrix, translateMatrix);
-
-        // Put the model vertex and index buffers on the graphics pipeline to prepare them for drawing.
-        m_Model->Render(m_Direct3D->GetDeviceContext());
-
-        // Render the model using the light shader.
-        result = m_Shader->Render(m_Direct3D->GetDeviceContext(), m_Model->GetIndexCount(), worldMatrix, viewMatrix, projectionMatrix,
-                                  m_Model->GetTexture(),
-                                  m_Camera->GetPosition(),
-                                  useAmbientLight, ambientColor,
-                                  useDiffuseLight, m_numDiffuseLights, diffuseColor,
-                                  m_isDiffuseLightPosGiven, lightPosDir,
-                                  useSpecularLight, specularColor, specularPower);
+    // The objects drawn one by one are queued already, the instanced and the deferred draws are one packet for all.
+    if ((m_InstanceBuffer || m_CommandRecorder) && !state.visibleWorlds.empty()) {
+        renderQueue->Submit(renderQueue->MakeKey(RENDER_PASS_OPAQUE, m_Shader->GetCurrentVariant(), RenderQueueClass::GetResourceId(texture), 0,
+                                                 state.modelDepth), m_CommandRecorder ? SCENE_DRAW_GRID : SCENE_DRAW_INSTANCES);
+    }
+    if (scene.use2D) {
+        renderQueue->Submit(renderQueue->MakeKey(RENDER_PASS_OVERLAY, m_Shader->GetCurrentVariant(), 0, 0, 0.0f),
+                            m_SpriteBatch ? SCENE_DRAW_SPRITES : SCENE_DRAW_BITMAP);
+    }
+    if (m_Text) {
+        renderQueue->Submit(renderQueue->MakeKey(RENDER_PASS_OVERLAY, m_TextShader->GetCurrentVariant(), 0, 1, 0.0f), SCENE_DRAW_HUD);
+    }
+
+    // Step 4: Issue the draws in key order ---------------------------------------------------------------------------
+    const RenderPacketType* packets = renderQueue->Sort();
+    for (auto packet = 0; packet < renderQueue->GetPacketCount(); packet++) {
+        switch (packets[packet].payload) {
+        case SCENE_DRAW_INSTANCES:
+            // All the objects of an instancing scene are the same model, so they are drawn with a single instanced draw call.
+            result = m_Shader->RenderInstanced(m_Direct3D->GetDeviceContext(), m_Model->GetIndexCount(), instanceCount, viewMatrix, projectionMatrix,
+                                               texture,
+                                               state.cameraPosition,
+                                               useAmbientLight, ambientColor,
+                                               useDiffuseLight, m_numDiffuseLights, diffuseColor,
+                                               m_isDiffuseLightPosGiven, lightPosDir,
+                                               useSpecularLight, specularColor, specularPower);
+            break;
+
+        case SCENE_DRAW_GRID:
+            result = RenderDeferredGrid(state, viewMatrix, projectionMatrix, texture,
+                                        useAmbientLight, ambientColor,
+                                        useDiffuseLight, diffuseColor, lightPosDir,
+                                        useSpecularLight, specularColor, specularPower);
+            break;
+
+        case SCENE_DRAW_SPRITES:
+            // 2D rendering of the sprite batch stress test, all the sprites go through the batch in a few draws.
+            m_Direct3D->TurnZBufferOff();
+
+            m_SpriteBatch->Begin(SPRITE_SORT_TEXTURE);
+            for (auto& sprite : state.sprites) {
+                m_SpriteBatch->Draw(m_SpriteTextures[sprite.image].GetTexture(), sprite.x, sprite.y, 16.0f, 16.0f, sprite.uvRect);
+            }
+            result = m_SpriteBatch->End(m_Direct3D->GetDeviceContext(), m_Shader, worldMatrix, viewMatrixDefault, orthoMatrix);
+
+            m_Direct3D->TurnZBufferOn();
+            break;
+
+        case SCENE_DRAW_BITMAP:
+            // 2D REndeirng usign bitmap
+            // Turn off the Z buffer to begin all 2D rendering.
+            m_Direct3D->TurnZBufferOff();
+
+            // Put the bitmap vertex and index buffers on the graphics pipeline to prepare them for drawing.
+            result = m_Bitmap->Render(m_Direct3D->GetDeviceContext());
+            if (!result) { return false; }
+
+            // Once the vertex / index buffers are prepared we draw them using the texture shader.
+            // Notice we send in the orthoMatrix instead of the projectionMatrix for rendering 2D.
+            // Due note also that if your view matrix is changing you will need to create a default one for 2D rendering and use it instead of the regular view matrix.
+            // Render the bitmap with the texture shader, for an animated sprite the frame is the slice of its texture array.
+            m_Shader->SetTextureSlice(state.bitmapFrame);
+            result = m_Shader->Render(m_Direct3D->GetDeviceContext(), m_Bitmap->GetIndexCount(), worldMatrix, viewMatrixDefault, orthoMatrix,
+                                      m_Bitmap->GetTexture(),
+                                      state.cameraPosition,
+                                      useAmbientLight, ambientColor,
+                                      useDiffuseLight, m_numDiffuseLights, diffuseColor,
+                                      m_isDiffuseLightPosGiven, lightPosDir,
+                                      useSpecularLight, specularColor, specularPower);
+
+            // After all the 2D rendering is done we turn the Z buffer back on for the next round of 3D rendering.
+            m_Direct3D->TurnZBufferOn();
+            break;
+
+        case SCENE_DRAW_HUD:
+            // The HUD goes on top of everything, all its strings in one draw. The glyph coverage is in the alpha of the
+            // font atlas, so the text is alpha blended with the scene.
+            m_Direct3D->TurnZBufferOff();
+            m_Direct3D->TurnOnAlphaBlending();
+
+            result = m_Text->Render(m_Direct3D->GetDeviceContext(), m_TextShader, worldMatrix, viewMatrixDefault, orthoMatrix);
+
+            m_Direct3D->TurnOffAlphaBlending();
+            m_Direct3D->TurnZBufferOn();
+
+            // The font atlas is now bound on slot 0 behind the back of the scene shader.
+            m_Shader->InvalidateBoundTexture();
+            break;
+
+        default:
+            // One visible object, only its world matrix changes from draw to draw.
+            modelMatrix = XMLoadFloat4x4((const XMFLOAT4X4*)state.visibleWorlds[packets[packet].payload - SCENE_DRAW_OBJECT].m);
+            result = m_Shader->Render(m_Direct3D->GetDeviceContext(), m_Model->GetIndexCount(), modelMatrix, viewMatrix, projectionMatrix,
+                                      texture,
+                                      state.cameraPosition,
+                                      useAmbientLight, ambientColor,
+                                      useDiffuseLight, m_numDiffuseLights, diffuseColor,
+                                      m_isDiffuseLightPosGiven, lightPosDir,
+                                      useSpecularLight, specularColor, specularPower);
+            break;
+        }
         if (!result) { return false; }
     }
 
-    // 2D REndeirng usign bitmap
-    if (use2DRendering) {
-        // Turn off the Z buffer to begin all 2D rendering.
-        m_Direct3D->TurnZBufferOff();
+    // Step 5: Present the rendered scene to the screen. -----------------------------------------------------------------
+    m_Direct3D->EndScene();
 
-        // Put the bitmap vertex and index buffers on the graphics pipeline to prepare them for drawing.
-        result = m_Bitmap->Render(m_Direct3D->GetDeviceContext());
-        if (!result) { return false; }
+    return true;
+}
 
-        // Once the vertex / index buffers are prepared we draw them using the texture shader.
-        // Notice we send in the orthoMatrix instead of the projectionMatrix for rendering 2D.
-        // Due note also that if your view matrix is changing you will need to create a default one for 2D rendering and use it instead of the regular view matrix.
-        // Render the bitmap with the texture shader.
-        result = m_Shader->Render(m_Direct3D->GetDeviceContext(), m_Bitmap->GetIndexCount(), worldMatrix, viewMatrixDefault, orthoMatrix,
-                                  m_Bitmap->GetTexture(),
-                                  m_Camera->GetPosition(),
-                                  useAmbientLight, ambientColor,
-                                  useDiffuseLight, m_numDiffuseLights, diffuseColor,
-                                  m_isDiffuseLightPosGiven, lightPosDir,
-                                  useSpecularLight, specularColor, specularPower);
-        if (!result) { return false; }
+// The objects of a deferred scene (the grid of test 16). Every partition is recorded on its deferred context by a worker thread: its output state, the
+// model buffers and one draw per cube, each with its own world matrix. The render thread then plays the command lists
+// in partition order.
+bool ApplicationClass::RenderDeferredGrid(const FrameStateType& state, XMMATRIX viewMatrix, XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture,
+                                          bool useAmbientLight, XMFLOAT4 ambientColor,
+                                          bool useDiffuseLight, XMFLOAT4 diffuseColor[], XMFLOAT3 lightPosDir[],
+                                          bool useSpecularLight, XMFLOAT4 specularColor, float specularPower)
+{
+    bool result;
+    int partitionCount = m_CommandRecorder->GetContextCount();
+    int objectCount = (int)state.visibleWorlds.size();
+    XMFLOAT3 cameraPosition = state.cameraPosition;
+
+    result = m_CommandRecorder->Record(partitionCount, [&](ID3D11DeviceContext* deviceContext, int partition) -> bool {
+        ShaderClass* shader = m_PartitionShaders[partition];
+        int begin = objectCount * partition / partitionCount;
+        int end = objectCount * (partition + 1) / partitionCount;
+
+        m_Direct3D->SetDefaultState(deviceContext);
+        m_Model->Render(deviceContext);
+        shader->ResetContextState();
+
+        for (int i = begin; i < end; i++) {
+            XMMATRIX worldMatrix = XMLoadFloat4x4((const XMFLOAT4X4*)state.visibleWorlds[i].m);
+
+            if (!shader->Render(deviceContext, m_Model->GetIndexCount(), worldMatrix, viewMatrix, projectionMatrix, texture,
+                                cameraPosition,
+                                useAmbientLight, ambientColor,
+                                useDiffuseLight, m_numDiffuseLights, diffuseColor,
+                                m_isDiffuseLightPosGiven, lightPosDir,
+                                useSpecularLight, specularColor, specularPower)) { return false; }
+        }
 
-        // After all the 2D rendering is done we turn the Z buffer back on for the next round of 3D rendering.
-        m_Direct3D->TurnZBufferOn();
-    }
+        return true;
+    });
+    if (!result) { return false; }
 
-    // Step 3: Present the rendered scene to the screen. -----------------------------------------------------------------
-    m_Direct3D->EndScene();
+    m_CommandRecorder->Execute(m_Direct3D->GetDeviceContext());
+
+    // The command lists leave the immediate context in the default state: bind the output again and forget everything
+    // the state cache and the shader objects think is bound.
+    m_Direct3D->SetDefaultState(m_Direct3D->GetDeviceContext());
+    m_Direct3D->GetStateCache()->Invalidate();
+    m_Shader->InvalidateBoundTexture();
+    if (m_TextShader) { m_TextShader->InvalidateBoundTexture(); }
 
     return true;
 }
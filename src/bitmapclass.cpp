@@ -6,8 +6,11 @@ using namespace std;
 // --------------------------------------------------------------------------------------------------------------------
 BitmapClass::BitmapClass()
 {
-    m_vertexBuffer = nullptr;
+    m_VertexRing = nullptr;
+    m_StateCache = nullptr;
     m_indexBuffer = nullptr;
+    m_vertexOffset = 0;
+    m_vertexRingWrap = 0;
     m_Textures = nullptr;
 }
 
@@ -22,10 +25,15 @@ BitmapClass::~BitmapClass()
 // --------------------------------------------------------------------------------------------------------------------
 // if sprite_mode = true, filename will contain name of texture file to be loaded 
 // othewise, file will be nam of the texture file and no animation is needed
-bool BitmapClass::Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext, int screenWidth, int screenHeight, bool sprite_mode, char* filename, int renderX, int renderY)
+// The vertices of the bitmap are written in vertexRing, the dynamic vertex buffer shared by all the 2D geometry.
+bool BitmapClass::Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext, int screenWidth, int screenHeight, bool sprite_mode, char* filename, int renderX, int renderY,
+                             DynamicRingBufferClass* vertexRing)
 {
     bool result;
 
+    if (vertexRing == nullptr) { return false; }
+    m_VertexRing = vertexRing;
+
     // In the Initialize function both the screen size and where the image gets rendered is stored.
     // These will be required for generating exact vertex locations during rendering.
     // Store the screen size.
@@ -62,6 +70,13 @@ void BitmapClass::Shutdown()
     return;
 }
 
+// Optional, the input assembler state is then bound through the cache and binds matching the current state are dropped.
+void BitmapClass::SetStateCache(RenderStateCacheClass* stateCache)
+{
+    m_StateCache = stateCache;
+    return;
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 // Render puts the buffers of the 2D image on the video card. The UpdateBuffers function is called with the position parameters.
 // If the position has changed since the last frame, it will then update the location of the vertices in the dynamic vertex buffer
@@ -90,15 +105,16 @@ void BitmapClass::Update(float frameTime)
     // Increment the frame time each frame.
     m_frameTime += frameTime;
 
-    // Check if the frame time has reached the cycle time.
-    if (m_frameTime >= m_cycleTime) {
+    // Check if the frame time has reached the cycle time. A long frame (or a short cycle time) may pass several
+    // cycles at once, so keep advancing until the remaining time is within the current one.
+    while ((m_cycleTime > 0.0f) && (m_frameTime >= m_cycleTime)) {
         // If it has then reset the frame time and cycle to the next sprite in the texture array.
         m_frameTime -= m_cycleTime;
 
         m_currentTexture++;
 
         // If we are at the last sprite texture then go back to the beginning of the texture array to the first texture again.
-        if (m_currentTexture == m_textureCount) {
+        if (m_currentTexture == m_frameCount) {
             m_currentTexture = 0;
         }
     }
@@ -113,25 +129,32 @@ int BitmapClass::GetIndexCount()
     return m_indexCount;
 }
 
+// In sprite mode all the frames are the slices of one texture array, the texture stays the same and GetFrameIndex
+// gives the slice to sample.
 ID3D11ShaderResourceView* BitmapClass::GetTexture()
 {
-    return m_Textures[m_currentTexture].GetTexture();
+    return m_Textures[0].GetTexture();
+}
+
+unsigned int BitmapClass::GetFrameIndex()
+{
+    return (unsigned int)m_currentTexture;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
-// InitializeBuffers is the function that is used to build the vertex and index buffer that will be used to draw the 2D image.
+// InitializeBuffers is the function that is used to build the index buffer that will be used to draw the 2D image.
+// The vertices are not kept in a buffer of the bitmap, they are written in the shared dynamic ring buffer when rendering.
 bool BitmapClass::InitializeBuffers(ID3D11Device* device)
 {
-    VertexType* vertices;
     unsigned long* indices;
-    D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
-    D3D11_SUBRESOURCE_DATA vertexData, indexData;
+    D3D11_BUFFER_DESC indexBufferDesc;
+    D3D11_SUBRESOURCE_DATA indexData;
     HRESULT result;
     int i;
 
     // The previous rendering location is first initialized to negative one. This will be an important variable that will
-    // locate where it last drew this image. If the image location hasn't changed since last frame, then it won't modify
-    // the dynamic vertex buffer which will save us some cycles.
+    // locate where it last drew this image. If the image location hasn't changed since last frame, then it won't write
+    // the vertices again which will save us some cycles.
     // Initialize the previous rendering position to negative one.
     m_prevPosX = -1;
     m_prevPosY = -1;
@@ -143,38 +166,12 @@ bool BitmapClass::InitializeBuffers(ID3D11Device* device)
     // Set the number of indices in the index array.
     m_indexCount = m_vertexCount;
 
-    // Create the vertex array.
-    vertices = new VertexType[m_vertexCount];
-
     // Create the index array.
     indices = new unsigned long[m_indexCount];
 
-    // Initialize vertex array to zeros at first.
-    memset(vertices, 0, (sizeof(VertexType) * m_vertexCount));
-
     // Load the index array with data.
     for (i=0; i<m_indexCount; i++) { indices[i] = i; }
 
-    // Here is the big change in comparison to the ModelClass. We are now creating a dynamic vertex buffer so we can modify the data inside
-    // the vertex buffer each frame if we need to.
-    // To make it dynamic we set Usage to D3D11_USAGE_DYNAMIC and CPUAccessFlags to D3D11_CPU_ACCESS_WRITE in the description.
-    // Set up the description of the dynamic vertex buffer.
-    vertexBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-    vertexBufferDesc.ByteWidth = sizeof(VertexType) * m_vertexCount;
-    vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    vertexBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    vertexBufferDesc.MiscFlags = 0;
-    vertexBufferDesc.StructureByteStride = 0;
-
-    // Give the subresource structure a pointer to the vertex data.
-    vertexData.pSysMem = vertices;
-    vertexData.SysMemPitch = 0;
-    vertexData.SysMemSlicePitch = 0;
-
-    // Now finally create the vertex buffer.
-    result = device->CreateBuffer(&vertexBufferDesc, &vertexData, &m_vertexBuffer);
-    if (FAILED(result)) { return false; }
-
     // We don't need to make the index buffer dynamic since the six indices will always point to the same six vertices
     // even though the coordinates of the vertex may change.
     // Set up the description of the index buffer.
@@ -194,10 +191,7 @@ bool BitmapClass::InitializeBuffers(ID3D11Device* device)
     result = device->CreateBuffer(&indexBufferDesc, &indexData, &m_indexBuffer);
     if (FAILED(result)) { return false; }
 
-    // Release the arrays now that the vertex and index buffers have been created and loaded.
-    delete [] vertices;
-    vertices = 0;
-
+    // Release the array now that the index buffer has been created and loaded.
     delete [] indices;
     indices = 0;
 
@@ -207,30 +201,30 @@ bool BitmapClass::InitializeBuffers(ID3D11Device* device)
 void BitmapClass::ShutdownBuffers()
 {
     RT_RELEASE_ID3D11_PTR(m_indexBuffer);
-    RT_RELEASE_ID3D11_PTR(m_vertexBuffer);
     return;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
-// The UpdateBuffers function is called each frame to update the contents of the dynamic vertex buffer to re-position
-// the 2D bitmap image on the screen if need be.
+// The UpdateBuffers function is called each frame to write the vertices that position the 2D bitmap image on the
+// screen. They go directly in the range of the shared ring buffer returned by Map, with no temporary array.
+// When the position did not change and the ring did not wrap since the last write, the previous range is still
+// valid and is simply drawn again.
 bool BitmapClass::UpdateBuffers(ID3D11DeviceContext* deviceContent)
 {
     float left, right, top, bottom;
     VertexType* vertices;
-    D3D11_MAPPED_SUBRESOURCE mappedResource;
-    VertexType* dataPtr;
-    HRESULT result;
 
-    // If the position we are rendering this bitmap to hasn't changed then don't update the vertex buffer.
-    if ((m_prevPosX == m_renderX) && (m_prevPosY == m_renderY)) { return true; }
+    // If the position we are rendering this bitmap to hasn't changed and the vertices are still in the ring then don't write them again.
+    if ((m_prevPosX == m_renderX) && (m_prevPosY == m_renderY) && (m_vertexRingWrap == m_VertexRing->GetWrapCount())) { return true; }
+
+    // Get the range of the ring buffer the vertices are written to.
+    vertices = (VertexType*)m_VertexRing->Map(deviceContent, sizeof(VertexType) * m_vertexCount, sizeof(VertexType), m_vertexOffset);
+    if (vertices == nullptr) { return false; }
 
-    // If the rendering location has changed then store the new position and update the vertex buffer.
+    // If the rendering location has changed then store the new position.
     m_prevPosX = m_renderX;
     m_prevPosY = m_renderY;
-
-    // Create the vertex array.
-    vertices = new VertexType[m_vertexCount];
+    m_vertexRingWrap = m_VertexRing->GetWrapCount();
 
     // Calculate the screen coordinates of the left side of the bitmap.
     left = (float)((m_screenWidth / 2) * -1) + (float)m_renderX;
@@ -265,25 +259,8 @@ bool BitmapClass::UpdateBuffers(ID3D11DeviceContext* deviceContent)
     vertices[5].position = XMFLOAT3(right, bottom, 0.0f);  // Bottom right.
     vertices[5].texture = XMFLOAT2(1.0f, 1.0f);
 
-    // Lock the vertex buffer.
-    result = deviceContent->Map(m_vertexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-    if (FAILED(result)) { return false; }
-
-    // Get a pointer to the data in the constant buffer.
-    dataPtr = (VertexType*)mappedResource.pData;
-
-    // Copy the data into the vertex buffer.
-    memcpy(dataPtr, (void*)vertices, (sizeof(VertexType) * m_vertexCount));
-
-    // Unlock the vertex buffer.
-    deviceContent->Unmap(m_vertexBuffer, 0);
-
-    // Release the pointer reference.
-    dataPtr = 0;
-
-    // Release the vertex array as it is no longer needed.
-    delete [] vertices;
-    vertices = 0;
+    // Unlock the ring buffer.
+    m_VertexRing->Unmap(deviceContent);
 
     return true;
 }
@@ -293,13 +270,22 @@ void BitmapClass::RenderBuffers(ID3D11DeviceContext* deviceContext)
 {
     unsigned int stride;
     unsigned int offset;
+    ID3D11Buffer* vertexBuffer;
 
-    // Set vertex buffer stride and offset.
+    // Set vertex buffer stride and offset, the offset is the range of the ring buffer the vertices were written to.
     stride = sizeof(VertexType);
-    offset = 0;
+    offset = m_vertexOffset;
+    vertexBuffer = m_VertexRing->GetBuffer();
+
+    if (m_StateCache) {
+        m_StateCache->SetVertexBuffer(deviceContext, 0, vertexBuffer, stride, offset);
+        m_StateCache->SetIndexBuffer(deviceContext, m_indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+        m_StateCache->SetPrimitiveTopology(deviceContext, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        return;
+    }
 
     // Set the vertex buffer to active in the input assembler so it can be rendered.
-    deviceContext->IASetVertexBuffers(0, 1, &m_vertexBuffer, &stride, &offset);
+    deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
 
     // Set the index buffer to active in the input assembler so it can be rendered.
     deviceContext->IASetIndexBuffer(m_indexBuffer, DXGI_FORMAT_R32_UINT, 0);
@@ -318,49 +304,57 @@ bool BitmapClass::LoadTextures(ID3D11Device* device, ID3D11DeviceContext* device
     int i, j;
 
     m_textureCount = 1;
+    m_frameCount = 1;
     if (sprite_mode) {
         // Open the sprite info data file.
         fin.open(filename);
         if (fin.fail()) { return false; }
 
-        // Read in the number of textures.
-        fin >> m_textureCount;
-
-        if (m_textureCount == 1) { m_animate = false; }
+        // Read in the number of frames.
+        fin >> m_frameCount;
+        if (m_frameCount < 1) { return false; }
     }
 
-    // Create and initialize the texture object array
+    // Create and initialize the texture object, the frames of a sprite are loaded in a single texture array.
     m_Textures = new TextureClass[m_textureCount];
 
-    if (m_animate) {
+    if (sprite_mode) {
         char input;
-        char textureFilename[128];
+        char** textureFilenames;
 
         // Read to start of next line.
         fin.get(input);
 
         // Read in each texture file name.
-        for (i=0; i<m_textureCount; i++) {
+        textureFilenames = new char*[m_frameCount];
+        for (i=0; i<m_frameCount; i++) {
+            textureFilenames[i] = new char[128];
+
             j = 0;
             fin.get(input);
             while (input != '\n') {
-                textureFilename[j] = input;
+                textureFilenames[i][j] = input;
                 j++;
                 fin.get(input);
             }
-            textureFilename[j] = '\0';
-
-            // Once you have the filename then load the texture in the texture array.
-            result = m_Textures[i].Initialize(device, deviceContext, textureFilename);
-            if (!result) { return false; }
+            textureFilenames[i][j] = '\0';
         }
 
+        // Once you have the filenames then load all the frames in the slices of the texture array, their mip chains are built in parallel.
+        result = m_Textures[0].InitializeArray(device, deviceContext, textureFilenames, m_frameCount);
+
+        for (i=0; i<m_frameCount; i++) { delete [] textureFilenames[i]; }
+        delete [] textureFilenames;
+        if (!result) { return false; }
+
         // Read in the cycle time.
         fin >> m_cycleTime;
 
         // Convert the integer milliseconds to float representation.
         m_cycleTime = m_cycleTime * 0.001f;
 
+        if (m_frameCount == 1) { m_animate = false; }
+
         // Close the file.
         fin.close();
     } else {
@@ -371,9 +365,9 @@ bool BitmapClass::LoadTextures(ID3D11Device* device, ID3D11DeviceContext* device
     // Set the starting texture in the cycle to be the first one in the list.
     m_currentTexture = 0;
 
-    // Get the dimensions of the first texture and use that as the dimensions of the 2D sprite images.
-    m_bitmapWidth = m_Textures[m_currentTexture].GetWidth();
-    m_bitmapHeight = m_Textures[m_currentTexture].GetHeight();
+    // Get the dimensions of the texture (all the frames have the same size) and use that as the dimensions of the 2D sprite images.
+    m_bitmapWidth = m_Textures[0].GetWidth();
+    m_bitmapHeight = m_Textures[0].GetHeight();
 
     return true;
 }
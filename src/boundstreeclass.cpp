@@ -0,0 +1,490 @@
+// Filename: boundstreeclass.cpp
+#include "boundstreeclass.h"
+
+#include <algorithm>
+#include <cmath>
+
+// std::min and std::max instead of fminf and fmaxf, which stay library calls in the build and refit loops.
+
+// Half the surface area of a box, the SAH only compares areas.
+static float HalfArea(const float boxMin[3], const float boxMax[3])
+{
+    float x = boxMax[0] - boxMin[0], y = boxMax[1] - boxMin[1], z = boxMax[2] - boxMin[2];
+
+    return x * y + y * z + z * x;
+}
+
+static void GrowBox(float boxMin[3], float boxMax[3], const float otherMin[3], const float otherMax[3])
+{
+    for (int i = 0; i < 3; i++) {
+        boxMin[i] = std::min(boxMin[i], otherMin[i]);
+        boxMax[i] = std::max(boxMax[i], otherMax[i]);
+    }
+
+    return;
+}
+
+// 0 outside one of the planes of 'mask', otherwise the mask of the planes the box is not completely inside of.
+static unsigned int ClassifyBox(const float planes[6][4], unsigned int mask, const float boxMin[3], const float boxMax[3], bool& outside)
+{
+    outside = false;
+    for (int i = 0; i < 6; i++) {
+        if (!(mask & (1u << i))) { continue; }
+
+        const float* plane = planes[i];
+        float farthest = plane[0] * ((plane[0] >= 0.0f) ? boxMax[0] : boxMin[0]) + plane[1] * ((plane[1] >= 0.0f) ? boxMax[1] : boxMin[1]) +
+                         plane[2] * ((plane[2] >= 0.0f) ? boxMax[2] : boxMin[2]) + plane[3];
+        if (farthest < 0.0f) { outside = true; return 0; }
+
+        float nearest = plane[0] * ((plane[0] >= 0.0f) ? boxMin[0] : boxMax[0]) + plane[1] * ((plane[1] >= 0.0f) ? boxMin[1] : boxMax[1]) +
+                        plane[2] * ((plane[2] >= 0.0f) ? boxMin[2] : boxMax[2]) + plane[3];
+        if (nearest >= 0.0f) { mask &= ~(1u << i); }
+    }
+
+    return mask;
+}
+
+// Distance along the ray where it enters the box, or a negative value when it misses it before maxDistance.
+static float RayEnter(const float origin[3], const float inverseDirection[3], float maxDistance, const float boxMin[3], const float boxMax[3])
+{
+    float enter = 0.0f, leave = maxDistance;
+
+    for (int i = 0; i < 3; i++) {
+        float t0 = (boxMin[i] - origin[i]) * inverseDirection[i];
+        float t1 = (boxMax[i] - origin[i]) * inverseDirection[i];
+        enter = std::max(enter, std::min(t0, t1));
+        leave = std::min(leave, std::max(t0, t1));
+    }
+
+    return (enter <= leave) ? enter : -1.0f;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+BoundsTreeClass::BoundsTreeClass()
+{
+    m_objectCount = 0;
+    m_needsRebuild = false;
+    m_buildCost = 0.0f;
+    m_cost = 0.0f;
+}
+
+BoundsTreeClass::BoundsTreeClass(const BoundsTreeClass& other)
+{
+}
+
+BoundsTreeClass::~BoundsTreeClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool BoundsTreeClass::Initialize(int initialCapacity)
+{
+    if (initialCapacity < 0) { return false; }
+
+    m_boxes.reserve(initialCapacity * 6);
+    m_userData.reserve(initialCapacity);
+    m_alive.reserve(initialCapacity);
+    m_order.reserve(initialCapacity);
+    m_nodes.reserve(2 * initialCapacity / BOUNDS_TREE_LEAF_SIZE + 2);
+    m_objectCount = 0;
+    m_needsRebuild = true;
+
+    return true;
+}
+
+void BoundsTreeClass::Shutdown()
+{
+    m_nodes.clear();
+    m_boxes.clear();
+    m_userData.clear();
+    m_alive.clear();
+    m_freeProxies.clear();
+    m_order.clear();
+    m_objectCount = 0;
+
+    return;
+}
+
+int BoundsTreeClass::AddObject(const float boxMin[3], const float boxMax[3], unsigned int userData)
+{
+    int proxy;
+
+    if (!m_freeProxies.empty()) {
+        proxy = m_freeProxies.back();
+        m_freeProxies.pop_back();
+        m_userData[proxy] = userData;
+        m_alive[proxy] = true;
+    } else {
+        proxy = (int)m_userData.size();
+        m_boxes.resize(m_boxes.size() + 6);
+        m_userData.push_back(userData);
+        m_alive.push_back(true);
+    }
+    SetBox(proxy, boxMin, boxMax);
+    m_objectCount++;
+    m_needsRebuild = true;
+
+    return proxy;
+}
+
+void BoundsTreeClass::RemoveObject(int proxy)
+{
+    if ((proxy < 0) || (proxy >= (int)m_alive.size()) || !m_alive[proxy]) { return; }
+
+    m_alive[proxy] = false;
+    m_freeProxies.push_back(proxy);
+    m_objectCount--;
+    m_needsRebuild = true;
+
+    return;
+}
+
+void BoundsTreeClass::SetBox(int proxy, const float boxMin[3], const float boxMax[3])
+{
+    float* box = &m_boxes[proxy * 6];
+
+    box[0] = boxMin[0];
+    box[1] = boxMin[1];
+    box[2] = boxMin[2];
+    box[3] = boxMax[0];
+    box[4] = boxMax[1];
+    box[5] = boxMax[2];
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool BoundsTreeClass::Update()
+{
+    int i;
+
+    if (m_needsRebuild) {
+        Rebuild();
+        return true;
+    }
+    if (m_nodes.empty()) { return false; }
+
+    // Children come after their parent, so one pass from the end refits every node from boxes already refitted. The
+    // SAH cost (the areas of the inner nodes, plus the leaf areas times their object counts) is summed on the way.
+    float cost = 0.0f;
+    for (i = (int)m_nodes.size() - 1; i >= 0; i--) {
+        NodeType& node = m_nodes[i];
+
+        if (node.count > 0) {
+            SetNodeBox(node, node.first, node.count);
+            cost += HalfArea(node.boxMin, node.boxMax) * (float)node.count;
+        } else {
+            const NodeType& left = m_nodes[node.first];
+            const NodeType& right = m_nodes[node.first + 1];
+            for (int axis = 0; axis < 3; axis++) {
+                node.boxMin[axis] = std::min(left.boxMin[axis], right.boxMin[axis]);
+                node.boxMax[axis] = std::max(left.boxMax[axis], right.boxMax[axis]);
+            }
+            cost += HalfArea(node.boxMin, node.boxMax);
+        }
+    }
+
+    float rootArea = HalfArea(m_nodes[0].boxMin, m_nodes[0].boxMax);
+    m_cost = (rootArea > 0.0f) ? cost / rootArea : 0.0f;
+    if (m_cost > BOUNDS_TREE_REBUILD_RATIO * m_buildCost) {
+        Rebuild();
+        return true;
+    }
+
+    return false;
+}
+
+void BoundsTreeClass::Rebuild()
+{
+    std::vector<BuildItemType> items;
+    int proxy;
+
+    m_nodes.clear();
+    m_order.clear();
+    m_needsRebuild = false;
+    m_buildCost = m_cost = 0.0f;
+    if (m_objectCount == 0) { return; }
+
+    items.reserve(m_objectCount);
+    for (proxy = 0; proxy < (int)m_userData.size(); proxy++) {
+        if (!m_alive[proxy]) { continue; }
+
+        const float* box = &m_boxes[proxy * 6];
+        BuildItemType item;
+        for (int axis = 0; axis < 3; axis++) {
+            item.boxMin[axis] = box[axis];
+            item.boxMax[axis] = box[3 + axis];
+            item.center[axis] = 0.5f * (box[axis] + box[3 + axis]);
+        }
+        item.proxy = proxy;
+        items.push_back(item);
+    }
+
+    m_nodes.push_back(NodeType());
+    BuildNode(0, 0, (int)items.size(), items);
+
+    m_order.resize(items.size());
+    for (size_t i = 0; i < items.size(); i++) { m_order[i] = items[i].proxy; }
+
+    // The cost as a multiple of the root area, the same measure as Update.
+    float cost = 0.0f;
+    for (auto& node : m_nodes) { cost += HalfArea(node.boxMin, node.boxMax) * (float)((node.count > 0) ? node.count : 1); }
+    float rootArea = HalfArea(m_nodes[0].boxMin, m_nodes[0].boxMax);
+    m_buildCost = m_cost = (rootArea > 0.0f) ? cost / rootArea : 0.0f;
+
+    return;
+}
+
+void BoundsTreeClass::BuildNode(int nodeIndex, int first, int count, std::vector<BuildItemType>& items)
+{
+    float centerMin[3] = { 1.0e30f, 1.0e30f, 1.0e30f }, centerMax[3] = { -1.0e30f, -1.0e30f, -1.0e30f };
+    int i, axis, bin;
+
+    NodeType& node = m_nodes[nodeIndex];
+    node.boxMin[0] = node.boxMin[1] = node.boxMin[2] = 1.0e30f;
+    node.boxMax[0] = node.boxMax[1] = node.boxMax[2] = -1.0e30f;
+    for (i = first; i < first + count; i++) {
+        GrowBox(node.boxMin, node.boxMax, items[i].boxMin, items[i].boxMax);
+        GrowBox(centerMin, centerMax, items[i].center, items[i].center);
+    }
+    node.first = first;
+    node.count = count;
+    if (count <= BOUNDS_TREE_LEAF_SIZE) { return; }
+
+    // Step 1: Bin the centers on every axis and find the cheapest split. ------------------------------------------
+    // cost = area(left) * count(left) + area(right) * count(right).
+    struct BinType { float boxMin[3], boxMax[3]; int count; } bins[3][BOUNDS_TREE_BINS];
+    float scale[3];
+    for (axis = 0; axis < 3; axis++) {
+        float extent = centerMax[axis] - centerMin[axis];
+        scale[axis] = (extent > 0.0f) ? (float)BOUNDS_TREE_BINS / extent : 0.0f;
+        for (auto& entry : bins[axis]) {
+            entry.boxMin[0] = entry.boxMin[1] = entry.boxMin[2] = 1.0e30f;
+            entry.boxMax[0] = entry.boxMax[1] = entry.boxMax[2] = -1.0e30f;
+            entry.count = 0;
+        }
+    }
+
+    // One pass over the objects fills the bins of the three axes.
+    for (i = first; i < first + count; i++) {
+        const BuildItemType& item = items[i];
+        for (axis = 0; axis < 3; axis++) {
+            bin = std::min(BOUNDS_TREE_BINS - 1, (int)((item.center[axis] - centerMin[axis]) * scale[axis]));
+            GrowBox(bins[axis][bin].boxMin, bins[axis][bin].boxMax, item.boxMin, item.boxMax);
+            bins[axis][bin].count++;
+        }
+    }
+
+    float bestCost = 1.0e38f;
+    int bestAxis = -1, bestBin = 0;
+    for (axis = 0; axis < 3; axis++) {
+        if (scale[axis] == 0.0f) { continue; }
+
+        // Sweep from the right for the right side of every split, then from the left.
+        float rightArea[BOUNDS_TREE_BINS];
+        int rightCount[BOUNDS_TREE_BINS];
+        float sideMin[3] = { 1.0e30f, 1.0e30f, 1.0e30f }, sideMax[3] = { -1.0e30f, -1.0e30f, -1.0e30f };
+        int sideCount = 0;
+        for (bin = BOUNDS_TREE_BINS - 1; bin > 0; bin--) {
+            GrowBox(sideMin, sideMax, bins[axis][bin].boxMin, bins[axis][bin].boxMax);
+            sideCount += bins[axis][bin].count;
+            rightArea[bin] = (sideCount > 0) ? HalfArea(sideMin, sideMax) : 0.0f;
+            rightCount[bin] = sideCount;
+        }
+
+        sideMin[0] = sideMin[1] = sideMin[2] = 1.0e30f;
+        sideMax[0] = sideMax[1] = sideMax[2] = -1.0e30f;
+        sideCount = 0;
+        for (bin = 1; bin < BOUNDS_TREE_BINS; bin++) {
+            GrowBox(sideMin, sideMax, bins[axis][bin - 1].boxMin, bins[axis][bin - 1].boxMax);
+            sideCount += bins[axis][bin - 1].count;
+            if ((sideCount == 0) || (rightCount[bin] == 0)) { continue; }
+
+            float cost = HalfArea(sideMin, sideMax) * (float)sideCount + rightArea[bin] * (float)rightCount[bin];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = bin;
+            }
+        }
+    }
+
+    // Step 2: Split the objects, in the middle when every center is at the same place. -------------------------
+    int middle;
+    if (bestAxis >= 0) {
+        float splitScale = scale[bestAxis], splitMin = centerMin[bestAxis];
+        auto split = std::partition(items.begin() + first, items.begin() + first + count, [&](const BuildItemType& item) {
+            return std::min(BOUNDS_TREE_BINS - 1, (int)((item.center[bestAxis] - splitMin) * splitScale)) < bestBin;
+        });
+        middle = (int)(split - (items.begin() + first));
+    } else {
+        middle = count / 2;
+    }
+
+    // Step 3: The two children, next to each other. ------------------------------------------------------------
+    int left = (int)m_nodes.size();
+    m_nodes.push_back(NodeType());
+    m_nodes.push_back(NodeType());
+    m_nodes[nodeIndex].first = left;
+    m_nodes[nodeIndex].count = 0;
+
+    BuildNode(left, first, middle, items);
+    BuildNode(left + 1, first + middle, count - middle, items);
+
+    return;
+}
+
+void BoundsTreeClass::SetNodeBox(NodeType& node, int first, int count)
+{
+    node.boxMin[0] = node.boxMin[1] = node.boxMin[2] = 1.0e30f;
+    node.boxMax[0] = node.boxMax[1] = node.boxMax[2] = -1.0e30f;
+    for (int i = first; i < first + count; i++) {
+        const float* box = &m_boxes[m_order[i] * 6];
+        GrowBox(node.boxMin, node.boxMax, box, box + 3);
+    }
+    node.first = first;
+    node.count = count;
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void BoundsTreeClass::QueryFrustum(const float planes[6][4], const OcclusionBufferClass* occlusion, std::vector<unsigned int>& userData) const
+{
+    std::vector<std::pair<int, unsigned int>> stack;
+    bool outside;
+
+    if (m_nodes.empty()) { return; }
+
+    stack.reserve(64);
+    stack.push_back({ 0, 0x3fu });
+    while (!stack.empty()) {
+        int nodeIndex = stack.back().first;
+        unsigned int mask = stack.back().second;
+        const NodeType& node = m_nodes[nodeIndex];
+        stack.pop_back();
+
+        // The planes the parent was inside of are not tested again.
+        if (mask) {
+            mask = ClassifyBox(planes, mask, node.boxMin, node.boxMax, outside);
+            if (outside) { continue; }
+        }
+        if (occlusion && !occlusion->TestBox(node.boxMin, node.boxMax)) { continue; }
+
+        // Inside the whole frustum and nothing to occlude it: all the subtree.
+        if ((mask == 0) && !occlusion) {
+            AppendSubtree(nodeIndex, userData);
+            continue;
+        }
+
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; i++) {
+                const float* box = &m_boxes[m_order[i] * 6];
+                if (mask) {
+                    ClassifyBox(planes, mask, box, box + 3, outside);
+                    if (outside) { continue; }
+                }
+                if (occlusion && (node.count > 1) && !occlusion->TestBox(box, box + 3)) { continue; }
+                userData.push_back(m_userData[m_order[i]]);
+            }
+        } else {
+            stack.push_back({ node.first + 1, mask });
+            stack.push_back({ node.first, mask });
+        }
+    }
+
+    return;
+}
+
+void BoundsTreeClass::AppendSubtree(int nodeIndex, std::vector<unsigned int>& userData) const
+{
+    const NodeType& node = m_nodes[nodeIndex];
+
+    if (node.count > 0) {
+        for (int i = node.first; i < node.first + node.count; i++) { userData.push_back(m_userData[m_order[i]]); }
+    } else {
+        AppendSubtree(node.first, userData);
+        AppendSubtree(node.first + 1, userData);
+    }
+
+    return;
+}
+
+bool BoundsTreeClass::Raycast(const float origin[3], const float direction[3], float maxDistance, unsigned int& userData, float& distance) const
+{
+    std::vector<std::pair<int, float>> stack;
+    float inverseDirection[3];
+    int hit = -1;
+
+    if (m_nodes.empty()) { return false; }
+
+    for (int i = 0; i < 3; i++) { inverseDirection[i] = 1.0f / direction[i]; }
+    distance = maxDistance;
+
+    float enter = RayEnter(origin, inverseDirection, distance, m_nodes[0].boxMin, m_nodes[0].boxMax);
+    if (enter < 0.0f) { return false; }
+
+    stack.reserve(64);
+    stack.push_back({ 0, enter });
+    while (!stack.empty()) {
+        int nodeIndex = stack.back().first;
+        float nodeEnter = stack.back().second;
+        const NodeType& node = m_nodes[nodeIndex];
+        stack.pop_back();
+
+        // A nearer hit was found since the node was pushed.
+        if (nodeEnter > distance) { continue; }
+
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; i++) {
+                const float* box = &m_boxes[m_order[i] * 6];
+                float t = RayEnter(origin, inverseDirection, distance, box, box + 3);
+                if ((t >= 0.0f) && ((hit < 0) || (t < distance))) {
+                    distance = t;
+                    hit = m_order[i];
+                }
+            }
+            continue;
+        }
+
+        // The nearer child goes on top of the stack.
+        const NodeType& left = m_nodes[node.first];
+        const NodeType& right = m_nodes[node.first + 1];
+        float leftEnter = RayEnter(origin, inverseDirection, distance, left.boxMin, left.boxMax);
+        float rightEnter = RayEnter(origin, inverseDirection, distance, right.boxMin, right.boxMax);
+        if ((leftEnter >= 0.0f) && (rightEnter >= 0.0f)) {
+            if (leftEnter <= rightEnter) {
+                stack.push_back({ node.first + 1, rightEnter });
+                stack.push_back({ node.first, leftEnter });
+            } else {
+                stack.push_back({ node.first, leftEnter });
+                stack.push_back({ node.first + 1, rightEnter });
+            }
+        } else if (leftEnter >= 0.0f) {
+            stack.push_back({ node.first, leftEnter });
+        } else if (rightEnter >= 0.0f) {
+            stack.push_back({ node.first + 1, rightEnter });
+        }
+    }
+
+    if (hit < 0) { return false; }
+    userData = m_userData[hit];
+
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int BoundsTreeClass::GetObjectCount()
+{
+    return m_objectCount;
+}
+
+int BoundsTreeClass::GetNodeCount()
+{
+    return (int)m_nodes.size();
+}
+
+float BoundsTreeClass::GetCost()
+{
+    return m_cost;
+}
@@ -0,0 +1,194 @@
+// Filename: clusteredlightingclass.cpp
+#include "clusteredlightingclass.h"
+
+#include <cstring>
+
+// --------------------------------------------------------------------------------------------------------------------
+ClusteredLightingClass::ClusteredLightingClass()
+{
+    m_LightBinning = nullptr;
+    m_maxLights = 0;
+    m_lightCount = 0;
+    m_screenWidth = 0;
+    m_screenHeight = 0;
+    m_lightBuffer = nullptr;
+    m_clusterRangeBuffer = nullptr;
+    m_lightIndexBuffer = nullptr;
+    m_clusterBuffer = nullptr;
+    m_lightView = nullptr;
+    m_clusterRangeView = nullptr;
+    m_lightIndexView = nullptr;
+}
+
+ClusteredLightingClass::ClusteredLightingClass(const ClusteredLightingClass& other)
+{
+}
+
+ClusteredLightingClass::~ClusteredLightingClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool ClusteredLightingClass::Initialize(ID3D11Device* device, const LightBinningConfig& config, int maxLights, int screenWidth, int screenHeight,
+                                        float fovY, float nearZ, float farZ)
+{
+    D3D11_BUFFER_DESC cbufferDesc;
+    HRESULT hresult;
+    bool result;
+
+    if (maxLights < 1) { return false; }
+
+    m_config = config;
+    m_maxLights = maxLights;
+    m_screenWidth = screenWidth;
+    m_screenHeight = screenHeight;
+
+    // Step 1: The CPU binning, with the cluster boxes of the projection of the application. -------------------------
+    m_LightBinning = new LightBinningClass;
+    result = m_LightBinning->Initialize(config);
+    if (!result) { return false; }
+    m_LightBinning->SetFrustum(fovY, (float)screenWidth / (float)screenHeight, nearZ, farZ);
+
+    // Step 2: The structured buffers read by the pixel shader, rewritten every frame. --------------------------------
+    result = CreateStructuredBuffer(device, sizeof(ClusterLightType), maxLights, &m_lightBuffer, &m_lightView);
+    if (!result) { return false; }
+
+    result = CreateStructuredBuffer(device, sizeof(ClusterRangeType), m_LightBinning->GetClusterCount(), &m_clusterRangeBuffer, &m_clusterRangeView);
+    if (!result) { return false; }
+
+    result = CreateStructuredBuffer(device, sizeof(unsigned int), config.maxLightIndices, &m_lightIndexBuffer, &m_lightIndexView);
+    if (!result) { return false; }
+
+    // Step 3: The grid parameters the pixel shader needs to find its cluster. ---------------------------------------
+    cbufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+    cbufferDesc.ByteWidth = sizeof(ClusterBufferType);
+    cbufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    cbufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    cbufferDesc.MiscFlags = 0;
+    cbufferDesc.StructureByteStride = 0;
+
+    hresult = device->CreateBuffer(&cbufferDesc, NULL, &m_clusterBuffer);
+    if (FAILED(hresult)) { return false; }
+
+    return true;
+}
+
+void ClusteredLightingClass::Shutdown()
+{
+    RT_RELEASE_ID3D11_PTR(m_lightIndexView);
+    RT_RELEASE_ID3D11_PTR(m_clusterRangeView);
+    RT_RELEASE_ID3D11_PTR(m_lightView);
+    RT_RELEASE_ID3D11_PTR(m_clusterBuffer);
+    RT_RELEASE_ID3D11_PTR(m_lightIndexBuffer);
+    RT_RELEASE_ID3D11_PTR(m_clusterRangeBuffer);
+    RT_RELEASE_ID3D11_PTR(m_lightBuffer);
+    RT_SHUTDOWN_OBJ_PTR(m_LightBinning);
+
+    return;
+}
+
+// A dynamic structured buffer with a shader resource view over all its elements.
+bool ClusteredLightingClass::CreateStructuredBuffer(ID3D11Device* device, unsigned int elementSize, unsigned int elementCount, ID3D11Buffer** buffer,
+                                                    ID3D11ShaderResourceView** view)
+{
+    D3D11_BUFFER_DESC bufferDesc;
+    D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
+    HRESULT result;
+
+    bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+    bufferDesc.ByteWidth = elementSize * elementCount;
+    bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    bufferDesc.StructureByteStride = elementSize;
+
+    result = device->CreateBuffer(&bufferDesc, NULL, buffer);
+    if (FAILED(result)) { return false; }
+
+    viewDesc.Format = DXGI_FORMAT_UNKNOWN;
+    viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+    viewDesc.Buffer.FirstElement = 0;
+    viewDesc.Buffer.NumElements = elementCount;
+
+    result = device->CreateShaderResourceView(*buffer, &viewDesc, view);
+    if (FAILED(result)) { return false; }
+
+    return true;
+}
+
+bool ClusteredLightingClass::UploadBuffer(ID3D11DeviceContext* deviceContext, ID3D11Buffer* buffer, const void* data, unsigned int size)
+{
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    HRESULT result;
+
+    result = deviceContext->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+    if (FAILED(result)) { return false; }
+
+    if (size > 0) { memcpy(mappedResource.pData, data, size); }
+
+    deviceContext->Unmap(buffer, 0);
+
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool ClusteredLightingClass::Update(ID3D11DeviceContext* deviceContext, XMMATRIX viewMatrix, const ClusterLightType* lights, int lightCount)
+{
+    ClusterBufferType clusterData;
+    XMFLOAT4X4 view;
+    int indexCount;
+    bool result;
+
+    if (lightCount > m_maxLights) { lightCount = m_maxLights; }
+    m_lightCount = lightCount;
+
+    // Bin the lights on the CPU.
+    XMStoreFloat4x4(&view, viewMatrix);
+    indexCount = m_LightBinning->Bin(&view.m[0][0], lights, lightCount);
+
+    // Upload the lights, the ranges and the used part of the index list.
+    result = UploadBuffer(deviceContext, m_lightBuffer, lights, lightCount * sizeof(ClusterLightType));
+    if (!result) { return false; }
+
+    result = UploadBuffer(deviceContext, m_clusterRangeBuffer, m_LightBinning->GetClusterRanges(), m_LightBinning->GetClusterCount() * sizeof(ClusterRangeType));
+    if (!result) { return false; }
+
+    result = UploadBuffer(deviceContext, m_lightIndexBuffer, m_LightBinning->GetLightIndices(), indexCount * sizeof(unsigned int));
+    if (!result) { return false; }
+
+    clusterData.clustersX = m_config.clustersX;
+    clusterData.clustersY = m_config.clustersY;
+    clusterData.clustersZ = m_config.clustersZ;
+    clusterData.lightCount = lightCount;
+    clusterData.tileScaleX = (float)m_config.clustersX / (float)m_screenWidth;
+    clusterData.tileScaleY = (float)m_config.clustersY / (float)m_screenHeight;
+    clusterData.sliceScale = m_LightBinning->GetSliceScale();
+    clusterData.sliceBias = m_LightBinning->GetSliceBias();
+
+    result = UploadBuffer(deviceContext, m_clusterBuffer, &clusterData, sizeof(clusterData));
+    if (!result) { return false; }
+
+    return true;
+}
+
+// The registers are not used by anything else, so the resources stay bound while the light shader draws.
+void ClusteredLightingClass::Render(ID3D11DeviceContext* deviceContext)
+{
+    ID3D11ShaderResourceView* views[3] = { m_lightView, m_clusterRangeView, m_lightIndexView };
+
+    deviceContext->PSSetShaderResources(CLUSTER_LIGHT_SLOT, 3, views);
+    deviceContext->PSSetConstantBuffers(CLUSTER_CBUFFER_SLOT, 1, &m_clusterBuffer);
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int ClusteredLightingClass::GetLightCount()
+{
+    return m_lightCount;
+}
+
+int ClusteredLightingClass::GetLightIndexCount()
+{
+    return m_LightBinning->GetLightIndexCount();
+}
@@ -0,0 +1,111 @@
+// Filename: commandrecorderclass.cpp
+#include "commandrecorderclass.h"
+#include "rtparallel.h"
+
+#include <atomic>
+
+// --------------------------------------------------------------------------------------------------------------------
+CommandRecorderClass::CommandRecorderClass()
+{
+    m_driverCommandLists = false;
+}
+
+CommandRecorderClass::CommandRecorderClass(const CommandRecorderClass& other)
+{
+}
+
+CommandRecorderClass::~CommandRecorderClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool CommandRecorderClass::Initialize(ID3D11Device* device, int contextCount)
+{
+    HRESULT result;
+    D3D11_FEATURE_DATA_THREADING threading;
+    int i;
+
+    if (contextCount < 1) { return false; }
+
+    result = device->CheckFeatureSupport(D3D11_FEATURE_THREADING, &threading, sizeof(threading));
+    m_driverCommandLists = SUCCEEDED(result) && threading.DriverCommandLists;
+
+    m_contexts.assign(contextCount, nullptr);
+    m_commandLists.assign(contextCount, nullptr);
+    for (i = 0; i < contextCount; i++) {
+        result = device->CreateDeferredContext(0, &m_contexts[i]);
+        if (FAILED(result)) { return false; }
+    }
+
+    return true;
+}
+
+void CommandRecorderClass::Shutdown()
+{
+    ReleaseCommandLists();
+    for (auto& context : m_contexts) { RT_RELEASE_ID3D11_PTR(context); }
+    m_contexts.clear();
+    m_commandLists.clear();
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// One partition per deferred context, each recorded and closed by the thread that took it. A deferred context is
+// only ever used by one thread at a time, which is all D3D11 asks.
+bool CommandRecorderClass::Record(int partitionCount, const RecordFunction& record)
+{
+    std::atomic<bool> failed(false);
+
+    if ((partitionCount < 0) || (partitionCount > (int)m_contexts.size())) { return false; }
+
+    ReleaseCommandLists();
+
+    RTParallelFor(partitionCount, 1, [&](int begin, int end) {
+        for (int partition = begin; partition < end; partition++) {
+            ID3D11DeviceContext* context = m_contexts[partition];
+            bool recorded = record(context, partition);
+
+            // The list is closed even after an error, it also resets the context for the next frame.
+            HRESULT result = context->FinishCommandList(FALSE, &m_commandLists[partition]);
+            if (!recorded || FAILED(result)) { failed = true; }
+        }
+    });
+
+    if (failed) {
+        ReleaseCommandLists();
+        return false;
+    }
+
+    return true;
+}
+
+void CommandRecorderClass::Execute(ID3D11DeviceContext* deviceContext)
+{
+    for (auto commandList : m_commandLists) {
+        if (commandList) { deviceContext->ExecuteCommandList(commandList, FALSE); }
+    }
+
+    // A command list is executed once, the next frame records new ones.
+    ReleaseCommandLists();
+
+    return;
+}
+
+void CommandRecorderClass::ReleaseCommandLists()
+{
+    for (auto& commandList : m_commandLists) { RT_RELEASE_ID3D11_PTR(commandList); }
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int CommandRecorderClass::GetContextCount()
+{
+    return (int)m_contexts.size();
+}
+
+bool CommandRecorderClass::HasDriverCommandLists()
+{
+    return m_driverCommandLists;
+}
@@ -12,6 +12,9 @@ D3DClass::D3DClass()
     m_depthStencilView = nullptr;
     m_rasterState = nullptr;
     m_depthDisabledStencilState = nullptr;
+    m_alphaEnableBlendingState = nullptr;
+    m_alphaDisableBlendingState = nullptr;
+    m_StateCache = nullptr;
 }
 
 D3DClass::D3DClass(const D3DClass& from)
@@ -337,6 +340,30 @@ bool D3DClass::Initialize(int screenWidth, int screenHeight, bool vsync, HWND hw
     // Now set the rasterizer state.
     m_deviceContext->RSSetState(m_rasterState);
 
+    // The last states are the two blend states used for 2D text and sprites with transparent pixels. The first one blends
+    // the pixel with the back buffer by its alpha (SrcAlpha, InvSrcAlpha), the second one is the default of writing it as is.
+    D3D11_BLEND_DESC blendStateDesc;
+    ZeroMemory(&blendStateDesc, sizeof(D3D11_BLEND_DESC));
+
+    blendStateDesc.RenderTarget[0].BlendEnable = TRUE;
+    blendStateDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+    blendStateDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+    blendStateDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+    blendStateDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+    blendStateDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ZERO;
+    blendStateDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+    blendStateDesc.RenderTarget[0].RenderTargetWriteMask = 0x0f;
+
+    // Create the blend state using the description.
+    result = m_device->CreateBlendState(&blendStateDesc, &m_alphaEnableBlendingState);
+    if (FAILED(result)) { return false; }
+
+    // Modify the description to create an alpha disabled blend state description.
+    blendStateDesc.RenderTarget[0].BlendEnable = FALSE;
+
+    result = m_device->CreateBlendState(&blendStateDesc, &m_alphaDisableBlendingState);
+    if (FAILED(result)) { return false; }
+
     // Section 10 ------------------------------------------------------------------------------------------
     // The viewport also needs to be setup so that Direct3D can map clip space coordinates to the render target space.
     // Set this to be the entire size of the window.
@@ -379,6 +406,12 @@ bool D3DClass::Initialize(int screenWidth, int screenHeight, bool vsync, HWND hw
     // Create an orthographic projection matrix for 2D rendering.
     m_orthoMatrix = XMMatrixOrthographicLH((float)screenWidth, (float)screenHeight, screenNear, screenDepth);
 
+    // Section 12 ------------------------------------------------------------------------------------------
+    // The render state cache shadows what is bound on the device context, the shader and model classes bind through
+    // it so that binding the same layout, shaders or buffers again does not reach the driver.
+    m_StateCache = new RenderStateCacheClass;
+    if (!m_StateCache->Initialize(m_deviceContext)) { return false; }
+
     return true;
 }
 
@@ -399,6 +432,10 @@ void D3DClass::Shutdown()
     // Before shutting down set to windowed mode or when you release the swap chain it will throw an exception.
     if (m_swapChain) { m_swapChain->SetFullscreenState(false, NULL); }
 
+    RT_SHUTDOWN_OBJ_PTR(m_StateCache);
+
+    D3DCLASS_CHECK_AND_RELEASE(m_alphaEnableBlendingState);
+    D3DCLASS_CHECK_AND_RELEASE(m_alphaDisableBlendingState);
     D3DCLASS_CHECK_AND_RELEASE(m_rasterState);
     D3DCLASS_CHECK_AND_RELEASE(m_depthStencilView);
     D3DCLASS_CHECK_AND_RELEASE(m_depthDisabledStencilState);
@@ -460,6 +497,11 @@ ID3D11DeviceContext* D3DClass::GetDeviceContext()
     return m_deviceContext;
 }
 
+RenderStateCacheClass* D3DClass::GetStateCache()
+{
+    return m_StateCache;
+}
+
 void D3DClass::GetProjectionMatrix(XMMATRIX& projectionMatrix)
 {
     projectionMatrix = m_projectionMatrix;
@@ -501,6 +543,19 @@ void D3DClass::ResetViewport()
     return;
 }
 
+void D3DClass::SetDefaultState(ID3D11DeviceContext* deviceContext)
+{
+    float blendFactor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    deviceContext->OMSetRenderTargets(1, &m_renderTargetView, m_depthStencilView);
+    deviceContext->OMSetDepthStencilState(m_depthStencilState, 1);
+    deviceContext->OMSetBlendState(m_alphaDisableBlendingState, blendFactor, 0xffffffff);
+    deviceContext->RSSetState(m_rasterState);
+    deviceContext->RSSetViewports(1, &m_viewport);
+
+    return;
+}
+
 // These are the new functions for enabling and disabling the Z buffer.
 // To turn Z buffering on we set the original depth stencil.
 // To turn Z buffering off we set the new depth stencil that has depthEnable set to false.
@@ -517,4 +572,21 @@ void D3DClass::TurnZBufferOff()
     m_deviceContext->OMSetDepthStencilState(m_depthDisabledStencilState, 1);
     return;
 }
+
+// Alpha blending is turned on only around the 2D elements that need it (text), like the Z buffer functions above.
+void D3DClass::TurnOnAlphaBlending()
+{
+    float blendFactor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    m_deviceContext->OMSetBlendState(m_alphaEnableBlendingState, blendFactor, 0xffffffff);
+    return;
+}
+
+void D3DClass::TurnOffAlphaBlending()
+{
+    float blendFactor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    m_deviceContext->OMSetBlendState(m_alphaDisableBlendingState, blendFactor, 0xffffffff);
+    return;
+}
 // --------------------------------------------------------------------------------------------------------------------
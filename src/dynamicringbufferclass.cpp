@@ -0,0 +1,121 @@
+// Filename: dynamicringbufferclass.cpp
+#include "dynamicringbufferclass.h"
+
+// --------------------------------------------------------------------------------------------------------------------
+DynamicRingBufferClass::DynamicRingBufferClass()
+{
+    m_buffer = nullptr;
+    m_size = 0;
+    m_position = 0;
+    m_wrapCount = 0;
+    m_mapCount = 0;
+    m_mapped = false;
+}
+
+DynamicRingBufferClass::DynamicRingBufferClass(const DynamicRingBufferClass& other)
+{
+}
+
+DynamicRingBufferClass::~DynamicRingBufferClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// bindFlags is D3D11_BIND_VERTEX_BUFFER and / or D3D11_BIND_INDEX_BUFFER, the only buffers D3D 11.0 allows to be
+// mapped with NO_OVERWRITE.
+bool DynamicRingBufferClass::Initialize(ID3D11Device* device, unsigned int sizeBytes, unsigned int bindFlags)
+{
+    D3D11_BUFFER_DESC bufferDesc;
+    HRESULT result;
+
+    if (sizeBytes == 0) { return false; }
+
+    bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+    bufferDesc.ByteWidth = sizeBytes;
+    bufferDesc.BindFlags = bindFlags;
+    bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    bufferDesc.MiscFlags = 0;
+    bufferDesc.StructureByteStride = 0;
+
+    result = device->CreateBuffer(&bufferDesc, NULL, &m_buffer);
+    if (FAILED(result)) { return false; }
+
+    // Start at the end so the first Map discards, the content of a new buffer is undefined.
+    m_size = sizeBytes;
+    m_position = sizeBytes;
+    m_wrapCount = 0;
+    m_mapCount = 0;
+    m_mapped = false;
+
+    return true;
+}
+
+void DynamicRingBufferClass::Shutdown()
+{
+    RT_RELEASE_ID3D11_PTR(m_buffer);
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void* DynamicRingBufferClass::Map(ID3D11DeviceContext* deviceContext, unsigned int size, unsigned int alignment, unsigned int& offset)
+{
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    D3D11_MAP mapType;
+    unsigned int start;
+    HRESULT result;
+
+    if (m_mapped || (size == 0) || (size > m_size)) { return nullptr; }
+    if (alignment == 0) { alignment = 1; }
+
+    // Take the next range after the previous one, or wrap around to the start of a discarded buffer.
+    start = ((m_position + alignment - 1) / alignment) * alignment;
+    mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+    if ((start >= m_size) || (size > (m_size - start))) {
+        start = 0;
+        mapType = D3D11_MAP_WRITE_DISCARD;
+        m_wrapCount++;
+    }
+
+    result = deviceContext->Map(m_buffer, 0, mapType, 0, &mappedResource);
+    if (FAILED(result)) { return nullptr; }
+
+    m_position = start + size;
+    m_mapCount++;
+    m_mapped = true;
+    offset = start;
+
+    return (unsigned char*)mappedResource.pData + start;
+}
+
+void DynamicRingBufferClass::Unmap(ID3D11DeviceContext* deviceContext)
+{
+    if (!m_mapped) { return; }
+
+    deviceContext->Unmap(m_buffer, 0);
+    m_mapped = false;
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+ID3D11Buffer* DynamicRingBufferClass::GetBuffer()
+{
+    return m_buffer;
+}
+
+unsigned int DynamicRingBufferClass::GetSize()
+{
+    return m_size;
+}
+
+unsigned int DynamicRingBufferClass::GetWrapCount()
+{
+    return m_wrapCount;
+}
+
+unsigned int DynamicRingBufferClass::GetMapCount()
+{
+    return m_mapCount;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
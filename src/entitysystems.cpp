@@ -0,0 +1,286 @@
+// Filename: entitysystems.cpp
+#include "entitysystems.h"
+
+#include <atomic>
+#include <math.h>
+#include <xmmintrin.h>
+
+// --------------------------------------------------------------------------------------------------------------------
+// Quaternion of a roll (Z), then pitch (X), then yaw (Y) rotation, XMQuaternionRotationRollPitchYaw.
+static void RollPitchYawQuaternion(float pitch, float yaw, float roll, float quaternion[4])
+{
+    float sp = sinf(pitch * 0.5f), cp = cosf(pitch * 0.5f);
+    float sy = sinf(yaw * 0.5f), cy = cosf(yaw * 0.5f);
+    float sr = sinf(roll * 0.5f), cr = cosf(roll * 0.5f);
+
+    quaternion[0] = sp * cy * cr + cp * sy * sr;
+    quaternion[1] = cp * sy * cr - sp * cy * sr;
+    quaternion[2] = cp * cy * sr - sp * sy * cr;
+    quaternion[3] = cp * cy * cr + sp * sy * sr;
+
+    return;
+}
+
+void UpdateSpinSystem(EntityWorldClass& world, float rotation, bool useThreads)
+{
+    unsigned int mask = COMPONENT_BIT(COMPONENT_SPIN) | COMPONENT_BIT(COMPONENT_TRANSFORM);
+
+    world.ForEachChunk(mask, ENTITY_SYSTEM_GRAIN, useThreads, [rotation](const EntityChunkType& chunk) {
+        const SpinComponent* spins = (const SpinComponent*)chunk.components[COMPONENT_SPIN];
+        SceneTransformType* transforms = (SceneTransformType*)chunk.components[COMPONENT_TRANSFORM];
+
+        for (int i = 0; i < chunk.count; i++) {
+            const SpinComponent& spin = spins[i];
+            RollPitchYawQuaternion(spin.pitch, spin.yaw + spin.speed * rotation + spin.phase, spin.roll, transforms[i].rotation);
+        }
+    });
+
+    return;
+}
+
+void UpdateTransformSystem(EntityWorldClass& world, bool useThreads)
+{
+    unsigned int mask = COMPONENT_BIT(COMPONENT_TRANSFORM) | COMPONENT_BIT(COMPONENT_WORLD);
+
+    world.ForEachChunk(mask, ENTITY_SYSTEM_GRAIN, useThreads, [](const EntityChunkType& chunk) {
+        const SceneTransformType* transforms = (const SceneTransformType*)chunk.components[COMPONENT_TRANSFORM];
+        SceneMatrixType* worlds = (SceneMatrixType*)chunk.components[COMPONENT_WORLD];
+
+        for (int i = 0; i < chunk.count; i++) { SceneGraphClass::ComputeLocalMatrix(transforms[i], worlds[i]); }
+    });
+
+    return;
+}
+
+// The world box of a bounding sphere: its center in world space, the radius grown by the largest scale of the matrix.
+static void WorldSphereBox(const SceneMatrixType& world, const BoundsComponent& sphere, float boxMin[3], float boxMax[3])
+{
+    const float* m = world.m;
+    float scale0 = m[0] * m[0] + m[1] * m[1] + m[2] * m[2];
+    float scale1 = m[4] * m[4] + m[5] * m[5] + m[6] * m[6];
+    float scale2 = m[8] * m[8] + m[9] * m[9] + m[10] * m[10];
+    float maxScale = (scale0 > scale1) ? scale0 : scale1;
+    if (scale2 > maxScale) { maxScale = scale2; }
+    float radius = sphere.radius * sqrtf(maxScale);
+
+    for (int axis = 0; axis < 3; axis++) {
+        float center = sphere.center[0] * m[axis] + sphere.center[1] * m[4 + axis] + sphere.center[2] * m[8 + axis] + m[12 + axis];
+        boxMin[axis] = center - radius;
+        boxMax[axis] = center + radius;
+    }
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// With row vectors clip = v * M, so every clip coordinate is the dot product with a column of M: the planes are sums
+// and differences of the columns (Gribb / Hartmann).
+void ComputeFrustumPlanes(const SceneMatrixType& viewProjection, float planes[6][4])
+{
+    const float* m = viewProjection.m;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        float x = m[4 * i], y = m[4 * i + 1], z = m[4 * i + 2], w = m[4 * i + 3];
+        planes[0][i] = w + x;       // Left
+        planes[1][i] = w - x;       // Right
+        planes[2][i] = w + y;       // Bottom
+        planes[3][i] = w - y;       // Top
+        planes[4][i] = z;           // Near, z >= 0
+        planes[5][i] = w - z;       // Far
+    }
+
+    // Normalized so the plane distance compares with the sphere radius.
+    for (i = 0; i < 6; i++) {
+        float length = sqrtf(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] + planes[i][2] * planes[i][2]);
+        if (length > 0.0f) {
+            planes[i][0] /= length;
+            planes[i][1] /= length;
+            planes[i][2] /= length;
+            planes[i][3] /= length;
+        }
+    }
+
+    return;
+}
+
+// The six planes are tested at once, as two groups of four lanes (the last two lanes of the second group repeat a
+// plane). A sphere is out when it is fully behind any plane.
+int UpdateCullingSystem(EntityWorldClass& world, const float planes[6][4], bool useThreads)
+{
+    unsigned int mask = COMPONENT_BIT(COMPONENT_WORLD) | COMPONENT_BIT(COMPONENT_BOUNDS) | COMPONENT_BIT(COMPONENT_RENDERABLE);
+    std::atomic<int> visibleCount(0);
+    __m128 planeX[2], planeY[2], planeZ[2], planeD[2];
+
+    planeX[0] = _mm_setr_ps(planes[0][0], planes[1][0], planes[2][0], planes[3][0]);
+    planeY[0] = _mm_setr_ps(planes[0][1], planes[1][1], planes[2][1], planes[3][1]);
+    planeZ[0] = _mm_setr_ps(planes[0][2], planes[1][2], planes[2][2], planes[3][2]);
+    planeD[0] = _mm_setr_ps(planes[0][3], planes[1][3], planes[2][3], planes[3][3]);
+    planeX[1] = _mm_setr_ps(planes[4][0], planes[5][0], planes[5][0], planes[5][0]);
+    planeY[1] = _mm_setr_ps(planes[4][1], planes[5][1], planes[5][1], planes[5][1]);
+    planeZ[1] = _mm_setr_ps(planes[4][2], planes[5][2], planes[5][2], planes[5][2]);
+    planeD[1] = _mm_setr_ps(planes[4][3], planes[5][3], planes[5][3], planes[5][3]);
+
+    world.ForEachChunk(mask, ENTITY_SYSTEM_GRAIN, useThreads, [&](const EntityChunkType& chunk) {
+        const SceneMatrixType* worlds = (const SceneMatrixType*)chunk.components[COMPONENT_WORLD];
+        const BoundsComponent* bounds = (const BoundsComponent*)chunk.components[COMPONENT_BOUNDS];
+        RenderableComponent* renderables = (RenderableComponent*)chunk.components[COMPONENT_RENDERABLE];
+        int visible = 0;
+
+        for (int i = 0; i < chunk.count; i++) {
+            const float* m = worlds[i].m;
+            const BoundsComponent& sphere = bounds[i];
+
+            // Center in world space, and the radius grown by the largest scale of the world matrix.
+            float cx = sphere.center[0] * m[0] + sphere.center[1] * m[4] + sphere.center[2] * m[8] + m[12];
+            float cy = sphere.center[0] * m[1] + sphere.center[1] * m[5] + sphere.center[2] * m[9] + m[13];
+            float cz = sphere.center[0] * m[2] + sphere.center[1] * m[6] + sphere.center[2] * m[10] + m[14];
+            float scale0 = m[0] * m[0] + m[1] * m[1] + m[2] * m[2];
+            float scale1 = m[4] * m[4] + m[5] * m[5] + m[6] * m[6];
+            float scale2 = m[8] * m[8] + m[9] * m[9] + m[10] * m[10];
+            float maxScale = (scale0 > scale1) ? scale0 : scale1;
+            if (scale2 > maxScale) { maxScale = scale2; }
+            __m128 minusRadius = _mm_set1_ps(-sphere.radius * sqrtf(maxScale));
+
+            __m128 x = _mm_set1_ps(cx), y = _mm_set1_ps(cy), z = _mm_set1_ps(cz);
+            __m128 distance0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[0], x), _mm_mul_ps(planeY[0], y)), _mm_add_ps(_mm_mul_ps(planeZ[0], z), planeD[0]));
+            __m128 distance1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[1], x), _mm_mul_ps(planeY[1], y)), _mm_add_ps(_mm_mul_ps(planeZ[1], z), planeD[1]));
+            int outside = _mm_movemask_ps(_mm_or_ps(_mm_cmplt_ps(distance0, minusRadius), _mm_cmplt_ps(distance1, minusRadius)));
+
+            renderables[i].visible = (outside == 0) ? 1 : 0;
+            visible += renderables[i].visible;
+        }
+
+        visibleCount += visible;
+    });
+
+    return visibleCount;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// The occluders are placed on the calling thread, the buffer keeps one triangle list; the rasterization is parallel.
+void RasterizeOccluderSystem(EntityWorldClass& world, OcclusionBufferClass& buffer, bool useThreads)
+{
+    unsigned int mask = COMPONENT_BIT(COMPONENT_OCCLUDER) | COMPONENT_BIT(COMPONENT_WORLD);
+
+    world.ForEachChunk(mask, ENTITY_SYSTEM_GRAIN, false, [&](const EntityChunkType& chunk) {
+        const OccluderComponent* occluders = (const OccluderComponent*)chunk.components[COMPONENT_OCCLUDER];
+        const SceneMatrixType* worlds = (const SceneMatrixType*)chunk.components[COMPONENT_WORLD];
+
+        for (int i = 0; i < chunk.count; i++) { buffer.AddOccluder(occluders[i].mesh, worlds[i].m); }
+    });
+
+    buffer.Rasterize(useThreads);
+
+    return;
+}
+
+int UpdateOcclusionSystem(EntityWorldClass& world, const OcclusionBufferClass& buffer, bool useThreads)
+{
+    unsigned int mask = COMPONENT_BIT(COMPONENT_WORLD) | COMPONENT_BIT(COMPONENT_BOUNDS) | COMPONENT_BIT(COMPONENT_RENDERABLE);
+    std::atomic<int> hiddenCount(0);
+
+    world.ForEachChunk(mask, ENTITY_SYSTEM_GRAIN, useThreads, [&](const EntityChunkType& chunk) {
+        const SceneMatrixType* worlds = (const SceneMatrixType*)chunk.components[COMPONENT_WORLD];
+        const BoundsComponent* bounds = (const BoundsComponent*)chunk.components[COMPONENT_BOUNDS];
+        RenderableComponent* renderables = (RenderableComponent*)chunk.components[COMPONENT_RENDERABLE];
+        int hidden = 0;
+
+        // An occluder would only be tested against itself.
+        if (chunk.components[COMPONENT_OCCLUDER]) { return; }
+
+        for (int i = 0; i < chunk.count; i++) {
+            if (!renderables[i].visible) { continue; }
+
+            float boxMin[3], boxMax[3];
+            WorldSphereBox(worlds[i], bounds[i], boxMin, boxMax);
+            if (!buffer.TestBox(boxMin, boxMax)) {
+                renderables[i].visible = 0;
+                hidden++;
+            }
+        }
+
+        hiddenCount += hidden;
+    });
+
+    return hiddenCount;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void UpdateBoundsTreeSystem(EntityWorldClass& world, BoundsTreeClass& tree, bool useThreads)
+{
+    unsigned int mask = COMPONENT_BIT(COMPONENT_WORLD) | COMPONENT_BIT(COMPONENT_BOUNDS);
+
+    world.ForEachChunk(mask, ENTITY_SYSTEM_GRAIN, useThreads, [&](const EntityChunkType& chunk) {
+        const SceneMatrixType* worlds = (const SceneMatrixType*)chunk.components[COMPONENT_WORLD];
+        const BoundsComponent* bounds = (const BoundsComponent*)chunk.components[COMPONENT_BOUNDS];
+        float boxMin[3], boxMax[3];
+
+        for (int i = 0; i < chunk.count; i++) {
+            if (bounds[i].proxy < 0) { continue; }
+
+            WorldSphereBox(worlds[i], bounds[i], boxMin, boxMax);
+            tree.SetBox(bounds[i].proxy, boxMin, boxMax);
+        }
+    });
+
+    tree.Update();
+
+    return;
+}
+
+int UpdateTreeCullingSystem(EntityWorldClass& world, const BoundsTreeClass& tree, const float planes[6][4], const OcclusionBufferClass* occlusion,
+                            std::vector<unsigned int>& visibleEntities)
+{
+    world.ForEachChunk(COMPONENT_BIT(COMPONENT_RENDERABLE), ENTITY_SYSTEM_GRAIN, false, [](const EntityChunkType& chunk) {
+        RenderableComponent* renderables = (RenderableComponent*)chunk.components[COMPONENT_RENDERABLE];
+
+        for (int i = 0; i < chunk.count; i++) { renderables[i].visible = 0; }
+    });
+
+    visibleEntities.clear();
+    tree.QueryFrustum(planes, occlusion, visibleEntities);
+
+    int visibleCount = 0;
+    for (EntityId entity : visibleEntities) {
+        RenderableComponent* renderable = world.Get<RenderableComponent>(entity, COMPONENT_RENDERABLE);
+        if (renderable) {
+            renderable->visible = 1;
+            visibleCount++;
+        }
+    }
+
+    return visibleCount;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+float SubmitRenderSystem(EntityWorldClass& world, const SceneMatrixType& view, float farZ, RenderQueueClass* queue, unsigned int payloadBase,
+                         std::vector<SceneMatrixType>& visibleWorlds)
+{
+    unsigned int mask = COMPONENT_BIT(COMPONENT_WORLD) | COMPONENT_BIT(COMPONENT_RENDERABLE);
+    const float* v = view.m;
+    float nearestDepth = farZ;
+
+    // Submitted in order on the calling thread, the queue and the output array are not shared.
+    world.ForEachChunk(mask, ENTITY_SYSTEM_GRAIN, false, [&](const EntityChunkType& chunk) {
+        const SceneMatrixType* worlds = (const SceneMatrixType*)chunk.components[COMPONENT_WORLD];
+        const RenderableComponent* renderables = (const RenderableComponent*)chunk.components[COMPONENT_RENDERABLE];
+
+        for (int i = 0; i < chunk.count; i++) {
+            if (!renderables[i].visible) { continue; }
+
+            // View depth of the origin of the entity, the third column of the view matrix.
+            const float* m = worlds[i].m;
+            float depth = m[12] * v[2] + m[13] * v[6] + m[14] * v[10] + v[14];
+            if (depth < nearestDepth) { nearestDepth = depth; }
+
+            if (queue) {
+                queue->Submit(queue->MakeKey(RENDER_PASS_OPAQUE, renderables[i].variant, renderables[i].texture, renderables[i].material, depth),
+                              payloadBase + (unsigned int)visibleWorlds.size());
+            }
+            visibleWorlds.push_back(worlds[i]);
+        }
+    });
+
+    return nearestDepth;
+}
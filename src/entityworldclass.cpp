@@ -0,0 +1,282 @@
+// Filename: entityworldclass.cpp
+#include "entityworldclass.h"
+#include "rtparallel.h"
+
+#include <cstring>
+
+#define ENTITY_INDEX_MASK ((1u << ENTITY_INDEX_BITS) - 1)
+
+// Bytes of one component of every type, in ComponentType order.
+static const size_t s_componentSizes[COMPONENT_COUNT] = {
+    sizeof(SceneTransformType),
+    sizeof(SceneMatrixType),
+    sizeof(BoundsComponent),
+    sizeof(SpinComponent),
+    sizeof(RenderableComponent),
+    sizeof(LightComponent),
+    sizeof(OccluderComponent),
+};
+
+// The columns come from operator new (16 byte aligned on the 64 bit targets), the components the systems read with SSE
+// stay aligned from row to row.
+static_assert((sizeof(SceneTransformType) % 16) == 0 && (sizeof(SceneMatrixType) % 16) == 0, "SSE components must keep 16 byte rows");
+
+// --------------------------------------------------------------------------------------------------------------------
+EntityWorldClass::EntityWorldClass()
+{
+    m_entityCount = 0;
+    m_initialCapacity = 0;
+}
+
+EntityWorldClass::EntityWorldClass(const EntityWorldClass& other)
+{
+}
+
+EntityWorldClass::~EntityWorldClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool EntityWorldClass::Initialize(int initialCapacity)
+{
+    if (initialCapacity < 0) { return false; }
+
+    // Every archetype reserves this many entities when it is created, the records are reserved once.
+    m_initialCapacity = initialCapacity;
+    m_records.reserve(initialCapacity);
+    m_entityCount = 0;
+
+    return true;
+}
+
+void EntityWorldClass::Shutdown()
+{
+    m_archetypes.clear();
+    m_records.clear();
+    m_freeRecords.clear();
+    m_entityCount = 0;
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+EntityWorldClass::EntityRecordType* EntityWorldClass::GetRecord(EntityId entity)
+{
+    unsigned int index = entity & ENTITY_INDEX_MASK;
+
+    if ((entity == ENTITY_INVALID) || (index >= m_records.size())) { return nullptr; }
+    if ((m_records[index].archetype < 0) || (m_records[index].generation != (entity >> ENTITY_INDEX_BITS))) { return nullptr; }
+
+    return &m_records[index];
+}
+
+int EntityWorldClass::FindArchetype(unsigned int mask)
+{
+    int i;
+
+    for (i = 0; i < (int)m_archetypes.size(); i++) {
+        if (m_archetypes[i].mask == mask) { return i; }
+    }
+
+    ArchetypeType archetype;
+    archetype.mask = mask;
+    archetype.count = 0;
+    archetype.entities.reserve(m_initialCapacity);
+    for (i = 0; i < COMPONENT_COUNT; i++) {
+        if (mask & COMPONENT_BIT(i)) { archetype.columns[i].reserve(m_initialCapacity * s_componentSizes[i]); }
+    }
+    m_archetypes.push_back(std::move(archetype));
+
+    return (int)m_archetypes.size() - 1;
+}
+
+// A new row at the end of the archetype, its components are set to their defaults.
+int EntityWorldClass::AppendRow(int archetypeIndex, EntityId entity)
+{
+    static const SceneTransformType identityTransform = { { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f, 0.0f } };
+    static const SceneMatrixType identityMatrix = { { 1.0f, 0.0f, 0.0f, 0.0f,  0.0f, 1.0f, 0.0f, 0.0f,  0.0f, 0.0f, 1.0f, 0.0f,  0.0f, 0.0f, 0.0f, 1.0f } };
+    static const BoundsComponent noBounds = { { 0.0f, 0.0f, 0.0f }, 0.0f, -1 };
+    ArchetypeType& archetype = m_archetypes[archetypeIndex];
+    int row = archetype.count;
+    int i;
+
+    archetype.entities.push_back(entity);
+    for (i = 0; i < COMPONENT_COUNT; i++) {
+        if (!(archetype.mask & COMPONENT_BIT(i))) { continue; }
+
+        std::vector<unsigned char>& column = archetype.columns[i];
+        column.resize(column.size() + s_componentSizes[i], 0);
+        if (i == COMPONENT_TRANSFORM) { memcpy(&column[row * s_componentSizes[i]], &identityTransform, sizeof(identityTransform)); }
+        if (i == COMPONENT_WORLD) { memcpy(&column[row * s_componentSizes[i]], &identityMatrix, sizeof(identityMatrix)); }
+        if (i == COMPONENT_BOUNDS) { memcpy(&column[row * s_componentSizes[i]], &noBounds, sizeof(noBounds)); }
+    }
+    archetype.count++;
+
+    return row;
+}
+
+// The last entity of the archetype takes the place of the removed row.
+void EntityWorldClass::RemoveRow(int archetypeIndex, int row)
+{
+    ArchetypeType& archetype = m_archetypes[archetypeIndex];
+    int last = archetype.count - 1;
+    int i;
+
+    if (row != last) {
+        for (i = 0; i < COMPONENT_COUNT; i++) {
+            if (!(archetype.mask & COMPONENT_BIT(i))) { continue; }
+            memcpy(&archetype.columns[i][row * s_componentSizes[i]], &archetype.columns[i][last * s_componentSizes[i]], s_componentSizes[i]);
+        }
+        archetype.entities[row] = archetype.entities[last];
+        m_records[archetype.entities[row] & ENTITY_INDEX_MASK].row = row;
+    }
+
+    archetype.entities.pop_back();
+    for (i = 0; i < COMPONENT_COUNT; i++) {
+        if (archetype.mask & COMPONENT_BIT(i)) { archetype.columns[i].resize(last * s_componentSizes[i]); }
+    }
+    archetype.count--;
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+EntityId EntityWorldClass::CreateEntity(unsigned int componentMask)
+{
+    EntityRecordType* record;
+    unsigned int index;
+    int archetype;
+
+    if (componentMask >= COMPONENT_BIT(COMPONENT_COUNT)) { return ENTITY_INVALID; }
+
+    if (!m_freeRecords.empty()) {
+        index = m_freeRecords.back();
+        m_freeRecords.pop_back();
+    } else {
+        index = (unsigned int)m_records.size();
+        if (index > ENTITY_INDEX_MASK) { return ENTITY_INVALID; }
+        m_records.push_back({ -1, 0, 0 });
+    }
+
+    EntityId entity = index | (m_records[index].generation << ENTITY_INDEX_BITS);
+    archetype = FindArchetype(componentMask);
+    record = &m_records[index];
+    record->archetype = archetype;
+    record->row = AppendRow(archetype, entity);
+    m_entityCount++;
+
+    return entity;
+}
+
+void EntityWorldClass::DestroyEntity(EntityId entity)
+{
+    EntityRecordType* record = GetRecord(entity);
+
+    if (!record) { return; }
+
+    RemoveRow(record->archetype, record->row);
+
+    // The next entity using the record gets another generation, the handles of this one go stale.
+    record->archetype = -1;
+    record->generation = (record->generation + 1) & ((1u << (32 - ENTITY_INDEX_BITS)) - 1);
+    if (((entity & ENTITY_INDEX_MASK) | (record->generation << ENTITY_INDEX_BITS)) == ENTITY_INVALID) { record->generation = 0; }
+    m_freeRecords.push_back(entity & ENTITY_INDEX_MASK);
+    m_entityCount--;
+
+    return;
+}
+
+bool EntityWorldClass::IsAlive(EntityId entity)
+{
+    return GetRecord(entity) != nullptr;
+}
+
+int EntityWorldClass::GetEntityCount()
+{
+    return m_entityCount;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// The components both archetypes have are copied over, the new ones get their defaults.
+bool EntityWorldClass::MoveEntity(EntityId entity, unsigned int newMask)
+{
+    EntityRecordType* record = GetRecord(entity);
+    int oldArchetype, newArchetype, oldRow, newRow, i;
+
+    if (!record || (newMask >= COMPONENT_BIT(COMPONENT_COUNT))) { return false; }
+    if (m_archetypes[record->archetype].mask == newMask) { return true; }
+
+    oldArchetype = record->archetype;
+    oldRow = record->row;
+    newArchetype = FindArchetype(newMask);
+    newRow = AppendRow(newArchetype, entity);
+
+    ArchetypeType& from = m_archetypes[oldArchetype];
+    ArchetypeType& to = m_archetypes[newArchetype];
+    for (i = 0; i < COMPONENT_COUNT; i++) {
+        if ((from.mask & to.mask) & COMPONENT_BIT(i)) {
+            memcpy(&to.columns[i][newRow * s_componentSizes[i]], &from.columns[i][oldRow * s_componentSizes[i]], s_componentSizes[i]);
+        }
+    }
+
+    RemoveRow(oldArchetype, oldRow);
+    record = &m_records[entity & ENTITY_INDEX_MASK];
+    record->archetype = newArchetype;
+    record->row = newRow;
+
+    return true;
+}
+
+bool EntityWorldClass::AddComponents(EntityId entity, unsigned int componentMask)
+{
+    return MoveEntity(entity, GetComponentMask(entity) | componentMask);
+}
+
+bool EntityWorldClass::RemoveComponents(EntityId entity, unsigned int componentMask)
+{
+    return MoveEntity(entity, GetComponentMask(entity) & ~componentMask);
+}
+
+unsigned int EntityWorldClass::GetComponentMask(EntityId entity)
+{
+    EntityRecordType* record = GetRecord(entity);
+
+    return record ? m_archetypes[record->archetype].mask : 0;
+}
+
+void* EntityWorldClass::GetComponent(EntityId entity, ComponentType type)
+{
+    EntityRecordType* record = GetRecord(entity);
+
+    if (!record || !(m_archetypes[record->archetype].mask & COMPONENT_BIT(type))) { return nullptr; }
+
+    return &m_archetypes[record->archetype].columns[type][record->row * s_componentSizes[type]];
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void EntityWorldClass::ForEachChunk(unsigned int componentMask, int grain, bool useThreads, const ChunkFunction& function)
+{
+    if (grain < 1) { grain = 1; }
+
+    for (auto& archetype : m_archetypes) {
+        if (((archetype.mask & componentMask) != componentMask) || (archetype.count == 0)) { continue; }
+
+        auto runChunk = [&](int begin, int end) {
+            EntityChunkType chunk;
+            chunk.count = end - begin;
+            chunk.entities = &archetype.entities[begin];
+            for (int i = 0; i < COMPONENT_COUNT; i++) {
+                chunk.components[i] = (archetype.mask & COMPONENT_BIT(i)) ? &archetype.columns[i][begin * s_componentSizes[i]] : nullptr;
+            }
+            function(chunk);
+        };
+
+        if (useThreads && (archetype.count >= 2 * grain)) {
+            RTParallelFor(archetype.count, grain, runChunk);
+        } else {
+            runChunk(0, archetype.count);
+        }
+    }
+
+    return;
+}
@@ -0,0 +1,135 @@
+// Filename: fontclass.cpp
+#include "fontclass.h"
+#include <fstream>
+using namespace std;
+
+// --------------------------------------------------------------------------------------------------------------------
+FontClass::FontClass()
+{
+    m_Texture = nullptr;
+    m_atlasWidth = 0;
+    m_atlasHeight = 0;
+    m_lineHeight = 0;
+}
+
+FontClass::FontClass(const FontClass& other)
+{
+}
+
+FontClass::~FontClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool FontClass::Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext, char* fontFilename)
+{
+    bool result;
+    char atlasFilename[128];
+
+    // Load in the text file containing the font data.
+    result = LoadFontData(fontFilename, atlasFilename);
+    if (!result) { return false; }
+
+    // Load the atlas texture, the glyph coverage is in its alpha channel.
+    m_Texture = new TextureClass;
+    result = m_Texture->Initialize(device, deviceContext, atlasFilename);
+    if (!result) { return false; }
+
+    return true;
+}
+
+void FontClass::Shutdown()
+{
+    RT_SHUTDOWN_OBJ_PTR(m_Texture);
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// The font file is the header written by the atlas tool (atlas name, atlas size, line height...) followed by one line
+// per character: id x y width height xoffset yoffset xadvance, all in pixels.
+bool FontClass::LoadFontData(char* filename, char* atlasFilename)
+{
+    ifstream fin;
+    char input;
+    int pixelHeight, base, glyphCount, id, x, y, width, height, xOffset, yOffset, xAdvance, i;
+
+    fin.open(filename);
+    if (fin.fail()) { return false; }
+
+    // Skip the font name line.
+    fin.get(input);
+    while (input != '\n') { fin.get(input); }
+
+    // Read in the atlas file name, the rest of its line after the colon.
+    fin.get(input);
+    while (input != ':') { fin.get(input); }
+    fin >> atlasFilename;
+
+    // Read in the atlas size.
+    fin.get(input);
+    while (input != ':') { fin.get(input); }
+    fin >> m_atlasWidth >> m_atlasHeight;
+    if ((m_atlasWidth <= 0) || (m_atlasHeight <= 0)) { return false; }
+
+    // Read in the pixel height, the line height (distance between two lines) and the base line.
+    fin.get(input);
+    while (input != ':') { fin.get(input); }
+    fin >> pixelHeight;
+    fin.get(input);
+    while (input != ':') { fin.get(input); }
+    fin >> m_lineHeight;
+    fin.get(input);
+    while (input != ':') { fin.get(input); }
+    fin >> base;
+
+    // Read in the glyph count and then up to the beginning of the data.
+    fin.get(input);
+    while (input != ':') { fin.get(input); }
+    fin >> glyphCount;
+    fin.get(input);
+    while (input != ':') { fin.get(input); }
+    fin.get(input);
+    while (input != '\n') { fin.get(input); }
+
+    // Characters missing from the file are drawn as nothing.
+    ZeroMemory(m_glyphs, sizeof(m_glyphs));
+
+    for (i = 0; i < glyphCount; i++) {
+        fin >> id >> x >> y >> width >> height >> xOffset >> yOffset >> xAdvance;
+        if (fin.fail()) { return false; }
+        if ((id < FONT_FIRST_CHAR) || (id > FONT_LAST_CHAR)) { continue; }
+
+        GlyphType& glyph = m_glyphs[id - FONT_FIRST_CHAR];
+        glyph.uvRect = XMFLOAT4((float)x / (float)m_atlasWidth, (float)y / (float)m_atlasHeight,
+                                (float)(x + width) / (float)m_atlasWidth, (float)(y + height) / (float)m_atlasHeight);
+        glyph.width = (float)width;
+        glyph.height = (float)height;
+        glyph.xOffset = (float)xOffset;
+        glyph.yOffset = (float)yOffset;
+        glyph.xAdvance = (float)xAdvance;
+    }
+
+    fin.close();
+
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+ID3D11ShaderResourceView* FontClass::GetTexture()
+{
+    return m_Texture->GetTexture();
+}
+
+// Characters outside of the atlas are drawn as a space.
+const FontClass::GlyphType* FontClass::GetGlyph(char character)
+{
+    if ((character < FONT_FIRST_CHAR) || (character > FONT_LAST_CHAR)) { character = ' '; }
+    return &m_glyphs[character - FONT_FIRST_CHAR];
+}
+
+int FontClass::GetLineHeight()
+{
+    return m_lineHeight;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,152 @@
+// Filename: frameclockclass.cpp
+#include "frameclockclass.h"
+
+#include <algorithm>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+FrameClockClass::FrameClockClass()
+{
+    m_stepTime = 0.0;
+    m_frameTime = 0.0;
+    m_accumulator = 0.0;
+    m_framePeriod = 0.0;
+    m_oversleep = 0.0;
+    m_timer = nullptr;
+}
+
+FrameClockClass::FrameClockClass(const FrameClockClass& other)
+{
+}
+
+FrameClockClass::~FrameClockClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool FrameClockClass::Initialize(float stepTime)
+{
+    if (stepTime <= 0.0f) { return false; }
+
+    m_stepTime = stepTime;
+    m_frameTime = 0.0;
+    m_accumulator = 0.0;
+    m_oversleep = 0.0;
+    m_frameStart = m_deadline = ClockType::now();
+
+#ifdef _WIN32
+    if (m_timer == nullptr) {
+        m_timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (m_timer == nullptr) { m_timer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS); }
+        if (m_timer == nullptr) { return false; }
+    }
+#endif
+
+    return true;
+}
+
+void FrameClockClass::Shutdown()
+{
+#ifdef _WIN32
+    if (m_timer) { CloseHandle((HANDLE)m_timer); }
+#endif
+    m_timer = nullptr;
+
+    return;
+}
+
+void FrameClockClass::SetFrameRateLimit(float framesPerSecond)
+{
+    m_framePeriod = (framesPerSecond > 0.0f) ? 1.0 / framesPerSecond : 0.0;
+    m_deadline = ClockType::now();
+
+    return;
+}
+
+void FrameClockClass::Reset()
+{
+    m_frameStart = m_deadline = ClockType::now();
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int FrameClockClass::BeginFrame()
+{
+    ClockType::time_point now = ClockType::now();
+    int steps;
+
+    m_frameTime = std::chrono::duration<double>(now - m_frameStart).count();
+    m_frameStart = now;
+
+    // After a stall (a breakpoint, a window drag) the simulation skips ahead instead of running a burst of steps.
+    m_accumulator += std::min(m_frameTime, FRAME_CLOCK_MAX_FRAME_TIME);
+    steps = (int)(m_accumulator / m_stepTime);
+    m_accumulator -= (double)steps * m_stepTime;
+
+    return steps;
+}
+
+void FrameClockClass::WaitForNextFrame()
+{
+    if (m_framePeriod <= 0.0) { return; }
+
+    // Frames are due every period from the last deadline. A frame that came late starts the count again from now
+    // rather than letting the next frames run unlimited to catch up.
+    ClockType::time_point now = ClockType::now();
+    m_deadline += std::chrono::duration_cast<ClockType::duration>(std::chrono::duration<double>(m_framePeriod));
+    if (m_deadline <= now) {
+        m_deadline = now;
+        return;
+    }
+
+    // Step 1: Sleep until the deadline, the timer due time is relative and in 100 ns units. -----------------------
+#ifdef _WIN32
+    LARGE_INTEGER dueTime;
+    dueTime.QuadPart = -(long long)(std::chrono::duration_cast<std::chrono::nanoseconds>(m_deadline - now).count() / 100);
+    if (SetWaitableTimer((HANDLE)m_timer, &dueTime, 0, NULL, NULL, FALSE)) {
+        WaitForSingleObject((HANDLE)m_timer, INFINITE);
+    } else {
+        std::this_thread::sleep_until(m_deadline);
+    }
+#else
+    std::this_thread::sleep_until(m_deadline);
+#endif
+
+    // Step 2: Keep track of how late the waits wake up. ------------------------------------------------------------
+    double overslept = std::chrono::duration<double>(ClockType::now() - m_deadline).count();
+    m_oversleep += 0.05 * (std::max(overslept, 0.0) - m_oversleep);
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+float FrameClockClass::GetStepTime()
+{
+    return (float)m_stepTime;
+}
+
+float FrameClockClass::GetFrameTime()
+{
+    return (float)m_frameTime;
+}
+
+float FrameClockClass::GetInterpolation()
+{
+    return (float)(m_accumulator / m_stepTime);
+}
+
+double FrameClockClass::GetOversleep()
+{
+    return m_oversleep;
+}
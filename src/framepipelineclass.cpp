@@ -0,0 +1,106 @@
+// Filename: framepipelineclass.cpp
+#include "framepipelineclass.h"
+
+// --------------------------------------------------------------------------------------------------------------------
+FramePipelineClass::FramePipelineClass() : m_started(0), m_finished(0), m_quit(false)
+{
+    m_slot = -1;
+}
+
+FramePipelineClass::FramePipelineClass(const FramePipelineClass& other)
+{
+}
+
+FramePipelineClass::~FramePipelineClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool FramePipelineClass::Initialize(const std::function<void(int slot)>& produce)
+{
+    if (!produce || m_thread.joinable()) { return false; }
+
+    m_produce = produce;
+    m_started.store(0);
+    m_finished.store(0);
+    m_quit.store(false);
+    m_slot = -1;
+    m_thread = std::thread(&FramePipelineClass::Run, this);
+
+    return true;
+}
+
+// Waits for the frame in flight, the caller may free the frame states once this returns.
+void FramePipelineClass::Shutdown()
+{
+    if (!m_thread.joinable()) { return; }
+
+    WaitForFrame();
+    m_quit.store(true);
+    Wake(m_started, m_started.load() + 1);
+    m_thread.join();
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void FramePipelineClass::StartFrame(int slot)
+{
+    m_slot = slot;
+    Wake(m_started, m_started.load(std::memory_order_relaxed) + 1);
+
+    return;
+}
+
+int FramePipelineClass::WaitForFrame()
+{
+    int started = m_started.load(std::memory_order_relaxed);
+
+    if (started == 0) { return -1; }
+    Wait(m_finished, started);
+
+    return m_slot;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// The simulation thread: produce every frame started, in order.
+void FramePipelineClass::Run()
+{
+    int frame = 0;
+
+    for (;;) {
+        Wait(m_started, frame + 1);
+        if (m_quit.load(std::memory_order_acquire)) { break; }
+
+        frame++;
+        m_produce(m_slot);
+        Wake(m_finished, frame);
+    }
+
+    return;
+}
+
+// Until the counter reaches the value.
+void FramePipelineClass::Wait(const std::atomic<int>& counter, int value)
+{
+    for (int i = 0; i < FRAME_PIPELINE_SPIN_COUNT; i++) {
+        if (counter.load(std::memory_order_acquire) >= value) { return; }
+    }
+
+    std::unique_lock<std::mutex> lock(m_sleepMutex);
+    m_sleep.wait(lock, [&]() { return counter.load(std::memory_order_acquire) >= value; });
+
+    return;
+}
+
+// The store is published under the mutex, so a thread about to sleep either sees the new value or is woken.
+void FramePipelineClass::Wake(std::atomic<int>& counter, int value)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        counter.store(value, std::memory_order_release);
+    }
+    m_sleep.notify_all();
+
+    return;
+}
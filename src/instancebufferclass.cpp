@@ -0,0 +1,97 @@
+// Filename: instancebufferclass.cpp
+#include "instancebufferclass.h"
+
+// --------------------------------------------------------------------------------------------------------------------
+InstanceBufferClass::InstanceBufferClass()
+{
+    m_instanceBuffer = nullptr;
+    m_StateCache = nullptr;
+    m_maxInstances = 0;
+    m_instanceCount = 0;
+}
+
+InstanceBufferClass::InstanceBufferClass(const InstanceBufferClass& other)
+{
+}
+
+InstanceBufferClass::~InstanceBufferClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool InstanceBufferClass::Initialize(ID3D11Device* device, int maxInstances)
+{
+    D3D11_BUFFER_DESC instanceBufferDesc;
+    HRESULT result;
+
+    if (maxInstances < 1) { return false; }
+    m_maxInstances = maxInstances;
+    m_instanceCount = 0;
+
+    // The instances move every frame, so the buffer is dynamic and rewritten with Update.
+    instanceBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+    instanceBufferDesc.ByteWidth = sizeof(InstanceType) * m_maxInstances;
+    instanceBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    instanceBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    instanceBufferDesc.MiscFlags = 0;
+    instanceBufferDesc.StructureByteStride = 0;
+
+    result = device->CreateBuffer(&instanceBufferDesc, NULL, &m_instanceBuffer);
+    if (FAILED(result)) { return false; }
+
+    return true;
+}
+
+void InstanceBufferClass::Shutdown()
+{
+    RT_RELEASE_ID3D11_PTR(m_instanceBuffer);
+    return;
+}
+
+// Optional, the input assembler state is then bound through the cache and binds matching the current state are dropped.
+void InstanceBufferClass::SetStateCache(RenderStateCacheClass* stateCache)
+{
+    m_StateCache = stateCache;
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool InstanceBufferClass::Update(ID3D11DeviceContext* deviceContext, const XMMATRIX* worldMatrices, int instanceCount)
+{
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    InstanceType* dataPtr;
+    HRESULT result;
+    int i;
+
+    if ((instanceCount < 0) || (instanceCount > m_maxInstances)) { return false; }
+
+    result = deviceContext->Map(m_instanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+    if (FAILED(result)) { return false; }
+
+    dataPtr = (InstanceType*)mappedResource.pData;
+    for (i = 0; i < instanceCount; i++) { XMStoreFloat4x4(&dataPtr[i].world, worldMatrices[i]); }
+
+    deviceContext->Unmap(m_instanceBuffer, 0);
+    m_instanceCount = instanceCount;
+
+    return true;
+}
+
+// Bind the instance stream next to the vertex buffer the model put on the input assembler.
+void InstanceBufferClass::Render(ID3D11DeviceContext* deviceContext)
+{
+    unsigned int stride = sizeof(InstanceType);
+    unsigned int offset = 0;
+
+    if (m_StateCache) { m_StateCache->SetVertexBuffer(deviceContext, INSTANCE_INPUT_SLOT, m_instanceBuffer, stride, offset); }
+    else { deviceContext->IASetVertexBuffers(INSTANCE_INPUT_SLOT, 1, &m_instanceBuffer, &stride, &offset); }
+
+    return;
+}
+
+int InstanceBufferClass::GetInstanceCount()
+{
+    return m_instanceCount;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,388 @@
+// Filename: jobsystemclass.cpp
+#include "jobsystemclass.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// The job system the current thread is a worker of, and its index there.
+static thread_local JobSystemClass* s_jobSystem = nullptr;
+static thread_local int s_worker = -1;
+static thread_local unsigned int s_random = 0;
+
+// A parallel loop: its chunks are handed out through an atomic counter to the caller and the helper jobs.
+struct ParallelForType
+{
+    const std::function<void(int begin, int end)>* func;
+    int count, grain, chunkCount;
+    std::atomic<int> nextChunk;
+};
+
+static void RunParallelForChunks(void* data)
+{
+    ParallelForType* loop = (ParallelForType*)data;
+
+    for (int chunk = loop->nextChunk.fetch_add(1); chunk < loop->chunkCount; chunk = loop->nextChunk.fetch_add(1)) {
+        int begin = chunk * loop->grain;
+        (*loop->func)(begin, std::min(begin + loop->grain, loop->count));
+    }
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+JobSystemClass::JobDequeType::JobDequeType() : m_top(0), m_bottom(0)
+{
+    for (auto& job : m_jobs) { job.store(nullptr, std::memory_order_relaxed); }
+}
+
+bool JobSystemClass::JobDequeType::Push(JobType* job)
+{
+    long long bottom = m_bottom.load(std::memory_order_relaxed);
+    long long top = m_top.load(std::memory_order_acquire);
+
+    if (bottom - top >= JOB_SYSTEM_DEQUE_SIZE) { return false; }
+
+    m_jobs[bottom & (JOB_SYSTEM_DEQUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+    m_bottom.store(bottom + 1, std::memory_order_release);
+
+    return true;
+}
+
+// Taking the bottom back before reading the top keeps a thief from taking the same job. Only the last job can be
+// contended, the owner and the thieves then race for it on the top.
+JobType* JobSystemClass::JobDequeType::Pop()
+{
+    long long bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(bottom, std::memory_order_seq_cst);
+    long long top = m_top.load(std::memory_order_seq_cst);
+
+    if (top > bottom) {
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    JobType* job = m_jobs[bottom & (JOB_SYSTEM_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) { job = nullptr; }
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    return job;
+}
+
+JobType* JobSystemClass::JobDequeType::Steal()
+{
+    long long top = m_top.load(std::memory_order_seq_cst);
+    long long bottom = m_bottom.load(std::memory_order_seq_cst);
+
+    if (top >= bottom) { return nullptr; }
+
+    JobType* job = m_jobs[top & (JOB_SYSTEM_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+    if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) { return nullptr; }
+
+    return job;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+JobSystemClass::JobSystemClass() : m_quit(false), m_queueSize(0), m_signal(0), m_sleeping(0), m_steals(0)
+{
+}
+
+JobSystemClass::JobSystemClass(const JobSystemClass& other)
+{
+}
+
+JobSystemClass::~JobSystemClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool JobSystemClass::Initialize(int workerCount, bool pinThreads)
+{
+    int worker;
+
+    if ((workerCount < 0) || (workerCount > JOB_SYSTEM_MAX_WORKERS) || !m_workers.empty()) { return false; }
+
+    m_quit.store(false);
+    m_steals.store(0);
+
+    // Step 1: The deques, all of them before any worker can steal. ------------------------------------------------
+    for (worker = 0; worker < workerCount; worker++) { m_deques.push_back(new JobDequeType); }
+
+    // Step 2: The workers, one per core when there are enough cores. ----------------------------------------------
+    int coreCount = (int)std::thread::hardware_concurrency();
+    pinThreads = pinThreads && (workerCount < coreCount);
+    for (worker = 0; worker < workerCount; worker++) {
+        m_workers.emplace_back(&JobSystemClass::WorkerThread, this, worker);
+        if (pinThreads) { PinThread(m_workers.back(), worker + 1); }
+    }
+
+    return true;
+}
+
+// The jobs started must all be done.
+void JobSystemClass::Shutdown()
+{
+    m_quit.store(true);
+    WakeWorkers();
+    for (auto& worker : m_workers) { worker.join(); }
+    m_workers.clear();
+
+    for (auto deque : m_deques) { delete deque; }
+    m_deques.clear();
+    m_queue.clear();
+    m_queueSize.store(0);
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// A worker queues the jobs on its own deque, any other thread on the shared queue. Without workers the jobs run here.
+void JobSystemClass::Run(JobType* jobs, int count, JobCounterType& counter)
+{
+    int i;
+
+    if (count <= 0) { return; }
+
+    counter.pending.fetch_add(count, std::memory_order_relaxed);
+    for (i = 0; i < count; i++) { jobs[i].counter = &counter; }
+
+    if (m_workers.empty()) {
+        for (i = 0; i < count; i++) { Execute(&jobs[i]); }
+        return;
+    }
+
+    if (s_jobSystem == this) {
+        for (i = 0; i < count; i++) {
+            if (!m_deques[s_worker]->Push(&jobs[i])) { Execute(&jobs[i]); }
+        }
+    }
+    else {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        for (i = 0; i < count; i++) { m_queue.push_back(&jobs[i]); }
+        m_queueSize.fetch_add(count, std::memory_order_relaxed);
+    }
+    WakeWorkers();
+
+    return;
+}
+
+// Runs jobs until the counter is zero, those of this thread first. With nothing to run it spins for a while, then
+// sleeps with the idle workers until the counter is zero or new jobs are queued.
+void JobSystemClass::Wait(JobCounterType& counter)
+{
+    int idle = 0;
+
+    while (counter.pending.load(std::memory_order_acquire) > 0) {
+        JobType* job = FindJob();
+        if (job) {
+            Execute(job);
+            idle = 0;
+            continue;
+        }
+        if (++idle < JOB_SYSTEM_SPIN_COUNT) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // As the workers do: a job queued after the signal was read changes it, a finished counter is seen under the
+        // mutex or notified by Execute.
+        unsigned int signal = m_signal.load();
+        job = FindJob();
+        if (job) {
+            Execute(job);
+            idle = 0;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleeping.fetch_add(1);
+        m_sleep.wait(lock, [&]() { return (counter.pending.load() == 0) || (m_signal.load() != signal); });
+        m_sleeping.fetch_sub(1);
+        idle = 0;
+    }
+
+    return;
+}
+
+// Helper jobs, one per worker at most, run the chunks along with the caller. A helper that starts after the chunks
+// are all taken just returns.
+void JobSystemClass::ParallelFor(int count, int grain, const std::function<void(int begin, int end)>& func)
+{
+    ParallelForType loop;
+    JobType jobs[JOB_SYSTEM_MAX_WORKERS];
+    JobCounterType counter;
+
+    if (count <= 0) { return; }
+    if (grain < 1) { grain = 1; }
+
+    int chunkCount = (count + grain - 1) / grain;
+    int helperCount = std::min((int)m_workers.size(), chunkCount - 1);
+    if (helperCount <= 0) {
+        func(0, count);
+        return;
+    }
+
+    loop.func = &func;
+    loop.count = count;
+    loop.grain = grain;
+    loop.chunkCount = chunkCount;
+    loop.nextChunk.store(0, std::memory_order_relaxed);
+    for (int i = 0; i < helperCount; i++) {
+        jobs[i].function = RunParallelForChunks;
+        jobs[i].data = &loop;
+    }
+
+    Run(jobs, helperCount, counter);
+    RunParallelForChunks(&loop);
+    Wait(counter);
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int JobSystemClass::GetThreadCount()
+{
+    return (int)m_workers.size() + 1;
+}
+
+unsigned long long JobSystemClass::GetStealCount()
+{
+    return m_steals.load(std::memory_order_relaxed);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void JobSystemClass::WorkerThread(int worker)
+{
+    int idle = 0;
+
+    s_jobSystem = this;
+    s_worker = worker;
+    s_random = 2654435761u * (unsigned int)(worker + 1);
+
+    while (!m_quit.load(std::memory_order_acquire)) {
+        JobType* job = FindJob();
+        if (job) {
+            Execute(job);
+            idle = 0;
+            continue;
+        }
+        if (++idle < JOB_SYSTEM_SPIN_COUNT) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Look once more after reading the signal: a job queued after that look changes the signal.
+        unsigned int signal = m_signal.load();
+        job = FindJob();
+        if (job) {
+            Execute(job);
+            idle = 0;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleeping.fetch_add(1);
+        m_sleep.wait(lock, [&]() { return (m_signal.load() != signal) || m_quit.load(); });
+        m_sleeping.fetch_sub(1);
+        idle = 0;
+    }
+
+    s_jobSystem = nullptr;
+    s_worker = -1;
+
+    return;
+}
+
+// Own deque, then the shared queue, then the other deques from a random one on.
+JobType* JobSystemClass::FindJob()
+{
+    JobType* job;
+    int self = (s_jobSystem == this) ? s_worker : -1;
+    int dequeCount = (int)m_deques.size();
+
+    if (self >= 0) {
+        job = m_deques[self]->Pop();
+        if (job) { return job; }
+    }
+
+    if (m_queueSize.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        if (!m_queue.empty()) {
+            job = m_queue.front();
+            m_queue.pop_front();
+            m_queueSize.fetch_sub(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+
+    if (dequeCount == 0) { return nullptr; }
+    s_random = s_random * 1664525u + 1013904223u;
+    int start = (int)((s_random >> 8) % (unsigned int)dequeCount);
+    for (int i = 0; i < dequeCount; i++) {
+        int victim = (start + i) % dequeCount;
+        if (victim == self) { continue; }
+
+        job = m_deques[victim]->Steal();
+        if (job) {
+            m_steals.fetch_add(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+// The job may be gone once its counter moved, so the counter is read first. The counter may be gone too once it is
+// zero (its waiter returned), the threads sleeping in Wait are woken without touching it again.
+void JobSystemClass::Execute(JobType* job)
+{
+    JobCounterType* counter = job->counter;
+
+    job->function(job->data);
+    if (counter->pending.fetch_sub(1) == 1) { WakeSleepers(); }
+
+    return;
+}
+
+// Sleeping threads only count after they took the mutex, so either they see the new signal or they are notified.
+void JobSystemClass::WakeWorkers()
+{
+    m_signal.fetch_add(1);
+    WakeSleepers();
+
+    return;
+}
+
+void JobSystemClass::WakeSleepers()
+{
+    if (m_sleeping.load() > 0) {
+        { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+        m_sleep.notify_all();
+    }
+
+    return;
+}
+
+void JobSystemClass::PinThread(std::thread& thread, int core)
+{
+#ifdef _WIN32
+    if (core < 64) { SetThreadAffinityMask((HANDLE)thread.native_handle(), 1ull << core); }
+#elif defined(__linux__)
+    cpu_set_t cores;
+    CPU_ZERO(&cores);
+    CPU_SET(core, &cores);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(cores), &cores);
+#endif
+
+    return;
+}
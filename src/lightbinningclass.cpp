@@ -0,0 +1,292 @@
+// Filename: lightbinningclass.cpp
+#include "lightbinningclass.h"
+#include "rtparallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <xmmintrin.h>
+
+// Position of the padding lights at the end of a slice list, far enough that no cluster box ever reaches them.
+#define LIGHT_BINNING_FAR_AWAY 1.0e30f
+
+// --------------------------------------------------------------------------------------------------------------------
+LightBinningClass::LightBinningClass()
+{
+    m_clusterCount = 0;
+    m_tileCount = 0;
+    m_nearZ = 0.0f;
+    m_farZ = 0.0f;
+    m_sliceScale = 0.0f;
+    m_sliceBias = 0.0f;
+    m_indexCount = 0;
+    m_overflowCount = 0;
+}
+
+LightBinningClass::LightBinningClass(const LightBinningClass& other)
+{
+}
+
+LightBinningClass::~LightBinningClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool LightBinningClass::Initialize(const LightBinningConfig& config)
+{
+    if ((config.clustersX < 1) || (config.clustersY < 1) || (config.clustersZ < 1) || (config.maxLightIndices < 1)) { return false; }
+
+    m_config = config;
+    m_tileCount = config.clustersX * config.clustersY;
+    m_clusterCount = m_tileCount * config.clustersZ;
+
+    m_minX.assign(m_clusterCount, 0.0f);
+    m_maxX.assign(m_clusterCount, 0.0f);
+    m_minY.assign(m_clusterCount, 0.0f);
+    m_maxY.assign(m_clusterCount, 0.0f);
+    m_sliceNear.assign(config.clustersZ, 0.0f);
+    m_sliceFar.assign(config.clustersZ, 0.0f);
+
+    m_slices.resize(config.clustersZ);
+    for (auto& slice : m_slices) { slice.counts.assign(m_tileCount, 0); }
+
+    m_ranges.assign(m_clusterCount, ClusterRangeType{ 0, 0 });
+    m_indices.assign(config.maxLightIndices, 0);
+    m_indexCount = 0;
+    m_overflowCount = 0;
+
+    return true;
+}
+
+void LightBinningClass::Shutdown()
+{
+    m_minX.clear();
+    m_maxX.clear();
+    m_minY.clear();
+    m_maxY.clear();
+    m_sliceNear.clear();
+    m_sliceFar.clear();
+    m_lightX.clear();
+    m_lightY.clear();
+    m_lightZ.clear();
+    m_lightRadius.clear();
+    m_slices.clear();
+    m_ranges.clear();
+    m_indices.clear();
+    m_clusterCount = 0;
+    m_tileCount = 0;
+    m_indexCount = 0;
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// The slices are spaced exponentially (slice k starts at near * (far / near)^(k / Z)), so the clusters stay roughly
+// cubic as they get further away instead of the distant ones becoming long thin columns.
+void LightBinningClass::SetFrustum(float fovY, float aspect, float nearZ, float farZ)
+{
+    float tanHalfFovY, tanHalfFovX, x0, x1, y0, y1, zn, zf;
+    int slice, tileX, tileY, cluster;
+
+    m_nearZ = nearZ;
+    m_farZ = farZ;
+    m_sliceScale = (float)m_config.clustersZ / logf(farZ / nearZ);
+    m_sliceBias = -(float)m_config.clustersZ * logf(nearZ) / logf(farZ / nearZ);
+
+    tanHalfFovY = tanf(fovY * 0.5f);
+    tanHalfFovX = tanHalfFovY * aspect;
+
+    for (slice = 0; slice < m_config.clustersZ; slice++) {
+        zn = nearZ * powf(farZ / nearZ, (float)slice / (float)m_config.clustersZ);
+        zf = nearZ * powf(farZ / nearZ, (float)(slice + 1) / (float)m_config.clustersZ);
+        m_sliceNear[slice] = zn;
+        m_sliceFar[slice] = zf;
+
+        for (tileY = 0; tileY < m_config.clustersY; tileY++) {
+            // Tile row 0 is the top of the screen, like the pixel coordinates of SV_POSITION.
+            y0 = (1.0f - 2.0f * (float)(tileY + 1) / (float)m_config.clustersY) * tanHalfFovY;
+            y1 = (1.0f - 2.0f * (float)tileY / (float)m_config.clustersY) * tanHalfFovY;
+
+            for (tileX = 0; tileX < m_config.clustersX; tileX++) {
+                x0 = (-1.0f + 2.0f * (float)tileX / (float)m_config.clustersX) * tanHalfFovX;
+                x1 = (-1.0f + 2.0f * (float)(tileX + 1) / (float)m_config.clustersX) * tanHalfFovX;
+
+                // The tile edges are planes through the eye, so the box of the cluster is spanned by its near and far faces.
+                cluster = (slice * m_config.clustersY + tileY) * m_config.clustersX + tileX;
+                m_minX[cluster] = std::min(x0 * zn, x0 * zf);
+                m_maxX[cluster] = std::max(x1 * zn, x1 * zf);
+                m_minY[cluster] = std::min(y0 * zn, y0 * zf);
+                m_maxY[cluster] = std::max(y1 * zn, y1 * zf);
+            }
+        }
+    }
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int LightBinningClass::Bin(const float* viewMatrix, const ClusterLightType* lights, int lightCount)
+{
+    const float* m = viewMatrix;
+    int i, slice, tile, cluster;
+    unsigned int offset, count;
+
+    // Step 1: Move the lights to view space. -------------------------------------------------------------------------
+    m_lightX.resize(lightCount);
+    m_lightY.resize(lightCount);
+    m_lightZ.resize(lightCount);
+    m_lightRadius.resize(lightCount);
+    for (i = 0; i < lightCount; i++) {
+        const float* p = lights[i].position;
+        m_lightX[i] = p[0] * m[0] + p[1] * m[4] + p[2] * m[8] + m[12];
+        m_lightY[i] = p[0] * m[1] + p[1] * m[5] + p[2] * m[9] + m[13];
+        m_lightZ[i] = p[0] * m[2] + p[1] * m[6] + p[2] * m[10] + m[14];
+        m_lightRadius[i] = lights[i].radius;
+    }
+
+    // Step 2: Bin the lights into the clusters of every depth slice, one slice per task. ---------------------------
+    RTParallelFor(m_config.clustersZ, 1, [&](int begin, int end) {
+        for (int s = begin; s < end; s++) { BinSlice(s); }
+    });
+
+    // Step 3: Concatenate the per slice lists into the index list and build the cluster ranges. ----------------------
+    m_indexCount = 0;
+    m_overflowCount = 0;
+    for (slice = 0; slice < m_config.clustersZ; slice++) {
+        SliceType& sliceData = m_slices[slice];
+        const unsigned int* indices = sliceData.indices.data();
+
+        for (tile = 0; tile < m_tileCount; tile++) {
+            cluster = slice * m_tileCount + tile;
+            count = sliceData.counts[tile];
+            offset = (unsigned int)m_indexCount;
+
+            // A full index list drops the remaining lights rather than failing the frame.
+            if ((m_indexCount + (int)count) > m_config.maxLightIndices) {
+                m_overflowCount += (m_indexCount + (int)count) - m_config.maxLightIndices;
+                count = (unsigned int)(m_config.maxLightIndices - m_indexCount);
+            }
+
+            if (count > 0) { memcpy(&m_indices[m_indexCount], indices, count * sizeof(unsigned int)); }
+            indices += sliceData.counts[tile];
+
+            m_ranges[cluster].offset = offset;
+            m_ranges[cluster].count = count;
+            m_indexCount += (int)count;
+        }
+    }
+
+    return m_indexCount;
+}
+
+// Gather the lights whose depth range overlaps the slice, then test them against every cluster of the slice. The
+// distance from the light center to the cluster box is computed for four lights at once (per axis, the amount the
+// center lies outside the box), the light touches the cluster when it is within the radius.
+void LightBinningClass::BinSlice(int slice)
+{
+    SliceType& sliceData = m_slices[slice];
+    float zn = m_sliceNear[slice];
+    float zf = m_sliceFar[slice];
+    int lightCount = (int)m_lightZ.size();
+    int count, padded, i, j, tile, cluster;
+    __m128 zero, minX, maxX, minY, maxY, minZ, maxZ;
+    __m128 x, y, z, radiusSq, dx, dy, dz, distanceSq;
+    unsigned int mask;
+    size_t first;
+
+    sliceData.x.clear();
+    sliceData.y.clear();
+    sliceData.z.clear();
+    sliceData.radiusSq.clear();
+    sliceData.light.clear();
+    sliceData.indices.clear();
+
+    for (i = 0; i < lightCount; i++) {
+        if (((m_lightZ[i] + m_lightRadius[i]) < zn) || ((m_lightZ[i] - m_lightRadius[i]) > zf)) { continue; }
+        sliceData.x.push_back(m_lightX[i]);
+        sliceData.y.push_back(m_lightY[i]);
+        sliceData.z.push_back(m_lightZ[i]);
+        sliceData.radiusSq.push_back(m_lightRadius[i] * m_lightRadius[i]);
+        sliceData.light.push_back(i);
+    }
+
+    // Pad to a multiple of four with lights no cluster can reach, so the SSE loop has no scalar tail.
+    count = (int)sliceData.light.size();
+    padded = (count + 3) & ~3;
+    for (i = count; i < padded; i++) {
+        sliceData.x.push_back(LIGHT_BINNING_FAR_AWAY);
+        sliceData.y.push_back(LIGHT_BINNING_FAR_AWAY);
+        sliceData.z.push_back(LIGHT_BINNING_FAR_AWAY);
+        sliceData.radiusSq.push_back(0.0f);
+        sliceData.light.push_back(0);
+    }
+
+    zero = _mm_setzero_ps();
+    minZ = _mm_set1_ps(zn);
+    maxZ = _mm_set1_ps(zf);
+
+    for (tile = 0; tile < m_tileCount; tile++) {
+        cluster = slice * m_tileCount + tile;
+        minX = _mm_set1_ps(m_minX[cluster]);
+        maxX = _mm_set1_ps(m_maxX[cluster]);
+        minY = _mm_set1_ps(m_minY[cluster]);
+        maxY = _mm_set1_ps(m_maxY[cluster]);
+
+        first = sliceData.indices.size();
+        for (i = 0; i < padded; i += 4) {
+            x = _mm_loadu_ps(&sliceData.x[i]);
+            y = _mm_loadu_ps(&sliceData.y[i]);
+            z = _mm_loadu_ps(&sliceData.z[i]);
+            radiusSq = _mm_loadu_ps(&sliceData.radiusSq[i]);
+
+            dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, x), _mm_sub_ps(x, maxX)), zero);
+            dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, y), _mm_sub_ps(y, maxY)), zero);
+            dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, z), _mm_sub_ps(z, maxZ)), zero);
+            distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+            mask = (unsigned int)_mm_movemask_ps(_mm_cmple_ps(distanceSq, radiusSq));
+            for (j = 0; mask != 0; j++, mask >>= 1) {
+                if (mask & 1) { sliceData.indices.push_back((unsigned int)sliceData.light[i + j]); }
+            }
+        }
+        sliceData.counts[tile] = (unsigned int)(sliceData.indices.size() - first);
+    }
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int LightBinningClass::GetClusterCount()
+{
+    return m_clusterCount;
+}
+
+const ClusterRangeType* LightBinningClass::GetClusterRanges()
+{
+    return m_ranges.data();
+}
+
+const unsigned int* LightBinningClass::GetLightIndices()
+{
+    return m_indices.data();
+}
+
+int LightBinningClass::GetLightIndexCount()
+{
+    return m_indexCount;
+}
+
+int LightBinningClass::GetOverflowCount()
+{
+    return m_overflowCount;
+}
+
+float LightBinningClass::GetSliceScale()
+{
+    return m_sliceScale;
+}
+
+float LightBinningClass::GetSliceBias()
+{
+    return m_sliceBias;
+}
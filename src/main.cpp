@@ -37,6 +37,12 @@ void displayHelp() {
 	std::wcout << L"  --test <>      Test number to run (default=5)\n";
 	std::wcout << L"  --api <>       Specify api: API_DX11=1 (default), API_DX12=2, API_VK=3, API_OGL=3\n";
 	std::wcout << L"  --end <>       End test number to end (inclusive) (default=5)\n";
+	std::wcout << L"  --texbudget <> Memory budget in MB of the streamed textures (default=256)\n";
+	std::wcout << L"  --hud <>       Draw the frame statistics text: 0=off (default), 1=on\n";
+	std::wcout << L"  --hotreload <> Recompile shaders edited in shaders/ while running: 0=off (default), 1=on\n";
+	std::wcout << L"  --fps <>       Frame rate limit, the loop sleeps between frames: 0=none (default)\n";
+	std::wcout << L"  --pipelined <> Simulate the next frame on its own thread while a frame is drawn: 0=off (default), 1=on\n";
+	std::wcout << L"  --scene <>     Scene file to run instead of the one of the test (default ..\\data\\scenes\\testNN.json)\n";
 	std::wcout << L"  --dir <>       Path to resources (default .) - not yet supported\n";
 }
 
@@ -98,6 +104,25 @@ int parseArguments(LPWSTR lpCmdLine) {
  	CHECK_AND_ASSIGN("--api", RTApi, RTArgs.api);
 	CHECK_AND_ASSIGN("--test", uchar, RTArgs.test);
 	CHECK_AND_ASSIGN("--end", uchar, RTArgs.end);
+	CHECK_AND_ASSIGN("--texbudget", int, RTArgs.texBudget);
+	CHECK_AND_ASSIGN("--hud", uchar, RTArgs.hud);
+	CHECK_AND_ASSIGN("--hotreload", uchar, RTArgs.hotReload);
+	CHECK_AND_ASSIGN("--fps", int, RTArgs.fps);
+	CHECK_AND_ASSIGN("--pipelined", uchar, RTArgs.pipelined);
+
+	// The scene file is the only argument taking a path.
+	auto sceneIt = std::find(args.begin(), args.end(), L"--scene");
+	if (sceneIt != args.end()) {
+		validArgumentFound = true;
+		std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
+		std::string scene;
+		if ((sceneIt + 1) != args.end()) { scene = converter.to_bytes(*(sceneIt + 1)); }
+		if (scene.empty() || (scene.size() >= sizeof(RTArgs.scene))) {
+			std::cout << "Error: --scene requires a file name\n";
+			return(RT_ERROR);
+		}
+		strcpy(RTArgs.scene, scene.c_str());
+	}
 
 	if ( (!args.empty()) && (validArgumentFound != true) ) {
 		std::wcout << L"No valid arguments provided. Use -h or --help for help.\n";
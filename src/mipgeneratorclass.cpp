@@ -0,0 +1,383 @@
+// Filename: mipgeneratorclass.cpp
+#include "mipgeneratorclass.h"
+#include "rtparallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+// --------------------------------------------------------------------------------------------------------------------
+// Zero order modified Bessel function of the first kind, used by the Kaiser window. The power series converges
+// quickly for the alpha values used here.
+static float BesselI0(float x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    double halfX = x * 0.5;
+
+    for (int k = 1; k < 32; k++) {
+        term *= (halfX / k) * (halfX / k);
+        sum += term;
+        if (term < (sum * 1e-9)) { break; }
+    }
+
+    return (float)sum;
+}
+
+static float SrgbToLinear(float value)
+{
+    return (value <= 0.04045f) ? (value / 12.92f) : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+MipGeneratorClass::MipGeneratorClass()
+{
+    m_kaiserNormalization = 1.0f;
+}
+
+MipGeneratorClass::MipGeneratorClass(const MipGeneratorClass& other)
+{
+}
+
+MipGeneratorClass::~MipGeneratorClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool MipGeneratorClass::Initialize(const MipGeneratorConfig& config)
+{
+    int i;
+
+    if ((config.filter == MIP_FILTER_KAISER) && (config.kaiserWidth <= 0.0f)) { return false; }
+    m_config = config;
+
+    // Build the 8 bit -> linear table used to decode the color channels.
+    for (i = 0; i < 256; i++) {
+        float value = (float)i / 255.0f;
+        m_srgbToLinear[i] = m_config.srgb ? SrgbToLinear(value) : value;
+    }
+
+    // Build the decision thresholds used to encode back to 8 bit. Threshold i is the linear value half way
+    // (in encoded space) between code i and code i+1, so the encode is exact round to nearest in sRGB space.
+    for (i = 0; i < 255; i++) {
+        float value = ((float)i + 0.5f) / 255.0f;
+        m_srgbThresholds[i] = m_config.srgb ? SrgbToLinear(value) : value;
+    }
+
+    m_kaiserNormalization = 1.0f / BesselI0(m_config.kaiserAlpha);
+
+    return true;
+}
+
+void MipGeneratorClass::Shutdown()
+{
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int MipGeneratorClass::GetMipLevelCount(int width, int height)
+{
+    int levels = 1;
+    int size = std::max(width, height);
+
+    while (size > 1) {
+        size >>= 1;
+        levels++;
+    }
+
+    return levels;
+}
+
+// Generate the full chain for one image. Level 0 is a copy of the input, every following level is filtered from the
+// linear float version of the previous one so no precision is lost to 8 bit rounding along the chain.
+bool MipGeneratorClass::Generate(const unsigned char* rgba, int width, int height, MipChain& chain)
+{
+    int levelCount, level, srcWidth, srcHeight;
+    float targetCoverage = 0.0f;
+
+    if ((rgba == nullptr) || (width <= 0) || (height <= 0)) { return false; }
+
+    levelCount = GetMipLevelCount(width, height);
+    if ((m_config.maxLevels > 0) && (m_config.maxLevels < levelCount)) { levelCount = m_config.maxLevels; }
+
+    chain.levels.resize(levelCount);
+
+    // Step 1: Level 0 is the source image itself. ----------------------------------------------------------------------
+    chain.levels[0].width = width;
+    chain.levels[0].height = height;
+    chain.levels[0].pixels.assign(rgba, rgba + ((size_t)width * height * 4));
+
+    if (levelCount == 1) { return true; }
+
+    // Step 2: Convert to linear floating point RGBA. ----------------------------------------------------------------
+    std::vector<float> current((size_t)width * height * 4);
+    std::vector<float> next;
+    DecodeToLinear(rgba, width * height, current.data());
+
+    // The alpha test coverage of the top level is the reference all other levels are matched against.
+    if (m_config.preserveAlphaCoverage) {
+        targetCoverage = ComputeAlphaCoverage(current.data(), width * height, 1.0f);
+    }
+
+    // Step 3: Filter each level from the previous one and encode it back to 8 bit. ------------------------------------
+    srcWidth = width;
+    srcHeight = height;
+    for (level = 1; level < levelCount; level++) {
+        int dstWidth = std::max(1, srcWidth >> 1);
+        int dstHeight = std::max(1, srcHeight >> 1);
+        float alphaScale = 1.0f;
+
+        next.resize((size_t)dstWidth * dstHeight * 4);
+        Downsample(current.data(), srcWidth, srcHeight, next.data(), dstWidth, dstHeight);
+
+        if (m_config.preserveAlphaCoverage) {
+            alphaScale = FindAlphaScale(next.data(), dstWidth * dstHeight, targetCoverage);
+        }
+
+        MipLevelData& mip = chain.levels[level];
+        mip.width = dstWidth;
+        mip.height = dstHeight;
+        mip.pixels.resize((size_t)dstWidth * dstHeight * 4);
+        EncodeFromLinear(next.data(), dstWidth * dstHeight, alphaScale, mip.pixels.data());
+
+        current.swap(next);
+        srcWidth = dstWidth;
+        srcHeight = dstHeight;
+    }
+
+    return true;
+}
+
+// Generate the chains of several images at once, one image per task. The row band parallelism inside Generate is
+// only used when there are fewer images than threads (nested parallel loops run inline).
+bool MipGeneratorClass::GenerateBatch(const unsigned char* const* images, const int* widths, const int* heights, int imageCount, MipChain* chains)
+{
+    std::atomic<bool> success(true);
+
+    RTParallelFor(imageCount, 1, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            if (!Generate(images[i], widths[i], heights[i], chains[i])) { success = false; }
+        }
+    });
+
+    return success;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Filter function evaluated at t, the distance to the destination texel center measured in destination texels.
+float MipGeneratorClass::EvaluateFilter(float t)
+{
+    t = fabsf(t);
+
+    if (m_config.filter == MIP_FILTER_BOX) {
+        return (t <= 0.5f) ? 1.0f : 0.0f;
+    }
+
+    // Kaiser windowed sinc.
+    if (t >= m_config.kaiserWidth) { return 0.0f; }
+
+    float sinc = 1.0f;
+    if (t > 1e-5f) {
+        float x = 3.14159265f * t;
+        sinc = sinf(x) / x;
+    }
+
+    float ratio = t / m_config.kaiserWidth;
+    float window = BesselI0(m_config.kaiserAlpha * sqrtf(1.0f - ratio * ratio)) * m_kaiserNormalization;
+
+    return sinc * window;
+}
+
+// Precompute the weights of the separable filter for one axis. Source taps falling outside the image are clamped
+// to the edge texel (their weight is added to it) and every weight set is normalized to one.
+void MipGeneratorClass::BuildKernel(int srcSize, int dstSize, FilterKernel& kernel)
+{
+    float scale = (float)srcSize / (float)dstSize;
+    float radius = ((m_config.filter == MIP_FILTER_BOX) ? 0.5f : m_config.kaiserWidth) * scale;
+    std::vector<float> taps;
+
+    kernel.contributions.resize(dstSize);
+    kernel.weights.clear();
+
+    for (int d = 0; d < dstSize; d++) {
+        float center = ((float)d + 0.5f) * scale - 0.5f;
+        int lo = (int)floorf(center - radius);
+        int hi = (int)ceilf(center + radius);
+        int first = std::max(lo, 0);
+        int last = std::min(hi, srcSize - 1);
+        float sum = 0.0f;
+
+        taps.assign(last - first + 1, 0.0f);
+        for (int s = lo; s <= hi; s++) {
+            float weight = EvaluateFilter(((float)s - center) / scale);
+            if (weight == 0.0f) { continue; }
+
+            int clamped = std::min(std::max(s, 0), srcSize - 1);
+            taps[clamped - first] += weight;
+            sum += weight;
+        }
+
+        // Degenerate case (should not happen with the supported filters), fall back to point sampling.
+        if (fabsf(sum) < 1e-6f) {
+            int nearest = std::min(std::max((int)(center + 0.5f), first), last);
+            std::fill(taps.begin(), taps.end(), 0.0f);
+            taps[nearest - first] = 1.0f;
+            sum = 1.0f;
+        }
+
+        FilterContribution& contribution = kernel.contributions[d];
+        contribution.first = first;
+        contribution.count = (int)taps.size();
+        contribution.weightOffset = (int)kernel.weights.size();
+        for (float tap : taps) { kernel.weights.push_back(tap / sum); }
+    }
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void MipGeneratorClass::DecodeToLinear(const unsigned char* rgba, int pixelCount, float* linear)
+{
+    RTParallelFor(pixelCount, 16384, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            const unsigned char* src = rgba + (size_t)i * 4;
+            float* dst = linear + (size_t)i * 4;
+            dst[0] = m_srgbToLinear[src[0]];
+            dst[1] = m_srgbToLinear[src[1]];
+            dst[2] = m_srgbToLinear[src[2]];
+            dst[3] = (float)src[3] / 255.0f;    // Alpha is always stored linearly.
+        }
+    });
+
+    return;
+}
+
+unsigned char MipGeneratorClass::LinearToSrgb(float value)
+{
+    // The number of thresholds below the value is the nearest 8 bit code.
+    return (unsigned char)(std::upper_bound(m_srgbThresholds, m_srgbThresholds + 255, value) - m_srgbThresholds);
+}
+
+void MipGeneratorClass::EncodeFromLinear(const float* linear, int pixelCount, float alphaScale, unsigned char* rgba)
+{
+    RTParallelFor(pixelCount, 16384, [&](int begin, int end) {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 scale = _mm_set_ps(alphaScale, 1.0f, 1.0f, 1.0f);
+        float texel[4];
+
+        for (int i = begin; i < end; i++) {
+            // The Kaiser filter has negative lobes, clamp the result back into [0, 1].
+            __m128 value = _mm_loadu_ps(linear + (size_t)i * 4);
+            value = _mm_min_ps(_mm_max_ps(_mm_mul_ps(value, scale), zero), one);
+            _mm_storeu_ps(texel, value);
+
+            unsigned char* dst = rgba + (size_t)i * 4;
+            dst[0] = LinearToSrgb(texel[0]);
+            dst[1] = LinearToSrgb(texel[1]);
+            dst[2] = LinearToSrgb(texel[2]);
+            dst[3] = (unsigned char)(texel[3] * 255.0f + 0.5f);
+        }
+    });
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Separable resampling: first every source row is filtered horizontally into a temporary image, then the columns of
+// that image are filtered vertically into the destination. Each RGBA texel is one SSE register, so a tap is a single
+// multiply-add for all four channels. Both passes are split in row bands across threads.
+void MipGeneratorClass::Downsample(const float* src, int srcWidth, int srcHeight, float* dst, int dstWidth, int dstHeight)
+{
+    FilterKernel kernelX, kernelY;
+    std::vector<float> temp((size_t)dstWidth * srcHeight * 4);
+
+    BuildKernel(srcWidth, dstWidth, kernelX);
+    BuildKernel(srcHeight, dstHeight, kernelY);
+
+    // Step 1: Horizontal pass, srcWidth x srcHeight -> dstWidth x srcHeight.
+    RTParallelFor(srcHeight, 16, [&](int begin, int end) {
+        for (int y = begin; y < end; y++) {
+            const float* srcRow = src + (size_t)y * srcWidth * 4;
+            float* tempRow = temp.data() + (size_t)y * dstWidth * 4;
+
+            for (int x = 0; x < dstWidth; x++) {
+                const FilterContribution& contribution = kernelX.contributions[x];
+                const float* weights = &kernelX.weights[contribution.weightOffset];
+                const float* texel = srcRow + (size_t)contribution.first * 4;
+                __m128 sum = _mm_setzero_ps();
+
+                for (int i = 0; i < contribution.count; i++) {
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(texel + i * 4), _mm_set1_ps(weights[i])));
+                }
+                _mm_storeu_ps(tempRow + (size_t)x * 4, sum);
+            }
+        }
+    });
+
+    // Step 2: Vertical pass, dstWidth x srcHeight -> dstWidth x dstHeight.
+    RTParallelFor(dstHeight, 8, [&](int begin, int end) {
+        size_t tempPitch = (size_t)dstWidth * 4;
+
+        for (int y = begin; y < end; y++) {
+            const FilterContribution& contribution = kernelY.contributions[y];
+            const float* weights = &kernelY.weights[contribution.weightOffset];
+            const float* column = temp.data() + (size_t)contribution.first * tempPitch;
+            float* dstRow = dst + (size_t)y * dstWidth * 4;
+
+            for (int x = 0; x < dstWidth; x++) {
+                const float* texel = column + (size_t)x * 4;
+                __m128 sum = _mm_setzero_ps();
+
+                for (int i = 0; i < contribution.count; i++) {
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(texel + i * tempPitch), _mm_set1_ps(weights[i])));
+                }
+                _mm_storeu_ps(dstRow + (size_t)x * 4, sum);
+            }
+        }
+    });
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Fraction of texels that pass the alpha test once alpha is multiplied by alphaScale.
+float MipGeneratorClass::ComputeAlphaCoverage(const float* linear, int pixelCount, float alphaScale)
+{
+    int covered = 0;
+
+    for (int i = 0; i < pixelCount; i++) {
+        if ((linear[(size_t)i * 4 + 3] * alphaScale) > m_config.alphaCutoff) { covered++; }
+    }
+
+    return (float)covered / (float)pixelCount;
+}
+
+// Coverage grows monotonically with the scale, so a bisection finds the scale that best matches the target.
+float MipGeneratorClass::FindAlphaScale(const float* linear, int pixelCount, float targetCoverage)
+{
+    float low = 0.0f;
+    float high = 4.0f;
+    float best = 1.0f;
+    float bestError = fabsf(ComputeAlphaCoverage(linear, pixelCount, 1.0f) - targetCoverage);
+
+    for (int i = 0; i < 12; i++) {
+        float scale = (low + high) * 0.5f;
+        float coverage = ComputeAlphaCoverage(linear, pixelCount, scale);
+        float error = fabsf(coverage - targetCoverage);
+
+        if (error < bestError) {
+            best = scale;
+            bestError = error;
+        }
+
+        if (coverage < targetCoverage) { low = scale; }
+        else { high = scale; }
+    }
+
+    return best;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
@@ -7,7 +7,10 @@ ModelClass::ModelClass()
     m_vertexBuffer = nullptr;
     m_indexBuffer = nullptr;
     m_Texture = nullptr;
+    m_TextureStreamer = nullptr;
+    m_StateCache = nullptr;
     m_model = nullptr;
+    m_boundingRadius = 1.0f;
 }
 
 ModelClass::ModelClass(const ModelClass& other)
@@ -19,11 +22,16 @@ ModelClass::~ModelClass()
 }
 
 // --------------------------------------------------------------------------------------------------------------------
-bool ModelClass::Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext, CraftModel craftModel, char* modelFilename, char* textureFilename, bool useNormal)
+// If a texture streamer is given, the model texture is streamed: only its low resolution mips are loaded here and the
+// finer ones follow on demand (see RequestTextureDetail).
+bool ModelClass::Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext, CraftModel craftModel, char* modelFilename, char* textureFilename, bool useNormal,
+                            TextureStreamerClass* textureStreamer)
 {
     bool result;
     bool useTexture, useModelFile;
 
+    m_TextureStreamer = textureStreamer;
+
     useModelFile = ((strcmp(modelFilename,"") != 0) ? true : false);
     useTexture = ((strcmp(textureFilename, "") != 0) ? true : false);
 
@@ -60,6 +68,13 @@ void ModelClass::Shutdown()
     return;
 }
 
+// Optional, the input assembler state is then bound through the cache and binds matching the current state are dropped.
+void ModelClass::SetStateCache(RenderStateCacheClass* stateCache)
+{
+    m_StateCache = stateCache;
+    return;
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 // This function to put the vertex and index buffers on the graphics pipeline so the color shader will be able to render them.
 void ModelClass::Render(ID3D11DeviceContext* deviceContext)
@@ -82,6 +97,40 @@ ID3D11ShaderResourceView* ModelClass::GetTexture()
     return m_Texture->GetTexture();
 }
 
+// Radius of the sphere around the model origin containing all its vertices (in model space).
+float ModelClass::GetBoundingRadius()
+{
+    return m_boundingRadius;
+}
+
+// The vertex positions of a model loaded from a file, three by triangle (the indices are the vertex order). Used for the
+// CPU side copies of the model, the occluder meshes. Empty for the crafted geometry.
+void ModelClass::GetTrianglePositions(std::vector<float>& positions)
+{
+    positions.clear();
+    if (!m_model) { return; }
+
+    positions.reserve(m_vertexCount * 3);
+    for (int i = 0; i < m_vertexCount; i++) {
+        positions.push_back(m_model[i].x);
+        positions.push_back(m_model[i].y);
+        positions.push_back(m_model[i].z);
+    }
+
+    return;
+}
+
+// Report to the texture streamer how big (in pixels) the model is on screen this frame, so the right mips of its
+// texture get streamed in. Nothing to do for textures that are not streamed.
+void ModelClass::RequestTextureDetail(float projectedSize)
+{
+    if ((m_Texture == nullptr) || (m_TextureStreamer == nullptr)) { return; }
+
+    m_TextureStreamer->RequestProjectedSize(m_Texture, projectedSize, projectedSize);
+
+    return;
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 bool ModelClass::InitializeBuffers(ID3D11Device* device, CraftModel crafModel, bool useTexture, bool useNormal, bool useModelFile)
 {
@@ -289,7 +338,11 @@ bool ModelClass::LoadTexture(ID3D11Device* device, ID3D11DeviceContext* deviceCo
     // Create and initialize the texture object.
     m_Texture = new TextureClass;
 
-    result = m_Texture->Initialize(device, deviceContext, filename);
+    if (m_TextureStreamer) {
+        result = m_Texture->InitializeStreaming(device, deviceContext, filename, m_TextureStreamer);
+    } else {
+        result = m_Texture->Initialize(device, deviceContext, filename);
+    }
     if (!result) { return false; }
 
     return true;
@@ -338,11 +391,15 @@ bool ModelClass::LoadModel(char* filename)
     fin.get(input);
     fin.get(input);
 
-    // Read in the vertex data.
+    // Read in the vertex data, keeping track of the bounding radius of the model.
+    m_boundingRadius = 0.0f;
     for (i = 0; i < m_vertexCount; i++) {
         fin >> m_model[i].x >> m_model[i].y >> m_model[i].z;
         fin >> m_model[i].tu >> m_model[i].tv;
         fin >> m_model[i].nx >> m_model[i].ny >> m_model[i].nz;
+
+        float radius = sqrtf(m_model[i].x * m_model[i].x + m_model[i].y * m_model[i].y + m_model[i].z * m_model[i].z);
+        if (radius > m_boundingRadius) { m_boundingRadius = radius; }
     }
 
     // Close the model file.
@@ -372,6 +429,14 @@ void ModelClass::RenderBuffers(ID3D11DeviceContext* deviceContext)
     offset = 0;
     stride = GetVertexBufferStride();
 
+    // Drawing the same model again (e.g. the two cubes of test 8) leaves the state cache nothing to bind.
+    if (m_StateCache) {
+        m_StateCache->SetVertexBuffer(deviceContext, 0, m_vertexBuffer, stride, offset);
+        m_StateCache->SetIndexBuffer(deviceContext, m_indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+        m_StateCache->SetPrimitiveTopology(deviceContext, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        return;
+    }
+
     // Set the vertex buffer to active in the input assembler so it can be rendered.
     deviceContext->IASetVertexBuffers(0, 1, &m_vertexBuffer, &stride, &offset);
 
@@ -0,0 +1,390 @@
+// Filename: occlusionbufferclass.cpp
+#include "occlusionbufferclass.h"
+#include "rtparallel.h"
+
+#include <cmath>
+#include <emmintrin.h>
+
+// Triangles thinner than this (in square pixels) cover no pixel completely.
+#define OCCLUSION_MIN_AREA 1.0e-6f
+
+// clip = (x, y, z, 1) * m, row vector convention.
+static void TransformPoint(const float* m, float x, float y, float z, float clip[4])
+{
+    for (int i = 0; i < 4; i++) { clip[i] = x * m[i] + y * m[4 + i] + z * m[8 + i] + m[12 + i]; }
+
+    return;
+}
+
+static float Clamp(float value, float low, float high)
+{
+    return (value < low) ? low : ((value > high) ? high : value);
+}
+
+// Horizontal minimum and maximum of the four lanes.
+static float MinLane(__m128 value)
+{
+    value = _mm_min_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 0, 3, 2)));
+    value = _mm_min_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(value);
+}
+
+static float MaxLane(__m128 value)
+{
+    value = _mm_max_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 0, 3, 2)));
+    value = _mm_max_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(value);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+OcclusionBufferClass::OcclusionBufferClass()
+{
+    m_width = 0;
+    m_height = 0;
+    m_tilesX = 0;
+    m_tilesY = 0;
+    for (int i = 0; i < 16; i++) { m_viewProjection[i] = (i % 5 == 0) ? 1.0f : 0.0f; }
+}
+
+OcclusionBufferClass::OcclusionBufferClass(const OcclusionBufferClass& other)
+{
+}
+
+OcclusionBufferClass::~OcclusionBufferClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool OcclusionBufferClass::Initialize(int width, int height)
+{
+    if ((width < OCCLUSION_TILE_SIZE) || (height < OCCLUSION_TILE_SIZE)) { return false; }
+    if ((width % OCCLUSION_TILE_SIZE != 0) || (height % OCCLUSION_TILE_SIZE != 0)) { return false; }
+
+    m_width = width;
+    m_height = height;
+    m_tilesX = width / OCCLUSION_TILE_SIZE;
+    m_tilesY = height / OCCLUSION_TILE_SIZE;
+
+    m_depth.assign(width * height, 1.0f);
+    m_tileMaxDepth.assign(m_tilesX * m_tilesY, 1.0f);
+    m_bandTriangles.resize(m_tilesY);
+
+    return true;
+}
+
+void OcclusionBufferClass::Shutdown()
+{
+    m_depth.clear();
+    m_tileMaxDepth.clear();
+    m_meshes.clear();
+    m_triangles.clear();
+    m_bandTriangles.clear();
+    m_width = 0;
+    m_height = 0;
+
+    return;
+}
+
+int OcclusionBufferClass::AddMesh(const float* positions, int vertexCount)
+{
+    m_meshes.push_back(std::vector<float>(positions, positions + (vertexCount / 3) * 9));
+
+    return (int)m_meshes.size() - 1;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void OcclusionBufferClass::Begin(const float* viewProjection)
+{
+    for (int i = 0; i < 16; i++) { m_viewProjection[i] = viewProjection[i]; }
+
+    m_triangles.clear();
+    for (auto& band : m_bandTriangles) { band.clear(); }
+
+    return;
+}
+
+void OcclusionBufferClass::AddOccluder(int mesh, const float* worldMatrix)
+{
+    float worldViewProjection[16], clip[3][4];
+    int row, column;
+
+    if ((mesh < 0) || (mesh >= (int)m_meshes.size())) { return; }
+
+    for (row = 0; row < 4; row++) {
+        for (column = 0; column < 4; column++) {
+            worldViewProjection[4 * row + column] = worldMatrix[4 * row] * m_viewProjection[column] + worldMatrix[4 * row + 1] * m_viewProjection[4 + column] +
+                                                    worldMatrix[4 * row + 2] * m_viewProjection[8 + column] + worldMatrix[4 * row + 3] * m_viewProjection[12 + column];
+        }
+    }
+
+    const std::vector<float>& positions = m_meshes[mesh];
+    for (size_t i = 0; i + 9 <= positions.size(); i += 9) {
+        TransformPoint(worldViewProjection, positions[i], positions[i + 1], positions[i + 2], clip[0]);
+        TransformPoint(worldViewProjection, positions[i + 3], positions[i + 4], positions[i + 5], clip[1]);
+        TransformPoint(worldViewProjection, positions[i + 6], positions[i + 7], positions[i + 8], clip[2]);
+        ClipAndAddTriangle(clip);
+    }
+
+    return;
+}
+
+// The part of the triangle in front of the near plane (z >= 0 in clip space, which also keeps w > 0) is projected to
+// the buffer and binned in the bands its bounds overlap. Off screen parts are left to the rasterizer bounds.
+void OcclusionBufferClass::ClipAndAddTriangle(const float clip[3][4])
+{
+    float polygon[4][4];
+    int count = 0, i, j, k;
+
+    for (i = 0; i < 3; i++) {
+        const float* a = clip[i];
+        const float* b = clip[(i + 1) % 3];
+
+        if (a[2] >= 0.0f) {
+            for (k = 0; k < 4; k++) { polygon[count][k] = a[k]; }
+            count++;
+        }
+        if ((a[2] >= 0.0f) != (b[2] >= 0.0f)) {
+            float t = a[2] / (a[2] - b[2]);
+            for (k = 0; k < 4; k++) { polygon[count][k] = a[k] + t * (b[k] - a[k]); }
+            count++;
+        }
+    }
+    if (count < 3) { return; }
+
+    // A far away vertex (z / w past 1) is fine, its depth never wins over the cleared buffer.
+    TriangleType screen[2];
+    float x[4], y[4], z[4];
+    for (i = 0; i < count; i++) {
+        if (polygon[i][3] <= 0.0f) { return; }
+        float invW = 1.0f / polygon[i][3];
+        x[i] = (polygon[i][0] * invW * 0.5f + 0.5f) * (float)m_width;
+        y[i] = (0.5f - polygon[i][1] * invW * 0.5f) * (float)m_height;
+        z[i] = polygon[i][2] * invW;
+    }
+
+    for (j = 0; j + 2 < count; j++) {
+        int corners[3] = { 0, j + 1, j + 2 };
+        TriangleType& triangle = screen[j];
+        float minY = 1.0e30f, maxY = -1.0e30f;
+
+        for (i = 0; i < 3; i++) {
+            triangle.x[i] = x[corners[i]];
+            triangle.y[i] = y[corners[i]];
+            triangle.z[i] = z[corners[i]];
+            if (triangle.y[i] < minY) { minY = triangle.y[i]; }
+            if (triangle.y[i] > maxY) { maxY = triangle.y[i]; }
+        }
+
+        int firstBand = (int)Clamp(minY, 0.0f, (float)(m_height - 1)) / OCCLUSION_TILE_SIZE;
+        int lastBand = (int)Clamp(maxY, 0.0f, (float)(m_height - 1)) / OCCLUSION_TILE_SIZE;
+        if ((maxY < 0.0f) || (minY > (float)m_height)) { continue; }
+
+        m_triangles.push_back(triangle);
+        for (int band = firstBand; band <= lastBand; band++) { m_bandTriangles[band].push_back((int)m_triangles.size() - 1); }
+    }
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void OcclusionBufferClass::Rasterize(bool useThreads)
+{
+    if (useThreads) {
+        RTParallelFor(m_tilesY, 1, [this](int begin, int end) {
+            for (int band = begin; band < end; band++) { RasterizeBand(band); }
+        });
+    } else {
+        for (int band = 0; band < m_tilesY; band++) { RasterizeBand(band); }
+    }
+
+    return;
+}
+
+// Only the band's rows and tiles are written, the bands never share data.
+void OcclusionBufferClass::RasterizeBand(int band)
+{
+    int bandTop = band * OCCLUSION_TILE_SIZE;
+    int bandBottom = bandTop + OCCLUSION_TILE_SIZE;
+    const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    int x, y, i;
+
+    for (y = bandTop; y < bandBottom; y++) {
+        float* row = &m_depth[y * m_width];
+        for (x = 0; x < m_width; x++) { row[x] = 1.0f; }
+    }
+
+    for (int index : m_bandTriangles[band]) {
+        TriangleType triangle = m_triangles[index];
+
+        // Counterclockwise on screen (y down), so the three edge functions are positive inside.
+        float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) - (triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+        if (fabsf(area) < OCCLUSION_MIN_AREA) { continue; }
+        if (area < 0.0f) {
+            float swap;
+            swap = triangle.x[1]; triangle.x[1] = triangle.x[2]; triangle.x[2] = swap;
+            swap = triangle.y[1]; triangle.y[1] = triangle.y[2]; triangle.y[2] = swap;
+            swap = triangle.z[1]; triangle.z[1] = triangle.z[2]; triangle.z[2] = swap;
+            area = -area;
+        }
+
+        // Edge i goes from vertex i to the next one, E(x, y) = a x + b y + c. A pixel is completely inside an edge
+        // when the edge function at its center is at least half the sum of the gradient magnitudes.
+        float edgeA[3], edgeB[3], edgeC[3];
+        for (i = 0; i < 3; i++) {
+            int next = (i + 1) % 3;
+            edgeA[i] = -(triangle.y[next] - triangle.y[i]);
+            edgeB[i] = triangle.x[next] - triangle.x[i];
+            edgeC[i] = -(edgeA[i] * triangle.x[i] + edgeB[i] * triangle.y[i]) - 0.5f * (fabsf(edgeA[i]) + fabsf(edgeB[i]));
+        }
+
+        // Depth plane, moved to the farthest depth of the triangle over each pixel and capped at its farthest vertex.
+        float dx1 = triangle.x[1] - triangle.x[0], dy1 = triangle.y[1] - triangle.y[0], dz1 = triangle.z[1] - triangle.z[0];
+        float dx2 = triangle.x[2] - triangle.x[0], dy2 = triangle.y[2] - triangle.y[0], dz2 = triangle.z[2] - triangle.z[0];
+        float depthA = (dz1 * dy2 - dy1 * dz2) / area;
+        float depthB = (dx1 * dz2 - dz1 * dx2) / area;
+        float depthC = triangle.z[0] - depthA * triangle.x[0] - depthB * triangle.y[0] + 0.5f * (fabsf(depthA) + fabsf(depthB));
+        float depthMax = fmaxf(triangle.z[0], fmaxf(triangle.z[1], triangle.z[2]));
+
+        // Pixels the triangle bounds overlap in the band, x in groups of four.
+        float minX = fminf(triangle.x[0], fminf(triangle.x[1], triangle.x[2]));
+        float maxX = fmaxf(triangle.x[0], fmaxf(triangle.x[1], triangle.x[2]));
+        float minY = fminf(triangle.y[0], fminf(triangle.y[1], triangle.y[2]));
+        float maxY = fmaxf(triangle.y[0], fmaxf(triangle.y[1], triangle.y[2]));
+        int startX = ((int)Clamp(floorf(minX), 0.0f, (float)m_width)) & ~3;
+        int endX = (int)Clamp(ceilf(maxX), 0.0f, (float)m_width);
+        int startY = (int)Clamp(floorf(minY), (float)bandTop, (float)bandBottom);
+        int endY = (int)Clamp(ceilf(maxY), (float)bandTop, (float)bandBottom);
+
+        __m128 stepA[3], threshold = _mm_setzero_ps();
+        for (i = 0; i < 3; i++) { stepA[i] = _mm_set1_ps(edgeA[i]); }
+        __m128 depthStep = _mm_set1_ps(depthA), depthLimit = _mm_set1_ps(depthMax);
+
+        for (y = startY; y < endY; y++) {
+            float centerY = (float)y + 0.5f;
+            float* row = &m_depth[y * m_width];
+            __m128 rowEdge[3];
+            for (i = 0; i < 3; i++) { rowEdge[i] = _mm_set1_ps(edgeB[i] * centerY + edgeC[i]); }
+            __m128 rowDepth = _mm_set1_ps(depthB * centerY + depthC);
+
+            for (x = startX; x < endX; x += 4) {
+                __m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(stepA[0], centerX), rowEdge[0]);
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(stepA[1], centerX), rowEdge[1]);
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(stepA[2], centerX), rowEdge[2]);
+                __m128 covered = _mm_and_ps(_mm_cmpge_ps(e0, threshold), _mm_and_ps(_mm_cmpge_ps(e1, threshold), _mm_cmpge_ps(e2, threshold)));
+                if (_mm_movemask_ps(covered) == 0) { continue; }
+
+                __m128 depth = _mm_min_ps(_mm_add_ps(_mm_mul_ps(depthStep, centerX), rowDepth), depthLimit);
+                __m128 current = _mm_loadu_ps(&row[x]);
+                __m128 nearest = _mm_min_ps(current, depth);
+                _mm_storeu_ps(&row[x], _mm_or_ps(_mm_and_ps(covered, nearest), _mm_andnot_ps(covered, current)));
+            }
+        }
+    }
+
+    // The farthest depth of every tile of the band.
+    for (int tile = 0; tile < m_tilesX; tile++) {
+        __m128 farthest = _mm_setzero_ps();
+        for (y = bandTop; y < bandBottom; y++) {
+            const float* pixels = &m_depth[y * m_width + tile * OCCLUSION_TILE_SIZE];
+            for (x = 0; x < OCCLUSION_TILE_SIZE; x += 4) { farthest = _mm_max_ps(farthest, _mm_loadu_ps(&pixels[x])); }
+        }
+        m_tileMaxDepth[band * m_tilesX + tile] = MaxLane(farthest);
+    }
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool OcclusionBufferClass::TestBox(const float boxMin[3], const float boxMax[3]) const
+{
+    const float* m = m_viewProjection;
+    __m128 screenMinX, screenMaxX, screenMinY, screenMaxY, depthMin;
+    int half, x, y;
+
+    // The box on screen is the bounds of its corners, its nearest depth the nearest of theirs. The eight corners are
+    // transformed four at a time: the near face (z min) then the far face.
+    __m128 cornerX = _mm_setr_ps(boxMin[0], boxMax[0], boxMin[0], boxMax[0]);
+    __m128 cornerY = _mm_setr_ps(boxMin[1], boxMin[1], boxMax[1], boxMax[1]);
+    for (half = 0; half < 2; half++) {
+        __m128 cornerZ = _mm_set1_ps(half ? boxMax[2] : boxMin[2]);
+        __m128 clip[4];
+        for (int i = 0; i < 4; i++) {
+            clip[i] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cornerX, _mm_set1_ps(m[i])), _mm_mul_ps(cornerY, _mm_set1_ps(m[4 + i]))),
+                                 _mm_add_ps(_mm_mul_ps(cornerZ, _mm_set1_ps(m[8 + i])), _mm_set1_ps(m[12 + i])));
+        }
+        if (_mm_movemask_ps(_mm_cmplt_ps(clip[2], _mm_setzero_ps())) != 0) { return true; }
+
+        __m128 invW = _mm_div_ps(_mm_set1_ps(1.0f), clip[3]);
+        __m128 screenX = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(clip[0], invW), _mm_set1_ps(0.5f)), _mm_set1_ps(0.5f)), _mm_set1_ps((float)m_width));
+        __m128 screenY = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(0.5f), _mm_mul_ps(_mm_mul_ps(clip[1], invW), _mm_set1_ps(0.5f))), _mm_set1_ps((float)m_height));
+        __m128 depth = _mm_mul_ps(clip[2], invW);
+        if (half == 0) {
+            screenMinX = screenMaxX = screenX;
+            screenMinY = screenMaxY = screenY;
+            depthMin = depth;
+        } else {
+            screenMinX = _mm_min_ps(screenMinX, screenX);
+            screenMaxX = _mm_max_ps(screenMaxX, screenX);
+            screenMinY = _mm_min_ps(screenMinY, screenY);
+            screenMaxY = _mm_max_ps(screenMaxY, screenY);
+            depthMin = _mm_min_ps(depthMin, depth);
+        }
+    }
+    float minX = MinLane(screenMinX), maxX = MaxLane(screenMaxX);
+    float minY = MinLane(screenMinY), maxY = MaxLane(screenMaxY);
+    float nearest = MinLane(depthMin);
+
+    // Every pixel the box touches. A box off screen is left to the frustum culling.
+    int startX = (int)Clamp(floorf(minX), 0.0f, (float)m_width);
+    int endX = (int)Clamp(ceilf(maxX), 0.0f, (float)m_width);
+    int startY = (int)Clamp(floorf(minY), 0.0f, (float)m_height);
+    int endY = (int)Clamp(ceilf(maxY), 0.0f, (float)m_height);
+    if ((startX >= endX) || (startY >= endY)) { return true; }
+
+    const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 boxDepth = _mm_set1_ps(nearest);
+    __m128 first = _mm_set1_ps((float)startX), last = _mm_set1_ps((float)endX);
+
+    for (int tileY = startY / OCCLUSION_TILE_SIZE; tileY * OCCLUSION_TILE_SIZE < endY; tileY++) {
+        for (int tileX = startX / OCCLUSION_TILE_SIZE; tileX * OCCLUSION_TILE_SIZE < endX; tileX++) {
+            // All the tile is nearer than the box.
+            if (m_tileMaxDepth[tileY * m_tilesX + tileX] < nearest) { continue; }
+
+            int top = (tileY * OCCLUSION_TILE_SIZE > startY) ? tileY * OCCLUSION_TILE_SIZE : startY;
+            int bottom = ((tileY + 1) * OCCLUSION_TILE_SIZE < endY) ? (tileY + 1) * OCCLUSION_TILE_SIZE : endY;
+            for (y = top; y < bottom; y++) {
+                const float* row = &m_depth[y * m_width];
+                for (x = tileX * OCCLUSION_TILE_SIZE; x < (tileX + 1) * OCCLUSION_TILE_SIZE; x += 4) {
+                    __m128 column = _mm_add_ps(_mm_set1_ps((float)x), lanes);
+                    __m128 inside = _mm_and_ps(_mm_cmpge_ps(column, first), _mm_cmplt_ps(column, last));
+                    __m128 seen = _mm_and_ps(inside, _mm_cmpge_ps(_mm_loadu_ps(&row[x]), boxDepth));
+                    if (_mm_movemask_ps(seen) != 0) { return true; }
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int OcclusionBufferClass::GetWidth()
+{
+    return m_width;
+}
+
+int OcclusionBufferClass::GetHeight()
+{
+    return m_height;
+}
+
+const float* OcclusionBufferClass::GetDepth()
+{
+    return m_depth.data();
+}
+
+int OcclusionBufferClass::GetTriangleCount()
+{
+    return (int)m_triangles.size();
+}
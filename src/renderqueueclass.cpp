@@ -0,0 +1,190 @@
+// Filename: renderqueueclass.cpp
+#include "renderqueueclass.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#define RENDER_QUEUE_RADIX_BITS 8
+#define RENDER_QUEUE_RADIX_PASSES (64 / RENDER_QUEUE_RADIX_BITS)
+#define RENDER_QUEUE_RADIX_SIZE (1 << RENDER_QUEUE_RADIX_BITS)
+
+// Field 'value' of 'bits' bits ending at bit 'shift' of the key.
+#define RENDER_KEY_FIELD(value, bits, shift) (((unsigned long long)(value) & ((1ULL << (bits)) - 1)) << (shift))
+
+// --------------------------------------------------------------------------------------------------------------------
+RenderQueueClass::RenderQueueClass()
+{
+    m_sorted = nullptr;
+    m_nearZ = 0.1f;
+    m_logScale = 1.0f;
+}
+
+RenderQueueClass::RenderQueueClass(const RenderQueueClass& other)
+{
+}
+
+RenderQueueClass::~RenderQueueClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool RenderQueueClass::Initialize(int initialCapacity)
+{
+    if (initialCapacity < 0) { return false; }
+
+    // The queue still grows past this, but a frame of the expected size does not allocate.
+    m_packets.reserve(initialCapacity);
+    m_scratch.reserve(initialCapacity);
+    m_sorted = nullptr;
+
+    return true;
+}
+
+void RenderQueueClass::Shutdown()
+{
+    m_packets.clear();
+    m_packets.shrink_to_fit();
+    m_scratch.clear();
+    m_scratch.shrink_to_fit();
+    m_sorted = nullptr;
+
+    return;
+}
+
+void RenderQueueClass::SetDepthRange(float nearZ, float farZ)
+{
+    m_nearZ = nearZ;
+    m_logScale = 1.0f / logf(farZ / nearZ);
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+unsigned long long RenderQueueClass::MakeKey(RenderPass pass, unsigned int variant, unsigned int texture, unsigned int material, float viewDepth)
+{
+    unsigned long long key = RENDER_KEY_FIELD(pass, 2, 62);
+    unsigned int depth;
+
+    switch (pass) {
+    case RENDER_PASS_OPAQUE:
+        depth = QuantizeDepth(viewDepth, 20);
+        key |= RENDER_KEY_FIELD(depth >> 16, 4, 58) | RENDER_KEY_FIELD(variant, 10, 48) | RENDER_KEY_FIELD(texture, 16, 32) |
+               RENDER_KEY_FIELD(material, 12, 20) | RENDER_KEY_FIELD(depth, 20, 0);
+        break;
+    case RENDER_PASS_TRANSPARENT:
+        depth = QuantizeDepth(viewDepth, 24);
+        key |= RENDER_KEY_FIELD(~depth, 24, 38) | RENDER_KEY_FIELD(variant, 10, 28) | RENDER_KEY_FIELD(texture, 16, 12) |
+               RENDER_KEY_FIELD(material, 12, 0);
+        break;
+    default:
+        key |= RENDER_KEY_FIELD(material, 12, 50) | RENDER_KEY_FIELD(variant, 10, 40) | RENDER_KEY_FIELD(texture, 16, 24);
+        break;
+    }
+
+    return key;
+}
+
+unsigned int RenderQueueClass::GetResourceId(const void* resource)
+{
+    unsigned long long value = (unsigned long long)(uintptr_t)resource;
+
+    // Mix the bits of the address (the low ones are alignment) and fold them to 16 bits.
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+
+    return (unsigned int)(value & 0xffff);
+}
+
+// Logarithmic, like the depth slices of the clustered lighting: the same precision relative to the distance everywhere.
+unsigned int RenderQueueClass::QuantizeDepth(float viewDepth, int bits)
+{
+    float depth = (viewDepth > m_nearZ) ? logf(viewDepth / m_nearZ) * m_logScale : 0.0f;
+    unsigned int maxValue = (1u << bits) - 1;
+
+    if (depth >= 1.0f) { return maxValue; }
+
+    return (unsigned int)(depth * (float)maxValue);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void RenderQueueClass::Begin()
+{
+    m_packets.clear();
+    m_sorted = nullptr;
+
+    return;
+}
+
+void RenderQueueClass::Submit(unsigned long long key, unsigned int payload)
+{
+    RenderPacketType packet;
+
+    packet.key = key;
+    packet.payload = payload;
+    packet.padding = 0;
+    m_packets.push_back(packet);
+
+    return;
+}
+
+// LSD radix sort. The histograms of all the digits are built in one read of the keys, then every pass scatters the
+// packets by one digit between the two arrays. A digit that is the same for every key (the pass bits of a frame
+// with only opaque draws, the high bits of small ids) leaves the order unchanged, its pass is skipped.
+const RenderPacketType* RenderQueueClass::Sort()
+{
+    unsigned int histograms[RENDER_QUEUE_RADIX_PASSES][RENDER_QUEUE_RADIX_SIZE];
+    unsigned int offsets[RENDER_QUEUE_RADIX_SIZE];
+    size_t count = m_packets.size();
+    size_t i;
+    int pass, digit;
+
+    if (count == 0) {
+        m_sorted = m_packets.data();
+        return m_sorted;
+    }
+
+    // Step 1: Count the packets of every digit value ---------------------------------------------------------------
+    memset(histograms, 0, sizeof(histograms));
+    for (i = 0; i < count; i++) {
+        unsigned long long key = m_packets[i].key;
+        for (pass = 0; pass < RENDER_QUEUE_RADIX_PASSES; pass++) {
+            histograms[pass][(key >> (pass * RENDER_QUEUE_RADIX_BITS)) & (RENDER_QUEUE_RADIX_SIZE - 1)]++;
+        }
+    }
+
+    // Step 2: Scatter by every digit, least significant first ------------------------------------------------------
+    m_scratch.resize(count);
+    RenderPacketType* source = m_packets.data();
+    RenderPacketType* destination = m_scratch.data();
+
+    for (pass = 0; pass < RENDER_QUEUE_RADIX_PASSES; pass++) {
+        int shift = pass * RENDER_QUEUE_RADIX_BITS;
+        unsigned int* histogram = histograms[pass];
+
+        if (histogram[(source[0].key >> shift) & (RENDER_QUEUE_RADIX_SIZE - 1)] == count) { continue; }
+
+        unsigned int offset = 0;
+        for (digit = 0; digit < RENDER_QUEUE_RADIX_SIZE; digit++) {
+            offsets[digit] = offset;
+            offset += histogram[digit];
+        }
+
+        for (i = 0; i < count; i++) {
+            destination[offsets[(source[i].key >> shift) & (RENDER_QUEUE_RADIX_SIZE - 1)]++] = source[i];
+        }
+
+        std::swap(source, destination);
+    }
+
+    m_sorted = source;
+
+    return m_sorted;
+}
+
+int RenderQueueClass::GetPacketCount()
+{
+    return (int)m_packets.size();
+}
@@ -0,0 +1,219 @@
+// Filename: renderstatecacheclass.cpp
+#include "renderstatecacheclass.h"
+
+#include <cstdint>
+
+// Value of a shadow pointer after Invalidate, it is never a real object (nor null) so the next bind is issued.
+template <typename T> static T* UnknownState()
+{
+    return (T*)(~(uintptr_t)0);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+RenderStateCacheClass::RenderStateCacheClass()
+{
+    m_deviceContext = nullptr;
+    m_issuedCount = 0;
+    m_skippedCount = 0;
+    Invalidate();
+}
+
+RenderStateCacheClass::RenderStateCacheClass(const RenderStateCacheClass& other)
+{
+}
+
+RenderStateCacheClass::~RenderStateCacheClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool RenderStateCacheClass::Initialize(ID3D11DeviceContext* deviceContext)
+{
+    if (deviceContext == nullptr) { return false; }
+
+    m_deviceContext = deviceContext;
+    ResetCounters();
+    Invalidate();
+
+    return true;
+}
+
+void RenderStateCacheClass::Shutdown()
+{
+    m_deviceContext = nullptr;
+    Invalidate();
+    return;
+}
+
+void RenderStateCacheClass::Invalidate()
+{
+    int i;
+
+    m_layout = UnknownState<ID3D11InputLayout>();
+    m_topology = (D3D11_PRIMITIVE_TOPOLOGY)-1;
+    for (i = 0; i < RENDER_STATE_MAX_VERTEX_BUFFERS; i++) {
+        m_vertexBuffers[i].buffer = UnknownState<ID3D11Buffer>();
+        m_vertexBuffers[i].stride = 0;
+        m_vertexBuffers[i].offset = 0;
+    }
+    m_indexBuffer = UnknownState<ID3D11Buffer>();
+    m_indexFormat = DXGI_FORMAT_UNKNOWN;
+    m_indexOffset = 0;
+    m_vertexShader = UnknownState<ID3D11VertexShader>();
+    m_pixelShader = UnknownState<ID3D11PixelShader>();
+    for (i = 0; i < RENDER_STATE_MAX_CONSTANT_BUFFERS; i++) {
+        m_vsConstantBuffers[i] = UnknownState<ID3D11Buffer>();
+        m_psConstantBuffers[i] = UnknownState<ID3D11Buffer>();
+    }
+    for (i = 0; i < RENDER_STATE_MAX_SAMPLERS; i++) { m_psSamplers[i] = UnknownState<ID3D11SamplerState>(); }
+
+    return;
+}
+
+bool RenderStateCacheClass::IsTracked(ID3D11DeviceContext* deviceContext)
+{
+    return (deviceContext == m_deviceContext);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Every Set function compares against the shadow state first; a match is counted as skipped and goes no further.
+void RenderStateCacheClass::SetInputLayout(ID3D11DeviceContext* deviceContext, ID3D11InputLayout* layout)
+{
+    if (IsTracked(deviceContext)) {
+        if (layout == m_layout) { m_skippedCount++; return; }
+        m_layout = layout;
+    }
+
+    deviceContext->IASetInputLayout(layout);
+    if (IsTracked(deviceContext)) { m_issuedCount++; }
+
+    return;
+}
+
+void RenderStateCacheClass::SetPrimitiveTopology(ID3D11DeviceContext* deviceContext, D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+    if (IsTracked(deviceContext)) {
+        if (topology == m_topology) { m_skippedCount++; return; }
+        m_topology = topology;
+    }
+
+    deviceContext->IASetPrimitiveTopology(topology);
+    if (IsTracked(deviceContext)) { m_issuedCount++; }
+
+    return;
+}
+
+// The offset is part of the state: the ring buffer users bind the same buffer at a new offset for every upload.
+void RenderStateCacheClass::SetVertexBuffer(ID3D11DeviceContext* deviceContext, unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset)
+{
+    if (IsTracked(deviceContext) && (slot < RENDER_STATE_MAX_VERTEX_BUFFERS)) {
+        VertexBufferType& current = m_vertexBuffers[slot];
+        if ((buffer == current.buffer) && (stride == current.stride) && (offset == current.offset)) { m_skippedCount++; return; }
+        current.buffer = buffer;
+        current.stride = stride;
+        current.offset = offset;
+    }
+
+    deviceContext->IASetVertexBuffers(slot, 1, &buffer, &stride, &offset);
+    if (IsTracked(deviceContext)) { m_issuedCount++; }
+
+    return;
+}
+
+void RenderStateCacheClass::SetIndexBuffer(ID3D11DeviceContext* deviceContext, ID3D11Buffer* buffer, DXGI_FORMAT format, unsigned int offset)
+{
+    if (IsTracked(deviceContext)) {
+        if ((buffer == m_indexBuffer) && (format == m_indexFormat) && (offset == m_indexOffset)) { m_skippedCount++; return; }
+        m_indexBuffer = buffer;
+        m_indexFormat = format;
+        m_indexOffset = offset;
+    }
+
+    deviceContext->IASetIndexBuffer(buffer, format, offset);
+    if (IsTracked(deviceContext)) { m_issuedCount++; }
+
+    return;
+}
+
+void RenderStateCacheClass::SetVertexShader(ID3D11DeviceContext* deviceContext, ID3D11VertexShader* shader)
+{
+    if (IsTracked(deviceContext)) {
+        if (shader == m_vertexShader) { m_skippedCount++; return; }
+        m_vertexShader = shader;
+    }
+
+    deviceContext->VSSetShader(shader, NULL, 0);
+    if (IsTracked(deviceContext)) { m_issuedCount++; }
+
+    return;
+}
+
+void RenderStateCacheClass::SetPixelShader(ID3D11DeviceContext* deviceContext, ID3D11PixelShader* shader)
+{
+    if (IsTracked(deviceContext)) {
+        if (shader == m_pixelShader) { m_skippedCount++; return; }
+        m_pixelShader = shader;
+    }
+
+    deviceContext->PSSetShader(shader, NULL, 0);
+    if (IsTracked(deviceContext)) { m_issuedCount++; }
+
+    return;
+}
+
+void RenderStateCacheClass::SetVSConstantBuffer(ID3D11DeviceContext* deviceContext, unsigned int slot, ID3D11Buffer* buffer)
+{
+    if (IsTracked(deviceContext) && (slot < RENDER_STATE_MAX_CONSTANT_BUFFERS)) {
+        if (buffer == m_vsConstantBuffers[slot]) { m_skippedCount++; return; }
+        m_vsConstantBuffers[slot] = buffer;
+    }
+
+    deviceContext->VSSetConstantBuffers(slot, 1, &buffer);
+    if (IsTracked(deviceContext)) { m_issuedCount++; }
+
+    return;
+}
+
+void RenderStateCacheClass::SetPSConstantBuffer(ID3D11DeviceContext* deviceContext, unsigned int slot, ID3D11Buffer* buffer)
+{
+    if (IsTracked(deviceContext) && (slot < RENDER_STATE_MAX_CONSTANT_BUFFERS)) {
+        if (buffer == m_psConstantBuffers[slot]) { m_skippedCount++; return; }
+        m_psConstantBuffers[slot] = buffer;
+    }
+
+    deviceContext->PSSetConstantBuffers(slot, 1, &buffer);
+    if (IsTracked(deviceContext)) { m_issuedCount++; }
+
+    return;
+}
+
+void RenderStateCacheClass::SetPSSampler(ID3D11DeviceContext* deviceContext, unsigned int slot, ID3D11SamplerState* sampler)
+{
+    if (IsTracked(deviceContext) && (slot < RENDER_STATE_MAX_SAMPLERS)) {
+        if (sampler == m_psSamplers[slot]) { m_skippedCount++; return; }
+        m_psSamplers[slot] = sampler;
+    }
+
+    deviceContext->PSSetSamplers(slot, 1, &sampler);
+    if (IsTracked(deviceContext)) { m_issuedCount++; }
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int RenderStateCacheClass::GetIssuedCount()
+{
+    return m_issuedCount;
+}
+
+int RenderStateCacheClass::GetSkippedCount()
+{
+    return m_skippedCount;
+}
+
+void RenderStateCacheClass::ResetCounters()
+{
+    m_issuedCount = 0;
+    m_skippedCount = 0;
+    return;
+}
@@ -0,0 +1,40 @@
+// Filename: rtparallel.cpp
+#include "rtparallel.h"
+#include "jobsystemclass.h"
+
+#include <algorithm>
+#include <thread>
+
+// The job system of the process: one worker per core besides the calling thread, pinned to their cores.
+struct RTJobSystemType
+{
+    JobSystemClass jobSystem;
+
+    RTJobSystemType()
+    {
+        unsigned int coreCount = std::max(1u, std::thread::hardware_concurrency());
+        jobSystem.Initialize((int)std::min(coreCount - 1, (unsigned int)JOB_SYSTEM_MAX_WORKERS), true);
+    }
+    ~RTJobSystemType() { jobSystem.Shutdown(); }
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+JobSystemClass* RTGetJobSystem()
+{
+    static RTJobSystemType s_jobSystem;
+    return &s_jobSystem.jobSystem;
+}
+
+unsigned int RTGetWorkerCount()
+{
+    return (unsigned int)RTGetJobSystem()->GetThreadCount();
+}
+
+void RTParallelFor(int count, int grain, const std::function<void(int begin, int end)>& func)
+{
+    RTGetJobSystem()->ParallelFor(count, grain, func);
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
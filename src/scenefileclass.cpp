@@ -0,0 +1,431 @@
+// Filename: scenefileclass.cpp
+#include "scenefileclass.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#define SCENE_MAX_JSON_DEPTH 16
+#define SCENE_MAX_OBJECTS (1 << 20)         // A typo in a grid size fails the load instead of allocating forever.
+#define SCENE_DEG_TO_RAD 0.0174532925f
+
+// --------------------------------------------------------------------------------------------------------------------
+SceneFileClass::SceneFileClass()
+{
+    m_pos = 0;
+    m_line = 1;
+    m_errorLine = 0;
+}
+
+SceneFileClass::SceneFileClass(const SceneFileClass& other)
+{
+}
+
+SceneFileClass::~SceneFileClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool SceneFileClass::Initialize(const char* filename)
+{
+    JsonValue root;
+    std::ifstream file(filename, std::ios::binary);
+    std::stringstream buffer;
+
+    m_errorLine = 0;
+    if (!file) { return false; }
+    buffer << file.rdbuf();
+    m_text = buffer.str();
+    m_pos = 0;
+    m_line = 1;
+
+    // Step 1: Parse the whole file ------------------------------------------------------------------------------------
+    if (!ParseValue(root, 0)) {
+        m_errorLine = m_line;
+        return false;
+    }
+    SkipSpace();
+    if ((m_pos != m_text.size()) || (root.type != JSON_OBJECT)) {
+        m_errorLine = m_line;
+        return false;
+    }
+    m_text.clear();
+
+    // Step 2: Fill the scene from it ----------------------------------------------------------------------------------
+    strncpy(m_scene.name, filename, SCENE_MAX_PATH - 1);
+    m_scene.name[SCENE_MAX_PATH - 1] = 0;
+    if (!ReadScene(root)) { return false; }
+    DeriveFlags();
+
+    return true;
+}
+
+void SceneFileClass::Shutdown()
+{
+    m_scene.objects.clear();
+    m_scene.lights.clear();
+    m_text.clear();
+
+    return;
+}
+
+const SceneDescType& SceneFileClass::GetScene()
+{
+    return m_scene;
+}
+
+int SceneFileClass::GetErrorLine()
+{
+    return m_errorLine;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+const SceneFileClass::JsonValue* SceneFileClass::JsonValue::Find(const char* key) const
+{
+    size_t i;
+
+    for (i = 0; i < keys.size(); i++) {
+        if (keys[i] == key) { return &items[i]; }
+    }
+
+    return nullptr;
+}
+
+void SceneFileClass::SkipSpace()
+{
+    while (m_pos < m_text.size()) {
+        char c = m_text[m_pos];
+        if (c == '\n') { m_line++; }
+        else if ((c != ' ') && (c != '\t') && (c != '\r')) { break; }
+        m_pos++;
+    }
+
+    return;
+}
+
+bool SceneFileClass::ParseString(std::string& text)
+{
+    // The opening quote was checked by the caller.
+    m_pos++;
+    text.clear();
+    while (m_pos < m_text.size()) {
+        char c = m_text[m_pos++];
+        if (c == '"') { return true; }
+        if ((c == '\n') || (c == '\r')) { return false; }
+        if (c == '\\') {
+            if (m_pos >= m_text.size()) { return false; }
+            c = m_text[m_pos++];
+            switch (c) {
+            case '"': case '\\': case '/': break;
+            case 'n': c = '\n'; break;
+            case 't': c = '\t'; break;
+            default: return false;          // \u escapes are not used by the scene files.
+            }
+        }
+        text += c;
+    }
+
+    return false;
+}
+
+bool SceneFileClass::ParseValue(JsonValue& value, int depth)
+{
+    if (depth > SCENE_MAX_JSON_DEPTH) { return false; }
+
+    SkipSpace();
+    if (m_pos >= m_text.size()) { return false; }
+    value.line = m_line;
+
+    char c = m_text[m_pos];
+    if (c == '{') {
+        value.type = JSON_OBJECT;
+        m_pos++;
+        SkipSpace();
+        if ((m_pos < m_text.size()) && (m_text[m_pos] == '}')) { m_pos++; return true; }
+        while (true) {
+            SkipSpace();
+            if ((m_pos >= m_text.size()) || (m_text[m_pos] != '"')) { return false; }
+            value.keys.emplace_back();
+            if (!ParseString(value.keys.back())) { return false; }
+            SkipSpace();
+            if ((m_pos >= m_text.size()) || (m_text[m_pos] != ':')) { return false; }
+            m_pos++;
+            value.items.emplace_back();
+            if (!ParseValue(value.items.back(), depth + 1)) { return false; }
+            SkipSpace();
+            if (m_pos >= m_text.size()) { return false; }
+            c = m_text[m_pos++];
+            if (c == '}') { return true; }
+            if (c != ',') { return false; }
+        }
+    }
+    if (c == '[') {
+        value.type = JSON_ARRAY;
+        m_pos++;
+        SkipSpace();
+        if ((m_pos < m_text.size()) && (m_text[m_pos] == ']')) { m_pos++; return true; }
+        while (true) {
+            value.items.emplace_back();
+            if (!ParseValue(value.items.back(), depth + 1)) { return false; }
+            SkipSpace();
+            if (m_pos >= m_text.size()) { return false; }
+            c = m_text[m_pos++];
+            if (c == ']') { return true; }
+            if (c != ',') { return false; }
+        }
+    }
+    if (c == '"') {
+        value.type = JSON_STRING;
+        return ParseString(value.text);
+    }
+    if (m_text.compare(m_pos, 4, "true") == 0) {
+        value.type = JSON_BOOL;
+        value.number = 1.0;
+        m_pos += 4;
+        return true;
+    }
+    if (m_text.compare(m_pos, 5, "false") == 0) {
+        value.type = JSON_BOOL;
+        m_pos += 5;
+        return true;
+    }
+    if (m_text.compare(m_pos, 4, "null") == 0) {
+        m_pos += 4;
+        return true;
+    }
+
+    // Anything else has to be a number.
+    const char* start = m_text.c_str() + m_pos;
+    char* end;
+    value.type = JSON_NUMBER;
+    value.number = strtod(start, &end);
+    if (end == start) { return false; }
+    m_pos += end - start;
+
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// A missing value keeps the defaults already in 'floats'.
+bool SceneFileClass::ReadFloats(const JsonValue* value, float* floats, int count)
+{
+    int i;
+
+    if (!value) { return true; }
+    if ((value->type != JSON_ARRAY) || ((int)value->items.size() != count)) { m_errorLine = value->line; return false; }
+    for (i = 0; i < count; i++) {
+        if (value->items[i].type != JSON_NUMBER) { m_errorLine = value->line; return false; }
+        floats[i] = (float)value->items[i].number;
+    }
+
+    return true;
+}
+
+bool SceneFileClass::ReadPath(const JsonValue* value, char* path)
+{
+    path[0] = 0;
+    if (!value) { return true; }
+    if ((value->type != JSON_STRING) || (value->text.size() >= SCENE_MAX_PATH)) { m_errorLine = value->line; return false; }
+    strcpy(path, value->text.c_str());
+
+    return true;
+}
+
+bool SceneFileClass::ReadBool(const JsonValue* value, bool& flag)
+{
+    flag = false;
+    if (!value) { return true; }
+    if (value->type != JSON_BOOL) { m_errorLine = value->line; return false; }
+    flag = (value->number != 0.0);
+
+    return true;
+}
+
+bool SceneFileClass::ReadScene(const JsonValue& root)
+{
+    const JsonValue* value;
+    bool result;
+
+    // Step 1: Clear color and camera ----------------------------------------------------------------------------------
+    float clearColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    float cameraPosition[3] = { 0.0f, 0.0f, -5.0f };
+    float cameraRotation[3] = { 0.0f, 0.0f, 0.0f };
+    memcpy(m_scene.clearColor, clearColor, sizeof(clearColor));
+    memcpy(m_scene.cameraPosition, cameraPosition, sizeof(cameraPosition));
+    memcpy(m_scene.cameraRotation, cameraRotation, sizeof(cameraRotation));
+
+    result = ReadFloats(root.Find("clearColor"), m_scene.clearColor, 4) && ReadBool(root.Find("clearOnly"), m_scene.clearOnly);
+    if (!result) { return false; }
+
+    value = root.Find("camera");
+    if (value) {
+        if (value->type != JSON_OBJECT) { m_errorLine = value->line; return false; }
+        result = ReadFloats(value->Find("position"), m_scene.cameraPosition, 3) && ReadFloats(value->Find("rotation"), m_scene.cameraRotation, 3);
+        if (!result) { return false; }
+    }
+
+    // Step 2: Model, texture and the copies of the model --------------------------------------------------------------
+    m_scene.craft = SCENE_CRAFT_FULLCOL;
+    value = root.Find("craft");
+    if (value) {
+        if ((value->type == JSON_STRING) && (value->text == "red")) { m_scene.craft = SCENE_CRAFT_RED; }
+        else if ((value->type == JSON_STRING) && (value->text == "redinc")) { m_scene.craft = SCENE_CRAFT_REDINC; }
+        else if ((value->type == JSON_STRING) && (value->text == "fullcol")) { m_scene.craft = SCENE_CRAFT_FULLCOL; }
+        else { m_errorLine = value->line; return false; }
+    }
+
+    result = ReadPath(root.Find("model"), m_scene.model) && ReadPath(root.Find("texture"), m_scene.texture);
+    if (!result) { return false; }
+
+    result = ReadObjects(root.Find("objects"));
+    if (!result) { return false; }
+
+    // Step 3: Lights, a light type missing from the file is off -------------------------------------------------------
+    float black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    memcpy(m_scene.ambientColor, black, sizeof(black));
+    memcpy(m_scene.specularColor, black, sizeof(black));
+    m_scene.specularPower = 0.0f;
+
+    value = root.Find("ambient");
+    m_scene.useAmbient = (value != nullptr);
+    result = ReadFloats(value, m_scene.ambientColor, 4);
+    if (!result) { return false; }
+
+    result = ReadLights(root.Find("lights"));
+    if (!result) { return false; }
+
+    value = root.Find("specular");
+    m_scene.useSpecular = (value != nullptr);
+    if (value) {
+        const JsonValue* power = value->Find("power");
+        if ((value->type != JSON_OBJECT) || !power || (power->type != JSON_NUMBER)) { m_errorLine = value->line; return false; }
+        m_scene.specularPower = (float)power->number;
+        result = ReadFloats(value->Find("color"), m_scene.specularColor, 4);
+        if (!result) { return false; }
+    }
+
+    // Step 4: 2D rendering and the features of the tests --------------------------------------------------------------
+    result = ReadPath(root.Find("bitmap"), m_scene.bitmap) &&
+             ReadBool(root.Find("spriteAnimation"), m_scene.spriteAnimation) &&
+             ReadBool(root.Find("spriteStress"), m_scene.spriteStress) &&
+             ReadBool(root.Find("instancing"), m_scene.instancing) &&
+             ReadBool(root.Find("clusteredLights"), m_scene.clusteredLights) &&
+             ReadBool(root.Find("deferred"), m_scene.deferred) &&
+             ReadBool(root.Find("hud"), m_scene.hud);
+    if (!result) { return false; }
+
+    // Combinations the application has no path for.
+    if ((m_scene.instancing && m_scene.deferred) || (m_scene.spriteAnimation && (m_scene.bitmap[0] == 0))) {
+        m_errorLine = root.line;
+        return false;
+    }
+
+    return true;
+}
+
+// Every entry is one object, or a countX x countZ grid of them centered on its position when it has a "grid".
+bool SceneFileClass::ReadObjects(const JsonValue* objects)
+{
+    SceneObjectType object;
+    int grid[2], x, z;
+    float gridValues[2], spacing, phaseStep;
+    bool result;
+
+    m_scene.objects.clear();
+    if (!objects) {
+        object = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, false };
+        m_scene.objects.push_back(object);
+        return true;
+    }
+    if ((objects->type != JSON_ARRAY) || objects->items.empty()) { m_errorLine = objects->line; return false; }
+
+    for (auto& entry : objects->items) {
+        const JsonValue* value;
+
+        if (entry.type != JSON_OBJECT) { m_errorLine = entry.line; return false; }
+
+        object = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f, false };
+        gridValues[0] = gridValues[1] = 1.0f;
+        spacing = 0.0f;
+        phaseStep = 0.0f;
+        result = ReadFloats(entry.Find("position"), object.position, 3) &&
+                 ReadFloats(entry.Find("rotation"), object.rotation, 3) &&
+                 ReadFloats(entry.Find("scale"), object.scale, 3) &&
+                 ReadFloats(entry.Find("grid"), gridValues, 2) &&
+                 ReadBool(entry.Find("occluder"), object.occluder);
+        if (!result) { return false; }
+
+        // The single numbers. Angles are given in degrees.
+        const char* names[] = { "spin", "phase", "spacing", "phaseStep" };
+        float* targets[] = { &object.spin, &object.phase, &spacing, &phaseStep };
+        for (int i = 0; i < 4; i++) {
+            value = entry.Find(names[i]);
+            if (!value) { continue; }
+            if (value->type != JSON_NUMBER) { m_errorLine = value->line; return false; }
+            *targets[i] = (float)value->number;
+        }
+        for (int i = 0; i < 3; i++) { object.rotation[i] *= SCENE_DEG_TO_RAD; }
+        object.phase *= SCENE_DEG_TO_RAD;
+        phaseStep *= SCENE_DEG_TO_RAD;
+
+        grid[0] = (int)gridValues[0];
+        grid[1] = (int)gridValues[1];
+        if ((grid[0] < 1) || (grid[1] < 1) || ((long long)grid[0] * grid[1] + m_scene.objects.size() > SCENE_MAX_OBJECTS)) {
+            m_errorLine = entry.line;
+            return false;
+        }
+
+        float origin[3] = { object.position[0], object.position[1], object.position[2] };
+        float phase = object.phase;
+        for (z = 0; z < grid[1]; z++) {
+            for (x = 0; x < grid[0]; x++) {
+                object.position[0] = origin[0] + spacing * (float)(x - grid[0] / 2);
+                object.position[2] = origin[2] + spacing * (float)(z - grid[1] / 2);
+                object.phase = phase + phaseStep * (float)(z * grid[0] + x);
+                m_scene.objects.push_back(object);
+            }
+        }
+    }
+
+    return true;
+}
+
+// All the lights of a scene light along their direction or all from their position, the light shader does one or the other.
+bool SceneFileClass::ReadLights(const JsonValue* lights)
+{
+    SceneLightType light;
+    bool result;
+
+    m_scene.lights.clear();
+    if (!lights) { return true; }
+    if ((lights->type != JSON_ARRAY) || (lights->items.size() > SCENE_MAX_LIGHTS)) { m_errorLine = lights->line; return false; }
+
+    for (auto& entry : lights->items) {
+        if (entry.type != JSON_OBJECT) { m_errorLine = entry.line; return false; }
+
+        light = { { 1.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f }, false };
+        light.positional = (entry.Find("position") != nullptr);
+        result = ReadFloats(entry.Find("color"), light.color, 4) &&
+                 ReadFloats(entry.Find("direction"), light.direction, 3) &&
+                 ReadFloats(entry.Find("position"), light.position, 3);
+        if (!result) { return false; }
+
+        if (!m_scene.lights.empty() && (light.positional != m_scene.lights[0].positional)) { m_errorLine = entry.line; return false; }
+        m_scene.lights.push_back(light);
+    }
+
+    return true;
+}
+
+void SceneFileClass::DeriveFlags()
+{
+    m_scene.use2D = (m_scene.bitmap[0] != 0) || m_scene.spriteStress;
+    m_scene.useTexture = (m_scene.texture[0] != 0) || m_scene.use2D;
+    m_scene.useDiffuse = !m_scene.lights.empty() || m_scene.clusteredLights;
+    m_scene.useTimer = m_scene.spriteAnimation || m_scene.spriteStress || m_scene.hud;
+    m_scene.useOcclusion = false;
+    for (auto& object : m_scene.objects) { m_scene.useOcclusion = m_scene.useOcclusion || object.occluder; }
+
+    return;
+}
@@ -0,0 +1,288 @@
+// Filename: scenegraphclass.cpp
+#include "scenegraphclass.h"
+#include "rtparallel.h"
+
+#include <atomic>
+#include <xmmintrin.h>
+
+// Nodes per chunk when a depth level is split across the worker threads, smaller levels are updated inline.
+#define SCENE_GRAPH_GRAIN 4096
+
+// --------------------------------------------------------------------------------------------------------------------
+SceneGraphClass::SceneGraphClass()
+{
+    m_sorted = true;
+    m_updateCount = 0;
+}
+
+SceneGraphClass::SceneGraphClass(const SceneGraphClass& other)
+{
+}
+
+SceneGraphClass::~SceneGraphClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool SceneGraphClass::Initialize(int initialCapacity)
+{
+    if (initialCapacity < 0) { return false; }
+
+    m_local.reserve(initialCapacity);
+    m_world.reserve(initialCapacity);
+    m_parent.reserve(initialCapacity);
+    m_depth.reserve(initialCapacity);
+    m_node.reserve(initialCapacity);
+    m_dirty.reserve(initialCapacity);
+    m_updateStamp.reserve(initialCapacity);
+    m_slot.reserve(initialCapacity);
+    m_levelStart.assign(1, 0);
+    m_sorted = true;
+    m_updateCount = 0;
+
+    return true;
+}
+
+void SceneGraphClass::Shutdown()
+{
+    m_local.clear();
+    m_world.clear();
+    m_parent.clear();
+    m_depth.clear();
+    m_node.clear();
+    m_dirty.clear();
+    m_updateStamp.clear();
+    m_slot.clear();
+    m_levelStart.clear();
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int SceneGraphClass::AddNode(int parent)
+{
+    SceneTransformType local = { { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f, 0.0f } };
+    SceneMatrixType world = { { 1.0f, 0.0f, 0.0f, 0.0f,  0.0f, 1.0f, 0.0f, 0.0f,  0.0f, 0.0f, 1.0f, 0.0f,  0.0f, 0.0f, 0.0f, 1.0f } };
+    int node = (int)m_slot.size();
+    int slot = (int)m_local.size();
+    int parentSlot = -1;
+
+    if ((parent >= node) || (parent < -1)) { return -1; }
+    if (parent >= 0) { parentSlot = m_slot[parent]; }
+
+    m_local.push_back(local);
+    m_world.push_back(world);
+    m_parent.push_back(parentSlot);
+    m_depth.push_back((parentSlot >= 0) ? m_depth[parentSlot] + 1 : 0);
+    m_node.push_back(node);
+    m_dirty.push_back(1);
+    m_updateStamp.push_back(0);
+    m_slot.push_back(slot);
+
+    // The level table is rebuilt (and the arrays reordered if this node broke the depth order) on the next update.
+    m_sorted = false;
+
+    return node;
+}
+
+int SceneGraphClass::GetNodeCount()
+{
+    return (int)m_slot.size();
+}
+
+void SceneGraphClass::SetTranslation(int node, float x, float y, float z)
+{
+    int slot = m_slot[node];
+
+    m_local[slot].translation[0] = x;
+    m_local[slot].translation[1] = y;
+    m_local[slot].translation[2] = z;
+    m_dirty[slot] = 1;
+
+    return;
+}
+
+void SceneGraphClass::SetRotation(int node, float x, float y, float z, float w)
+{
+    int slot = m_slot[node];
+
+    m_local[slot].rotation[0] = x;
+    m_local[slot].rotation[1] = y;
+    m_local[slot].rotation[2] = z;
+    m_local[slot].rotation[3] = w;
+    m_dirty[slot] = 1;
+
+    return;
+}
+
+void SceneGraphClass::SetScale(int node, float x, float y, float z)
+{
+    int slot = m_slot[node];
+
+    m_local[slot].scale[0] = x;
+    m_local[slot].scale[1] = y;
+    m_local[slot].scale[2] = z;
+    m_dirty[slot] = 1;
+
+    return;
+}
+
+const SceneMatrixType* SceneGraphClass::GetWorldMatrix(int node)
+{
+    return &m_world[m_slot[node]];
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Stable counting sort of the slots by depth, then the level table. Children added after their parent (the usual
+// case) keep the arrays in depth order and only the level table is rebuilt.
+void SceneGraphClass::SortByDepth()
+{
+    int count = (int)m_local.size();
+    int maxDepth = 0;
+    bool ordered = true;
+    int slot, depth;
+
+    for (slot = 0; slot < count; slot++) {
+        if (m_depth[slot] > maxDepth) { maxDepth = m_depth[slot]; }
+        if ((slot > 0) && (m_depth[slot] < m_depth[slot - 1])) { ordered = false; }
+    }
+
+    m_levelStart.assign(maxDepth + 2, 0);
+    for (slot = 0; slot < count; slot++) { m_levelStart[m_depth[slot] + 1]++; }
+    for (depth = 0; depth <= maxDepth; depth++) { m_levelStart[depth + 1] += m_levelStart[depth]; }
+
+    if (!ordered) {
+        std::vector<int> newSlot(count);
+        std::vector<int> next(m_levelStart.begin(), m_levelStart.end() - 1);
+        for (slot = 0; slot < count; slot++) { newSlot[slot] = next[m_depth[slot]]++; }
+
+        std::vector<SceneTransformType> local(count);
+        std::vector<SceneMatrixType> world(count);
+        std::vector<int> parent(count), depths(count), node(count);
+        std::vector<unsigned char> dirty(count);
+        std::vector<unsigned int> updateStamp(count);
+        for (slot = 0; slot < count; slot++) {
+            int target = newSlot[slot];
+            local[target] = m_local[slot];
+            world[target] = m_world[slot];
+            parent[target] = (m_parent[slot] >= 0) ? newSlot[m_parent[slot]] : -1;
+            depths[target] = m_depth[slot];
+            node[target] = m_node[slot];
+            dirty[target] = m_dirty[slot];
+            updateStamp[target] = m_updateStamp[slot];
+            m_slot[m_node[slot]] = target;
+        }
+
+        m_local.swap(local);
+        m_world.swap(world);
+        m_parent.swap(parent);
+        m_depth.swap(depths);
+        m_node.swap(node);
+        m_dirty.swap(dirty);
+        m_updateStamp.swap(updateStamp);
+    }
+
+    m_sorted = true;
+
+    return;
+}
+
+int SceneGraphClass::Update(bool useThreads)
+{
+    std::atomic<int> updated(0);
+    int level;
+
+    if (!m_sorted) { SortByDepth(); }
+
+    m_updateCount++;
+
+    // Level after level, a level only reads the world matrices of the one above.
+    for (level = 0; level + 1 < (int)m_levelStart.size(); level++) {
+        int begin = m_levelStart[level];
+        int end = m_levelStart[level + 1];
+
+        if (useThreads && ((end - begin) >= 2 * SCENE_GRAPH_GRAIN)) {
+            RTParallelFor(end - begin, SCENE_GRAPH_GRAIN, [&](int chunkBegin, int chunkEnd) {
+                updated += UpdateRange(begin + chunkBegin, begin + chunkEnd);
+            });
+        } else {
+            updated += UpdateRange(begin, end);
+        }
+    }
+
+    return updated;
+}
+
+// Rows of the local matrix = scale * rotation * translation (XMMatrixAffineTransformation) from the quaternion, the
+// scale and the translation.
+static inline void ComputeLocalRows(const SceneTransformType& local, __m128 rows[4])
+{
+    float x = local.rotation[0], y = local.rotation[1], z = local.rotation[2], w = local.rotation[3];
+    float xx = x * x, yy = y * y, zz = z * z, xy = x * y, xz = x * z, yz = y * z, wx = w * x, wy = w * y, wz = w * z;
+
+    rows[0] = _mm_mul_ps(_mm_set1_ps(local.scale[0]), _mm_setr_ps(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f));
+    rows[1] = _mm_mul_ps(_mm_set1_ps(local.scale[1]), _mm_setr_ps(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f));
+    rows[2] = _mm_mul_ps(_mm_set1_ps(local.scale[2]), _mm_setr_ps(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f));
+    rows[3] = _mm_setr_ps(local.translation[0], local.translation[1], local.translation[2], 1.0f);
+
+    return;
+}
+
+void SceneGraphClass::ComputeLocalMatrix(const SceneTransformType& local, SceneMatrixType& matrix)
+{
+    __m128 rows[4];
+
+    ComputeLocalRows(local, rows);
+    _mm_storeu_ps(matrix.m, rows[0]);
+    _mm_storeu_ps(matrix.m + 4, rows[1]);
+    _mm_storeu_ps(matrix.m + 8, rows[2]);
+    _mm_storeu_ps(matrix.m + 12, rows[3]);
+
+    return;
+}
+
+// World = local * parent world. Every row of the product is a sum of the rows of the parent matrix weighted by the
+// local row, four lanes at a time.
+int SceneGraphClass::UpdateRange(int begin, int end)
+{
+    __m128 rows[4];
+    int updated = 0;
+    int slot;
+
+    for (slot = begin; slot < end; slot++) {
+        int parent = m_parent[slot];
+        bool parentUpdated = (parent >= 0) && (m_updateStamp[parent] == m_updateCount);
+        if (!m_dirty[slot] && !parentUpdated) { continue; }
+
+        // Step 1: Rows of the local matrix -----------------------------------------------------------------------------
+        ComputeLocalRows(m_local[slot], rows);
+
+        // Step 2: Multiply by the parent world matrix -----------------------------------------------------------------
+        float* world = m_world[slot].m;
+        if (parent >= 0) {
+            const float* parentWorld = m_world[parent].m;
+            __m128 p0 = _mm_load_ps(parentWorld);
+            __m128 p1 = _mm_load_ps(parentWorld + 4);
+            __m128 p2 = _mm_load_ps(parentWorld + 8);
+            __m128 p3 = _mm_load_ps(parentWorld + 12);
+            for (int i = 0; i < 4; i++) {
+                __m128 result = _mm_mul_ps(_mm_shuffle_ps(rows[i], rows[i], _MM_SHUFFLE(0, 0, 0, 0)), p0);
+                result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(rows[i], rows[i], _MM_SHUFFLE(1, 1, 1, 1)), p1));
+                result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(rows[i], rows[i], _MM_SHUFFLE(2, 2, 2, 2)), p2));
+                result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(rows[i], rows[i], _MM_SHUFFLE(3, 3, 3, 3)), p3));
+                _mm_store_ps(world + 4 * i, result);
+            }
+        } else {
+            _mm_store_ps(world, rows[0]);
+            _mm_store_ps(world + 4, rows[1]);
+            _mm_store_ps(world + 8, rows[2]);
+            _mm_store_ps(world + 12, rows[3]);
+        }
+
+        m_dirty[slot] = 0;
+        m_updateStamp[slot] = m_updateCount;
+        updated++;
+    }
+
+    return updated;
+}
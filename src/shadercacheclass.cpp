@@ -0,0 +1,258 @@
+// Filename: shadercacheclass.cpp
+#include "shadercacheclass.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#define SHADER_CACHE_MAGIC 0x43535452      // "RTSC"
+#define SHADER_CACHE_VERSION 2             // Bump when the entry layout or the key computation changes.
+#define SHADER_CACHE_MAX_INCLUDE_DEPTH 16
+
+// Header of a cache entry file, followed by the bytecode and the metadata.
+struct ShaderCacheEntryHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned long long key;
+    unsigned long long size;
+    unsigned long long metadataSize;
+    unsigned long long checksum;           // Hash of the bytecode and the metadata, a truncated or corrupted entry is a miss.
+};
+
+// 64 bit FNV-1a, continued from the previous hash so several inputs can be chained into one key.
+static unsigned long long HashBytes(unsigned long long hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+// Strings are hashed with their terminating zero so that ("ab", "c") and ("a", "bc") give different keys.
+static unsigned long long HashString(unsigned long long hash, const std::string& text)
+{
+    return HashBytes(hash, text.c_str(), text.size() + 1);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+ShaderCacheClass::ShaderCacheClass()
+{
+    m_compilerVersion = 0;
+    m_hitCount = 0;
+    m_missCount = 0;
+}
+
+ShaderCacheClass::ShaderCacheClass(const ShaderCacheClass& other)
+{
+}
+
+ShaderCacheClass::~ShaderCacheClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool ShaderCacheClass::Initialize(const char* cacheDirectory, unsigned int compilerVersion)
+{
+    std::error_code error;
+
+    m_directory = cacheDirectory;
+    m_compilerVersion = compilerVersion;
+    m_hitCount = 0;
+    m_missCount = 0;
+
+    std::filesystem::create_directories(m_directory, error);
+    if (error) { return false; }
+
+    return true;
+}
+
+void ShaderCacheClass::Shutdown()
+{
+    m_directory.clear();
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Look the shader up in the cache, on a miss compile it and store the result for the next launch. A failure to write
+// the entry is not an error, the shader is just compiled again next time.
+bool ShaderCacheClass::GetBytecode(const char* sourceFile, const std::vector<ShaderDefine>& defines, const char* entryPoint, const char* profile,
+                                   unsigned int flags, const CompileFunction& compile, std::vector<unsigned char>& bytecode,
+                                   std::vector<unsigned char>& metadata)
+{
+    unsigned long long key;
+    bool result;
+
+    // Without a readable source there is no key, let the compiler report the missing file.
+    result = ComputeKey(sourceFile, defines, entryPoint, profile, flags, key);
+    if (!result) { return compile(bytecode, metadata); }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (ReadEntry(key, bytecode, metadata)) {
+            m_hitCount++;
+            return true;
+        }
+        m_missCount++;
+    }
+
+    // Compile outside the lock, a shader hot reload can compile on its own thread while the render thread does too.
+    result = compile(bytecode, metadata);
+    if (!result) { return false; }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    WriteEntry(key, bytecode, metadata);
+
+    return true;
+}
+
+bool ShaderCacheClass::ComputeKey(const char* sourceFile, const std::vector<ShaderDefine>& defines, const char* entryPoint, const char* profile,
+                                  unsigned int flags, unsigned long long& key)
+{
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+    unsigned int version = SHADER_CACHE_VERSION;
+    bool result;
+
+    hash = HashBytes(hash, &version, sizeof(version));
+    hash = HashBytes(hash, &m_compilerVersion, sizeof(m_compilerVersion));
+
+    result = HashSourceFile(sourceFile, hash, 0);
+    if (!result) { return false; }
+
+    for (auto& define : defines) {
+        hash = HashString(hash, define.first);
+        hash = HashString(hash, define.second);
+    }
+    hash = HashString(hash, entryPoint);
+    hash = HashString(hash, profile);
+    hash = HashBytes(hash, &flags, sizeof(flags));
+
+    key = hash;
+
+    return true;
+}
+
+// Hash the text of a source file and, recursively, of the files it includes with #include "file" (relative to the
+// including file, like the standard include handler of the compiler).
+bool ShaderCacheClass::HashSourceFile(const std::string& filename, unsigned long long& hash, int depth)
+{
+    std::ifstream fin;
+    std::stringstream text;
+    std::string line, includeName;
+    size_t start, end;
+
+    if (depth > SHADER_CACHE_MAX_INCLUDE_DEPTH) { return false; }
+
+    fin.open(filename, std::ios::binary);
+    if (fin.fail()) { return false; }
+    text << fin.rdbuf();
+    fin.close();
+
+    hash = HashString(hash, filename);
+    hash = HashString(hash, text.str());
+
+    while (std::getline(text, line)) {
+        start = line.find_first_not_of(" \t");
+        if ((start == std::string::npos) || (line.compare(start, 8, "#include") != 0)) { continue; }
+
+        start = line.find('"', start + 8);
+        end = (start == std::string::npos) ? std::string::npos : line.find('"', start + 1);
+        if (end == std::string::npos) { continue; }
+
+        includeName = line.substr(start + 1, end - start - 1);
+        if (!HashSourceFile((std::filesystem::path(filename).parent_path() / includeName).string(), hash, depth + 1)) { return false; }
+    }
+
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+std::string ShaderCacheClass::GetEntryFilename(unsigned long long key)
+{
+    char name[32];
+
+    snprintf(name, sizeof(name), "%016llx.cso", key);
+    return (std::filesystem::path(m_directory) / name).string();
+}
+
+bool ShaderCacheClass::ReadEntry(unsigned long long key, std::vector<unsigned char>& bytecode, std::vector<unsigned char>& metadata)
+{
+    ShaderCacheEntryHeader header;
+    std::ifstream fin;
+
+    fin.open(GetEntryFilename(key), std::ios::binary);
+    if (fin.fail()) { return false; }
+
+    fin.read((char*)&header, sizeof(header));
+    if (fin.fail()) { return false; }
+    if ((header.magic != SHADER_CACHE_MAGIC) || (header.version != SHADER_CACHE_VERSION) || (header.key != key)) { return false; }
+    if ((header.size == 0) || (header.size > (64ULL * 1024 * 1024)) || (header.metadataSize > (64ULL * 1024 * 1024))) { return false; }
+
+    bytecode.resize((size_t)header.size);
+    fin.read((char*)bytecode.data(), (std::streamsize)header.size);
+    metadata.resize((size_t)header.metadataSize);
+    fin.read((char*)metadata.data(), (std::streamsize)header.metadataSize);
+    if (fin.fail()) { return false; }
+
+    if (HashBytes(HashBytes(0xcbf29ce484222325ULL, bytecode.data(), bytecode.size()), metadata.data(), metadata.size()) != header.checksum) {
+        return false;
+    }
+
+    return true;
+}
+
+// The entry is written to a temporary file and renamed, so another instance reading the cache at the same time
+// never sees a half written entry.
+bool ShaderCacheClass::WriteEntry(unsigned long long key, const std::vector<unsigned char>& bytecode, const std::vector<unsigned char>& metadata)
+{
+    ShaderCacheEntryHeader header;
+    std::ofstream fout;
+    std::string filename, tempFilename;
+    std::error_code error;
+
+    filename = GetEntryFilename(key);
+    tempFilename = filename + ".tmp";
+
+    memset(&header, 0, sizeof(header));
+    header.magic = SHADER_CACHE_MAGIC;
+    header.version = SHADER_CACHE_VERSION;
+    header.key = key;
+    header.size = bytecode.size();
+    header.metadataSize = metadata.size();
+    header.checksum = HashBytes(HashBytes(0xcbf29ce484222325ULL, bytecode.data(), bytecode.size()), metadata.data(), metadata.size());
+
+    fout.open(tempFilename, std::ios::binary | std::ios::trunc);
+    if (fout.fail()) { return false; }
+    fout.write((const char*)&header, sizeof(header));
+    fout.write((const char*)bytecode.data(), (std::streamsize)bytecode.size());
+    fout.write((const char*)metadata.data(), (std::streamsize)metadata.size());
+    fout.close();
+    if (fout.fail()) { std::filesystem::remove(tempFilename, error); return false; }
+
+    std::filesystem::rename(tempFilename, filename, error);
+    if (error) { std::filesystem::remove(tempFilename, error); return false; }
+
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int ShaderCacheClass::GetHitCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hitCount;
+}
+
+int ShaderCacheClass::GetMissCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_missCount;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
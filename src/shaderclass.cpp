@@ -3,21 +3,38 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include "RasterTek.h"
 #include "shaderclass.h"
+#include "instancebufferclass.h"
+
+// Names of the cbuffers in the shader files, in ShaderConstantBuffer order.
+static const char* CBUFFER_NAMES[CBUFFER_COUNT] = { "FrameBuffer", "ObjectBuffer", "LightBuffer", "MaterialBuffer" };
 
 // --------------------------------------------------------------------------------------------------------------------
 ShaderClass::ShaderClass()
 {
+    m_device = nullptr;
+    m_hwnd = NULL;
+    m_ShaderCache = nullptr;
+    m_StateCache = nullptr;
+    m_useClusteredLights = false;
+    m_reloadPending = false;
+    m_currentVariant = 0;
     m_vertexShader = nullptr;
     m_pixelShader = nullptr;
+    for (int i = 0; i < CBUFFER_COUNT; i++) {
+        m_vsSlots[i] = -1;
+        m_psSlots[i] = -1;
+    }
     m_layout = nullptr;
     m_sampleState = nullptr;
     
-    m_matrixBuffer = nullptr;
-    m_textureConfigBuffer = nullptr;
-    m_lightConfigBuffer = nullptr;
-    m_lightDiffuseParamBuffer = nullptr;
-    m_lightAmbientSpecularParamBuffer = nullptr;
-    m_cameraBuffer = nullptr;
+    m_frameBuffer = { nullptr, 0 };
+    m_objectBuffer = { nullptr, 0 };
+    m_lightBuffer = { nullptr, 0 };
+    m_materialBuffer = { nullptr, 0 };
+    m_mapCount = 0;
+
+    m_boundTexture = nullptr;
+    m_textureSlice = 0;
 }
 
 ShaderClass::ShaderClass(const ShaderClass& other)
@@ -29,12 +46,20 @@ ShaderClass::~ShaderClass()
 }
 
 // --------------------------------------------------------------------------------------------------------------------
-bool ShaderClass::Initialize(ID3D11Device* device, HWND hwnd, bool useTexture, bool useAmbient, bool useDiffuse, bool useSpecular)
+// useTextureArray selects the shader sampling a Texture2DArray (e.g. the frames of an animated sprite), the slice to
+// sample is then given with SetTextureSlice before each Render call.
+// useInstancing selects the instanced vertex shader, drawn with RenderInstanced and an InstanceBufferClass stream.
+// The lighting features and numDiffuseLights select the light shader variant compiled up front, other combinations
+// used later by Render are compiled the first time they are needed.
+bool ShaderClass::Initialize(ID3D11Device* device, HWND hwnd, bool useTexture, bool useTextureArray, bool useInstancing, bool useAmbient, bool useDiffuse, bool useSpecular,
+                             unsigned int numDiffuseLights)
 {
     bool result;
 
-    auto useLighting = useAmbient || useDiffuse || useSpecular;
-    result = SetShaderUsed(useTexture, useLighting);
+    m_device = device;
+    m_hwnd = hwnd;
+
+    result = SetShaderUsed(useTexture, useTextureArray, useInstancing, useAmbient, useDiffuse, useSpecular, numDiffuseLights);
     if (!result) { return false; }
 
     // Initialize the vertex and pixel shaders.
@@ -52,10 +77,43 @@ void ShaderClass::Shutdown()
     return;
 }
 
+// The cache is shared by all the shader objects and owned by the caller, it must be set before Initialize.
+void ShaderClass::SetShaderCache(ShaderCacheClass* shaderCache)
+{
+    m_ShaderCache = shaderCache;
+    return;
+}
+
+// Optional, without a state cache every draw binds its whole pipeline state.
+void ShaderClass::SetStateCache(RenderStateCacheClass* stateCache)
+{
+    m_StateCache = stateCache;
+    return;
+}
+
+// The clustered point lights are a compile time feature of the light shader like the others, it must be set before
+// Initialize. The structured buffers and the cluster grid are bound by ClusteredLightingClass.
+void ShaderClass::SetClusteredLighting(bool useClusteredLights)
+{
+    m_useClusteredLights = useClusteredLights;
+    return;
+}
+
+void ShaderClass::SetTextureSlice(unsigned int slice)
+{
+    m_textureSlice = slice;
+    return;
+}
+
 // --------------------------------------------------------------------------------------------------------------------
-bool ShaderClass::SetShaderUsed(bool useTexture, bool useLighting)
+bool ShaderClass::SetShaderUsed(bool useTexture, bool useTextureArray, bool useInstancing, bool useAmbient, bool useDiffuse, bool useSpecular,
+                                unsigned int numDiffuseLights)
 {
     bool status = true;
+    bool useLighting = useAmbient || useDiffuse || useSpecular;
+
+    m_shader_info.instanced = false;
+    m_shader_info.variant = 0;
 
     if (!useTexture && !useLighting) {
         m_shader_info.type = SHADER_COLOR;
@@ -63,7 +121,13 @@ bool ShaderClass::SetShaderUsed(bool useTexture, bool useLighting)
         m_shader_info.vs_shader_name = "ColorVertexShader";
         m_shader_info.ps_shader_file = L"../shaders/color.ps";
         m_shader_info.ps_shader_name = "ColorPixelShader";
-        m_shader_info.param_cnt = 2;
+    }
+    else if (useTexture && useTextureArray && !useLighting) {
+        m_shader_info.type = SHADER_TEXTURE_ARRAY;
+        m_shader_info.vs_shader_file = L"../shaders/texture.vs";
+        m_shader_info.vs_shader_name = "TextureVertexShader";
+        m_shader_info.ps_shader_file = L"../shaders/texturearray.ps";
+        m_shader_info.ps_shader_name = "TextureArrayPixelShader";
     }
     else if (useTexture && !useLighting) {
         m_shader_info.type = SHADER_TEXURE;
@@ -71,7 +135,6 @@ bool ShaderClass::SetShaderUsed(bool useTexture, bool useLighting)
         m_shader_info.vs_shader_name = "TextureVertexShader";
         m_shader_info.ps_shader_file = L"../shaders/texture.ps";
         m_shader_info.ps_shader_name = "TexturePixelShader";
-        m_shader_info.param_cnt = 2;
     }
     else if (useTexture && useLighting) {
         m_shader_info.type = SHADER_LIGHT;
@@ -79,13 +142,23 @@ bool ShaderClass::SetShaderUsed(bool useTexture, bool useLighting)
         m_shader_info.vs_shader_name = "LightVertexShader";
         m_shader_info.ps_shader_file = L"../shaders/light.ps";
         m_shader_info.ps_shader_name = "LightPixelShader";
-        m_shader_info.param_cnt = 4;
+        m_shader_info.variant = GetVariantKey(useTexture, useAmbient, useDiffuse, useSpecular, numDiffuseLights, m_useClusteredLights);
     }
     else {
         // ToDo: support ligting shader with color and add command line options to override test lighting defaults
         status = false;
     }
 
+    // The instanced vertex shaders read the world matrix from four more (per-instance) inputs. The texture array
+    // shader shares the vertex shader of the texture one.
+    if (status && useInstancing) {
+        if (m_shader_info.type == SHADER_COLOR) { m_shader_info.vs_shader_name = "ColorVertexShaderInstanced"; }
+        else if (m_shader_info.type == SHADER_LIGHT) { m_shader_info.vs_shader_name = "LightVertexShaderInstanced"; }
+        else { m_shader_info.vs_shader_name = "TextureVertexShaderInstanced"; }
+
+        m_shader_info.instanced = true;
+    }
+
     return(status);
 }
 
@@ -94,6 +167,47 @@ ShaderInfo ShaderClass::GetShaderUsed()
     return m_shader_info;
 }
 
+// The key of a light shader variant, the feature bits with the number of diffuse lights above them.
+unsigned int ShaderClass::GetVariantKey(bool useTexture, bool useAmbient, bool useDiffuse, bool useSpecular, unsigned int numDiffuseLights,
+                                        bool useClusteredLights)
+{
+    unsigned int features = 0;
+
+    if (useTexture) { features |= SHADER_FEATURE_TEXTURE; }
+    if (useAmbient) { features |= SHADER_FEATURE_AMBIENT; }
+    if (useDiffuse) { features |= SHADER_FEATURE_DIFFUSE; }
+    if (useSpecular) { features |= SHADER_FEATURE_SPECULAR; }
+    if (useClusteredLights) { features |= SHADER_FEATURE_CLUSTERED; }
+    if (numDiffuseLights > MAX_DIFFUSE_LIGHTS) { numDiffuseLights = MAX_DIFFUSE_LIGHTS; }
+
+    return features | (numDiffuseLights << 8);
+}
+
+// Switch to the shaders of a variant, compiling it the first time it is used. Every variant has the same vertex
+// inputs, so the input layout created at initialization works with all of them.
+bool ShaderClass::SelectVariant(unsigned int variant)
+{
+    bool result;
+
+    if (variant == m_currentVariant) { return true; }
+
+    auto found = m_variants.find(variant);
+    if (found == m_variants.end()) {
+        ShaderVariantType shaders;
+        result = CompileVariant(variant, shaders, nullptr, nullptr, m_hwnd);
+        if (!result) { return false; }
+        found = m_variants.emplace(variant, shaders).first;
+    }
+
+    m_vertexShader = found->second.vertexShader;
+    m_pixelShader = found->second.pixelShader;
+    memcpy(m_vsSlots, found->second.vsSlots, sizeof(m_vsSlots));
+    memcpy(m_psSlots, found->second.psSlots, sizeof(m_psSlots));
+    m_currentVariant = variant;
+
+    return true;
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 bool ShaderClass::Render(ID3D11DeviceContext* deviceContext, int indexCount, XMMATRIX worldMatrix, XMMATRIX viewMatrix,
                          XMMATRIX projMatrix, ID3D11ShaderResourceView* texture,
@@ -115,7 +229,34 @@ bool ShaderClass::Render(ID3D11DeviceContext* deviceContext, int indexCount, XMM
     if (!result) { return false; }
 
     // Now render the prepared buffers with the shader.
-    RenderShader(deviceContext, indexCount);
+    RenderShader(deviceContext, indexCount, 1);
+
+    return true;
+}
+
+// RenderInstanced draws instanceCount copies of the prepared buffers in one call, the world matrices are taken from
+// the instance stream bound to INSTANCE_INPUT_SLOT so the world matrix of the MatrixBuffer is left to identity.
+bool ShaderClass::RenderInstanced(ID3D11DeviceContext* deviceContext, int indexCount, int instanceCount, XMMATRIX viewMatrix,
+                                  XMMATRIX projMatrix, ID3D11ShaderResourceView* texture,
+                                  XMFLOAT3 cameraPos,
+                                  bool useAmbient, XMFLOAT4 ambientCol,
+                                  bool useDiffuse, unsigned int numDiffuseLights, XMFLOAT4 diffuseCol[],
+                                  bool isLightPos, XMFLOAT3 lightPosDir[],
+                                  bool useSpecular, XMFLOAT4 specularCol, float specularPow)
+{
+    bool result;
+
+    if (!m_shader_info.instanced) { return false; }
+
+    result = SetShaderParameters(deviceContext, XMMatrixIdentity(), viewMatrix, projMatrix, texture,
+                                 cameraPos,
+                                 useAmbient, ambientCol,
+                                 useDiffuse, numDiffuseLights, diffuseCol,
+                                 isLightPos, lightPosDir,
+                                 useSpecular, specularCol, specularPow);
+    if (!result) { return false; }
+
+    RenderShader(deviceContext, indexCount, instanceCount);
 
     return true;
 }
@@ -127,7 +268,7 @@ bool ShaderClass::Render(ID3D11DeviceContext* deviceContext, int indexCount, XMM
     if (FAILED(result)) {\
         if (errorMessage) {\
             OutputShaderErrorMessage(errorMessage, hwnd, filename);\
-        } else {\
+        } else if (hwnd) {\
             char* tmp_char_name; WCHAR2CHAR(filename, tmp_char_name);\
             MessageBox(hwnd, tmp_char_name, "Missing Shader File", MB_OK);\
         }\
@@ -156,111 +297,36 @@ bool ShaderClass::InitializeShader(ID3D11Device* device, HWND hwnd, bool useText
     // Initialize paramaters
     auto useLighting = useAmbient || useDiffuse || useSpecular;
 
-    // Initialize the pointers this function will use to null.
-    ID3D10Blob* errorMessage = nullptr;
-
-    // Step 1: Compile shaders -------------------------------------------------------------------------------------------
+    // Step 1: Compile and create the shaders of the variant selected by SetShaderUsed. ------------------------------
+    // The bytecode and the reflection of the vertex shader are kept to create the input layout.
     auto shader_info = GetShaderUsed();
-#if _DEBUG
-    // UINT compilerFlag1 = D3D10_SHADER_ENABLE_STRICTNESS | D3D10_SHADER_DEBUG;  // To debug using Visual Studio Graphics Debug
-    UINT compilerFlag1 = D3D10_SHADER_ENABLE_STRICTNESS | D3D10_SHADER_DEBUG | D3D10_SHADER_SKIP_OPTIMIZATION;  // To debug using RenderDoc
-#else
-    UINT compilerFlag1 = D3D10_SHADER_ENABLE_STRICTNESS;
-#endif
-
-    // Compile the vertex shader code.
-    ID3D10Blob* vertexShaderBuffer = nullptr;
-    result = D3DCompileFromFile(shader_info.vs_shader_file, NULL, NULL, shader_info.vs_shader_name, "vs_5_0", compilerFlag1, 0,
-                                &vertexShaderBuffer, &errorMessage);
-    CHECK_AND_RETURN_COMPILE_RESULT(result, shader_info.vs_shader_file);
-
-    // Compile the pixel shader code.
-    ID3D10Blob* pixelShaderBuffer = nullptr;
-    result = D3DCompileFromFile(shader_info.ps_shader_file, NULL, NULL, shader_info.ps_shader_name, "ps_5_0", compilerFlag1, 0,
-                                &pixelShaderBuffer, &errorMessage);
-    CHECK_AND_RETURN_COMPILE_RESULT(result, shader_info.ps_shader_file);
-
-    // Step 2: Create shader objects/sblobs ------------------------------------------------------------------------------
-    // Create the vertex shader from the buffer.
-    result = device->CreateVertexShader(vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), NULL, &m_vertexShader);
-    if (FAILED(result)) { return false; }
-
-    // Create the pixel shader from the buffer.
-    result = device->CreatePixelShader(pixelShaderBuffer->GetBufferPointer(), pixelShaderBuffer->GetBufferSize(), NULL, &m_pixelShader);
-    if (FAILED(result)) { return false; }
-
-    // Step 3: Define inputs to vertex shader ----------------------------------------------------------------------------
-    // Create the vertex input layout description.
-    // This setup needs to match the VertexType stucture in the ModelClass and in the shader.
-    unsigned int param_num = 0;
-    D3D11_INPUT_ELEMENT_DESC* polygonLayout = new D3D11_INPUT_ELEMENT_DESC[shader_info.param_cnt];
-    polygonLayout[param_num].SemanticName = "POSITION";
-    polygonLayout[param_num].SemanticIndex = 0;
-    polygonLayout[param_num].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-    polygonLayout[param_num].InputSlot = 0;
-    polygonLayout[param_num].AlignedByteOffset = 0;
-    polygonLayout[param_num].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-    polygonLayout[param_num].InstanceDataStepRate = 0;
-    param_num++;
-
-    if ((shader_info.type == SHADER_COLOR) || (shader_info.type == SHADER_LIGHT)) {
-        polygonLayout[param_num].SemanticName = "COLOR";
-        polygonLayout[param_num].SemanticIndex = 0;
-        polygonLayout[param_num].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-        polygonLayout[param_num].InputSlot = 0;
-        polygonLayout[param_num].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-        polygonLayout[param_num].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-        polygonLayout[param_num].InstanceDataStepRate = 0;
-        param_num++;
-    }
-
-    if ((shader_info.type == SHADER_TEXURE) || (shader_info.type == SHADER_LIGHT)) {
-        polygonLayout[param_num].SemanticName = "TEXCOORD";
-        polygonLayout[param_num].SemanticIndex = 0;
-        polygonLayout[param_num].Format = DXGI_FORMAT_R32G32_FLOAT;
-        polygonLayout[param_num].InputSlot = 0;
-        polygonLayout[param_num].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-        polygonLayout[param_num].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-        polygonLayout[param_num].InstanceDataStepRate = 0;
-        param_num++;
-    }
-
-    if (shader_info.type == SHADER_LIGHT) {
-        polygonLayout[param_num].SemanticName = "NORMAL";
-        polygonLayout[param_num].SemanticIndex = 0;
-        polygonLayout[param_num].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-        polygonLayout[param_num].InputSlot = 0;
-        polygonLayout[param_num].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-        polygonLayout[param_num].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-        polygonLayout[param_num].InstanceDataStepRate = 0;
-        param_num++;
-    }
-
-    // Get a count of the elements in the layout.
-    // numElements = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
-
-    // Create the vertex input layout.
-    result = device->CreateInputLayout(polygonLayout, shader_info.param_cnt, vertexShaderBuffer->GetBufferPointer(),
-                                       vertexShaderBuffer->GetBufferSize(), &m_layout);
-    delete[] polygonLayout;
-    if (FAILED(result)) { return false; }
-
-    // Release the vertex shader buffer and pixel shader buffer since they are no longer needed.
-    vertexShaderBuffer->Release();
-    vertexShaderBuffer = 0;
-
-    pixelShaderBuffer->Release();
-    pixelShaderBuffer = 0;
-
-    // Step 4: Define buffer to pass constats to the shader --------------------------------------------------------------
+    std::vector<unsigned char> vertexShaderCode;
+    ShaderReflectionType vertexReflection;
+    ShaderVariantType shaders;
+    if (!CompileVariant(shader_info.variant, shaders, &vertexShaderCode, &vertexReflection, hwnd)) { return false; }
+    m_variants[shader_info.variant] = shaders;
+
+    m_vertexShader = m_variants[shader_info.variant].vertexShader;
+    m_pixelShader = m_variants[shader_info.variant].pixelShader;
+    memcpy(m_vsSlots, m_variants[shader_info.variant].vsSlots, sizeof(m_vsSlots));
+    memcpy(m_psSlots, m_variants[shader_info.variant].psSlots, sizeof(m_psSlots));
+    m_currentVariant = shader_info.variant;
+
+    // Step 2: Define inputs to vertex shader ----------------------------------------------------------------------------
+    // The vertex input layout is generated from the input signature of the vertex shader.
+    if (!CreateInputLayout(device, vertexShaderCode, vertexReflection, &m_layout)) { return false; }
+
+    // Step 3: Define buffer to pass constats to the shader --------------------------------------------------------------
     // Setup the description of the dynamic matrix constant buffer that is in the vertex shader.
     // The buffer usage needs to be set to dynamic since we will be updating it each frame.
     // The bind flags indicate that this buffer will be a constant buffer.
     // The CPU access flags need to match up with the usage so it is set to D3D11_CPU_ACCESS_WRITE.
-    CREATE_CBUFFER(m_matrixBuffer, MatrixBufferType);
-    if (useTexture) { CREATE_CBUFFER(m_textureConfigBuffer, TextureConfigBufferType); }
+    // The hash of a buffer is 0 until its first write, so the first draw always fills it.
+    CREATE_CBUFFER(m_frameBuffer.buffer, FrameBufferType);
+    CREATE_CBUFFER(m_objectBuffer.buffer, ObjectBufferType);
+    if (shader_info.type == SHADER_TEXTURE_ARRAY) { CREATE_CBUFFER(m_materialBuffer.buffer, MaterialBufferType); }
 
-    // Step 5: Setup the sampler state description and then can be passed to the pixel shader after. ---------------------
+    // Step 4: Setup the sampler state description and then can be passed to the pixel shader after. ---------------------
     // The most important element of the texture sampler description is Filter. Filter will determine how it decides
     // which pixels will be used or combined to create the final look of the texture on the polygon face. 
     // AddressU and AddressV are set to Wrap which ensures that the coordinates stay between 0.0f and 1.0f.
@@ -288,45 +354,380 @@ bool ShaderClass::InitializeShader(ID3D11Device* device, HWND hwnd, bool useText
         if (FAILED(result)) { return false; }
     }
 
-    // Step 6: Setup the light constant buffer description which will handle the diffuse light color and light direction.
+    // Step 5: Setup the light constant buffer description which will handle the diffuse light color and light direction.
     // Pay attention to the size of the constant buffers, if they are not multiples of 16 you need to pad extra space on
     // to the end of them or the CreateBuffer function will fail. In this case the constant buffer is 28 bytes with 4 bytes 
     // padding to make it 32.
     // Setup the description of the light dynamic constant buffer that is in the pixel shader.
     // Note that ByteWidth always needs to be a multiple of 16 if using D3D11_BIND_CONSTANT_BUFFER or CreateBuffer will fail.
-    if (useLighting) {
-        CREATE_CBUFFER(m_lightConfigBuffer, LightConfigBufferType);
-        CREATE_CBUFFER(m_lightDiffuseParamBuffer, LightDiffuseParamBufferType);
-        CREATE_CBUFFER(m_lightAmbientSpecularParamBuffer, LightAmbientSpecularParamBufferType);
+    // The diffuse, ambient and specular parameters and the camera position are all set once per frame, so they share
+    // one buffer read by both the vertex and the pixel shader.
+    if (useLighting) { CREATE_CBUFFER(m_lightBuffer.buffer, LightBufferType); }
+
+    return true;
+}
+
+// Compile the vertex and pixel shader of a variant, its features are passed to the shader files as defines.
+// Only the device is used (it is free threaded), so a variant can also be compiled on the hot reload thread, with a
+// NULL window: the compile errors then only go to shader-error.txt.
+bool ShaderClass::CompileVariant(unsigned int variant, ShaderVariantType& shaders, std::vector<unsigned char>* vertexShaderCode,
+                                 ShaderReflectionType* vertexReflection, HWND hwnd)
+{
+    HRESULT result;
+    ShaderReflectionType vsReflection, psReflection;
+    char lightCount[8];
+    int i;
+
+    auto shader_info = GetShaderUsed();
+#if _DEBUG
+    // UINT compilerFlag1 = D3D10_SHADER_ENABLE_STRICTNESS | D3D10_SHADER_DEBUG;  // To debug using Visual Studio Graphics Debug
+    UINT compilerFlag1 = D3D10_SHADER_ENABLE_STRICTNESS | D3D10_SHADER_DEBUG | D3D10_SHADER_SKIP_OPTIMIZATION;  // To debug using RenderDoc
+#else
+    UINT compilerFlag1 = D3D10_SHADER_ENABLE_STRICTNESS;
+#endif
+
+    // The light shaders are compiled with the defines of the variant, the other shaders have a single variant (0)
+    // compiled without defines.
+    sprintf(lightCount, "%u", variant >> 8);
+    D3D_SHADER_MACRO lightDefines[] = {
+        { "USE_TEXTURE", (variant & SHADER_FEATURE_TEXTURE) ? "1" : "0" },
+        { "USE_AMBIENT_LIGHT", (variant & SHADER_FEATURE_AMBIENT) ? "1" : "0" },
+        { "USE_DIFFUSE_LIGHT", (variant & SHADER_FEATURE_DIFFUSE) ? "1" : "0" },
+        { "USE_SPECULAR_LIGHT", (variant & SHADER_FEATURE_SPECULAR) ? "1" : "0" },
+        { "USE_CLUSTERED_LIGHTS", (variant & SHADER_FEATURE_CLUSTERED) ? "1" : "0" },
+        { "NUM_DIFFUSE_LIGHTS", lightCount },
+        { NULL, NULL }
+    };
+    D3D_SHADER_MACRO* defines = (shader_info.type == SHADER_LIGHT) ? lightDefines : NULL;
+
+    // Compile (or load from the shader cache) the vertex and pixel shader code.
+    std::vector<unsigned char> vsCode, psCode;
+    if (!CompileShader(shader_info.vs_shader_file, shader_info.vs_shader_name, "vs_5_0", defines, compilerFlag1, hwnd, vsCode, vsReflection)) { return false; }
+    if (!CompileShader(shader_info.ps_shader_file, shader_info.ps_shader_name, "ps_5_0", defines, compilerFlag1, hwnd, psCode, psReflection)) { return false; }
+
+    // Map the constant buffers to their registers by name, once per variant, so binding one at draw time is a table
+    // lookup. A buffer the compiler removed from a stage (none of its members used) is not bound to that stage.
+    for (i = 0; i < CBUFFER_COUNT; i++) {
+        shaders.vsSlots[i] = FindShaderBinding(vsReflection, CBUFFER_NAMES[i], D3D_SIT_CBUFFER);
+        shaders.psSlots[i] = FindShaderBinding(psReflection, CBUFFER_NAMES[i], D3D_SIT_CBUFFER);
+    }
+
+    // Create the vertex and pixel shaders from the bytecode.
+    shaders.vertexShader = nullptr;
+    shaders.pixelShader = nullptr;
+    result = m_device->CreateVertexShader(vsCode.data(), vsCode.size(), NULL, &shaders.vertexShader);
+    if (FAILED(result)) { return false; }
+
+    result = m_device->CreatePixelShader(psCode.data(), psCode.size(), NULL, &shaders.pixelShader);
+    if (FAILED(result)) {
+        RT_RELEASE_ID3D11_PTR(shaders.vertexShader);
+        return false;
+    }
+
+    if (vertexShaderCode) { vertexShaderCode->swap(vsCode); }
+    if (vertexReflection) { *vertexReflection = vsReflection; }
+
+    return true;
+}
+
+// Compile one stage. With a shader cache the bytecode is loaded from disk when the source, defines, entry point,
+// profile and flags are unchanged since it was compiled, D3DCompileFromFile only runs on a miss. The reflection is
+// made on the compile and stored with the bytecode, a hit reads it back.
+bool ShaderClass::CompileShader(WCHAR* filename, char* entryPoint, const char* profile, D3D_SHADER_MACRO* defines, UINT flags, HWND hwnd,
+                                std::vector<unsigned char>& bytecode, ShaderReflectionType& reflection)
+{
+    std::vector<unsigned char> metadata;
+
+    auto compile = [&](std::vector<unsigned char>& code, std::vector<unsigned char>& codeMetadata) -> bool {
+        HRESULT result;
+        ID3D10Blob* errorMessage = nullptr;
+        ID3D10Blob* shaderBuffer = nullptr;
+
+        result = D3DCompileFromFile(filename, defines, NULL, entryPoint, profile, flags, 0, &shaderBuffer, &errorMessage);
+        CHECK_AND_RETURN_COMPILE_RESULT(result, filename);
+
+        code.assign((unsigned char*)shaderBuffer->GetBufferPointer(), (unsigned char*)shaderBuffer->GetBufferPointer() + shaderBuffer->GetBufferSize());
+        shaderBuffer->Release();
+
+        if (!ReflectShader(code, reflection)) { return false; }
+        WriteShaderReflection(reflection, codeMetadata);
+
+        return true;
+    };
+
+    if (m_ShaderCache == nullptr) { return compile(bytecode, metadata); }
+
+    // The cache works with narrow paths and plain define strings.
+    std::vector<ShaderDefine> cacheDefines;
+    for (D3D_SHADER_MACRO* define = defines; define && define->Name; define++) {
+        cacheDefines.push_back(ShaderDefine(define->Name, define->Definition));
+    }
+    char* sourceFile; WCHAR2CHAR(filename, sourceFile);
+
+    bool result = m_ShaderCache->GetBytecode(sourceFile, cacheDefines, entryPoint, profile, flags, compile, bytecode, metadata);
+    delete [] sourceFile;
+    if (!result) { return false; }
+
+    // An entry whose reflection can not be read (written by an older build) still has valid bytecode to reflect.
+    if (!ReadShaderReflection(metadata, reflection)) { return ReflectShader(bytecode, reflection); }
+
+    return true;
+}
+
+// Keep the parts of the shader reflection ShaderClass uses: the input signature (for the input layout) and the
+// registers of the bound resources (for binding the constant buffers by name).
+bool ShaderClass::ReflectShader(const std::vector<unsigned char>& bytecode, ShaderReflectionType& reflection)
+{
+    ID3D11ShaderReflection* shaderReflection = nullptr;
+    D3D11_SHADER_DESC shaderDesc;
+    D3D11_SIGNATURE_PARAMETER_DESC parameterDesc;
+    D3D11_SHADER_INPUT_BIND_DESC bindDesc;
+    HRESULT result;
+    unsigned int i, mask;
+
+    reflection.inputs.clear();
+    reflection.bindings.clear();
+
+    result = D3DReflect(bytecode.data(), bytecode.size(), IID_ID3D11ShaderReflection, (void**)&shaderReflection);
+    if (FAILED(result)) { return false; }
+
+    result = shaderReflection->GetDesc(&shaderDesc);
+    if (FAILED(result)) { shaderReflection->Release(); return false; }
+
+    for (i = 0; i < shaderDesc.InputParameters; i++) {
+        ShaderInputType input;
+
+        result = shaderReflection->GetInputParameterDesc(i, &parameterDesc);
+        if (FAILED(result)) { shaderReflection->Release(); return false; }
+
+        input.semanticName = parameterDesc.SemanticName;
+        input.semanticIndex = parameterDesc.SemanticIndex;
+        input.componentType = parameterDesc.ComponentType;
+        input.systemValue = parameterDesc.SystemValueType;
+
+        // The mask has one bit per declared component (x, y, z, w).
+        input.componentCount = 0;
+        for (mask = parameterDesc.Mask & 0xf; mask != 0; mask >>= 1) { input.componentCount += (mask & 1); }
+
+        reflection.inputs.push_back(input);
+    }
+
+    for (i = 0; i < shaderDesc.BoundResources; i++) {
+        ShaderBindingType binding;
+
+        result = shaderReflection->GetResourceBindingDesc(i, &bindDesc);
+        if (FAILED(result)) { shaderReflection->Release(); return false; }
+
+        binding.name = bindDesc.Name;
+        binding.type = bindDesc.Type;
+        binding.slot = bindDesc.BindPoint;
+        reflection.bindings.push_back(binding);
+    }
+
+    shaderReflection->Release();
+
+    return true;
+}
+
+// One layout element per input of the vertex shader, in declaration order and packed one after the other like the
+// vertex types of the model, bitmap, sprite batch and text classes. Two conventions of the vertex data are not in
+// the signature: POSITION is stored as three floats (the input assembler fills w with 1), and the WORLDn rows of an
+// instanced shader come from the per-instance stream.
+bool ShaderClass::CreateInputLayout(ID3D11Device* device, const std::vector<unsigned char>& vertexShaderCode, const ShaderReflectionType& vertexReflection,
+                                    ID3D11InputLayout** layout)
+{
+    static const DXGI_FORMAT formats[3][4] = {
+        { DXGI_FORMAT_R32_UINT, DXGI_FORMAT_R32G32_UINT, DXGI_FORMAT_R32G32B32_UINT, DXGI_FORMAT_R32G32B32A32_UINT },
+        { DXGI_FORMAT_R32_SINT, DXGI_FORMAT_R32G32_SINT, DXGI_FORMAT_R32G32B32_SINT, DXGI_FORMAT_R32G32B32A32_SINT },
+        { DXGI_FORMAT_R32_FLOAT, DXGI_FORMAT_R32G32_FLOAT, DXGI_FORMAT_R32G32B32_FLOAT, DXGI_FORMAT_R32G32B32A32_FLOAT }
+    };
+    std::vector<D3D11_INPUT_ELEMENT_DESC> polygonLayout;
+    D3D11_INPUT_ELEMENT_DESC element;
+    bool firstInSlot[2] = { true, true };
+    unsigned int componentCount, stream;
+    HRESULT result;
+
+    for (auto& input : vertexReflection.inputs) {
+        // System values (SV_VertexID, SV_InstanceID) are generated by the input assembler, not read from a buffer.
+        if (input.systemValue != D3D_NAME_UNDEFINED) { continue; }
+        if ((input.componentType < D3D_REGISTER_COMPONENT_UINT32) || (input.componentType > D3D_REGISTER_COMPONENT_FLOAT32)) { return false; }
 
-        // Setup the description of the camera dynamic constant buffer that is in the vertex shader use for specualr lighting calculations
-        if (useSpecular) { CREATE_CBUFFER(m_cameraBuffer, CameraBufferType); }
+        componentCount = input.componentCount;
+        if ((_stricmp(input.semanticName.c_str(), "POSITION") == 0) && (componentCount == 4)) { componentCount = 3; }
+
+        stream = (_stricmp(input.semanticName.c_str(), "WORLD") == 0) ? 1 : 0;
+
+        element.SemanticName = input.semanticName.c_str();
+        element.SemanticIndex = input.semanticIndex;
+        element.Format = formats[input.componentType - D3D_REGISTER_COMPONENT_UINT32][componentCount - 1];
+        element.InputSlot = (stream == 1) ? INSTANCE_INPUT_SLOT : 0;
+        element.AlignedByteOffset = firstInSlot[stream] ? 0 : D3D11_APPEND_ALIGNED_ELEMENT;
+        element.InputSlotClass = (stream == 1) ? D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA;
+        element.InstanceDataStepRate = (stream == 1) ? 1 : 0;
+        firstInSlot[stream] = false;
+
+        polygonLayout.push_back(element);
     }
+    if (polygonLayout.empty()) { return false; }
+
+    // Create the vertex input layout.
+    result = device->CreateInputLayout(polygonLayout.data(), (UINT)polygonLayout.size(), vertexShaderCode.data(), vertexShaderCode.size(), layout);
+    if (FAILED(result)) { return false; }
 
     return true;
 }
 
 void ShaderClass::ShutdownShader()
 {
-    // Release the created constant buffers.
-    RT_RELEASE_ID3D11_PTR(m_cameraBuffer);
+    // Wait for a hot reload still compiling and drop its shaders.
+    if (m_reload.valid()) {
+        ReloadResultType reload = m_reload.get();
+        ReleaseVariants(reload.variants);
+        RT_RELEASE_ID3D11_PTR(reload.layout);
+    }
+    m_reloadPending = false;
 
-    RT_RELEASE_ID3D11_PTR(m_lightAmbientSpecularParamBuffer);
-    RT_RELEASE_ID3D11_PTR(m_lightDiffuseParamBuffer);
-    RT_RELEASE_ID3D11_PTR(m_lightConfigBuffer);
+    // Release the created constant buffers.
+    RT_RELEASE_ID3D11_PTR(m_materialBuffer.buffer);
+    RT_RELEASE_ID3D11_PTR(m_lightBuffer.buffer);
+    RT_RELEASE_ID3D11_PTR(m_objectBuffer.buffer);
+    RT_RELEASE_ID3D11_PTR(m_frameBuffer.buffer);
+    m_materialBuffer.hash = 0;
+    m_lightBuffer.hash = 0;
+    m_objectBuffer.hash = 0;
+    m_frameBuffer.hash = 0;
 
-    RT_RELEASE_ID3D11_PTR(m_textureConfigBuffer);
-    RT_RELEASE_ID3D11_PTR(m_matrixBuffer);
+    m_boundTexture = nullptr;
 
     // Release the created sampler state, input layout and shader buffers
     RT_RELEASE_ID3D11_PTR(m_sampleState);
     RT_RELEASE_ID3D11_PTR(m_layout);
-    RT_RELEASE_ID3D11_PTR(m_pixelShader);
-    RT_RELEASE_ID3D11_PTR(m_vertexShader);
+    ReleaseVariants(m_variants);
+    m_pixelShader = nullptr;
+    m_vertexShader = nullptr;
+
+    return;
+}
+
+void ShaderClass::ReleaseVariants(std::map<unsigned int, ShaderVariantType>& variants)
+{
+    for (auto& variant : variants) {
+        RT_RELEASE_ID3D11_PTR(variant.second.pixelShader);
+        RT_RELEASE_ID3D11_PTR(variant.second.vertexShader);
+    }
+    variants.clear();
 
     return;
 }
 
+// --------------------------------------------------------------------------------------------------------------------
+// True when filename (a name without directory, as reported by ShaderWatcherClass) is the vertex or pixel shader
+// source of this shader object.
+bool ShaderClass::UsesShaderFile(const char* filename)
+{
+    char* vsFile;
+    char* psFile;
+    bool found;
+
+    WCHAR2CHAR(m_shader_info.vs_shader_file, vsFile);
+    WCHAR2CHAR(m_shader_info.ps_shader_file, psFile);
+    found = (std::filesystem::path(vsFile).filename() == filename) || (std::filesystem::path(psFile).filename() == filename);
+    delete [] vsFile;
+    delete [] psFile;
+
+    return found;
+}
+
+// Recompile every variant compiled so far from the current sources, on a worker thread. The render loop keeps drawing
+// with the running shaders meanwhile, ApplyReload swaps the new ones in once they are all ready.
+void ShaderClass::StartReload()
+{
+    std::vector<unsigned int> variants;
+
+    // The running reload may have read the sources before this change, start another one when it is done.
+    if (m_reload.valid()) {
+        m_reloadPending = true;
+        return;
+    }
+
+    for (auto& variant : m_variants) { variants.push_back(variant.first); }
+    m_reload = std::async(std::launch::async, &ShaderClass::ReloadVariants, this, variants);
+
+    return;
+}
+
+// Runs on the reload thread. Nothing of the running shaders is touched here, the result is all new objects.
+ShaderClass::ReloadResultType ShaderClass::ReloadVariants(std::vector<unsigned int> variants)
+{
+    ReloadResultType reload;
+    ShaderVariantType shaders;
+    std::vector<unsigned char> vertexShaderCode;
+    ShaderReflectionType vertexReflection;
+
+    reload.succeeded = false;
+    reload.layout = nullptr;
+
+    for (auto variant : variants) {
+        if (!CompileVariant(variant, shaders, &vertexShaderCode, &vertexReflection, NULL)) { break; }
+        reload.variants[variant] = shaders;
+
+        // The input layout is made from the variant compiled at initialization, as InitializeShader does.
+        if ((variant == m_shader_info.variant) && !CreateInputLayout(m_device, vertexShaderCode, vertexReflection, &reload.layout)) { break; }
+    }
+
+    if (reload.variants.size() != variants.size() || (reload.layout == nullptr)) {
+        ReleaseVariants(reload.variants);
+        RT_RELEASE_ID3D11_PTR(reload.layout);
+        return reload;
+    }
+
+    reload.succeeded = true;
+
+    return reload;
+}
+
+// Called between two frames. Only a finished reload is applied, the render loop never waits for the compiler.
+ShaderReloadStatus ShaderClass::ApplyReload()
+{
+    ShaderReloadStatus status;
+
+    if (!m_reload.valid() || (m_reload.wait_for(std::chrono::seconds(0)) != std::future_status::ready)) { return SHADER_RELOAD_NONE; }
+
+    ReloadResultType reload = m_reload.get();
+    if (reload.succeeded) {
+        for (auto& variant : reload.variants) {
+            ShaderVariantType& running = m_variants[variant.first];
+            RT_RELEASE_ID3D11_PTR(running.pixelShader);
+            RT_RELEASE_ID3D11_PTR(running.vertexShader);
+            running = variant.second;
+        }
+        RT_RELEASE_ID3D11_PTR(m_layout);
+        m_layout = reload.layout;
+
+        auto current = m_variants.find(m_currentVariant);
+        m_vertexShader = current->second.vertexShader;
+        m_pixelShader = current->second.pixelShader;
+        memcpy(m_vsSlots, current->second.vsSlots, sizeof(m_vsSlots));
+        memcpy(m_psSlots, current->second.psSlots, sizeof(m_psSlots));
+
+        // A new shader can be created at the address of a released one, the state cache must not take it for the
+        // shader it already has bound.
+        if (m_StateCache) { m_StateCache->Invalidate(); }
+
+        status = SHADER_RELOAD_APPLIED;
+    } else {
+        // Keep drawing with the running shaders, the errors are in shader-error.txt.
+        status = SHADER_RELOAD_FAILED;
+    }
+
+    if (m_reloadPending) {
+        m_reloadPending = false;
+        StartReload();
+    }
+
+    return status;
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 void ShaderClass::OutputShaderErrorMessage(ID3D10Blob* errorMessage, HWND hwnd, WCHAR* shaderFilename)
 {
@@ -356,29 +757,76 @@ void ShaderClass::OutputShaderErrorMessage(ID3D10Blob* errorMessage, HWND hwnd,
     errorMessage = 0;
 
     // Pop a message up on the screen to notify the user to check the text file for compile errors.
-    char* tmp_char_name; WCHAR2CHAR(shaderFilename, tmp_char_name);
-    MessageBox(hwnd, "Error compiling shader.  Check shader-error.txt for message.", tmp_char_name, MB_OK);
+    if (hwnd) {
+        char* tmp_char_name; WCHAR2CHAR(shaderFilename, tmp_char_name);
+        MessageBox(hwnd, "Error compiling shader.  Check shader-error.txt for message.", tmp_char_name, MB_OK);
+    }
 
     return;
 }
 
-#define PRE_CBUFFER_UPDATE(cbuffer, data_type, data_ptr) {\
-    /* Lock the constant buffer so it can be written to. */\
-    result = deviceContext->Map(cbuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);\
-    if (FAILED(result)) { return false; }\
-    /* Get a pointer to the data in the constant buffer.*/\
-    data_ptr = (data_type*)mappedResource.pData;\
+// Write a constant buffer, unless the data is the same as in the previous write. The data is hashed (64 bit FNV-1a)
+// instead of kept as a copy, the buffers are at most a couple of hundred bytes so hashing costs much less than the
+// Map / Unmap (a driver call that renames the buffer memory with D3D11_MAP_WRITE_DISCARD).
+bool ShaderClass::UpdateConstantBuffer(ID3D11DeviceContext* deviceContext, ConstantBufferType& cbuffer, const void* data, unsigned int size)
+{
+    HRESULT result;
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    const unsigned char* bytes = (const unsigned char*)data;
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+    unsigned int i;
+
+    for (i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    if (hash == cbuffer.hash) { return true; }
+
+    // Lock the constant buffer so it can be written to.
+    result = deviceContext->Map(cbuffer.buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+    if (FAILED(result)) { return false; }
+
+    memcpy(mappedResource.pData, data, size);
+
+    // Unlock the constant buffer.
+    deviceContext->Unmap(cbuffer.buffer, 0);
+
+    cbuffer.hash = hash;
+    m_mapCount++;
+
+    return true;
 }
-#define POST_CBUFFER_UPDATE(cbuffer, vs_or_ps_SetConstantBuffers_func, cbuff_num_var) {\
-    /* Unlock the constant buffer.*/\
-    deviceContext->Unmap(cbuffer, 0);\
-    /* Now set the camera cbuffer in the approapriate shader with the updated values.*/\
-    deviceContext->vs_or_ps_SetConstantBuffers_func(cbuff_num_var++, 1, &cbuffer);\
+
+// The per frame and per object matrix buffers are used by every vertex shader. They are bound for every draw since
+// another shader object may have bound its own buffers to the same slots since, the state cache drops the repeats.
+bool ShaderClass::SetMatrixBuffers(ID3D11DeviceContext* deviceContext, XMMATRIX worldMatrix, XMMATRIX viewMatrix, XMMATRIX projMatrix)
+{
+    FrameBufferType frameData;
+    ObjectBufferType objectData;
+    bool result;
+
+    // Transpose the matrices before sending them into the shader, this is a requirement for DirectX 11.
+    // The view and projection are combined here, once, instead of in the vertex shader for every vertex.
+    frameData.viewProjection = XMMatrixTranspose(XMMatrixMultiply(viewMatrix, projMatrix));
+    objectData.world = XMMatrixTranspose(worldMatrix);
+
+    result = UpdateConstantBuffer(deviceContext, m_frameBuffer, &frameData, sizeof(frameData));
+    if (!result) { return false; }
+
+    result = UpdateConstantBuffer(deviceContext, m_objectBuffer, &objectData, sizeof(objectData));
+    if (!result) { return false; }
+
+    SetConstantBuffer(deviceContext, CBUFFER_FRAME, m_frameBuffer.buffer);
+    SetConstantBuffer(deviceContext, CBUFFER_OBJECT, m_objectBuffer.buffer);
+
+    return true;
 }
 
 // The SetShaderVariables function exists to make setting the global variables in the shader easier.
 // The matrices used in this function are created inside the ApplicationClass, after which this function is called
 // to send them from there into the vertex shader during the Render function call.
+// Every buffer is only written when its content changed: within a frame the view-projection and the lights stay the
+// same, so a draw usually only writes the world matrix of its object.
 bool ShaderClass::SetShaderParameters(ID3D11DeviceContext* deviceContext, XMMATRIX worldMatrix, XMMATRIX viewMatrix,
                                       XMMATRIX projMatrix, ID3D11ShaderResourceView* texture,
                                       XMFLOAT3 cameraPos,
@@ -387,118 +835,183 @@ bool ShaderClass::SetShaderParameters(ID3D11DeviceContext* deviceContext, XMMATR
                                       bool isLightPos, XMFLOAT3 lightPosDir[],
                                       bool useSpecular, XMFLOAT4 specularCol, float specularPow)
 {
-    HRESULT result;
+    bool result;
     bool useTexture = false;
     bool useLighting = false;
-    unsigned int VS_bufferNum = 0;
-    unsigned int PS_bufferNum = 0;
-    D3D11_MAPPED_SUBRESOURCE mappedResource;
 
     // Step 0: Initialize local varaibles
     if (texture != nullptr) { useTexture = true; }
     useLighting = useAmbient || useDiffuse || useSpecular;
 
-    // Step 1: Transpose matrices before sending them into the shader, this is a requirement for DirectX 11.
-    worldMatrix = XMMatrixTranspose(worldMatrix);
-    viewMatrix = XMMatrixTranspose(viewMatrix);
-    projMatrix = XMMatrixTranspose(projMatrix);
-
-    // Step 2: Copy updated metrics (constant buffers) for VS shader to use
-    MatrixBufferType* dataPtr;
-    PRE_CBUFFER_UPDATE(m_matrixBuffer, MatrixBufferType, dataPtr);
-    // Copy the matrices into the constant buffer.
-    dataPtr->world = worldMatrix;
-    dataPtr->view = viewMatrix;
-    dataPtr->projection = projMatrix;
-    POST_CBUFFER_UPDATE(m_matrixBuffer, VSSetConstantBuffers, VS_bufferNum);
-
-    // Step 3: Set shader resource view if specified
-    if (useTexture) {
+    // The lighting switches and the light count are compiled in the light shader, pick (or build) the matching variant.
+    if (m_shader_info.type == SHADER_LIGHT) {
+        if (!SelectVariant(GetVariantKey(useTexture, useAmbient, useDiffuse, useSpecular, numDiffuseLights, m_useClusteredLights))) { return false; }
+    }
+
+    // Step 1: Update the per frame and per object matrices (constant buffers) for VS shader to use
+    result = SetMatrixBuffers(deviceContext, worldMatrix, viewMatrix, projMatrix);
+    if (!result) { return false; }
+
+    // Step 2: Set shader resource view if specified
+    // The view is only bound when it changed since the previous draw. With a texture array the animation frames all
+    // live in the same view, so an animated sprite binds its texture once and only the slice index changes.
+    if (useTexture && (texture != m_boundTexture)) {
         deviceContext->PSSetShaderResources(0, 1, &texture);
+        m_boundTexture = texture;
+    }
+
+    // Step 3: Update the material (the texture array slice) for PS shader to use
+    if (useTexture && (m_shader_info.type == SHADER_TEXTURE_ARRAY)) {
+        MaterialBufferType materialData;
+        materialData.textureSlice = m_textureSlice;
+        materialData.paddingMB = XMFLOAT3(0.0f, 0.0f, 0.0f);
 
-        // Update Texture config paramaters (constant buffers) for PS shader to use
-        TextureConfigBufferType* dataPtr;
-        PRE_CBUFFER_UPDATE(m_textureConfigBuffer, TextureConfigBufferType, dataPtr);
-        // Copy the camera position into the constant buffer.
-        dataPtr->useTexture = true;
-        dataPtr->paddingTCB = XMFLOAT3(0.0f, 0.0f, 0.0f);
-        POST_CBUFFER_UPDATE(m_textureConfigBuffer, PSSetConstantBuffers, PS_bufferNum);
+        result = UpdateConstantBuffer(deviceContext, m_materialBuffer, &materialData, sizeof(materialData));
+        if (!result) { return false; }
+        SetConstantBuffer(deviceContext, CBUFFER_MATERIAL, m_materialBuffer.buffer);
     }
 
-    // Step 4: Set up the light constant buffer is setup the same way as the matrix constant buffer.
-    // We first lock the buffer and get a pointer to it. After that we set the diffuse color and light direction using that pointer.
-    // Once the data is set, we unlock the buffer and then set it in the pixel shader.
-    // Note that we use the PSSetConstantBuffers function instead of VSSetConstantBuffers since this is a pixel shader buffer we are setting.
+    // Step 4: Set up the light constant buffer, read by both the vertex shader (light positions / directions and
+    // camera) and the pixel shader (light colors and specular power). The unused lights are zeroed so stale values
+    // from a previous frame do not defeat the hash.
     if (useLighting) {
-        // Update Diffsue lighting paramaters (constant buffers) for VS shader to use
-        LightDiffuseParamBufferType* dataPtr;
-        PRE_CBUFFER_UPDATE(m_lightDiffuseParamBuffer, LightDiffuseParamBufferType, dataPtr);
-        dataPtr->numDiffuseLights = numDiffuseLights;
-        dataPtr->isDiffuseLightPos = isLightPos;
-        for (auto i=0; i<numDiffuseLights; i++) {
-            dataPtr->diffuseLightPosDir[i].x = lightPosDir[i].x;
-            dataPtr->diffuseLightPosDir[i].y = lightPosDir[i].y;
-            dataPtr->diffuseLightPosDir[i].z = lightPosDir[i].z;
-            dataPtr->diffuseColor[i] = diffuseCol[i];
-        }
-        POST_CBUFFER_UPDATE(m_lightDiffuseParamBuffer, VSSetConstantBuffers, VS_bufferNum);
-
-        // Update Lighting config paramaters (constant buffers) for PS shader to use
-        LightConfigBufferType* dataPtr2;
-        PRE_CBUFFER_UPDATE(m_lightConfigBuffer, LightConfigBufferType, dataPtr2);
-        // Copy the lighting configuration variables into the constant buffer.
-        dataPtr2->useAmbientLight = useAmbient;
-        dataPtr2->useDiffuseLight = useDiffuse;
-        dataPtr2->useSpecularLight = useSpecular;
-        POST_CBUFFER_UPDATE(m_lightConfigBuffer, PSSetConstantBuffers, PS_bufferNum);
-
-        // Update diffuse lighting paramaters (constant buffers) for PS shader to use
-        PRE_CBUFFER_UPDATE(m_lightDiffuseParamBuffer, LightDiffuseParamBufferType, dataPtr);
-        POST_CBUFFER_UPDATE(m_lightDiffuseParamBuffer, PSSetConstantBuffers, PS_bufferNum);
-
-        // Update Lighting paramaters (constant buffers) for PS shader to use
-        LightAmbientSpecularParamBufferType* dataPtr3;
-        PRE_CBUFFER_UPDATE(m_lightAmbientSpecularParamBuffer, LightAmbientSpecularParamBufferType, dataPtr3);
-        // Copy the camera position into the constant buffer.
-        // Copy the lighting variables into the constant buffer.
-        dataPtr3->ambientColor = ambientCol;
-        dataPtr3->specularColor = specularCol;
-        dataPtr3->specularPower = specularPow;
-        POST_CBUFFER_UPDATE(m_lightAmbientSpecularParamBuffer, PSSetConstantBuffers, PS_bufferNum);
-
-        if (useSpecular) {
-            // Update Camera paramaters (constant buffers) for PS shader to use
-            CameraBufferType* dataPtr;
-            PRE_CBUFFER_UPDATE(m_cameraBuffer, CameraBufferType, dataPtr);
-            // Copy the camera position into the constant buffer.
-            dataPtr->cameraPosition = cameraPos;
-            dataPtr->calcViewDirection = true;
-            POST_CBUFFER_UPDATE(m_cameraBuffer, VSSetConstantBuffers, VS_bufferNum);
+        LightBufferType lightData;
+        memset(&lightData, 0, sizeof(lightData));
+
+        for (unsigned int i = 0; (i < numDiffuseLights) && (i < MAX_DIFFUSE_LIGHTS); i++) {
+            lightData.diffuseLightPosDir[i] = XMFLOAT4(lightPosDir[i].x, lightPosDir[i].y, lightPosDir[i].z, 0.0f);
+            lightData.diffuseColor[i] = diffuseCol[i];
         }
+        lightData.ambientColor = ambientCol;
+        lightData.specularColor = specularCol;
+        lightData.cameraPosition = cameraPos;
+        lightData.specularPower = specularPow;
+        lightData.numDiffuseLights = numDiffuseLights;
+        lightData.isDiffuseLightPos = isLightPos;
+
+        result = UpdateConstantBuffer(deviceContext, m_lightBuffer, &lightData, sizeof(lightData));
+        if (!result) { return false; }
+        SetConstantBuffer(deviceContext, CBUFFER_LIGHT, m_lightBuffer.buffer);
     }
 
     return true;
 }
 
+// BeginBatch does the part of Render that is common to all the draws of a batch. Only the matrix buffers are needed
+// by the texture shader; the texture is given per draw.
+bool ShaderClass::BeginBatch(ID3D11DeviceContext* deviceContext, XMMATRIX worldMatrix, XMMATRIX viewMatrix, XMMATRIX projMatrix)
+{
+    bool result;
+
+    if ((m_shader_info.type != SHADER_TEXURE) || m_shader_info.instanced) { return false; }
+
+    result = SetMatrixBuffers(deviceContext, worldMatrix, viewMatrix, projMatrix);
+    if (!result) { return false; }
+
+    SetPipelineState(deviceContext);
+
+    return true;
+}
+
+void ShaderClass::DrawBatch(ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView* texture, int indexCount, int startIndex)
+{
+    if (texture != m_boundTexture) {
+        deviceContext->PSSetShaderResources(0, 1, &texture);
+        m_boundTexture = texture;
+    }
+
+    deviceContext->DrawIndexed(indexCount, startIndex, 0);
+
+    return;
+}
+
+void ShaderClass::InvalidateBoundTexture()
+{
+    m_boundTexture = nullptr;
+    return;
+}
+
+// A deferred context must write a dynamic buffer (D3D11_MAP_WRITE_DISCARD) in its command list before reading it,
+// the hash of the data written in another command list does not count.
+void ShaderClass::ResetContextState()
+{
+    m_materialBuffer.hash = 0;
+    m_lightBuffer.hash = 0;
+    m_objectBuffer.hash = 0;
+    m_frameBuffer.hash = 0;
+    m_boundTexture = nullptr;
+
+    return;
+}
+
+unsigned int ShaderClass::GetCurrentVariant()
+{
+    return m_currentVariant;
+}
+
+int ShaderClass::GetMapCount()
+{
+    return m_mapCount;
+}
+
+void ShaderClass::ResetMapCount()
+{
+    m_mapCount = 0;
+    return;
+}
+
+// The input layout, the shaders and the sampler of the current variant. With a state cache, the binds matching the
+// state already on the context (e.g. the previous draw used the same shader) are dropped by the cache.
+void ShaderClass::SetPipelineState(ID3D11DeviceContext* deviceContext)
+{
+    if (m_StateCache) {
+        m_StateCache->SetInputLayout(deviceContext, m_layout);
+        m_StateCache->SetVertexShader(deviceContext, m_vertexShader);
+        m_StateCache->SetPixelShader(deviceContext, m_pixelShader);
+        m_StateCache->SetPSSampler(deviceContext, 0, m_sampleState);
+    } else {
+        deviceContext->IASetInputLayout(m_layout);
+        deviceContext->VSSetShader(m_vertexShader, NULL, 0);
+        deviceContext->PSSetShader(m_pixelShader, NULL, 0);
+        deviceContext->PSSetSamplers(0, 1, &m_sampleState);
+    }
+
+    return;
+}
+
+// Bind a constant buffer to the registers the current variant declares it at, in each stage that reads it.
+void ShaderClass::SetConstantBuffer(ID3D11DeviceContext* deviceContext, ShaderConstantBuffer cbuffer, ID3D11Buffer* buffer)
+{
+    int vsSlot = m_vsSlots[cbuffer];
+    int psSlot = m_psSlots[cbuffer];
+
+    if (m_StateCache) {
+        if (vsSlot >= 0) { m_StateCache->SetVSConstantBuffer(deviceContext, vsSlot, buffer); }
+        if (psSlot >= 0) { m_StateCache->SetPSConstantBuffer(deviceContext, psSlot, buffer); }
+    } else {
+        if (vsSlot >= 0) { deviceContext->VSSetConstantBuffers(vsSlot, 1, &buffer); }
+        if (psSlot >= 0) { deviceContext->PSSetConstantBuffers(psSlot, 1, &buffer); }
+    }
+
+    return;
+}
+
 // The render function sets the shader parameters and then draws the prepared model vertices using the shader.
 // The first step in this function is to set our input layout to active in the input assembler. This lets the GPU
 // know the format of the data in the vertex buffer.
 // The second step is to set the vertex shader and pixel shader we will be using to render this vertex buffer.
-// The third step is to issue a draw call
-void ShaderClass::RenderShader(ID3D11DeviceContext* deviceContext, int indexCount)
+// The third step is to issue a draw call, instanced if the shader reads the instance stream.
+void ShaderClass::RenderShader(ID3D11DeviceContext* deviceContext, int indexCount, int instanceCount)
 {
-    // Step 1: Set the vertex input layout.
-    deviceContext->IASetInputLayout(m_layout);
-
-    // Step 2: Set the vertex and pixel shaders that will be used to render this triangle.
-    deviceContext->VSSetShader(m_vertexShader, NULL, 0);
-    deviceContext->PSSetShader(m_pixelShader, NULL, 0);
-
-    // Step 3: Set the sampler state in the pixel shader.
-    deviceContext->PSSetSamplers(0, 1, &m_sampleState);
+    // Step 1 - 3: Set the vertex input layout, the vertex and pixel shaders and the sampler state.
+    SetPipelineState(deviceContext);
 
     // Step 4: Render the triangle.
-    deviceContext->DrawIndexed(indexCount, 0, 0);
+    if (m_shader_info.instanced) {
+        deviceContext->DrawIndexedInstanced(indexCount, instanceCount, 0, 0, 0);
+    } else {
+        deviceContext->DrawIndexed(indexCount, 0, 0);
+    }
 
     return;
 }
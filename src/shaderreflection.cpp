@@ -0,0 +1,109 @@
+// Filename: shaderreflection.cpp
+#include "shaderreflection.h"
+
+#define SHADER_REFLECTION_VERSION 1            // Bump when the serialized layout changes.
+#define SHADER_REFLECTION_MAX_NAME 256
+
+// --------------------------------------------------------------------------------------------------------------------
+static void WriteUInt(std::vector<unsigned char>& data, unsigned int value)
+{
+    unsigned char bytes[4] = { (unsigned char)value, (unsigned char)(value >> 8), (unsigned char)(value >> 16), (unsigned char)(value >> 24) };
+    data.insert(data.end(), bytes, bytes + 4);
+}
+
+static void WriteString(std::vector<unsigned char>& data, const std::string& text)
+{
+    WriteUInt(data, (unsigned int)text.size());
+    data.insert(data.end(), text.begin(), text.end());
+}
+
+// The readers advance 'offset' and fail instead of reading past the end, the data comes from a file.
+static bool ReadUInt(const std::vector<unsigned char>& data, size_t& offset, unsigned int& value)
+{
+    if ((offset + 4) > data.size()) { return false; }
+
+    value = (unsigned int)data[offset] | ((unsigned int)data[offset + 1] << 8) | ((unsigned int)data[offset + 2] << 16) |
+            ((unsigned int)data[offset + 3] << 24);
+    offset += 4;
+
+    return true;
+}
+
+static bool ReadString(const std::vector<unsigned char>& data, size_t& offset, std::string& text)
+{
+    unsigned int size;
+
+    if (!ReadUInt(data, offset, size)) { return false; }
+    if ((size > SHADER_REFLECTION_MAX_NAME) || ((offset + size) > data.size())) { return false; }
+
+    text.assign((const char*)&data[offset], size);
+    offset += size;
+
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int FindShaderBinding(const ShaderReflectionType& reflection, const char* name, unsigned int type)
+{
+    for (auto& binding : reflection.bindings) {
+        if ((binding.type == type) && (binding.name == name)) { return (int)binding.slot; }
+    }
+
+    return -1;
+}
+
+void WriteShaderReflection(const ShaderReflectionType& reflection, std::vector<unsigned char>& data)
+{
+    data.clear();
+    WriteUInt(data, SHADER_REFLECTION_VERSION);
+
+    WriteUInt(data, (unsigned int)reflection.inputs.size());
+    for (auto& input : reflection.inputs) {
+        WriteString(data, input.semanticName);
+        WriteUInt(data, input.semanticIndex);
+        WriteUInt(data, input.componentType);
+        WriteUInt(data, input.componentCount);
+        WriteUInt(data, input.systemValue);
+    }
+
+    WriteUInt(data, (unsigned int)reflection.bindings.size());
+    for (auto& binding : reflection.bindings) {
+        WriteString(data, binding.name);
+        WriteUInt(data, binding.type);
+        WriteUInt(data, binding.slot);
+    }
+
+    return;
+}
+
+bool ReadShaderReflection(const std::vector<unsigned char>& data, ShaderReflectionType& reflection)
+{
+    size_t offset = 0;
+    unsigned int version, count, i;
+
+    reflection.inputs.clear();
+    reflection.bindings.clear();
+
+    if (!ReadUInt(data, offset, version) || (version != SHADER_REFLECTION_VERSION)) { return false; }
+
+    // Every element takes at least 4 bytes, a count larger than the data left is a corrupted entry.
+    if (!ReadUInt(data, offset, count) || (count > (data.size() - offset) / 4)) { return false; }
+    reflection.inputs.resize(count);
+    for (i = 0; i < count; i++) {
+        ShaderInputType& input = reflection.inputs[i];
+        if (!ReadString(data, offset, input.semanticName)) { return false; }
+        if (!ReadUInt(data, offset, input.semanticIndex) || !ReadUInt(data, offset, input.componentType) ||
+            !ReadUInt(data, offset, input.componentCount) || !ReadUInt(data, offset, input.systemValue)) { return false; }
+        if ((input.componentCount < 1) || (input.componentCount > 4)) { return false; }
+    }
+
+    if (!ReadUInt(data, offset, count) || (count > (data.size() - offset) / 4)) { return false; }
+    reflection.bindings.resize(count);
+    for (i = 0; i < count; i++) {
+        ShaderBindingType& binding = reflection.bindings[i];
+        if (!ReadString(data, offset, binding.name)) { return false; }
+        if (!ReadUInt(data, offset, binding.type) || !ReadUInt(data, offset, binding.slot)) { return false; }
+    }
+
+    return (offset == data.size());
+}
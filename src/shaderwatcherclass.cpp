@@ -0,0 +1,188 @@
+// Filename: shaderwatcherclass.cpp
+#include "shaderwatcherclass.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#define SHADER_WATCH_WAIT_MS 100            // How often the watch thread checks whether it must stop.
+#define SHADER_WATCH_BUFFER_SIZE 16384
+
+// --------------------------------------------------------------------------------------------------------------------
+ShaderWatcherClass::ShaderWatcherClass()
+{
+    m_stop = false;
+#ifdef _WIN32
+    m_directoryHandle = INVALID_HANDLE_VALUE;
+#else
+    m_notifyFd = -1;
+#endif
+}
+
+ShaderWatcherClass::ShaderWatcherClass(const ShaderWatcherClass& other)
+{
+}
+
+ShaderWatcherClass::~ShaderWatcherClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool ShaderWatcherClass::Initialize(const char* directory)
+{
+    m_directory = directory;
+    m_stop = false;
+
+#ifdef _WIN32
+    // Overlapped, so the watch thread can wait with a timeout and notice Shutdown.
+    m_directoryHandle = CreateFileA(directory, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+                                    FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    if (m_directoryHandle == INVALID_HANDLE_VALUE) { return false; }
+#else
+    m_notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_notifyFd < 0) { return false; }
+
+    // Writes in place and the rename of a temporary file over the source, as editors save.
+    if (inotify_add_watch(m_notifyFd, directory, IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE) < 0) {
+        close(m_notifyFd);
+        m_notifyFd = -1;
+        return false;
+    }
+#endif
+
+    m_thread = std::thread(&ShaderWatcherClass::WatchThread, this);
+
+    return true;
+}
+
+void ShaderWatcherClass::Shutdown()
+{
+    m_stop = true;
+    if (m_thread.joinable()) { m_thread.join(); }
+
+#ifdef _WIN32
+    if (m_directoryHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_directoryHandle);
+        m_directoryHandle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (m_notifyFd >= 0) {
+        close(m_notifyFd);
+        m_notifyFd = -1;
+    }
+#endif
+
+    m_changes.clear();
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool ShaderWatcherClass::GetChangedFiles(std::vector<std::string>& files)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto now = std::chrono::steady_clock::now();
+
+    files.clear();
+    for (auto change = m_changes.begin(); change != m_changes.end();) {
+        if ((now - change->second) >= std::chrono::milliseconds(SHADER_WATCH_SETTLE_MS)) {
+            files.push_back(change->first);
+            change = m_changes.erase(change);
+        } else {
+            change++;
+        }
+    }
+
+    return !files.empty();
+}
+
+void ShaderWatcherClass::AddChange(const std::string& filename)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_changes[filename] = std::chrono::steady_clock::now();
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+#ifdef _WIN32
+void ShaderWatcherClass::WatchThread()
+{
+    alignas(DWORD) char buffer[SHADER_WATCH_BUFFER_SIZE];
+    OVERLAPPED overlapped;
+    DWORD bytes;
+    BOOL result;
+
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (overlapped.hEvent == NULL) { return; }
+
+    while (!m_stop) {
+        ResetEvent(overlapped.hEvent);
+        result = ReadDirectoryChangesW(m_directoryHandle, buffer, sizeof(buffer), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME,
+                                       NULL, &overlapped, NULL);
+        if (!result) { break; }
+
+        while (!m_stop && (WaitForSingleObject(overlapped.hEvent, SHADER_WATCH_WAIT_MS) == WAIT_TIMEOUT)) { }
+        if (m_stop) {
+            CancelIoEx(m_directoryHandle, &overlapped);
+            GetOverlappedResult(m_directoryHandle, &overlapped, &bytes, TRUE);
+            break;
+        }
+
+        // No bytes means the buffer overflowed and the changes were lost, the next ones are still reported.
+        if (!GetOverlappedResult(m_directoryHandle, &overlapped, &bytes, FALSE) || (bytes == 0)) { continue; }
+
+        FILE_NOTIFY_INFORMATION* info = (FILE_NOTIFY_INFORMATION*)buffer;
+        for (;;) {
+            if ((info->Action == FILE_ACTION_MODIFIED) || (info->Action == FILE_ACTION_ADDED) || (info->Action == FILE_ACTION_RENAMED_NEW_NAME)) {
+                char filename[MAX_PATH];
+                int length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, info->FileNameLength / sizeof(WCHAR), filename, MAX_PATH - 1, NULL, NULL);
+                if (length > 0) { AddChange(std::string(filename, length)); }
+            }
+
+            if (info->NextEntryOffset == 0) { break; }
+            info = (FILE_NOTIFY_INFORMATION*)((char*)info + info->NextEntryOffset);
+        }
+    }
+
+    CloseHandle(overlapped.hEvent);
+
+    return;
+}
+#else
+void ShaderWatcherClass::WatchThread()
+{
+    alignas(struct inotify_event) char buffer[SHADER_WATCH_BUFFER_SIZE];
+    struct pollfd pollFd;
+    ssize_t bytes;
+    char* position;
+
+    pollFd.fd = m_notifyFd;
+    pollFd.events = POLLIN;
+
+    while (!m_stop) {
+        if (poll(&pollFd, 1, SHADER_WATCH_WAIT_MS) <= 0) { continue; }
+
+        bytes = read(m_notifyFd, buffer, sizeof(buffer));
+        if (bytes <= 0) { continue; }
+
+        for (position = buffer; position < buffer + bytes; position += sizeof(struct inotify_event) + ((struct inotify_event*)position)->len) {
+            struct inotify_event* event = (struct inotify_event*)position;
+            if ((event->len > 0) && !(event->mask & IN_ISDIR)) { AddChange(event->name); }
+        }
+    }
+
+    return;
+}
+#endif
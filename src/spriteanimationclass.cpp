@@ -0,0 +1,253 @@
+// Filename: spriteanimationclass.cpp
+#include "spriteanimationclass.h"
+#include "rtparallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+
+// Animations updated per parallel chunk, a multiple of the four lanes of an SSE register.
+#define ANIMATION_UPDATE_GRAIN 4096
+
+// --------------------------------------------------------------------------------------------------------------------
+SpriteAnimationClass::SpriteAnimationClass()
+{
+    m_time = nullptr;
+    m_frameTime = nullptr;
+    m_invFrameTime = nullptr;
+    m_speed = nullptr;
+    m_frameCount = nullptr;
+    m_frame = nullptr;
+    m_firstFrame = nullptr;
+    m_animationCount = 0;
+    m_maxAnimations = 0;
+}
+
+SpriteAnimationClass::SpriteAnimationClass(const SpriteAnimationClass& other)
+{
+}
+
+SpriteAnimationClass::~SpriteAnimationClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool SpriteAnimationClass::Initialize(int maxAnimations)
+{
+    int i;
+
+    if (maxAnimations < 1) { return false; }
+
+    // Round the capacity up to whole SSE registers.
+    m_maxAnimations = (maxAnimations + 3) & ~3;
+    m_animationCount = 0;
+
+    m_time = new float[m_maxAnimations];
+    m_frameTime = new float[m_maxAnimations];
+    m_invFrameTime = new float[m_maxAnimations];
+    m_speed = new float[m_maxAnimations];
+    m_frameCount = new float[m_maxAnimations];
+    m_frame = new int[m_maxAnimations];
+    m_firstFrame = new int[m_maxAnimations];
+
+    // Every slot starts as a stopped one frame animation, which is what the padding lanes stay.
+    for (i = 0; i < m_maxAnimations; i++) {
+        m_time[i] = 0.0f;
+        m_frameTime[i] = 1.0f;
+        m_invFrameTime[i] = 1.0f;
+        m_speed[i] = 0.0f;
+        m_frameCount[i] = 1.0f;
+        m_frame[i] = 0;
+        m_firstFrame[i] = 0;
+    }
+
+    // Frame 0 is the default whole texture frame used by the unused slots.
+    FrameType frame;
+    frame.image = 0;
+    frame.uvRect = XMFLOAT4(0.0f, 0.0f, 1.0f, 1.0f);
+    m_frames.push_back(frame);
+
+    return true;
+}
+
+void SpriteAnimationClass::Shutdown()
+{
+    // The state arrays were all allocated together in Initialize.
+    delete [] m_time; m_time = nullptr;
+    delete [] m_frameTime; m_frameTime = nullptr;
+    delete [] m_invFrameTime; m_invFrameTime = nullptr;
+    delete [] m_speed; m_speed = nullptr;
+    delete [] m_frameCount; m_frameCount = nullptr;
+    delete [] m_frame; m_frame = nullptr;
+    delete [] m_firstFrame; m_firstFrame = nullptr;
+
+    m_frames.clear();
+    m_clips.clear();
+    m_animationCount = 0;
+    m_maxAnimations = 0;
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int SpriteAnimationClass::AddClip(int frameCount, float frameTime, const int* images, const XMFLOAT4* uvRects)
+{
+    ClipType clip;
+    FrameType frame;
+    int i;
+
+    if ((frameCount < 1) || (frameTime <= 0.0f)) { return -1; }
+
+    clip.firstFrame = (int)m_frames.size();
+    clip.frameCount = frameCount;
+    clip.frameTime = frameTime;
+
+    for (i = 0; i < frameCount; i++) {
+        frame.image = images ? images[i] : 0;
+        frame.uvRect = uvRects ? uvRects[i] : XMFLOAT4(0.0f, 0.0f, 1.0f, 1.0f);
+        m_frames.push_back(frame);
+    }
+
+    m_clips.push_back(clip);
+
+    return (int)m_clips.size() - 1;
+}
+
+// A sprite sheet with the frames laid out in a grid of cells, left to right and then top to bottom.
+int SpriteAnimationClass::AddSheetClip(int columns, int rows, int frameCount, float frameTime, int image)
+{
+    std::vector<XMFLOAT4> uvRects;
+    std::vector<int> images;
+    float cellWidth, cellHeight;
+    int i;
+
+    if ((columns < 1) || (rows < 1) || (frameCount < 1) || (frameCount > (columns * rows))) { return -1; }
+
+    cellWidth = 1.0f / (float)columns;
+    cellHeight = 1.0f / (float)rows;
+    for (i = 0; i < frameCount; i++) {
+        float left = (float)(i % columns) * cellWidth;
+        float top = (float)(i / columns) * cellHeight;
+        uvRects.push_back(XMFLOAT4(left, top, left + cellWidth, top + cellHeight));
+        images.push_back(image);
+    }
+
+    return AddClip(frameCount, frameTime, images.data(), uvRects.data());
+}
+
+int SpriteAnimationClass::AddAnimation(int clip, float startTime, float speed)
+{
+    int animation, startFrame;
+
+    if ((clip < 0) || (clip >= (int)m_clips.size()) || (m_animationCount == m_maxAnimations)) { return -1; }
+
+    const ClipType& clipInfo = m_clips[clip];
+    animation = m_animationCount++;
+
+    // Place the start time within the loop of the clip.
+    startTime = fmodf(std::max(startTime, 0.0f), clipInfo.frameTime * (float)clipInfo.frameCount);
+    startFrame = std::min((int)(startTime / clipInfo.frameTime), clipInfo.frameCount - 1);
+
+    m_time[animation] = startTime - ((float)startFrame * clipInfo.frameTime);
+    m_frameTime[animation] = clipInfo.frameTime;
+    m_invFrameTime[animation] = 1.0f / clipInfo.frameTime;
+    m_speed[animation] = std::max(speed, 0.0f);
+    m_frameCount[animation] = (float)clipInfo.frameCount;
+    m_frame[animation] = startFrame;
+    m_firstFrame[animation] = clipInfo.firstFrame;
+
+    return animation;
+}
+
+// Speed scales the frame time of the clip for this animation only, 0 pauses it. Playing backwards is not supported.
+void SpriteAnimationClass::SetSpeed(int animation, float speed)
+{
+    if ((animation < 0) || (animation >= m_animationCount)) { return; }
+
+    m_speed[animation] = std::max(speed, 0.0f);
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void SpriteAnimationClass::Update(float frameTime)
+{
+    int count;
+
+    if (frameTime <= 0.0f) { return; }
+
+    // Whole SSE registers only, the padding lanes are part of the allocation.
+    count = (m_animationCount + 3) & ~3;
+
+    RTParallelFor(count, ANIMATION_UPDATE_GRAIN, [&](int begin, int end) {
+        UpdateRange(frameTime, begin, end);
+    });
+
+    return;
+}
+
+// Four animations per iteration. The elapsed time is added to the time spent in the current frame, the number of
+// whole frames it covers is the catch up step (any number of frames, not just one), and the frame is wrapped back
+// into the clip with a modulo done in float (the values are small integers, so they are exact).
+void SpriteAnimationClass::UpdateRange(float frameTime, int begin, int end)
+{
+    const __m128 elapsed = _mm_set1_ps(frameTime);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 time, duration, frameCount, frame, steps, loops, mask;
+    int i;
+
+    for (i = begin; i < end; i += 4) {
+        time = _mm_loadu_ps(m_time + i);
+        duration = _mm_loadu_ps(m_frameTime + i);
+        frameCount = _mm_loadu_ps(m_frameCount + i);
+        frame = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(m_frame + i)));
+
+        // Step 1: Add the elapsed time and count the whole frames it covers (the time is positive, truncation is floor).
+        time = _mm_add_ps(time, _mm_mul_ps(elapsed, _mm_loadu_ps(m_speed + i)));
+        steps = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(time, _mm_loadu_ps(m_invFrameTime + i))));
+        time = _mm_sub_ps(time, _mm_mul_ps(steps, duration));
+
+        // The reciprocal may be off by one ulp at a frame boundary, move the remainder back into [0, duration).
+        mask = _mm_cmplt_ps(time, zero);
+        time = _mm_add_ps(time, _mm_and_ps(mask, duration));
+        steps = _mm_sub_ps(steps, _mm_and_ps(mask, one));
+        mask = _mm_cmpge_ps(time, duration);
+        time = _mm_sub_ps(time, _mm_and_ps(mask, duration));
+        steps = _mm_add_ps(steps, _mm_and_ps(mask, one));
+
+        // Step 2: Advance the frame and wrap it into the clip, frame = (frame + steps) mod frameCount.
+        frame = _mm_add_ps(frame, steps);
+        loops = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_div_ps(frame, frameCount)));
+        frame = _mm_sub_ps(frame, _mm_mul_ps(loops, frameCount));
+        mask = _mm_cmpge_ps(frame, frameCount);
+        frame = _mm_sub_ps(frame, _mm_and_ps(mask, frameCount));
+
+        _mm_storeu_ps(m_time + i, time);
+        _mm_storeu_si128((__m128i*)(m_frame + i), _mm_cvttps_epi32(frame));
+    }
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int SpriteAnimationClass::GetAnimationCount()
+{
+    return m_animationCount;
+}
+
+int SpriteAnimationClass::GetFrame(int animation)
+{
+    return m_frame[animation];
+}
+
+int SpriteAnimationClass::GetImage(int animation)
+{
+    return m_frames[m_firstFrame[animation] + m_frame[animation]].image;
+}
+
+XMFLOAT4 SpriteAnimationClass::GetUVRect(int animation)
+{
+    return m_frames[m_firstFrame[animation] + m_frame[animation]].uvRect;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
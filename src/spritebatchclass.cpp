@@ -0,0 +1,268 @@
+// Filename: spritebatchclass.cpp
+#include "spritebatchclass.h"
+#include "rtparallel.h"
+
+#include <algorithm>
+
+// --------------------------------------------------------------------------------------------------------------------
+SpriteBatchClass::SpriteBatchClass()
+{
+    m_VertexRing = nullptr;
+    m_StateCache = nullptr;
+    m_indexBuffer = nullptr;
+    m_screenWidth = 0;
+    m_screenHeight = 0;
+    m_maxSprites = 0;
+    m_sortMode = SPRITE_SORT_TEXTURE;
+    m_inBatch = false;
+    m_spriteCount = 0;
+    m_drawCount = 0;
+}
+
+SpriteBatchClass::SpriteBatchClass(const SpriteBatchClass& other)
+{
+}
+
+SpriteBatchClass::~SpriteBatchClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// maxSpritesPerFlush sets the number of sprites written to the ring buffer at once (also limited by the size of the
+// ring). More sprites than that can still be queued, they are then drawn in several passes.
+bool SpriteBatchClass::Initialize(ID3D11Device* device, DynamicRingBufferClass* vertexRing, int screenWidth, int screenHeight, int maxSpritesPerFlush)
+{
+    bool result;
+
+    if ((vertexRing == nullptr) || (maxSpritesPerFlush < 1)) { return false; }
+
+    m_VertexRing = vertexRing;
+    m_screenWidth = screenWidth;
+    m_screenHeight = screenHeight;
+    m_maxSprites = std::min(maxSpritesPerFlush, (int)(m_VertexRing->GetSize() / (sizeof(VertexType) * 4)));
+    if (m_maxSprites < 1) { return false; }
+
+    result = InitializeBuffers(device);
+    if (!result) { return false; }
+
+    m_sprites.reserve(m_maxSprites);
+
+    return true;
+}
+
+void SpriteBatchClass::Shutdown()
+{
+    ShutdownBuffers();
+    m_sprites.clear();
+
+    return;
+}
+
+// Optional, the input assembler state is then bound through the cache and binds matching the current state are dropped.
+void SpriteBatchClass::SetStateCache(RenderStateCacheClass* stateCache)
+{
+    m_StateCache = stateCache;
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool SpriteBatchClass::InitializeBuffers(ID3D11Device* device)
+{
+    D3D11_BUFFER_DESC indexBufferDesc;
+    D3D11_SUBRESOURCE_DATA indexData;
+    unsigned int* indices;
+    unsigned int vertex;
+    HRESULT result;
+    int i;
+
+    // Create the static index buffer, the same two triangles for every quad, 4 vertices per sprite.
+    // The vertices of a quad are top left, top right, bottom right, bottom left (the winding BitmapClass uses).
+    indices = new unsigned int[6 * m_maxSprites];
+    for (i = 0; i < m_maxSprites; i++) {
+        vertex = i * 4;
+        indices[(i * 6) + 0] = vertex + 0;
+        indices[(i * 6) + 1] = vertex + 2;
+        indices[(i * 6) + 2] = vertex + 3;
+        indices[(i * 6) + 3] = vertex + 0;
+        indices[(i * 6) + 4] = vertex + 1;
+        indices[(i * 6) + 5] = vertex + 2;
+    }
+
+    indexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    indexBufferDesc.ByteWidth = sizeof(unsigned int) * 6 * m_maxSprites;
+    indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    indexBufferDesc.CPUAccessFlags = 0;
+    indexBufferDesc.MiscFlags = 0;
+    indexBufferDesc.StructureByteStride = 0;
+
+    indexData.pSysMem = indices;
+    indexData.SysMemPitch = 0;
+    indexData.SysMemSlicePitch = 0;
+
+    result = device->CreateBuffer(&indexBufferDesc, &indexData, &m_indexBuffer);
+    delete [] indices;
+    if (FAILED(result)) { return false; }
+
+    return true;
+}
+
+void SpriteBatchClass::ShutdownBuffers()
+{
+    RT_RELEASE_ID3D11_PTR(m_indexBuffer);
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void SpriteBatchClass::Begin(SpriteSortMode sortMode)
+{
+    m_sortMode = sortMode;
+    m_sprites.clear();
+    m_inBatch = true;
+
+    return;
+}
+
+void SpriteBatchClass::Draw(ID3D11ShaderResourceView* texture, float x, float y, float width, float height)
+{
+    Draw(texture, x, y, width, height, XMFLOAT4(0.0f, 0.0f, 1.0f, 1.0f));
+    return;
+}
+
+// Draw only queues the sprite, nothing is sent to the GPU before End.
+void SpriteBatchClass::Draw(ID3D11ShaderResourceView* texture, float x, float y, float width, float height, XMFLOAT4 uvRect)
+{
+    SpriteInfo sprite;
+
+    if (!m_inBatch) { return; }
+
+    sprite.texture = texture;
+    sprite.rect = XMFLOAT4(x, y, width, height);
+    sprite.uvRect = uvRect;
+    m_sprites.push_back(sprite);
+
+    return;
+}
+
+// End sorts the queued sprites and draws them. The vertices of a pass are written to one range of the ring buffer and
+// then every run of sprites sharing a texture in it is one DrawIndexed.
+bool SpriteBatchClass::End(ID3D11DeviceContext* deviceContext, ShaderClass* shader, XMMATRIX worldMatrix, XMMATRIX viewMatrix, XMMATRIX orthoMatrix)
+{
+    bool result;
+    int first, count;
+
+    if (!m_inBatch) { return false; }
+    m_inBatch = false;
+
+    m_spriteCount = (int)m_sprites.size();
+    m_drawCount = 0;
+    if (m_spriteCount == 0) { return true; }
+
+    // Step 1: Group the sprites by texture, the stable sort keeps the submission order within a texture. ------------
+    if (m_sortMode == SPRITE_SORT_TEXTURE) {
+        std::stable_sort(m_sprites.begin(), m_sprites.end(), [](const SpriteInfo& a, const SpriteInfo& b) {
+            return a.texture < b.texture;
+        });
+    }
+
+    // Step 2: Set the shared pipeline state once for the whole batch. ------------------------------------------------
+    if (m_StateCache) {
+        m_StateCache->SetIndexBuffer(deviceContext, m_indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+        m_StateCache->SetPrimitiveTopology(deviceContext, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    } else {
+        deviceContext->IASetIndexBuffer(m_indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+        deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    }
+
+    result = shader->BeginBatch(deviceContext, worldMatrix, viewMatrix, orthoMatrix);
+    if (!result) { return false; }
+
+    // Step 3: Draw the sprites, as many passes over the vertex buffer as needed. -------------------------------------
+    for (first = 0; first < m_spriteCount; first += m_maxSprites) {
+        count = std::min(m_maxSprites, m_spriteCount - first);
+
+        result = Flush(deviceContext, shader, first, count);
+        if (!result) { return false; }
+    }
+
+    return true;
+}
+
+bool SpriteBatchClass::Flush(ID3D11DeviceContext* deviceContext, ShaderClass* shader, int first, int count)
+{
+    VertexType* vertices;
+    ID3D11Buffer* vertexBuffer;
+    unsigned int stride, offset;
+    int runStart, i;
+
+    // Write the vertices of all the sprites of this pass straight into the mapped range of the ring, split across the workers.
+    vertices = (VertexType*)m_VertexRing->Map(deviceContext, sizeof(VertexType) * 4 * count, sizeof(VertexType), offset);
+    if (vertices == nullptr) { return false; }
+
+    RTParallelFor(count, 4096, [&](int begin, int end) {
+        WriteVertices(vertices + (begin * 4), first + begin, end - begin);
+    });
+
+    m_VertexRing->Unmap(deviceContext);
+
+    stride = sizeof(VertexType);
+    vertexBuffer = m_VertexRing->GetBuffer();
+    if (m_StateCache) { m_StateCache->SetVertexBuffer(deviceContext, 0, vertexBuffer, stride, offset); }
+    else { deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset); }
+
+    // One draw per run of sprites with the same texture.
+    runStart = 0;
+    for (i = 1; i <= count; i++) {
+        if ((i == count) || (m_sprites[first + i].texture != m_sprites[first + runStart].texture)) {
+            shader->DrawBatch(deviceContext, m_sprites[first + runStart].texture, (i - runStart) * 6, runStart * 6);
+            m_drawCount++;
+            runStart = i;
+        }
+    }
+
+    return true;
+}
+
+// Convert the pixel rectangles to the ortho projection space (origin at the center of the screen, y up), the same
+// way BitmapClass::UpdateBuffers does.
+void SpriteBatchClass::WriteVertices(VertexType* vertices, int first, int count)
+{
+    float halfWidth, halfHeight, left, right, top, bottom;
+    int i;
+
+    halfWidth = (float)(m_screenWidth / 2);
+    halfHeight = (float)(m_screenHeight / 2);
+
+    for (i = 0; i < count; i++) {
+        const SpriteInfo& sprite = m_sprites[first + i];
+        VertexType* quad = vertices + (i * 4);
+
+        left = sprite.rect.x - halfWidth;
+        right = left + sprite.rect.z;
+        top = halfHeight - sprite.rect.y;
+        bottom = top - sprite.rect.w;
+
+        quad[0].position = XMFLOAT3(left, top, 0.0f);       // Top left.
+        quad[0].texture = XMFLOAT2(sprite.uvRect.x, sprite.uvRect.y);
+        quad[1].position = XMFLOAT3(right, top, 0.0f);      // Top right.
+        quad[1].texture = XMFLOAT2(sprite.uvRect.z, sprite.uvRect.y);
+        quad[2].position = XMFLOAT3(right, bottom, 0.0f);   // Bottom right.
+        quad[2].texture = XMFLOAT2(sprite.uvRect.z, sprite.uvRect.w);
+        quad[3].position = XMFLOAT3(left, bottom, 0.0f);    // Bottom left.
+        quad[3].texture = XMFLOAT2(sprite.uvRect.x, sprite.uvRect.w);
+    }
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int SpriteBatchClass::GetSpriteCount()
+{
+    return m_spriteCount;
+}
+
+int SpriteBatchClass::GetDrawCount()
+{
+    return m_drawCount;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
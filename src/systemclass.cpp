@@ -1,10 +1,16 @@
 #include "systemclass.h"
 
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+
 // --------------------------------------------------------------------------------------------------------------------
 SystemClass::SystemClass()
 {
 	m_Input = nullptr;
 	m_Application = nullptr;
+	m_Clock = nullptr;
+	m_isActive = true;
+	m_isMinimized = false;
 }
 
 SystemClass::SystemClass(const SystemClass&)
@@ -38,6 +44,14 @@ bool SystemClass::Initialize()
 	result = m_Application->Initialize(screenWidth, screenHeight, m_hwnd, app_config);
 	if (!result) { return false; }
 
+	// Create the clock of the main loop. The 1 ms system timer period keeps the frame limiter close to the time the
+	// next frame is due on systems without high resolution waitable timers.
+	timeBeginPeriod(1);
+	m_Clock = new FrameClockClass;
+	result = m_Clock->Initialize(SIMULATION_STEP_TIME);
+	if (!result) { return false; }
+	UpdateFrameRateLimit();
+
 	return true;
 }
 
@@ -56,6 +70,13 @@ void SystemClass::Shutdown()
 		m_Application = nullptr;
 	}
 
+	if (m_Clock != nullptr) {
+		m_Clock->Shutdown();
+		delete m_Clock;
+		m_Clock = nullptr;
+		timeEndPeriod(1);
+	}
+
 	ShutdownWindows();
 }
 // --------------------------------------------------------------------------------------------------------------------
@@ -65,10 +86,12 @@ void SystemClass::Shutdown()
 // as now the rest of our application must be written with this in mind.
 // The pseudo code looks like the following:
 //	while not done
+//		wait for a message if the window is minimized (idle)
 //		check for windows system messages
 //		process system messages
 //		process application loop
 //		check if user wanted to quit during the frame processing
+//		wait until the next frame is due (frame rate limit)
 void SystemClass::Run()
 {
 	MSG msg;
@@ -80,25 +103,31 @@ void SystemClass::Run()
 	// Loop until there is a quit message from the window or the user.
 	done = false;
 	while (!done) {
-		// Handle the windows messages.
-		if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+		// A minimized window has nothing to draw: block until a message comes instead of presenting frames nobody
+		// sees. The time spent waiting is not simulated afterwards.
+		if (m_isMinimized) {
+			WaitMessage();
+			m_Clock->Reset();
+		}
+
+		// Handle all the windows messages waiting.
+		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+			if (msg.message == WM_QUIT) { done = true; }
 			TranslateMessage(&msg);
 			DispatchMessage(&msg);
 		}
 
 		// If windows signals to end the application then exit out.
-		if (msg.message == WM_QUIT) {
+		if (done || m_isMinimized) { continue; }
+
+		// Otherwise do the frame processing.
+		result = Frame();
+		if (!result) {
 			done = true;
 		}
-		else
-		{
-			// Otherwise do the frame processing.
-			result = Frame();
-			if (!result) {
-				done = true;
-			}
-		}
 
+		// Sleep until the next frame is due, when the frame rate is limited.
+		m_Clock->WaitForNextFrame();
 	}
 
 	return;
@@ -107,23 +136,46 @@ void SystemClass::Run()
 // --------------------------------------------------------------------------------------------------------------------
 // The following Frame function is where all the processing for our application is done.
 // We check the input object to see if the user has pressed escape and wants to quit.
-// If not, call the application class object to do its frame processing which will render the graphics for that frame.
+// If not, advance the simulation by the fixed steps of the time since the last frame and call the application class
+// object to do its frame processing which will render the graphics for that frame.
 bool SystemClass::Frame()
 {
 	bool result;
+	int steps, i;
 
 	// Check if the user pressed escape and wants to exit the application.
 	if (m_Input->IsKeyDown(VK_ESCAPE)) {
 		return false;
 	}
 
+	// Run the simulation steps due, at the same speed whatever the frame rate.
+	steps = m_Clock->BeginFrame();
+	for (i = 0; i < steps; i++) {
+		m_Application->Update(m_Clock->GetStepTime());
+	}
+
 	// Do the frame processing for the application class object.
-	result = m_Application->Frame();
+	result = m_Application->Frame(m_Clock->GetFrameTime(), m_Clock->GetInterpolation());
 	if (!result) { return false; }
 
 	return true;
 }
 
+// The active window runs at the frame rate limit of the command line (--fps), a window in the background at
+// BACKGROUND_FRAME_RATE at most.
+void SystemClass::UpdateFrameRateLimit()
+{
+	float limit;
+
+	limit = (float)RTArgs.fps;
+	if (!m_isActive && ((limit <= 0.0f) || (limit > BACKGROUND_FRAME_RATE))) {
+		limit = BACKGROUND_FRAME_RATE;
+	}
+	m_Clock->SetFrameRateLimit(limit);
+
+	return;
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 // Currently we will just read if a key is pressed or if a key is released and pass that information on to the input object.
 // All other information we will pass back to the windows default message handler.
@@ -147,6 +199,21 @@ LRESULT CALLBACK SystemClass::MessageHandler(HWND hwnd, UINT umsg, WPARAM wparam
 			return 0;
 		}
 
+		// Check if the window was minimized or restored, a minimized window is not drawn.
+		case WM_SIZE:
+		{
+			m_isMinimized = (wparam == SIZE_MINIMIZED);
+			return 0;
+		}
+
+		// Check if the application was activated or went to the background, a background window is drawn slower.
+		case WM_ACTIVATEAPP:
+		{
+			m_isActive = (wparam != FALSE);
+			if (m_Clock != nullptr) { UpdateFrameRateLimit(); }
+			return 0;
+		}
+
 		// Any other messages send to the default message handler as our application won't make use of them.
 		default:
 		{
@@ -0,0 +1,264 @@
+// Filename: textclass.cpp
+#include "textclass.h"
+
+#include <algorithm>
+
+// --------------------------------------------------------------------------------------------------------------------
+TextClass::TextClass()
+{
+    m_VertexRing = nullptr;
+    m_StateCache = nullptr;
+    m_Font = nullptr;
+    m_indexBuffer = nullptr;
+    m_screenWidth = 0;
+    m_screenHeight = 0;
+    m_maxCharacters = 0;
+    m_dirty = true;
+    m_vertexOffset = 0;
+    m_vertexRingWrap = 0;
+    m_characterCount = 0;
+    m_layoutCount = 0;
+}
+
+TextClass::TextClass(const TextClass& other)
+{
+}
+
+TextClass::~TextClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// maxCharacters is the number of visible characters of all the strings together, the rest is not drawn.
+bool TextClass::Initialize(ID3D11Device* device, DynamicRingBufferClass* vertexRing, FontClass* font, int screenWidth, int screenHeight, int maxCharacters)
+{
+    bool result;
+
+    if ((vertexRing == nullptr) || (font == nullptr) || (maxCharacters < 1)) { return false; }
+
+    m_VertexRing = vertexRing;
+    m_Font = font;
+    m_screenWidth = screenWidth;
+    m_screenHeight = screenHeight;
+    m_maxCharacters = std::min(maxCharacters, (int)(m_VertexRing->GetSize() / (sizeof(VertexType) * 4)));
+    if (m_maxCharacters < 1) { return false; }
+
+    result = InitializeBuffers(device);
+    if (!result) { return false; }
+
+    return true;
+}
+
+void TextClass::Shutdown()
+{
+    ShutdownBuffers();
+    m_strings.clear();
+
+    return;
+}
+
+// Optional, the input assembler state is then bound through the cache and binds matching the current state are dropped.
+void TextClass::SetStateCache(RenderStateCacheClass* stateCache)
+{
+    m_StateCache = stateCache;
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool TextClass::InitializeBuffers(ID3D11Device* device)
+{
+    D3D11_BUFFER_DESC indexBufferDesc;
+    D3D11_SUBRESOURCE_DATA indexData;
+    unsigned int* indices;
+    unsigned int vertex;
+    HRESULT result;
+    int i;
+
+    // Same static quad index buffer as SpriteBatchClass, the vertices of a glyph are top left, top right, bottom right, bottom left.
+    indices = new unsigned int[6 * m_maxCharacters];
+    for (i = 0; i < m_maxCharacters; i++) {
+        vertex = i * 4;
+        indices[(i * 6) + 0] = vertex + 0;
+        indices[(i * 6) + 1] = vertex + 2;
+        indices[(i * 6) + 2] = vertex + 3;
+        indices[(i * 6) + 3] = vertex + 0;
+        indices[(i * 6) + 4] = vertex + 1;
+        indices[(i * 6) + 5] = vertex + 2;
+    }
+
+    indexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    indexBufferDesc.ByteWidth = sizeof(unsigned int) * 6 * m_maxCharacters;
+    indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    indexBufferDesc.CPUAccessFlags = 0;
+    indexBufferDesc.MiscFlags = 0;
+    indexBufferDesc.StructureByteStride = 0;
+
+    indexData.pSysMem = indices;
+    indexData.SysMemPitch = 0;
+    indexData.SysMemSlicePitch = 0;
+
+    result = device->CreateBuffer(&indexBufferDesc, &indexData, &m_indexBuffer);
+    delete [] indices;
+    if (FAILED(result)) { return false; }
+
+    return true;
+}
+
+void TextClass::ShutdownBuffers()
+{
+    RT_RELEASE_ID3D11_PTR(m_indexBuffer);
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// AddString returns the id used to set the string afterwards, strings are drawn in the order they were added.
+int TextClass::AddString()
+{
+    StringType string;
+
+    string.x = 0;
+    string.y = 0;
+    m_strings.push_back(string);
+
+    return (int)m_strings.size() - 1;
+}
+
+// Most HUD strings stay the same for many frames (labels) or only change a few times per second (counters),
+// so the layout is only built again when the text or the position actually changed.
+void TextClass::SetString(int id, const char* text, int x, int y)
+{
+    if ((id < 0) || (id >= (int)m_strings.size())) { return; }
+
+    StringType& string = m_strings[id];
+    if ((string.x == x) && (string.y == y) && (string.text == text)) { return; }
+
+    string.text = text;
+    string.x = x;
+    string.y = y;
+    BuildString(string);
+
+    m_dirty = true;
+    m_layoutCount++;
+
+    return;
+}
+
+// Lay out the glyph quads of a string in the ortho projection space (origin at the center of the screen, y up), the
+// same way BitmapClass::UpdateBuffers does. A new line goes back to x and down one line height.
+void TextClass::BuildString(StringType& string)
+{
+    const FontClass::GlyphType* glyph;
+    VertexType quad[4];
+    float halfWidth, halfHeight, penX, penY, left, right, top, bottom;
+
+    halfWidth = (float)(m_screenWidth / 2);
+    halfHeight = (float)(m_screenHeight / 2);
+    penX = (float)string.x;
+    penY = (float)string.y;
+
+    string.vertices.clear();
+    for (char character : string.text) {
+        if (character == '\n') {
+            penX = (float)string.x;
+            penY += (float)m_Font->GetLineHeight();
+            continue;
+        }
+
+        glyph = m_Font->GetGlyph(character);
+
+        // Blank characters only move the pen.
+        if ((glyph->width > 0.0f) && (glyph->height > 0.0f)) {
+            left = penX + glyph->xOffset - halfWidth;
+            right = left + glyph->width;
+            top = halfHeight - (penY + glyph->yOffset);
+            bottom = top - glyph->height;
+
+            quad[0].position = XMFLOAT3(left, top, 0.0f);       // Top left.
+            quad[0].texture = XMFLOAT2(glyph->uvRect.x, glyph->uvRect.y);
+            quad[1].position = XMFLOAT3(right, top, 0.0f);      // Top right.
+            quad[1].texture = XMFLOAT2(glyph->uvRect.z, glyph->uvRect.y);
+            quad[2].position = XMFLOAT3(right, bottom, 0.0f);   // Bottom right.
+            quad[2].texture = XMFLOAT2(glyph->uvRect.z, glyph->uvRect.w);
+            quad[3].position = XMFLOAT3(left, bottom, 0.0f);    // Bottom left.
+            quad[3].texture = XMFLOAT2(glyph->uvRect.x, glyph->uvRect.w);
+
+            string.vertices.insert(string.vertices.end(), quad, quad + 4);
+        }
+
+        penX += glyph->xAdvance;
+    }
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// All the strings share the font texture, so the whole text is one draw. The vertices are only copied to the ring
+// when a string changed or when the ring wrapped (the discard threw the previous copy away).
+bool TextClass::Render(ID3D11DeviceContext* deviceContext, ShaderClass* shader, XMMATRIX worldMatrix, XMMATRIX viewMatrix, XMMATRIX orthoMatrix)
+{
+    VertexType* vertices;
+    ID3D11Buffer* vertexBuffer;
+    unsigned int stride;
+    int vertexCount, count;
+    bool result;
+
+    if (m_dirty || (m_VertexRing->GetWrapCount() != m_vertexRingWrap)) {
+        vertexCount = 0;
+        for (auto& string : m_strings) { vertexCount += (int)string.vertices.size(); }
+        m_characterCount = std::min(vertexCount / 4, m_maxCharacters);
+        if (m_characterCount == 0) { m_dirty = false; return true; }
+
+        vertices = (VertexType*)m_VertexRing->Map(deviceContext, sizeof(VertexType) * 4 * m_characterCount, sizeof(VertexType), m_vertexOffset);
+        if (vertices == nullptr) { return false; }
+
+        vertexCount = 0;
+        for (auto& string : m_strings) {
+            count = std::min((int)string.vertices.size(), (m_characterCount * 4) - vertexCount);
+            if (count <= 0) { break; }
+            memcpy(vertices + vertexCount, string.vertices.data(), sizeof(VertexType) * count);
+            vertexCount += count;
+        }
+
+        m_VertexRing->Unmap(deviceContext);
+
+        m_vertexRingWrap = m_VertexRing->GetWrapCount();
+        m_dirty = false;
+    }
+
+    if (m_characterCount == 0) { return true; }
+
+    // Set the buffers and draw all the characters with the font atlas.
+    stride = sizeof(VertexType);
+    vertexBuffer = m_VertexRing->GetBuffer();
+    if (m_StateCache) {
+        m_StateCache->SetVertexBuffer(deviceContext, 0, vertexBuffer, stride, m_vertexOffset);
+        m_StateCache->SetIndexBuffer(deviceContext, m_indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+        m_StateCache->SetPrimitiveTopology(deviceContext, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    } else {
+        deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &m_vertexOffset);
+        deviceContext->IASetIndexBuffer(m_indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+        deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    }
+
+    result = shader->BeginBatch(deviceContext, worldMatrix, viewMatrix, orthoMatrix);
+    if (!result) { return false; }
+
+    // Other shader objects may have used slot 0 since the last frame, so the atlas is always bound again.
+    shader->InvalidateBoundTexture();
+    shader->DrawBatch(deviceContext, m_Font->GetTexture(), m_characterCount * 6, 0);
+
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int TextClass::GetCharacterCount()
+{
+    return m_characterCount;
+}
+
+int TextClass::GetLayoutCount()
+{
+    return m_layoutCount;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
@@ -2,6 +2,10 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include "RasterTek.h"
 #include "textureclass.h"
+#include "texturestreamerclass.h"
+
+#include <algorithm>
+#include <functional>
 
 // --------------------------------------------------------------------------------------------------------------------
 TextureClass::TextureClass()
@@ -9,6 +13,13 @@ TextureClass::TextureClass()
     m_targaData = nullptr;
     m_texture = nullptr;
     m_textureView = nullptr;
+    m_streamer = nullptr;
+    m_device = nullptr;
+    m_deviceContext = nullptr;
+    m_mipCount = 0;
+    m_residentMip = 0;
+    m_residentBytes = 0;
+    m_arraySize = 1;
 }
 
 TextureClass::TextureClass(const TextureClass& other)
@@ -20,76 +31,375 @@ TextureClass::~TextureClass()
 }
 
 // --------------------------------------------------------------------------------------------------------------------
+// The mip chain is built on the CPU by the MipGeneratorClass (gamma correct filtering) instead of ID3D11DeviceContext::GenerateMips,
+// so the texture no longer needs the render target bind flag and all levels are handed over at creation time.
+void TextureClass::GetMipGeneratorConfig(MipGeneratorConfig& config)
+{
+    config.filter = MIP_FILTER_KAISER;
+    config.srgb = true;
+    config.preserveAlphaCoverage = false;
+    return;
+}
+
 bool TextureClass::Initialize(ID3D11Device* device, ID3D11DeviceContext* deviceContext, char* filename)
 {
     bool result;
-    HRESULT hResult;
-    unsigned int rowPitch;
+    MipGeneratorConfig mipConfig;
+    MipGeneratorClass mipGenerator;
+    MipChain mipChain;
 
     // Load the targa image data into memory.
     result = LoadTarga32Bit(filename);
     if(!result) { return false; }
 
+    // Build the complete mip chain of the image on the CPU.
+    GetMipGeneratorConfig(mipConfig);
+    result = mipGenerator.Initialize(mipConfig);
+    if (!result) { return false; }
+
+    result = mipGenerator.Generate(m_targaData, m_width, m_height, mipChain);
+    if (!result) { return false; }
+
+    // Create the texture and its shader resource view from the chain.
+    result = CreateTexture(device, &mipChain, 1, false);
+    if (!result) { return false; }
+
+    // Release the targa image data now that the image data has been loaded into the texture.
+    delete [] m_targaData;
+    m_targaData = nullptr;
+
+    return true;
+}
+
+// InitializeArray loads a sequence of images of the same size (e.g. the frames of a sprite) into the slices of a single
+// Texture2DArray, so the whole sequence is bound with one shader resource view and the shader picks the slice.
+// All the images are read first and their mip chains are then generated in parallel, one image per worker thread;
+// every slice gets its own complete mip chain so a scaled down sprite samples a small level like any other texture.
+bool TextureClass::InitializeArray(ID3D11Device* device, ID3D11DeviceContext* deviceContext, char** filenames, int count)
+{
+    bool result;
+    int i, width = 0, height = 0;
+    MipGeneratorConfig mipConfig;
+    MipGeneratorClass mipGenerator;
+
+    if (count < 1) { return false; }
+
+    // Step 1: Load all the targa images, they all must have the size of the first one. -------------------------------
+    unsigned char** images = new unsigned char*[count];
+    int* widths = new int[count];
+    int* heights = new int[count];
+    MipChain* mipChains = new MipChain[count];
+    memset(images, 0, sizeof(unsigned char*) * count);
+
+    result = true;
+    for (i = 0; (i < count) && result; i++) {
+        result = LoadTarga32Bit(filenames[i]);
+        if (!result) { break; }
+
+        if (i == 0) { width = m_width; height = m_height; }
+        result = (m_width == width) && (m_height == height);
+
+        images[i] = m_targaData;
+        widths[i] = m_width;
+        heights[i] = m_height;
+        m_targaData = nullptr;
+    }
+
+    // Step 2: Generate the mip chains of all images in parallel. ------------------------------------------------------
+    if (result) {
+        GetMipGeneratorConfig(mipConfig);
+        result = mipGenerator.Initialize(mipConfig);
+    }
+    if (result) { result = mipGenerator.GenerateBatch(images, widths, heights, count, mipChains); }
+
+    // Step 3: Create the texture array from the chains. -----------------------------------------------------------------
+    if (result) { result = CreateTexture(device, mipChains, count, true); }
+
+    for (i = 0; i < count; i++) { RT_RELEASE_OBJ_PTR_ARR(images[i]); }
+    delete [] mipChains;
+    delete [] heights;
+    delete [] widths;
+    delete [] images;
+
+    return result;
+}
+
+// CreateTexture creates a texture with one slice per chain. With arrayView the view is a Texture2DArray one, even for
+// a single slice, so the texture can be used by the texture array shader whatever the number of frames.
+bool TextureClass::CreateTexture(ID3D11Device* device, const MipChain* chains, int arraySize, bool arrayView)
+{
+    HRESULT hResult;
+    unsigned int level, levelCount, slice;
+
+    levelCount = (unsigned int)chains[0].levels.size();
+
     // Setup the description of the texture.
     D3D11_TEXTURE2D_DESC textureDesc;
     textureDesc.Height = m_height;
     textureDesc.Width = m_width;
-    textureDesc.MipLevels = 0;
-    textureDesc.ArraySize = 1;
+    textureDesc.MipLevels = levelCount;
+    textureDesc.ArraySize = arraySize;
     textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
     textureDesc.SampleDesc.Count = 1;
     textureDesc.SampleDesc.Quality = 0;
     textureDesc.Usage = D3D11_USAGE_DEFAULT;
-    textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+    textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
     textureDesc.CPUAccessFlags = 0;
-    textureDesc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+    textureDesc.MiscFlags = 0;
+
+    // Every mip level is passed as initial data, so the whole chain is uploaded with the creation of the texture.
+    // This is the "load once" case UpdateSubresource was used for before, without the extra copy of level 0.
+    // The subresources of an array are ordered slice by slice, all the mips of slice 0 first (D3D11CalcSubresource).
+    D3D11_SUBRESOURCE_DATA* levelData = new D3D11_SUBRESOURCE_DATA[levelCount * arraySize];
+    m_residentBytes = 0;
+    for (slice = 0; slice < (unsigned int)arraySize; slice++) {
+        for (level = 0; level < levelCount; level++) {
+            const MipLevelData& chainLevel = chains[slice].levels[level];
+            unsigned int subresource = D3D11CalcSubresource(level, slice, levelCount);
+
+            levelData[subresource].pSysMem = chainLevel.pixels.data();
+            levelData[subresource].SysMemPitch = (chainLevel.width * 4) * sizeof(unsigned char);
+            levelData[subresource].SysMemSlicePitch = 0;
+            m_residentBytes += chainLevel.pixels.size();
+        }
+    }
 
-    // Create the empty texture.
-    hResult = device->CreateTexture2D(&textureDesc, NULL, &m_texture);
+    // Create the texture.
+    hResult = device->CreateTexture2D(&textureDesc, levelData, &m_texture);
+    delete [] levelData;
     if (FAILED(hResult)) { return false; }
 
-    // Set the row pitch of the targa image data.
-    rowPitch = (m_width * 4) * sizeof(unsigned char);
-
-    // Copy the targa image data into the texture.
-    // Here we use UpdateSubresource to actually do the copying of the Targa data array into the DirectX texture.
-    // We could have used Map and Unmap to copy our texture data. And in fact, using Map and Unmap is generally a lot quicker than using UpdateSubresource,
-    // however both loading methods have specific purposes and you need to choose correctly which one to use for performance reasons.
-    // The recommendation is that you use Map and Unmap for data that is going to be reloaded each frame or on a very regular basis.
-    // And you should use UpdateSubresource for something that will be loaded once or that gets loaded rarely during loading sequences.
-    // The reason being is that UpdateSubresource puts the data into higher speed memory that gets cache retention preference since 
-    // it knows you aren't going to remove or reload it anytime soon.
-    // We let DirectX also know by using D3D11_USAGE_DEFAULT when we are going to load using UpdateSubresource.
-    // And Map and Unmap will put the data into memory locations that will not be cached as DirectX is expecting that data to be overwritten shortly.
-    // And that is why we use D3D11_USAGE_DYNAMIC to notify DirectX that this type of data is transient.
-    deviceContext->UpdateSubresource(m_texture, 0, NULL, m_targaData, rowPitch, 0);
-
     // Setup the shader resource view description.
     // After the texture is loaded, we create a shader resource view which allows us to have a pointer to set the texture in shaders.
-    // In the description we also set two important Mipmap variables which will give us the full range of Mipmap levels for high quality texture rendering at any distance.
-    // Once the shader resource view is created, we call GenerateMips and it creates the Mipmaps for us, however if you want you can load your own Mipmap levels in manually
+    // MipLevels = -1 exposes every level of the chain for high quality texture rendering at any distance.
     D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
     srvDesc.Format = textureDesc.Format;
-    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-    srvDesc.Texture2D.MostDetailedMip = 0;
-    srvDesc.Texture2D.MipLevels = -1;
+    if (arrayView) {
+        srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+        srvDesc.Texture2DArray.MostDetailedMip = 0;
+        srvDesc.Texture2DArray.MipLevels = -1;
+        srvDesc.Texture2DArray.FirstArraySlice = 0;
+        srvDesc.Texture2DArray.ArraySize = arraySize;
+    } else {
+        srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+        srvDesc.Texture2D.MostDetailedMip = 0;
+        srvDesc.Texture2D.MipLevels = -1;
+    }
 
     // Create the shader resource view for the texture.
     hResult = device->CreateShaderResourceView(m_texture, &srvDesc, &m_textureView);
     if (FAILED(hResult)) { return false; }
 
-    // Generate mipmaps for this texture.
-    deviceContext->GenerateMips(m_textureView);
+    // The whole chain is resident.
+    m_mipCount = levelCount;
+    m_residentMip = 0;
+    m_arraySize = arraySize;
 
-    // Release the targa image data now that the image data has been loaded into the texture.
-    delete [] m_targaData;
-    m_targaData = nullptr;
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Size of a level of the chain, as MipGeneratorClass builds them.
+static int GetMipSize(int size, int mip)
+{
+    return std::max(1, size >> mip);
+}
+
+// A streamed texture starts with only the low resolution mips on the GPU (the ones not bigger than the streamer's
+// initial resident size). The streamer then moves the most detailed resident mip up and down with SetResidentMip.
+// The chain is generated once here; the finer mips are written to a file of the streamer's mip directory, and no copy
+// stays in system memory. Streaming in reads the levels it needs back from there, it never generates them again.
+bool TextureClass::InitializeStreaming(ID3D11Device* device, ID3D11DeviceContext* deviceContext, char* filename, TextureStreamerClass* streamer)
+{
+    bool result;
+    int initialMip;
+    char mipName[32];
+    MipGeneratorConfig mipConfig;
+    MipGeneratorClass mipGenerator;
+    MipChain mipChain;
+
+    // Step 1: Load the targa image and build its complete mip chain. --------------------------------------------------
+    result = LoadTarga32Bit(filename);
+    if (!result) { return false; }
+
+    GetMipGeneratorConfig(mipConfig);
+    result = mipGenerator.Initialize(mipConfig);
+    if (result) { result = mipGenerator.Generate(m_targaData, m_width, m_height, mipChain); }
+    RT_RELEASE_OBJ_PTR_ARR(m_targaData);
+    if (!result) { return false; }
+
+    m_mipCount = (int)mipChain.levels.size();
+
+    // Find the first mip small enough to be loaded up front.
+    initialMip = 0;
+    while ((initialMip < (m_mipCount - 1)) &&
+           ((mipChain.levels[initialMip].width > streamer->GetInitialResidentSize()) ||
+            (mipChain.levels[initialMip].height > streamer->GetInitialResidentSize()))) {
+        initialMip++;
+    }
+
+    // Step 2: Write the finer mips out, named after the image file. ---------------------------------------------------
+    snprintf(mipName, sizeof(mipName), "/%016llx.mips", (unsigned long long)std::hash<std::string>()(filename));
+    m_mipFilename = std::string(streamer->GetMipDirectory()) + mipName;
+    result = WriteStreamedMips(mipChain, initialMip);
+    if (!result) { return false; }
+
+    // Step 3: Nothing is resident yet (resident mip = mip count), load the initial mips.
+    m_device = device;
+    m_deviceContext = deviceContext;
+    m_residentMip = m_mipCount;
+    result = CreateResidentTexture(initialMip, &mipChain);
+    if (!result) { return false; }
+
+    m_streamer = streamer;
+    m_streamer->Register(this, initialMip);
+
+    return true;
+}
+
+// The levels [0, initialMip) one after the other, finest first, as the generator built them.
+bool TextureClass::WriteStreamedMips(const MipChain& chain, int initialMip)
+{
+    int error, level;
+    FILE* filePtr;
+    size_t count;
+
+    error = fopen_s(&filePtr, m_mipFilename.c_str(), "wb");
+    if (error != 0) { return false; }
+
+    for (level = 0; level < initialMip; level++) {
+        const std::vector<unsigned char>& pixels = chain.levels[level].pixels;
+        count = fwrite(pixels.data(), 1, pixels.size(), filePtr);
+        if (count != pixels.size()) { break; }
+    }
+
+    error = fclose(filePtr);
+
+    return (level == initialMip) && (error == 0);
+}
+
+// Reads the levels [first, last) into their place in the chain, with one seek and one read per level.
+bool TextureClass::ReadStreamedMips(int first, int last, MipChain& chain)
+{
+    int error, level;
+    FILE* filePtr;
+    long offset = 0;
+    size_t count;
+
+    chain.levels.resize(m_mipCount);
+    for (level = 0; level < first; level++) { offset += (long)GetMipBytes(level); }
+
+    error = fopen_s(&filePtr, m_mipFilename.c_str(), "rb");
+    if (error != 0) { return false; }
+
+    error = fseek(filePtr, offset, SEEK_SET);
+    for (level = first; (level < last) && (error == 0); level++) {
+        MipLevelData& levelData = chain.levels[level];
+        levelData.width = GetMipSize(m_width, level);
+        levelData.height = GetMipSize(m_height, level);
+        levelData.pixels.resize((size_t)GetMipBytes(level));
+
+        count = fread(levelData.pixels.data(), 1, levelData.pixels.size(), filePtr);
+        if (count != levelData.pixels.size()) { error = 1; }
+    }
+
+    fclose(filePtr);
+
+    return (error == 0);
+}
+
+// Only streaming in reads the file, streaming out keeps levels the GPU already has. The streamer changes a texture once
+// per frame at most, so the levels read here are all the ones the frame streams in for it.
+bool TextureClass::SetResidentMip(int mip)
+{
+    bool result;
+    MipChain mipChain;
+
+    if ((mip < 0) || (mip >= m_mipCount)) { return false; }
+    if (mip == m_residentMip) { return true; }
+
+    if (mip < m_residentMip) {
+        result = ReadStreamedMips(mip, m_residentMip, mipChain);
+        if (!result) { return false; }
+    }
+
+    return CreateResidentTexture(mip, &mipChain);
+}
+
+// Changing the resident mips means creating a new texture holding the levels [mip, mipCount). The levels both
+// textures have in common are copied on the GPU, only the newly streamed in levels are uploaded from the chain.
+// The shader resource view changes with it, so GetTexture must be called again every frame (which all callers do).
+bool TextureClass::CreateResidentTexture(int mip, const MipChain* chain)
+{
+    HRESULT hResult;
+    int level, sourceLevel, levelCount;
+    ID3D11Texture2D* texture = nullptr;
+    ID3D11ShaderResourceView* textureView = nullptr;
+
+    levelCount = m_mipCount - mip;
+
+    // Step 1: Create the texture for the new set of resident mips. ----------------------------------------------------
+    D3D11_TEXTURE2D_DESC textureDesc;
+    textureDesc.Width = GetMipSize(m_width, mip);
+    textureDesc.Height = GetMipSize(m_height, mip);
+    textureDesc.MipLevels = levelCount;
+    textureDesc.ArraySize = 1;
+    textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.SampleDesc.Quality = 0;
+    textureDesc.Usage = D3D11_USAGE_DEFAULT;
+    textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    textureDesc.CPUAccessFlags = 0;
+    textureDesc.MiscFlags = 0;
+
+    hResult = m_device->CreateTexture2D(&textureDesc, NULL, &texture);
+    if (FAILED(hResult)) { return false; }
+
+    // Step 2: Fill its levels, from the old texture when possible, from the chain otherwise. ------------------------
+    m_residentBytes = 0;
+    for (level = 0; level < levelCount; level++) {
+        sourceLevel = mip + level;
+
+        if ((m_texture != nullptr) && (sourceLevel >= m_residentMip)) {
+            m_deviceContext->CopySubresourceRegion(texture, level, 0, 0, 0, m_texture, sourceLevel - m_residentMip, NULL);
+        } else {
+            const MipLevelData& levelData = chain->levels[sourceLevel];
+            m_deviceContext->UpdateSubresource(texture, level, NULL, levelData.pixels.data(), levelData.width * 4, 0);
+        }
+
+        m_residentBytes += GetMipBytes(sourceLevel);
+    }
+
+    // Step 3: Create the view and replace the old texture. --------------------------------------------------------------
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+    srvDesc.Format = textureDesc.Format;
+    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Texture2D.MostDetailedMip = 0;
+    srvDesc.Texture2D.MipLevels = -1;
+
+    hResult = m_device->CreateShaderResourceView(texture, &srvDesc, &textureView);
+    if (FAILED(hResult)) {
+        texture->Release();
+        return false;
+    }
+
+    RT_RELEASE_ID3D11_PTR(m_textureView);
+    RT_RELEASE_ID3D11_PTR(m_texture);
+    m_texture = texture;
+    m_textureView = textureView;
+    m_residentMip = mip;
 
     return true;
 }
 
 void TextureClass::Shutdown()
 {
+    if (m_streamer) {
+        m_streamer->Unregister(this);
+        m_streamer = nullptr;
+    }
+    m_device = nullptr;
+    m_deviceContext = nullptr;
     RT_RELEASE_ID3D11_PTR(m_textureView);
     RT_RELEASE_ID3D11_PTR(m_texture);
     RT_RELEASE_OBJ_PTR_ARR(m_targaData);
@@ -186,4 +496,30 @@ int TextureClass::GetHeight()
     return m_height;
 }
 
+int TextureClass::GetArraySize()
+{
+    return m_arraySize;
+}
+
+int TextureClass::GetMipCount()
+{
+    return m_mipCount;
+}
+
+int TextureClass::GetResidentMip()
+{
+    return m_residentMip;
+}
+
+unsigned long long TextureClass::GetMipBytes(int mip)
+{
+    if ((mip < 0) || (mip >= m_mipCount)) { return 0; }
+    return (unsigned long long)GetMipSize(m_width, mip) * GetMipSize(m_height, mip) * 4;
+}
+
+unsigned long long TextureClass::GetResidentBytes()
+{
+    return m_residentBytes;
+}
+
 // --------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,307 @@
+// Filename: texturestreamerclass.cpp
+#include "texturestreamerclass.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+
+// --------------------------------------------------------------------------------------------------------------------
+TextureStreamerClass::TextureStreamerClass()
+{
+    m_frame = 0;
+}
+
+TextureStreamerClass::TextureStreamerClass(const TextureStreamerClass& other)
+{
+}
+
+TextureStreamerClass::~TextureStreamerClass()
+{
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+bool TextureStreamerClass::Initialize(const TextureStreamerConfig& config)
+{
+    std::error_code error;
+
+    m_config = config;
+    m_frame = 0;
+
+    if (m_config.mipDirectory != nullptr) {
+        std::filesystem::create_directories(m_config.mipDirectory, error);
+        if (!std::filesystem::is_directory(m_config.mipDirectory, error)) { return false; }
+    }
+
+    return true;
+}
+
+void TextureStreamerClass::Shutdown()
+{
+    // The textures themselves are owned (and shut down) by their models / bitmaps.
+    m_entries.clear();
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+void TextureStreamerClass::Register(StreamedTextureClass* texture, int minimumMip)
+{
+    StreamEntry entry;
+
+    entry.texture = texture;
+    entry.requestedMip = -1;
+    entry.wantedMip = minimumMip;
+    entry.minimumMip = minimumMip;
+    entry.plannedMip = texture->GetResidentMip();
+    entry.lastRequestFrame = m_frame;
+    m_entries.push_back(entry);
+
+    return;
+}
+
+void TextureStreamerClass::Unregister(StreamedTextureClass* texture)
+{
+    m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(),
+                                   [texture](const StreamEntry& entry) { return entry.texture == texture; }),
+                    m_entries.end());
+    return;
+}
+
+TextureStreamerClass::StreamEntry* TextureStreamerClass::FindEntry(StreamedTextureClass* texture)
+{
+    for (auto& entry : m_entries) {
+        if (entry.texture == texture) { return &entry; }
+    }
+
+    return nullptr;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Several objects may use the same texture during a frame, the most detailed request wins.
+void TextureStreamerClass::RequestMip(StreamedTextureClass* texture, int mip)
+{
+    StreamEntry* entry = FindEntry(texture);
+    if (entry == nullptr) { return; }
+
+    mip = std::max(0, std::min(mip, entry->minimumMip));
+    if ((entry->requestedMip < 0) || (mip < entry->requestedMip)) { entry->requestedMip = mip; }
+
+    return;
+}
+
+void TextureStreamerClass::RequestProjectedSize(StreamedTextureClass* texture, float projectedWidth, float projectedHeight)
+{
+    RequestMip(texture, ComputeRequiredMip(texture->GetWidth(), texture->GetHeight(), projectedWidth, projectedHeight));
+    return;
+}
+
+// The mip needed is the one whose size is closest to (but not below) the number of pixels the texture covers on
+// screen: every level above it would only be minified away by the sampler.
+int TextureStreamerClass::ComputeRequiredMip(int textureWidth, int textureHeight, float projectedWidth, float projectedHeight)
+{
+    float ratio;
+
+    if ((projectedWidth <= 0.0f) || (projectedHeight <= 0.0f)) { return TEXTURE_STREAMER_NO_MIP; }
+
+    ratio = std::max((float)textureWidth / projectedWidth, (float)textureHeight / projectedHeight);
+    if (ratio <= 1.0f) { return 0; }
+
+    return (int)floorf(log2f(ratio));
+}
+
+// Approximate on screen diameter in pixels of a bounding sphere. projectionScaleY is the [1][1] element of the
+// projection matrix (1 / tan(fovY / 2)).
+float TextureStreamerClass::ComputeProjectedSize(float radius, float distance, float projectionScaleY, int screenHeight)
+{
+    if (distance <= radius) { return (float)screenHeight; }
+    return (radius / distance) * projectionScaleY * (float)screenHeight;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Update is called once per frame, after all the requests for the frame have been made. The evictions and the stream
+// ins are planned first and then applied, so a texture changes its resident mips (and loads its levels) once a frame.
+bool TextureStreamerClass::Update()
+{
+    bool result;
+    unsigned long long residentBytes = 0;
+
+    m_frame++;
+
+    // Step 1: Resolve the mip every texture wants from this frame's requests. -----------------------------------------
+    for (auto& entry : m_entries) {
+        if (entry.requestedMip >= 0) {
+            entry.wantedMip = entry.requestedMip;
+            entry.lastRequestFrame = m_frame;
+        } else if ((m_frame - entry.lastRequestFrame) > m_config.requestTimeoutFrames) {
+            entry.wantedMip = entry.minimumMip;
+        }
+        entry.requestedMip = -1;
+        entry.plannedMip = entry.texture->GetResidentMip();
+        residentBytes += entry.texture->GetResidentBytes();
+    }
+
+    // Step 2: Evict until the resident mips fit in the budget again. ------------------------------------------------
+    EvictOverBudget(residentBytes);
+
+    // Step 3: Stream in the finer mips that are missing, within the budget. ------------------------------------------
+    StreamIn(residentBytes);
+
+    // Step 4: Apply the plan, the evictions first so the memory is free before the new levels are created. -------------
+    for (auto& entry : m_entries) {
+        if (entry.plannedMip > entry.texture->GetResidentMip()) {
+            result = entry.texture->SetResidentMip(entry.plannedMip);
+            if (!result) { return false; }
+        }
+    }
+    for (auto& entry : m_entries) {
+        if (entry.plannedMip < entry.texture->GetResidentMip()) {
+            result = entry.texture->SetResidentMip(entry.plannedMip);
+            if (!result) { return false; }
+        }
+    }
+
+    return true;
+}
+
+// The resident bytes of a texture once the plan is applied.
+unsigned long long TextureStreamerClass::GetPlannedBytes(const StreamEntry& entry)
+{
+    int mip, residentMip = entry.texture->GetResidentMip();
+    unsigned long long bytes = entry.texture->GetResidentBytes();
+
+    for (mip = entry.plannedMip; mip < residentMip; mip++) { bytes += entry.texture->GetMipBytes(mip); }
+    for (mip = residentMip; mip < entry.plannedMip; mip++) { bytes -= entry.texture->GetMipBytes(mip); }
+
+    return bytes;
+}
+
+// The texture to lose its finest planned mip next: the textures holding more detail than they want first, then
+// the ones requested the longest ago, then the largest. With a candidate (a texture the room is made for), only the
+// textures holding more than they want or requested before the candidate qualify, never the candidate itself.
+TextureStreamerClass::StreamEntry* TextureStreamerClass::FindVictim(const StreamEntry* candidate)
+{
+    StreamEntry* victim = nullptr;
+
+    for (auto& entry : m_entries) {
+        if (entry.plannedMip >= entry.minimumMip) { continue; }
+
+        bool entryOver = (entry.plannedMip < entry.wantedMip);
+        if (candidate != nullptr) {
+            if (&entry == candidate) { continue; }
+            if (!entryOver && (entry.lastRequestFrame >= candidate->lastRequestFrame)) { continue; }
+        }
+
+        if (victim == nullptr) { victim = &entry; continue; }
+
+        bool victimOver = (victim->plannedMip < victim->wantedMip);
+        if (entryOver != victimOver) {
+            if (entryOver) { victim = &entry; }
+        } else if (entry.lastRequestFrame != victim->lastRequestFrame) {
+            if (entry.lastRequestFrame < victim->lastRequestFrame) { victim = &entry; }
+        } else if (GetPlannedBytes(entry) > GetPlannedBytes(*victim)) {
+            victim = &entry;
+        }
+    }
+
+    return victim;
+}
+
+// Eviction is lazy: mips that are no longer needed stay resident as a cache as long as the budget allows it.
+// When over budget (the budget was lowered), the finest mips go one level at a time.
+void TextureStreamerClass::EvictOverBudget(unsigned long long& residentBytes)
+{
+    while (residentBytes > m_config.budgetBytes) {
+        StreamEntry* victim = FindVictim(nullptr);
+
+        // Everything is already down to its initial mips, nothing more can be evicted.
+        if (victim == nullptr) { break; }
+
+        residentBytes -= victim->texture->GetMipBytes(victim->plannedMip);
+        victim->plannedMip++;
+    }
+
+    return;
+}
+
+// Finer mips are planned one level per texture per pass, the textures requested last first and among them the ones
+// missing the most levels, until the per frame upload limit is used or nothing more fits in the budget. A level that
+// does not fit first evicts what FindVictim gives up for it, and is only skipped when that is not enough. The textures
+// requested before that one then wait: the room they would take is the room it is missing, they would only be
+// evicted again for it.
+void TextureStreamerClass::StreamIn(unsigned long long& residentBytes)
+{
+    bool progress, blocked = false;
+    unsigned int blockedFrame = 0;
+    unsigned long long uploaded = 0;
+    std::vector<StreamEntry*> candidates;
+
+    do {
+        progress = false;
+
+        candidates.clear();
+        for (auto& entry : m_entries) {
+            if (entry.wantedMip < entry.plannedMip) { candidates.push_back(&entry); }
+        }
+
+        std::sort(candidates.begin(), candidates.end(), [](StreamEntry* a, StreamEntry* b) {
+            if (a->lastRequestFrame != b->lastRequestFrame) { return a->lastRequestFrame > b->lastRequestFrame; }
+            return (a->plannedMip - a->wantedMip) > (b->plannedMip - b->wantedMip);
+        });
+
+        for (auto entry : candidates) {
+            if (blocked && (entry->lastRequestFrame < blockedFrame)) { break; }
+
+            int nextMip = entry->plannedMip - 1;
+            unsigned long long levelBytes = entry->texture->GetMipBytes(nextMip);
+
+            if ((uploaded > 0) && ((uploaded + levelBytes) > m_config.uploadBytesPerFrame)) { return; }
+
+            while ((residentBytes + levelBytes) > m_config.budgetBytes) {
+                StreamEntry* victim = FindVictim(entry);
+                if (victim == nullptr) { break; }
+
+                residentBytes -= victim->texture->GetMipBytes(victim->plannedMip);
+                victim->plannedMip++;
+            }
+            if ((residentBytes + levelBytes) > m_config.budgetBytes) {
+                blocked = true;
+                blockedFrame = entry->lastRequestFrame;
+                continue;
+            }
+
+            entry->plannedMip = nextMip;
+            uploaded += levelBytes;
+            residentBytes += levelBytes;
+            progress = true;
+        }
+    } while (progress);
+
+    return;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int TextureStreamerClass::GetInitialResidentSize()
+{
+    return m_config.initialResidentSize;
+}
+
+const char* TextureStreamerClass::GetMipDirectory()
+{
+    return (m_config.mipDirectory != nullptr) ? m_config.mipDirectory : ".";
+}
+
+unsigned long long TextureStreamerClass::GetResidentBytes()
+{
+    unsigned long long total = 0;
+
+    for (auto& entry : m_entries) { total += entry.texture->GetResidentBytes(); }
+
+    return total;
+}
+
+unsigned long long TextureStreamerClass::GetBudgetBytes()
+{
+    return m_config.budgetBytes;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
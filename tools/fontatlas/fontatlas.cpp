@@ -0,0 +1,209 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: fontatlas.cpp : Offline glyph atlas generator.
+////////////////////////////////////////////////////////////////////////////////
+// Renders the printable ASCII characters (32 - 126) of an installed font with GDI and packs them into a 32 bit targa
+// atlas (white color, glyph coverage in alpha) plus a text file with the position and metrics of every glyph, the
+// format loaded by FontClass.
+//
+// Usage: RasterTekFontAtlas <font face> <pixel height> <output name> [atlas width]
+//   e.g. RasterTekFontAtlas "DejaVu Sans Mono" 16 dejavusansmono16
+//   writes dejavusansmono16.tga and dejavusansmono16.txt in the current directory (copy them to data/fonts).
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define FIRST_CHAR 32
+#define LAST_CHAR 126
+#define GLYPH_PADDING 1     // Empty texels around every glyph so bilinear filtering never picks up a neighbor.
+
+struct Glyph
+{
+    int id;
+    int x, y, width, height;
+    int xOffset, yOffset, xAdvance;
+    std::vector<unsigned char> coverage;
+};
+
+// --------------------------------------------------------------------------------------------------------------------
+// GGO_GRAY8_BITMAP returns 65 levels of coverage (0 - 64) in rows aligned to 4 bytes.
+static bool RenderGlyph(HDC hdc, int id, int ascent, Glyph& glyph)
+{
+    GLYPHMETRICS metrics;
+    MAT2 identity = { {0, 1}, {0, 0}, {0, 0}, {0, 1} };
+    DWORD size;
+    int row, column, pitch;
+
+    glyph.id = id;
+    size = GetGlyphOutlineA(hdc, (UINT)id, GGO_GRAY8_BITMAP, &metrics, 0, NULL, &identity);
+    if (size == GDI_ERROR) { return false; }
+
+    glyph.xAdvance = metrics.gmCellIncX;
+    glyph.xOffset = metrics.gmptGlyphOrigin.x;
+    glyph.yOffset = ascent - metrics.gmptGlyphOrigin.y;
+    glyph.width = 0;
+    glyph.height = 0;
+
+    // Blank characters (space) have no bitmap, only an advance.
+    if (size == 0) { return true; }
+
+    std::vector<unsigned char> buffer(size);
+    if (GetGlyphOutlineA(hdc, (UINT)id, GGO_GRAY8_BITMAP, &metrics, size, buffer.data(), &identity) == GDI_ERROR) { return false; }
+
+    glyph.width = metrics.gmBlackBoxX;
+    glyph.height = metrics.gmBlackBoxY;
+    pitch = (glyph.width + 3) & ~3;
+
+    glyph.coverage.resize(glyph.width * glyph.height);
+    for (row = 0; row < glyph.height; row++) {
+        for (column = 0; column < glyph.width; column++) {
+            glyph.coverage[(row * glyph.width) + column] = (unsigned char)((buffer[(row * pitch) + column] * 255 + 32) / 64);
+        }
+    }
+
+    return true;
+}
+
+// Shelf packing in character order: glyphs are placed left to right and a new row starts when the width is used.
+static int PackGlyphs(std::vector<Glyph>& glyphs, int atlasWidth)
+{
+    int x = GLYPH_PADDING, y = GLYPH_PADDING, rowHeight = 0, atlasHeight;
+
+    for (auto& glyph : glyphs) {
+        if ((x + glyph.width + GLYPH_PADDING) > atlasWidth) {
+            x = GLYPH_PADDING;
+            y += rowHeight + GLYPH_PADDING;
+            rowHeight = 0;
+        }
+        glyph.x = x;
+        glyph.y = y;
+        x += glyph.width + GLYPH_PADDING;
+        if (glyph.height > rowHeight) { rowHeight = glyph.height; }
+    }
+
+    // Round the height up to a power of two.
+    for (atlasHeight = 1; atlasHeight < (y + rowHeight + GLYPH_PADDING); atlasHeight *= 2) { }
+
+    return atlasHeight;
+}
+
+// Uncompressed 32 bit targa, stored bottom up in BGRA order like the files TextureClass loads.
+static bool WriteTarga(const char* filename, const std::vector<unsigned char>& alpha, int width, int height)
+{
+    unsigned char header[18];
+    FILE* file;
+    int row, column;
+
+    memset(header, 0, sizeof(header));
+    header[2] = 2;                              // Uncompressed true color.
+    header[12] = (unsigned char)(width & 0xFF);
+    header[13] = (unsigned char)(width >> 8);
+    header[14] = (unsigned char)(height & 0xFF);
+    header[15] = (unsigned char)(height >> 8);
+    header[16] = 32;
+    header[17] = 8;                             // 8 alpha bits, bottom left origin.
+
+    if (fopen_s(&file, filename, "wb") != 0) { return false; }
+    fwrite(header, 1, sizeof(header), file);
+
+    for (row = height - 1; row >= 0; row--) {
+        for (column = 0; column < width; column++) {
+            unsigned char pixel[4] = { 255, 255, 255, alpha[(row * width) + column] };
+            fwrite(pixel, 1, 4, file);
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+static bool WriteFontFile(const char* filename, const char* face, int pixelHeight, const char* atlasName,
+                          int atlasWidth, int atlasHeight, int lineHeight, int base, const std::vector<Glyph>& glyphs)
+{
+    FILE* file;
+
+    if (fopen_s(&file, filename, "w") != 0) { return false; }
+
+    fprintf(file, "Font: %s\n", face);
+    fprintf(file, "Atlas: ../data/fonts/%s\n", atlasName);
+    fprintf(file, "Atlas Size: %d %d\n", atlasWidth, atlasHeight);
+    fprintf(file, "Pixel Height: %d\n", pixelHeight);
+    fprintf(file, "Line Height: %d\n", lineHeight);
+    fprintf(file, "Base: %d\n", base);
+    fprintf(file, "Glyph Count: %d\n", (int)glyphs.size());
+    fprintf(file, "\nData: id x y width height xoffset yoffset xadvance\n\n");
+    for (auto& glyph : glyphs) {
+        fprintf(file, "%d %d %d %d %d %d %d %d\n", glyph.id, glyph.x, glyph.y, glyph.width, glyph.height,
+                glyph.xOffset, glyph.yOffset, glyph.xAdvance);
+    }
+
+    fclose(file);
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    HDC hdc;
+    HFONT font;
+    TEXTMETRICA textMetrics;
+    std::vector<Glyph> glyphs;
+    int pixelHeight, atlasWidth = 256, atlasHeight, id;
+
+    if (argc < 4) {
+        printf("Usage: RasterTekFontAtlas <font face> <pixel height> <output name> [atlas width]\n");
+        return 1;
+    }
+    pixelHeight = atoi(argv[2]);
+    if (argc > 4) { atlasWidth = atoi(argv[4]); }
+    if ((pixelHeight <= 0) || (atlasWidth <= 0)) { return 1; }
+
+    // Step 1: Create the font, a negative height selects the character height (without internal leading) in pixels.
+    hdc = CreateCompatibleDC(NULL);
+    font = CreateFontA(-pixelHeight, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE, ANSI_CHARSET, OUT_TT_ONLY_PRECIS,
+                       CLIP_DEFAULT_PRECIS, ANTIALIASED_QUALITY, DEFAULT_PITCH, argv[1]);
+    if (font == NULL) {
+        printf("Could not create font %s\n", argv[1]);
+        return 1;
+    }
+    SelectObject(hdc, font);
+    GetTextMetricsA(hdc, &textMetrics);
+
+    // Step 2: Render every glyph. ---------------------------------------------------------------------------------------
+    for (id = FIRST_CHAR; id <= LAST_CHAR; id++) {
+        Glyph glyph;
+        if (!RenderGlyph(hdc, id, textMetrics.tmAscent, glyph)) {
+            printf("Could not render character %d\n", id);
+            return 1;
+        }
+        glyphs.push_back(glyph);
+    }
+
+    DeleteObject(font);
+    DeleteDC(hdc);
+
+    // Step 3: Pack the glyphs and copy them into the atlas. ----------------------------------------------------------
+    atlasHeight = PackGlyphs(glyphs, atlasWidth);
+
+    std::vector<unsigned char> alpha(atlasWidth * atlasHeight, 0);
+    for (auto& glyph : glyphs) {
+        for (int row = 0; row < glyph.height; row++) {
+            memcpy(&alpha[((glyph.y + row) * atlasWidth) + glyph.x], &glyph.coverage[row * glyph.width], glyph.width);
+        }
+    }
+
+    // Step 4: Write the atlas and the glyph description. --------------------------------------------------------------
+    std::string atlasName = std::string(argv[3]) + ".tga";
+    std::string fontName = std::string(argv[3]) + ".txt";
+    if (!WriteTarga(atlasName.c_str(), alpha, atlasWidth, atlasHeight)) { return 1; }
+    if (!WriteFontFile(fontName.c_str(), argv[1], pixelHeight, atlasName.c_str(), atlasWidth, atlasHeight,
+                       textMetrics.tmHeight + textMetrics.tmExternalLeading, textMetrics.tmAscent, glyphs)) { return 1; }
+
+    printf("Wrote %s (%dx%d) and %s\n", atlasName.c_str(), atlasWidth, atlasHeight, fontName.c_str());
+
+    return 0;
+}